@@ -2,6 +2,8 @@
 #include <cmath>
 #include <iostream>
 
+#include "../Math/FastMath.h"
+
 void MomentumCorrection::AddPiecewiseCorrection(int pid, const RegionWithDetector& region, CorrectionFunction func) {
   p_corrections_[pid].emplace_back(RegionCorrection{region, func});
 }
@@ -53,7 +55,10 @@ MomentumCorrection::RECExtendStoreType MomentumCorrection::RECParticlePxCorrecte
     std::vector<float> result(p.size());
     for (size_t i = 0; i < p.size(); ++i) {
       float p_corr = GetCorrectedP(pid[i], p[i], theta[i], phi[i], status[i]);
-      result[i] = p_corr * std::sin(theta[i]) * std::cos(phi[i]);
+      float sinTheta, cosTheta, sinPhi, cosPhi;
+      FastMath::SinCos(theta[i], sinTheta, cosTheta);
+      FastMath::SinCos(phi[i], sinPhi, cosPhi);
+      result[i] = p_corr * sinTheta * cosPhi;
     }
     return result;
   };
@@ -78,7 +83,10 @@ MomentumCorrection::RECExtendStoreType MomentumCorrection::RECParticlePyCorrecte
     std::vector<float> result(p.size());
     for (size_t i = 0; i < p.size(); ++i) {
       float p_corr = GetCorrectedP(pid[i], p[i], theta[i], phi[i], status[i]);
-      result[i] = p_corr * std::sin(theta[i]) * std::sin(phi[i]);
+      float sinTheta, cosTheta, sinPhi, cosPhi;
+      FastMath::SinCos(theta[i], sinTheta, cosTheta);
+      FastMath::SinCos(phi[i], sinPhi, cosPhi);
+      result[i] = p_corr * sinTheta * sinPhi;
     }
     return result;
   };
@@ -103,7 +111,7 @@ MomentumCorrection::RECExtendStoreType MomentumCorrection::RECParticlePzCorrecte
     std::vector<float> result(p.size());
     for (size_t i = 0; i < p.size(); ++i) {
       float p_corr = GetCorrectedP(pid[i], p[i], theta[i], phi[i], status[i]);
-      result[i] = p_corr * std::cos(theta[i]);
+      result[i] = p_corr * FastMath::Cos(theta[i]);
     }
     return result;
   };
@@ -1,12 +1,62 @@
 
 #include "EventCut.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <iostream>
+#include <numeric>
+#include <sstream>
+
+#include "../Math/FastMath.h"
+
+CutOrderStats::CutOrderStats(std::vector<std::string> cutNames, long warmupEvents)
+    : names(std::move(cutNames)), warmup(warmupEvents), nanoseconds(names.size()), rejected(names.size()) {}
+
+void CutOrderStats::Learn() {
+  const size_t n = names.size();
+  std::vector<double> cost(n), costPerReject(n);
+  for (size_t c = 0; c < n; ++c) {
+    cost[c] = static_cast<double>(nanoseconds[c].load(std::memory_order_relaxed));
+    const long r = rejected[c].load(std::memory_order_relaxed);
+    costPerReject[c] = r > 0 ? cost[c] / r : HUGE_VAL;
+  }
+  order.resize(n);
+  std::iota(order.begin(), order.end(), 0);
+  // cuts that never rejected go last, cheapest first
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    if (costPerReject[a] != costPerReject[b]) return costPerReject[a] < costPerReject[b];
+    return cost[a] < cost[b];
+  });
+  ready.store(true, std::memory_order_release);
+
+  const long events = recorded.load(std::memory_order_relaxed);
+  std::cout << "[EventCut] adaptive cut order after " << events << " events:";
+  for (size_t c : order) {
+    std::cout << " " << names[c] << " (rejects " << 100.0 * rejected[c].load() / std::max(events, 1L) << "%, " << cost[c] / std::max(events, 1L) << " ns)";
+  }
+  std::cout << std::endl;
+}
+
+namespace {
+// RDataFrame calls the same EventCut from every slot, so the scratch buffers are per thread
+struct KinematicsScratch {
+  std::vector<float> p2, pt, theta, phi;
+};
+KinematicsScratch& Scratch() {
+  static thread_local KinematicsScratch scratch;
+  return scratch;
+}
+}  // namespace
 
 EventCut::EventCut() = default;
 EventCut::~EventCut() = default;
 
+void EventCut::SetAdaptiveOrder(bool adaptive, long warmupEvents) {
+  fWarmupEvents = adaptive ? std::max(warmupEvents, 1L) : 0;
+  fOrderStats = adaptive ? std::make_shared<CutOrderStats>(GetCutNames(), fWarmupEvents) : nullptr;
+}
+
 void EventCut::AddParticleCut(const std::string& name, const ParticleCut& userCut) {
   ParticleCut cut = userCut;
 
@@ -38,6 +88,9 @@ void EventCut::AddParticleCut(const std::string& name, const ParticleCut& userCu
   }
 
   fParticleCuts[name] = cut;
+  fCutTable.clear();
+  for (const auto& [cutName, particleCut] : fParticleCuts) fCutTable.push_back(particleCut);
+  if (fOrderStats) SetAdaptiveOrder(true, fWarmupEvents);
 }
 
 void EventCut::AddParticleMotherCut(const std::string& name, const TwoBodyMotherCut& userCut) {
@@ -61,6 +114,27 @@ const ParticleCut* EventCut::GetParticleCut(const std::string& name) const {
   return (it != fParticleCuts.end()) ? &it->second : nullptr;
 }
 
+std::vector<std::string> EventCut::GetCutNames() const {
+  std::vector<std::string> names;
+  for (const auto& [name, cut] : fParticleCuts) names.push_back(name);
+  return names;
+}
+
+std::string EventCut::Fingerprint(bool motherCut) const {
+  std::ostringstream os;
+  os.precision(9);
+  os << "acceptEverything " << fAcceptEverything << " motherCut " << motherCut;
+  for (const auto& [name, c] : fParticleCuts) {
+    os << "\n" << name << ": " << c.charge << " " << c.pid << " " << c.minCount << " " << c.maxCount << " " << c.minCDMomentum << " " << c.minFDMomentum << " "
+       << c.minFTMomentum << " " << c.maxCDMomentum << " " << c.maxFDMomentum << " " << c.maxFTMomentum << " " << c.minBeta << " " << c.maxBeta << " " << c.minTheta
+       << " " << c.maxTheta << " " << c.minPhi << " " << c.maxPhi << " " << c.minVz << " " << c.maxVz << " " << c.minChi2PID << " " << c.maxChi2PID << " " << c.minScore << " " << c.maxScore;
+  }
+  for (const auto& [name, c] : fTwoBodyMotherCuts) {
+    os << "\nmother " << name << ": " << c.charge << " " << c.pidDaug1 << " " << c.pidDaug2 << " " << c.expectedMotherMass << " " << c.massSigma << " " << c.nSigmaMass;
+  }
+  return os.str();
+}
+
 EventCut* EventCut::ProtonCuts() {
   EventCut* cuts = new EventCut();
   cuts->AddParticleCut("proton", ParticleCut());
@@ -83,29 +157,75 @@ EventCutResult EventCut::operator()(const std::vector<int>& pid, const std::vect
                                     const std::vector<float>& vx, const std::vector<float>& vy, const std::vector<float>& vz, const std::vector<float>& vt,
                                     const std::vector<short>& charge, const std::vector<float>& beta, const std::vector<float>& chi2pid, const std::vector<short>& status,
                                     const std::vector<int>& REC_Track_pass_fid) const {
+  return Evaluate(pid, px, py, pz, vx, vy, vz, vt, charge, beta, chi2pid, status, REC_Track_pass_fid, nullptr);
+}
+
+std::function<EventCutResult(const std::vector<int>&, const std::vector<float>&, const std::vector<float>&, const std::vector<float>&, const std::vector<float>&,
+                             const std::vector<float>&, const std::vector<float>&, const std::vector<float>&, const std::vector<short>&, const std::vector<float>&,
+                             const std::vector<float>&, const std::vector<short>&, const std::vector<int>&, const std::vector<float>&)>
+EventCut::WithScore() const {
+  return [cuts = *this](const std::vector<int>& pid, const std::vector<float>& px, const std::vector<float>& py, const std::vector<float>& pz, const std::vector<float>& vx,
+                        const std::vector<float>& vy, const std::vector<float>& vz, const std::vector<float>& vt, const std::vector<short>& charge,
+                        const std::vector<float>& beta, const std::vector<float>& chi2pid, const std::vector<short>& status, const std::vector<int>& REC_Track_pass_fid,
+                        const std::vector<float>& score) {
+    return cuts.Evaluate(pid, px, py, pz, vx, vy, vz, vt, charge, beta, chi2pid, status, REC_Track_pass_fid, &score);
+  };
+}
+
+EventCutResult EventCut::Evaluate(const std::vector<int>& pid, const std::vector<float>& px, const std::vector<float>& py, const std::vector<float>& pz,
+                                  const std::vector<float>& vx, const std::vector<float>& vy, const std::vector<float>& vz, const std::vector<float>& vt,
+                                  const std::vector<short>& charge, const std::vector<float>& beta, const std::vector<float>& chi2pid, const std::vector<short>& status,
+                                  const std::vector<int>& REC_Track_pass_fid, const std::vector<float>* score) const {
   EventCutResult result;
   result.particlePass.resize(pid.size(), false);
   result.particleDaughterPass.resize(pid.size(), false);
   result.MaxPhotonEnergyPass.resize(pid.size(), false);
   result.MotherMass.resize(pid.size(), -999);
+  result.cutCounts.assign(fCutTable.size(), 0);
 
   bool allCutsPassed = true;
   float MaxEphotonEnergy = 0.0f;
   float MaxPhotonEnergyIndex = 0;
 
-  for (const auto& [name, cut] : fParticleCuts) {
+  // Kinematics once per particle instead of once per particle and cut, in per-thread buffers
+  // that keep their capacity between events. With FastMath::SetExact(false) the angles use the
+  // kernels; theta/phi within FastMath::kGuard of a cut edge are recomputed with libm, so the
+  // selection is identical to the libm one.
+  const size_t n = pid.size();
+  auto& scratch = Scratch();
+  auto &p2 = scratch.p2, &pt = scratch.pt, &theta = scratch.theta, &phiv = scratch.phi;
+  p2.resize(n);
+  pt.resize(n);
+  theta.resize(n);
+  phiv.resize(n);
+  for (size_t i = 0; i < n; ++i) {
+    pt[i] = std::sqrt(px[i] * px[i] + py[i] * py[i]);
+    p2[i] = px[i] * px[i] + py[i] * py[i] + pz[i] * pz[i];
+  }
+  FastMath::Atan2(pt.data(), pz.data(), theta.data(), n);
+  FastMath::Atan2(py.data(), px.data(), phiv.data(), n);
+  for (size_t i = 0; i < n; ++i) {
+    if (phiv[i] < 0) phiv[i] += 2 * M_PI;
+  }
+
+  // Number of particles passing one cut. With stopAbove the loop ends once the count exceeds
+  // maxCount, at which point the event has already failed.
+  const auto countParticles = [&](const ParticleCut& cut, bool stopAbove) {
     int count = 0;
     for (size_t i = 0; i < pid.size(); ++i) {
-      const float p2 = px[i] * px[i] + py[i] * py[i] + pz[i] * pz[i];
-      if (p2 < 1e-4f) continue;
+      if (p2[i] < 1e-4f) continue;
 
       if (pid[i] != cut.pid || charge[i] != cut.charge || REC_Track_pass_fid[i] != 1) continue;
       if (!IsInRange(chi2pid[i], cut.minChi2PID, cut.maxChi2PID)) continue;
+      if (score && !IsInRange((*score)[i], cut.minScore, cut.maxScore)) continue;
 
-      const float momentum = std::sqrt(p2);
-      const float theta = std::atan2(std::sqrt(px[i] * px[i] + py[i] * py[i]), pz[i]);
-      float phi = std::atan2(py[i], px[i]);
-      if (phi < 0) phi += 2 * M_PI;
+      const float momentum = std::sqrt(p2[i]);
+      const auto exactTheta = [&]() -> float { return std::atan2(pt[i], pz[i]); };
+      const auto exactPhi = [&]() -> float {
+        float phi = std::atan2(py[i], px[i]);
+        if (phi < 0) phi += 2 * M_PI;
+        return phi;
+      };
       int statusAbs = std::abs(status[i]);
       // cut based on momentum and status of th detector of the particle
       bool momentumFTCut = IsInRange(momentum, cut.minFTMomentum, cut.maxFTMomentum) && (statusAbs >= 1000 && statusAbs < 2000);
@@ -114,8 +234,8 @@ EventCutResult EventCut::operator()(const std::vector<int>& pid, const std::vect
       bool momentumCut = momentumFTCut || momentumFDCut || momentumCDCut;
 
       bool betaCut = IsInRange(beta[i], cut.minBeta, cut.maxBeta);
-      bool thetaCut = IsInRange(theta, cut.minTheta, cut.maxTheta);
-      bool phiCut = IsInRange(phi, cut.minPhi, cut.maxPhi);
+      bool thetaCut = FastMath::InRangeGuarded(theta[i], cut.minTheta, cut.maxTheta, exactTheta);
+      bool phiCut = FastMath::InRangeGuarded(phiv[i], cut.minPhi, cut.maxPhi, exactPhi);
       bool vzCut = IsInRange(vz[i], cut.minVz, cut.maxVz);
       if (momentumCut && betaCut && thetaCut && phiCut && vzCut) {
         result.particlePass[i] = true;
@@ -126,20 +246,47 @@ EventCutResult EventCut::operator()(const std::vector<int>& pid, const std::vect
             MaxPhotonEnergyIndex = i;
         }
         ++count;
+        if (stopAbove && count > cut.maxCount) break;
       }
     }
+    return count;
+  };
 
+  // Adaptive order (SetAdaptiveOrder): name order and timing until the warm-up window is
+  // complete, then the learned order with an exit at the first failing cut. Never with
+  // AcceptEverything, where every count is needed.
+  CutOrderStats* stats = fAcceptEverything ? nullptr : fOrderStats.get();
+  const bool earlyExit = stats && stats->ready.load(std::memory_order_acquire);
 
-    if (!IsInRange(count, cut.minCount, cut.maxCount)) {
-      allCutsPassed = false;
+  if (earlyExit) {
+    for (size_t c : stats->order) {
+      const ParticleCut& cut = fCutTable[c];
+      result.cutCounts[c] = countParticles(cut, true);
+      if (!IsInRange(result.cutCounts[c], cut.minCount, cut.maxCount)) {
+        allCutsPassed = false;
+        break;
+      }
+    }
+  } else {
+    for (size_t c = 0; c < fCutTable.size(); ++c) {
+      const ParticleCut& cut = fCutTable[c];
+      const auto start = stats ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+      result.cutCounts[c] = countParticles(cut, false);
+      const bool failed = !IsInRange(result.cutCounts[c], cut.minCount, cut.maxCount);
+      if (failed) allCutsPassed = false;
+      if (stats) {
+        stats->nanoseconds[c].fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+        if (failed) stats->rejected[c].fetch_add(1, std::memory_order_relaxed);
+      }
     }
+    if (stats && stats->recorded.fetch_add(1, std::memory_order_acq_rel) + 1 == stats->warmup) stats->Learn();
   }
 
   if (fAcceptEverything) {
     allCutsPassed = true;
   }
 
-  if (fCutTwoBodyMotherDecay) {
+  if (fCutTwoBodyMotherDecay && !(earlyExit && !allCutsPassed)) {
     for (const auto& [name, cut] : fTwoBodyMotherCuts) {
       for (size_t i = 0; i < pid.size(); ++i) {
         if (pid[i] != cut.pidDaug1) continue;
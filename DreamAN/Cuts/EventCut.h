@@ -5,8 +5,11 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <atomic>
+#include <memory>
 #include <cfloat>
 #include <cmath>
+#include <functional>
 
 struct ParticleCut {
   int charge = 0;
@@ -31,6 +34,9 @@ struct ParticleCut {
   float maxVz = 999;
   float minChi2PID = -999999;
   float maxChi2PID = 999999;
+  // classifier score (REC_Photon_score, PhotonClassifier), only applied by EventCut::WithScore()
+  float minScore = -999;
+  float maxScore = 999;
 };
 
 struct TwoBodyMotherCut {
@@ -48,6 +54,23 @@ struct EventCutResult {
   std::vector<bool> particleDaughterPass;
   std::vector<bool> MaxPhotonEnergyPass;
   std::vector<float> MotherMass; // corresponding
+  std::vector<int> cutCounts; // selected particles per particle cut, in EventCut::GetCutNames() order
+};
+
+// Shared by all copies of an EventCut (RDataFrame copies the callable), updated from every slot.
+// During the warm-up window the particle cuts run in name order and each cut's time and number
+// of failed events are accumulated; Learn() then fixes the order by time per rejected event.
+struct CutOrderStats {
+  CutOrderStats(std::vector<std::string> cutNames, long warmupEvents);
+  void Learn();
+
+  std::vector<std::string> names;
+  long warmup = 0;
+  std::atomic<long> recorded{0};
+  std::vector<std::atomic<long long>> nanoseconds;
+  std::vector<std::atomic<long>> rejected;
+  std::vector<size_t> order;  // written once by Learn(), read after ready
+  std::atomic<bool> ready{false};
 };
 
 static inline float ParticleMassPDG(int pid) {
@@ -76,11 +99,25 @@ class EventCut {
   EventCut();
   virtual ~EventCut();
   void SetDoCutMotherInvMass(bool doCut) { fCutTwoBodyMotherDecay = doCut; }
+  bool GetDoCutMotherInvMass() const { return fCutTwoBodyMotherDecay; }
   void AddParticleCut(const std::string& name, const ParticleCut& cut);
   void AddParticleMotherCut(const std::string& name, const TwoBodyMotherCut& cut);
   void AcceptEverything(bool accept) { fAcceptEverything = accept; }
+  // Adaptive cut order: after warmupEvents the particle cuts are evaluated cheapest-rejecting
+  // first and the event stops at the first failing count. eventPass is unchanged; for failing
+  // events the other result fields are left partial (counts of unevaluated cuts are 0 and the
+  // mother loop is skipped), so only use it where the event is filtered on REC_Event_pass.
+  void SetAdaptiveOrder(bool adaptive, long warmupEvents = 5000);
+  bool IsAdaptiveOrder() const { return fOrderStats != nullptr; }
 
   const ParticleCut* GetParticleCut(const std::string& name) const;
+  std::vector<std::string> GetCutNames() const;
+  const std::map<std::string, TwoBodyMotherCut>& GetMotherCuts() const { return fTwoBodyMotherCuts; }
+  bool IsAcceptEverything() const { return fAcceptEverything; }
+  // All cut parameters as text, e.g. for cache keys (the adaptive order does not change results and is left out)
+  std::string Fingerprint() const { return Fingerprint(fCutTwoBodyMotherDecay); }
+  // The same, for these cuts applied with the mother-mass cut set to motherCut
+  std::string Fingerprint(bool motherCut) const;
 
   static EventCut* ProtonCuts();
   static EventCut* ElectronCuts();
@@ -96,11 +133,26 @@ class EventCut {
                             const std::vector<short>& status,
                             const std::vector<int>& REC_Track_pass_fid) const;
 
+  // operator() with one more column, a per-particle score (e.g. REC_Photon_score) cut by
+  // ParticleCut::minScore/maxScore; define EventCutResult with it and the usual columns + the score
+  std::function<EventCutResult(const std::vector<int>&, const std::vector<float>&, const std::vector<float>&, const std::vector<float>&, const std::vector<float>&,
+                               const std::vector<float>&, const std::vector<float>&, const std::vector<float>&, const std::vector<short>&, const std::vector<float>&,
+                               const std::vector<float>&, const std::vector<short>&, const std::vector<int>&, const std::vector<float>&)>
+  WithScore() const;
+
  private:
+  EventCutResult Evaluate(const std::vector<int>& pid, const std::vector<float>& px, const std::vector<float>& py, const std::vector<float>& pz,
+                          const std::vector<float>& vx, const std::vector<float>& vy, const std::vector<float>& vz, const std::vector<float>& vt,
+                          const std::vector<short>& charge, const std::vector<float>& beta, const std::vector<float>& chi2pid, const std::vector<short>& status,
+                          const std::vector<int>& REC_Track_pass_fid, const std::vector<float>* score) const;
+
   bool fCutTwoBodyMotherDecay = false;
   bool fAcceptEverything = false;
+  long fWarmupEvents = 0;
   std::map<std::string, ParticleCut> fParticleCuts;
+  std::vector<ParticleCut> fCutTable;  // fParticleCuts in name order, indexable
   std::map<std::string, TwoBodyMotherCut> fTwoBodyMotherCuts;
+  std::shared_ptr<CutOrderStats> fOrderStats;
 
   template <typename T>
   bool IsInRange(T value, T min, T max) const {
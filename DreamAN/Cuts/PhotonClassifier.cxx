@@ -0,0 +1,120 @@
+#include "PhotonClassifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+enum Feature { kP, kTheta, kRegion, kEPcal, kEECin, kEECout, kSF, kM2u, kM2v, kM2w, kMgg, kOpenMin, kNPhoton, kNFeatures };
+constexpr float kPi0Mass = 0.1349768f;
+}  // namespace
+
+const std::vector<std::string>& PhotonClassifier::FeatureNames() {
+  static const std::vector<std::string> names = {"p", "theta", "region", "e_pcal", "e_ecin", "e_ecout", "sf", "m2u", "m2v", "m2w", "mgg", "open_min", "n_photon"};
+  return names;
+}
+
+const std::vector<std::string>& PhotonClassifier::Columns() {
+  static const std::vector<std::string> columns = {"REC_Particle_pid",        "REC_Particle_px",       "REC_Particle_py",        "REC_Particle_pz",
+                                                   "REC_Particle_status",     "REC_Calorimeter_pindex", "REC_Calorimeter_layer", "REC_Calorimeter_energy",
+                                                   "REC_Calorimeter_m2u",     "REC_Calorimeter_m2v",   "REC_Calorimeter_m2w"};
+  return columns;
+}
+
+PhotonClassifier::PhotonClassifier(const std::string& modelFile) : fForest(std::make_shared<DecisionForest>(DecisionForest::Load(modelFile))) {
+  const auto& names = FeatureNames();
+  for (const auto& feature : fForest->GetFeatures()) {
+    auto it = std::find(names.begin(), names.end(), feature);
+    if (it == names.end()) throw std::runtime_error("[PhotonClassifier] " + modelFile + " uses feature " + feature + ", which is not one of PhotonClassifier::FeatureNames()");
+    fInput.push_back(static_cast<size_t>(it - names.begin()));
+  }
+  std::cout << "[PhotonClassifier] " << modelFile << ": " << fForest->GetNTrees() << " trees of depth " << fForest->GetDepth() << ", " << fInput.size() << " features"
+            << std::endl;
+}
+
+std::vector<float> PhotonClassifier::FeatureTable(const std::vector<int>& pid, const std::vector<float>& px, const std::vector<float>& py, const std::vector<float>& pz,
+                                                  const std::vector<short>& status, const std::vector<int16_t>& pindex, const std::vector<int16_t>& layer,
+                                                  const std::vector<float>& energy, const std::vector<float>& m2u, const std::vector<float>& m2v,
+                                                  const std::vector<float>& m2w, std::vector<size_t>& index) {
+  index.clear();
+  std::vector<int> row(pid.size(), -1);  // REC_Particle row -> photon
+  for (size_t i = 0; i < pid.size(); ++i) {
+    if (pid[i] != 22) continue;
+    row[i] = static_cast<int>(index.size());
+    index.push_back(i);
+  }
+  const size_t n = index.size();
+  std::vector<float> table(n * kNFeatures, 0.f);
+  if (n == 0) return table;
+
+  std::vector<float> p(n);
+  for (size_t k = 0; k < n; ++k) {
+    const size_t i = index[k];
+    float* f = &table[k * kNFeatures];
+    p[k] = std::sqrt(px[i] * px[i] + py[i] * py[i] + pz[i] * pz[i]);
+    f[kP] = p[k];
+    f[kTheta] = std::atan2(std::sqrt(px[i] * px[i] + py[i] * py[i]), pz[i]);
+    f[kRegion] = static_cast<float>(std::abs(status[i]) / 1000);
+    f[kMgg] = 0.f;
+    f[kOpenMin] = static_cast<float>(M_PI);
+    f[kNPhoton] = static_cast<float>(n);
+  }
+
+  for (size_t h = 0; h < pindex.size(); ++h) {
+    if (pindex[h] < 0 || static_cast<size_t>(pindex[h]) >= row.size() || row[pindex[h]] < 0) continue;
+    float* f = &table[row[pindex[h]] * kNFeatures];
+    if (layer[h] == 1) {
+      f[kEPcal] += energy[h];
+      f[kM2u] = m2u[h];
+      f[kM2v] = m2v[h];
+      f[kM2w] = m2w[h];
+    } else if (layer[h] == 4) {
+      f[kEECin] += energy[h];
+    } else if (layer[h] == 7) {
+      f[kEECout] += energy[h];
+    }
+  }
+
+  // photon pairs: the pi0 hypothesis closest to the pi0 mass, and the closest neighbour
+  for (size_t a = 0; a < n; ++a) {
+    float* fa = &table[a * kNFeatures];
+    fa[kSF] = p[a] > 0.f ? (fa[kEPcal] + fa[kEECin] + fa[kEECout]) / p[a] : 0.f;
+    for (size_t b = a + 1; b < n; ++b) {
+      float* fb = &table[b * kNFeatures];
+      const size_t i = index[a], j = index[b];
+      const float dot = px[i] * px[j] + py[i] * py[j] + pz[i] * pz[j];
+      const float cosine = p[a] > 0.f && p[b] > 0.f ? std::clamp(dot / (p[a] * p[b]), -1.f, 1.f) : 1.f;
+      const float open = std::acos(cosine);
+      const float mgg = std::sqrt(std::max(0.f, 2.f * (p[a] * p[b] - dot)));
+      fa[kOpenMin] = std::min(fa[kOpenMin], open);
+      fb[kOpenMin] = std::min(fb[kOpenMin], open);
+      if (fa[kMgg] == 0.f || std::fabs(mgg - kPi0Mass) < std::fabs(fa[kMgg] - kPi0Mass)) fa[kMgg] = mgg;
+      if (fb[kMgg] == 0.f || std::fabs(mgg - kPi0Mass) < std::fabs(fb[kMgg] - kPi0Mass)) fb[kMgg] = mgg;
+    }
+  }
+  return table;
+}
+
+std::vector<float> PhotonClassifier::operator()(const std::vector<int>& pid, const std::vector<float>& px, const std::vector<float>& py, const std::vector<float>& pz,
+                                                const std::vector<short>& status, const std::vector<int16_t>& pindex, const std::vector<int16_t>& layer,
+                                                const std::vector<float>& energy, const std::vector<float>& m2u, const std::vector<float>& m2v,
+                                                const std::vector<float>& m2w) const {
+  std::vector<float> score(pid.size(), -1.f);
+  std::vector<size_t> index;
+  const std::vector<float> table = FeatureTable(pid, px, py, pz, status, pindex, layer, energy, m2u, m2v, m2w, index);
+
+  constexpr size_t kBlock = DecisionForest::kBlock;
+  std::vector<float> x(fInput.size() * kBlock);
+  float out[kBlock];
+  for (size_t first = 0; first < index.size(); first += kBlock) {
+    const size_t n = std::min(kBlock, index.size() - first);
+    std::fill(x.begin(), x.end(), 0.f);
+    for (size_t f = 0; f < fInput.size(); ++f) {
+      for (size_t c = 0; c < n; ++c) x[f * kBlock + c] = table[(first + c) * kNFeatures + fInput[f]];
+    }
+    fForest->ScoreBlock(x.data(), n, out);
+    for (size_t c = 0; c < n; ++c) score[index[first + c]] = out[c];
+  }
+  return score;
+}
@@ -0,0 +1,58 @@
+#ifndef PHOTONCLASSIFIER_H_
+#define PHOTONCLASSIFIER_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../Math/DecisionForest.h"
+
+// DVCS photon / pi0 decay photon score of every REC_Particle photon, from a boosted-tree model
+// (DecisionForest) evaluated inside the event loop:
+//
+//   auto classifier = std::make_shared<PhotonClassifier>("models/photon_bdt.txt");
+//   dvcsTask->SetPhotonClassifier(classifier);  // defines REC_Photon_score
+//   ParticleCut photon; photon.pid = 22; photon.minScore = 0.6f;  // applied by EventCut::WithScore()
+//
+// REC_Photon_score has one entry per REC_Particle row: the model score for pid 22 and -1 for
+// every other particle. The model may use any subset of FeatureNames(), in any order:
+//
+//   p, theta           momentum (GeV) and polar angle (rad)
+//   region             |status| / 1000: 1 FT, 2 FD, 4 CD
+//   e_pcal, e_ecin, e_ecout   REC_Calorimeter energy in layers 1, 4, 7 (GeV, 0 without a hit)
+//   sf                 (e_pcal + e_ecin + e_ecout) / p
+//   m2u, m2v, m2w      second moments of the PCAL shower (0 without a PCAL hit)
+//   mgg                mass of the photon with the partner photon closest to the pi0 mass (0 alone)
+//   open_min           smallest opening angle to another photon (rad, pi alone)
+//   n_photon           photons in the event
+//
+// The photons of an event are scored kBlock at a time; FeatureTable() gives the same features
+// as rows, e.g. to write the training sample.
+class PhotonClassifier {
+ public:
+  explicit PhotonClassifier(const std::string& modelFile);
+
+  static const std::vector<std::string>& FeatureNames();
+  // REC_Particle pid px py pz status, REC_Calorimeter pindex layer energy m2u m2v m2w
+  static const std::vector<std::string>& Columns();
+
+  std::vector<float> operator()(const std::vector<int>& pid, const std::vector<float>& px, const std::vector<float>& py, const std::vector<float>& pz,
+                                const std::vector<short>& status, const std::vector<int16_t>& pindex, const std::vector<int16_t>& layer,
+                                const std::vector<float>& energy, const std::vector<float>& m2u, const std::vector<float>& m2v, const std::vector<float>& m2w) const;
+
+  // FeatureNames().size() values per photon, photons in REC_Particle order; index gets their rows
+  static std::vector<float> FeatureTable(const std::vector<int>& pid, const std::vector<float>& px, const std::vector<float>& py, const std::vector<float>& pz,
+                                         const std::vector<short>& status, const std::vector<int16_t>& pindex, const std::vector<int16_t>& layer,
+                                         const std::vector<float>& energy, const std::vector<float>& m2u, const std::vector<float>& m2v, const std::vector<float>& m2w,
+                                         std::vector<size_t>& index);
+
+  const DecisionForest& GetForest() const { return *fForest; }
+  std::string Fingerprint() const { return fForest->Fingerprint(); }
+
+ private:
+  std::shared_ptr<const DecisionForest> fForest;  // shared by the copies RDataFrame makes
+  std::vector<size_t> fInput;                      // model feature -> FeatureNames() index
+};
+
+#endif  // PHOTONCLASSIFIER_H_
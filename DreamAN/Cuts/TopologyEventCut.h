@@ -0,0 +1,236 @@
+#ifndef TOPOLOGYEVENTCUT_H_
+#define TOPOLOGYEVENTCUT_H_
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../Math/FastMath.h"
+#include "EventCut.h"
+
+// Compile-time feature switches of a TopologyEventCut
+namespace PipelineFeature {
+constexpr unsigned kInvMass = 1u << 0;  // two-body mother mass window (pi0 -> gg, phi -> K+K-)
+}  // namespace PipelineFeature
+
+// EventCut::operator() as a column function; what the analysis tasks define EventCutResult with
+using EventCutFunction = std::function<EventCutResult(const std::vector<int>&, const std::vector<float>&, const std::vector<float>&, const std::vector<float>&,
+                                                      const std::vector<float>&, const std::vector<float>&, const std::vector<float>&, const std::vector<float>&,
+                                                      const std::vector<short>&, const std::vector<float>&, const std::vector<float>&, const std::vector<short>&,
+                                                      const std::vector<int>&)>;
+
+struct TopologySlot {
+  const char* name;  // EventCut particle cut name
+  int pid;
+};
+
+constexpr bool TopologyNameLess(const char* a, const char* b) {
+  while (*a && *a == *b) ++a, ++b;
+  return static_cast<unsigned char>(*a) < static_cast<unsigned char>(*b);
+}
+
+// Topologies: the particle slots are listed in EventCut name order (std::map order), so the
+// per-cut counts and the leading-photon bookkeeping come out exactly as in EventCut.
+struct DVCSTopology {  // e p -> e' p' gamma
+  static constexpr const char* kName = "DVCS";
+  static constexpr TopologySlot kSlots[] = {{"electron", 11}, {"photon", 22}, {"proton", 2212}};
+  static constexpr const char* kMother = nullptr;
+  static constexpr int kDaughter1 = 0, kDaughter2 = 0;
+};
+
+struct PhiTopology {  // e p -> e' p' K+ K-
+  static constexpr const char* kName = "Phi";
+  static constexpr TopologySlot kSlots[] = {{"Neg Kaon", -321}, {"Pos Kaon", 321}, {"electron", 11}, {"proton", 2212}};
+  static constexpr const char* kMother = "phi";
+  static constexpr int kDaughter1 = 321, kDaughter2 = -321;
+};
+
+struct Pi0Topology {  // e p -> e' p' gamma gamma (photon minCount = 2 in the EventCut)
+  static constexpr const char* kName = "Pi0";
+  static constexpr TopologySlot kSlots[] = {{"electron", 11}, {"photon", 22}, {"proton", 2212}};
+  static constexpr const char* kMother = "pi0";
+  static constexpr int kDaughter1 = 22, kDaughter2 = 22;
+};
+
+// EventCut specialised on a topology and feature set. The cut table is copied once from a
+// configured EventCut into a fixed array indexed by slot; the pid -> slot lookup is a
+// compare chain over constants, the leading-photon bookkeeping is only instantiated when the
+// topology has a photon and the mother-mass loop only with kInvMass. The result is identical
+// to EventCut::operator() configured with the same cuts (and SetDoCutMotherInvMass(kInvMass));
+// the adaptive cut order is not used, every event is evaluated in full. Photon scores
+// (EventCut::WithScore) are not supported. Timed against EventCut by TopologyCutBenchmark.
+template <typename Topology, unsigned Features>
+class TopologyEventCut {
+ public:
+  static constexpr size_t kNSlots = sizeof(Topology::kSlots) / sizeof(TopologySlot);
+  static constexpr bool kInvMass = (Features & PipelineFeature::kInvMass) != 0;
+
+  static constexpr bool SlotsOrdered() {
+    for (size_t s = 1; s < kNSlots; ++s)
+      if (!TopologyNameLess(Topology::kSlots[s - 1].name, Topology::kSlots[s].name)) return false;
+    return true;
+  }
+  static constexpr bool PidsDistinct() {
+    for (size_t a = 0; a < kNSlots; ++a)
+      for (size_t b = a + 1; b < kNSlots; ++b)
+        if (Topology::kSlots[a].pid == Topology::kSlots[b].pid) return false;
+    return true;
+  }
+  static constexpr int PhotonSlot() {
+    for (size_t s = 0; s < kNSlots; ++s)
+      if (Topology::kSlots[s].pid == 22) return static_cast<int>(s);
+    return -1;
+  }
+  static constexpr int kPhotonSlot = PhotonSlot();
+
+  static_assert(SlotsOrdered(), "TopologyEventCut: list the slots in EventCut name order");
+  static_assert(PidsDistinct(), "TopologyEventCut: one slot per pid");
+  static_assert(!kInvMass || Topology::kMother != nullptr, "TopologyEventCut: kInvMass needs a topology with a two-body mother");
+
+  explicit TopologyEventCut(const EventCut& cuts) : fAcceptEverything(cuts.IsAcceptEverything()) {
+    if (cuts.GetCutNames().size() != kNSlots) throw std::runtime_error(std::string("TopologyEventCut<") + Topology::kName + ">: EventCut has cuts outside the topology");
+    for (size_t s = 0; s < kNSlots; ++s) {
+      const ParticleCut* cut = cuts.GetParticleCut(Topology::kSlots[s].name);
+      if (!cut || cut->pid != Topology::kSlots[s].pid)
+        throw std::runtime_error(std::string("TopologyEventCut<") + Topology::kName + ">: missing or mismatched cut " + Topology::kSlots[s].name);
+      fCuts[s] = *cut;
+    }
+    if constexpr (kInvMass) {
+      const auto& mothers = cuts.GetMotherCuts();
+      auto it = mothers.find(Topology::kMother);
+      if (mothers.size() != 1 || it == mothers.end() || it->second.pidDaug1 != Topology::kDaughter1 || it->second.pidDaug2 != Topology::kDaughter2)
+        throw std::runtime_error(std::string("TopologyEventCut<") + Topology::kName + ">: expected exactly the " + Topology::kMother + " mother cut");
+      fMother = it->second;
+    }
+  }
+
+  EventCutResult operator()(const std::vector<int>& pid, const std::vector<float>& px, const std::vector<float>& py, const std::vector<float>& pz,
+                            const std::vector<float>& vx, const std::vector<float>& vy, const std::vector<float>& vz, const std::vector<float>& vt,
+                            const std::vector<short>& charge, const std::vector<float>& beta, const std::vector<float>& chi2pid, const std::vector<short>& status,
+                            const std::vector<int>& REC_Track_pass_fid) const {
+    EventCutResult result;
+    const size_t n = pid.size();
+    result.particlePass.resize(n, false);
+    result.particleDaughterPass.resize(n, false);
+    result.MaxPhotonEnergyPass.resize(n, false);
+    result.MotherMass.resize(n, -999);
+    result.cutCounts.resize(kNSlots, 0);
+
+    // one pass over the particles: each pid belongs to at most one slot, so the slot is found with
+    // a constant compare chain instead of looping over the cuts, and the angles are only computed
+    // for particles that survived the cheap checks
+    float leadingEnergy = 0.0f;
+    float leadingIndex = 0;  // float like EventCut's MaxPhotonEnergyIndex
+    for (size_t i = 0; i < n; ++i) {
+      const int s = SlotOf(pid[i], std::make_index_sequence<kNSlots>{});
+      if (s < 0) continue;
+      const ParticleCut& cut = fCuts[s];
+      const float p2 = px[i] * px[i] + py[i] * py[i] + pz[i] * pz[i];
+      if (p2 < 1e-4f) continue;
+      if (charge[i] != cut.charge || REC_Track_pass_fid[i] != 1) continue;
+      if (!InRange(chi2pid[i], cut.minChi2PID, cut.maxChi2PID)) continue;
+
+      const float momentum = std::sqrt(p2);
+      const int statusAbs = std::abs(status[i]);
+      const bool momentumFTCut = InRange(momentum, cut.minFTMomentum, cut.maxFTMomentum) && (statusAbs >= 1000 && statusAbs < 2000);
+      const bool momentumFDCut = InRange(momentum, cut.minFDMomentum, cut.maxFDMomentum) && (statusAbs >= 2000 && statusAbs < 3000);
+      const bool momentumCDCut = InRange(momentum, cut.minCDMomentum, cut.maxCDMomentum) && (statusAbs >= 4000 && statusAbs < 5000);
+      if (!(momentumFTCut || momentumFDCut || momentumCDCut)) continue;
+      if (!InRange(beta[i], cut.minBeta, cut.maxBeta)) continue;
+      if (!InRange(vz[i], cut.minVz, cut.maxVz)) continue;
+
+      const float pt = std::sqrt(px[i] * px[i] + py[i] * py[i]);
+      const float theta = FastMath::Atan2(pt, pz[i]);
+      float phi = FastMath::Atan2(py[i], px[i]);
+      if (phi < 0) phi += 2 * M_PI;
+      if (!FastMath::InRangeGuarded(theta, cut.minTheta, cut.maxTheta, [&]() -> float { return std::atan2(pt, pz[i]); })) continue;
+      if (!FastMath::InRangeGuarded(phi, cut.minPhi, cut.maxPhi, [&]() -> float {
+            float exact = std::atan2(py[i], px[i]);
+            if (exact < 0) exact += 2 * M_PI;
+            return exact;
+          }))
+        continue;
+
+      result.particlePass[i] = true;
+      if constexpr (kPhotonSlot >= 0) {
+        if (s == kPhotonSlot && momentum > leadingEnergy) {
+          leadingEnergy = momentum;
+          result.MaxPhotonEnergyPass[leadingIndex] = false;
+          result.MaxPhotonEnergyPass[i] = true;
+          leadingIndex = i;
+        }
+      }
+      ++result.cutCounts[s];
+    }
+
+    bool allCutsPassed = true;
+    for (size_t s = 0; s < kNSlots; ++s) {
+      if (!InRange(result.cutCounts[s], fCuts[s].minCount, fCuts[s].maxCount)) allCutsPassed = false;
+    }
+    if (fAcceptEverything) allCutsPassed = true;
+
+    if constexpr (kInvMass) {
+      const float minMass = fMother.expectedMotherMass - fMother.massSigma * fMother.nSigmaMass;
+      const float maxMass = fMother.expectedMotherMass + fMother.massSigma * fMother.nSigmaMass;
+      for (size_t i = 0; i < n; ++i) {
+        if (pid[i] != Topology::kDaughter1) continue;
+        for (size_t j = i + 1; j < n; ++j) {
+          if (pid[j] != Topology::kDaughter2) continue;
+          float E1 = std::sqrt(px[i] * px[i] + py[i] * py[i] + pz[i] * pz[i]);
+          float E2 = std::sqrt(px[j] * px[j] + py[j] * py[j] + pz[j] * pz[j]);
+          float px_sum = px[i] + px[j];
+          float py_sum = py[i] + py[j];
+          float pz_sum = pz[i] + pz[j];
+          float E_sum = E1 + E2;
+          float invMass2 = E_sum * E_sum - (px_sum * px_sum + py_sum * py_sum + pz_sum * pz_sum);
+          float invMass = (invMass2 > 0) ? std::sqrt(invMass2) : 0;
+          result.MotherMass[i] = invMass;
+          result.MotherMass[j] = invMass;
+          if (invMass >= minMass && invMass <= maxMass) {
+            result.particleDaughterPass[i] = true;
+            result.particleDaughterPass[j] = true;
+          }
+        }
+      }
+    }
+
+    result.eventPass = allCutsPassed;
+    return result;
+  }
+
+ private:
+  template <size_t... S>
+  static int SlotOf(int pid, std::index_sequence<S...>) {
+    int slot = -1;
+    (void)((pid == Topology::kSlots[S].pid ? (slot = static_cast<int>(S), true) : false) || ...);
+    return slot;
+  }
+
+  template <typename T>
+  static bool InRange(T value, T min, T max) {
+    return value >= min && value <= max;
+  }
+
+  std::array<ParticleCut, kNSlots> fCuts{};
+  TwoBodyMotherCut fMother{};
+  bool fAcceptEverything = false;
+};
+
+// TopologyEventCut<Topology> built from cuts, with the mother-mass loop when invMass is set
+// (EventCut::SetDoCutMotherInvMass). Used by DVCSAnalysis::SetTopology / PhiAnalysis::SetTopology.
+template <typename Topology>
+EventCutFunction MakeTopologyEventCut(const EventCut& cuts, bool invMass) {
+  if constexpr (Topology::kMother != nullptr) {
+    if (invMass) return TopologyEventCut<Topology, PipelineFeature::kInvMass>(cuts);
+  } else {
+    if (invMass) throw std::runtime_error(std::string("TopologyEventCut<") + Topology::kName + ">: the topology has no two-body mother for the mass cut");
+  }
+  return TopologyEventCut<Topology, 0>(cuts);
+}
+
+#endif  // TOPOLOGYEVENTCUT_H_
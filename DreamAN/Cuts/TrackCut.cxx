@@ -3,6 +3,52 @@
 #include <cmath>
 #include <iostream>
 #include <map>
+#include <sstream>
+#include <tuple>
+
+#include "../Math/FastMath.h"
+
+namespace {
+// FastMath error on the CVT angles in degrees (kernel + float rounding of the degree value), with margin.
+// Valid for the CVT acceptance (35-125 deg); acos error grows as 1/sin(theta) towards the beam line.
+constexpr float kCVTGuardDeg = 2e-4f;
+
+// Plain-text dump of the cut containers for TrackCut::Fingerprint
+template <typename T>
+void Dump(std::ostream& os, const T& value) { os << value; }
+template <typename A, typename B>
+void Dump(std::ostream& os, const std::pair<A, B>& value);
+template <typename... T>
+void Dump(std::ostream& os, const std::tuple<T...>& value) {
+  std::apply([&os](const auto&... v) { ((os << "(", Dump(os, v), os << ")"), ...); }, value);
+}
+template <typename T>
+void Dump(std::ostream& os, const std::vector<T>& values) {
+  os << "[";
+  for (const auto& v : values) Dump(os, v), os << " ";
+  os << "]";
+}
+template <typename T>
+void Dump(std::ostream& os, const std::set<T>& values) {
+  os << "{";
+  for (const auto& v : values) Dump(os, v), os << " ";
+  os << "}";
+}
+template <typename K, typename V>
+void Dump(std::ostream& os, const std::map<K, V>& values) {
+  os << "{";
+  for (const auto& [k, v] : values) Dump(os, k), os << ":", Dump(os, v), os << " ";
+  os << "}";
+}
+template <typename A, typename B>
+void Dump(std::ostream& os, const std::pair<A, B>& value) {
+  os << "(";
+  Dump(os, value.first);
+  os << ",";
+  Dump(os, value.second);
+  os << ")";
+}
+}  // namespace
 
 TrackCut::TrackCut() = default;
 TrackCut::~TrackCut() = default;
@@ -58,6 +104,54 @@ TrackCut::TrackCut(const TrackCut& other) {
   this->fFiducialCutsFTCal = other.fFiducialCutsFTCal;
 }
 
+// Every cut parameter as text: equal fingerprints select the same tracks
+std::string TrackCut::Fingerprint() const {
+  std::ostringstream os;
+  os.precision(9);
+  os << "sector " << fselectSector << " " << fSector << " " << fselectPID << " " << fselectdetector << " ";
+  Dump(os, fSectors);
+  os << "\nfiducial " << fDoFiducialCut << " " << fDoDCFiducial << " " << fDoECALFiducial;
+  os << "\nsf " << fdoSFCut << " " << fSFpid << " " << fSFmin << " " << fSFminP;
+  os << "\nxyz " << fMinX << " " << fMaxX << " " << fMinY << " " << fMaxY << " " << fMinZ << " " << fMaxZ;
+  os << "\ncxyz " << fMinCX << " " << fMaxCX << " " << fMinCY << " " << fMaxCY << " " << fMinCZ << " " << fMaxCZ;
+  os << "\npath " << fMinPath << " " << fMaxPath << "\nedge " << fDCMinEdge << " " << fDCMaxEdge << " " << fECALMinEdge << " " << fECALMaxEdge;
+  os << "\nthetaBins ";
+  Dump(os, fThetaBins);
+  os << "\ndcEdge ";
+  Dump(os, fDCEdgeCutsPerPID);
+  os << "\ncvtEdge ";
+  Dump(os, fCVTEdgeCutsPerPID);
+  const auto axis = [&os](const FiducialAxisCut& cut) { Dump(os, cut.excludedRanges); };
+  const auto dump3D = [&](const char* name, const std::map<int, std::map<int, FiducialCut3D>>& cuts) {
+    os << "\n" << name;
+    for (const auto& [pid, bySector] : cuts)
+      for (const auto& [sector, cut] : bySector) os << " " << pid << "/" << sector << ":", axis(cut.luCut), axis(cut.lvCut), axis(cut.lwCut);
+  };
+  const auto dumpCVT = [&](const char* name, const std::map<int, std::map<int, FiducialCut2D_CVT>>& cuts) {
+    os << "\n" << name;
+    for (const auto& [pid, byLayer] : cuts)
+      for (const auto& [layer, cut] : byLayer) os << " " << pid << "/" << layer << ":", axis(cut.thetaCut), axis(cut.phiCut);
+  };
+  dumpCVT("cvt", fFiducialCutsCVT);
+  dumpCVT("cvtB", fFiducialCutsCVT_Bhawani);
+  os << "\nftcal";
+  for (const auto& [pid, byLayer] : fFiducialCutsFTCal)
+    for (const auto& [layer, cut] : byLayer) os << " " << pid << "/" << layer << ":", Dump(os, cut.ringCut.excludedRanges);
+  dump3D("pcal", fFiducialCutsPCal);
+  dump3D("ecin", fFiducialCutsECin);
+  dump3D("ecout", fFiducialCutsECout);
+  const auto dumpSF = [&](const char* name, const std::map<int, std::map<int, SFCutABC>>& cuts) {
+    os << "\n" << name;
+    for (const auto& [pid, bySector] : cuts)
+      for (const auto& [sector, cut] : bySector) os << " " << pid << "/" << sector << ":" << cut.A0 << "," << cut.Bm1 << "," << cut.Cm2;
+  };
+  dumpSF("sfMin", fSFCutsMinCut);
+  dumpSF("sfMax", fSFCutsMaxCut);
+  os << "\necalMinE ";
+  Dump(os, fMinECALEnergyCutPerPIDLayer);
+  return os.str();
+}
+
 void TrackCut::SetSectorCut(int SSector, int selectpid, int selectdetector, bool selectSector) {
   fSector = SSector;
   fselectSector = selectSector;
@@ -218,6 +312,12 @@ TrackCut::RECTrajPass() const {
       }
       return false;
     };
+    auto nearExcludedEdge = [](float value, const FiducialAxisCut& cut) -> bool {
+      for (const auto& range : cut.excludedRanges) {
+        if (FastMath::NearEdge(value, range.first, range.second, kCVTGuardDeg)) return true;
+      }
+      return false;
+    };
     for (size_t i = 0; i < pindex.size(); ++i) {
       if (detector[i] == 6) {  // DC
         if (fDoFiducialCut) {
@@ -286,8 +386,11 @@ TrackCut::RECTrajPass() const {
               auto it = layerMap.find(layer[i]);
               if (it != layerMap.end()) {
                 const FiducialCut2D_CVT& cut = it->second;
-                float CVTtheta = 180.0 / TMath::Pi() * TMath::ACos(z[i] / sqrt(x[i]*x[i] + y[i]*y[i] + z[i]*z[i]));
-                float CVTphi = 180.0 / TMath::Pi() * TMath::ATan2(y[i], x[i]);
+                // fast angles, recomputed in double next to an excluded-range edge so the decision matches the libm one
+                float CVTtheta = FastMath::kRadToDeg * FastMath::Acos(z[i] / FastMath::Sqrt(x[i]*x[i] + y[i]*y[i] + z[i]*z[i]));
+                float CVTphi = FastMath::kRadToDeg * FastMath::Atan2(y[i], x[i]);
+                if (nearExcludedEdge(CVTtheta, cut.thetaCut)) CVTtheta = 180.0 / TMath::Pi() * TMath::ACos(z[i] / sqrt(x[i]*x[i] + y[i]*y[i] + z[i]*z[i]));
+                if (nearExcludedEdge(CVTphi, cut.phiCut)) CVTphi = 180.0 / TMath::Pi() * TMath::ATan2(y[i], x[i]);
                 if (isExcluded(CVTtheta, cut.thetaCut) || isExcluded(CVTphi, cut.phiCut) ) {
                   pass_values[pindex[i]] = 0;
                   continue;
@@ -53,6 +53,8 @@ class TrackCut {
   float GetCVTEdgeCut(int pid, int layer) const;
   const std::map<int, std::vector<float>>& GetEdgeCuts() const;
   const std::map<int, std::vector<float>>& GetCVTEdgeCuts() const;
+  // All cut parameters as text, e.g. for cache keys
+  std::string Fingerprint() const;
 
 
   bool operator()(const std::vector<int16_t>& pindex, const std::vector<int16_t>& index, const std::vector<int>& detector, const std::vector<int>& layer,
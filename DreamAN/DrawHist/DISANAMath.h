@@ -7,6 +7,8 @@
 #include <cmath>
 #include <iostream>
 
+#include "../Math/FastMath.h"
+#include "../core/EventLoopDiagnostics.h"
 #include "TLorentzVector.h"
 #include "TMath.h"
 
@@ -20,10 +22,16 @@ const double m_kPlus = 0.493677;  // Proton mass in GeV
 // --- Utility Functions (unnamed namespace) ---
 // Converts spherical coordinates (p, θ, φ) to Cartesian 3-vector
 namespace {
+// With FastMath::SetExact(false) the float kernels are used: the angles come from float
+// columns, so their sin/cos (abs error <= 1e-7) is enough here
 TVector3 SphericalToCartesian(double p, double theta, double phi) {
-  double px = p * std::sin(theta) * std::cos(phi);
-  double py = p * std::sin(theta) * std::sin(phi);
-  double pz = p * std::cos(theta);
+  if (FastMath::IsExact()) return TVector3(p * std::sin(theta) * std::cos(phi), p * std::sin(theta) * std::sin(phi), p * std::cos(theta));
+  float sinTheta, cosTheta, sinPhi, cosPhi;
+  FastMath::SinCos(static_cast<float>(theta), sinTheta, cosTheta);
+  FastMath::SinCos(static_cast<float>(phi), sinPhi, cosPhi);
+  double px = p * sinTheta * cosPhi;
+  double py = p * sinTheta * sinPhi;
+  double pz = p * cosTheta;
   return TVector3(px, py, pz);
 }
 
@@ -336,7 +344,8 @@ class DISANAMath {
       }
     };
 
-    df.Foreach(filler, {"Q2", "t", "xB", "phi"});
+    DISANA_BOOK("Foreach", "DVCS cross-section filler", (std::vector<std::string>{"Q2", "t", "xB", "phi"}));
+    DISANA_WATCH(df, "Foreach(DVCS cross-section)", df.Foreach(filler, {"Q2", "t", "xB", "phi"}));
     // Normalize histograms
 
     const double bin_width = (M_PI/180)*(phi_max - phi_min) / n_phi_bins;
@@ -556,7 +565,8 @@ class DISANAMath {
       }
     };
 
-    df.Foreach(fill, {"Q2", "t"});
+    DISANA_BOOK("Foreach", "phi dsigma/dt filler", (std::vector<std::string>{"Q2", "t"}));
+    DISANA_WATCH(df, "Foreach(phi cross-section)", df.Foreach(fill, {"Q2", "t"}));
 
     // Normalize: dσ/dt = N / (L × Δt)
     for (size_t iq = 0; iq < n_q2; ++iq) {
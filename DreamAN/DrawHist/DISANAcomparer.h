@@ -8,16 +8,22 @@
 #include <sys/stat.h>
 // STL headers
 #include <filesystem>
+#include <iomanip>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <sstream>
 #include <string>
 #include <vector>
 
 // Project-specific headers
 #include <chrono>
 
+#include "../core/EventLoopDiagnostics.h"
 #include "DISANAplotter.h"
+#include "DISANApreview.h"
+#include "DISANArenderer.h"
+#include "DISANAresultcache.h"
 #include "DrawStyle.h"
 
 namespace fs = std::filesystem;
@@ -88,6 +94,33 @@ class DISANAcomparer {
     }
   }
 
+  // Paint the saved canvases in nWorkers batch processes at RenderPending() (or when the comparer
+  // goes away) instead of one by one while plotting; see DISANArenderer.h
+  void SetRenderWorkers(int nWorkers) { renderer_.SetWorkers(nWorkers); }
+  bool RenderPending() { return renderer_.Flush(); }
+
+  // Read the filled histograms back from directory when the inputs, the selection chain and the
+  // binning are unchanged, and store them otherwise; see DISANAresultcache.h. sources are the
+  // files holding the cuts (the macro: {__FILE__}); editing one of them refills everything, as
+  // does changing the tag.
+  void SetResultCache(const std::string& directory, const std::string& tag = "", const std::vector<std::string>& sources = {}) {
+    resultCache_ = std::make_unique<DISANAresultcache>(directory, tag, sources);
+    modelIdentity_.clear();
+  }
+  // Input files of the model added (or to be added) under label; only declared models are cached
+  void SetModelInputs(const std::string& label, const std::vector<std::string>& files) {
+    modelInputs_[label] = files;
+    modelIdentity_.clear();
+  }
+
+  // First look at a new dataset: while the loops of the DVCS kinematics and of the BSA / cross
+  // section run, scaled previews are written to directory every `every` of a model's entries
+  // (DISANApreview.h). The kinematic histograms then use the fixed preview ranges instead of a
+  // Min/Max pass. A model is previewed once its source entries are declared.
+  void EnableProgressivePreview(const std::string& directory, double every = 0.05) { preview_ = std::make_unique<DISANApreview>(directory, every); }
+  void SetModelEntries(const std::string& label, ULong64_t entries) { modelEntries_[label] = entries; }
+  void SetPreviewRange(const std::string& var, double lo, double hi) { previewRanges_[var] = {lo, hi}; }
+
   // Enable or disable individual variable plotting
   void PlotIndividual(bool plotInd) { plotIndividual = plotInd; }
 
@@ -147,10 +180,14 @@ class DISANAcomparer {
           // Apply filter
           auto rdf_cut = rdf.Filter(Form("xB >= %f && xB < %f", xb_lo, xb_hi)).Filter(Form("Q2 >= %f && Q2 < %f", q2_lo, q2_hi)).Filter(Form("t >= %f && t < %f", t_lo, t_hi));
 
-          // Compute means
-          double mean_xB = rdf_cut.Mean("xB").GetValue();
-          double mean_Q2 = rdf_cut.Mean("Q2").GetValue();
-          double mean_t = rdf_cut.Mean("t").GetValue();
+          // Compute means: book all three before triggering so they share one event loop
+          auto r_xB = rdf_cut.Mean("xB");
+          auto r_Q2 = rdf_cut.Mean("Q2");
+          auto r_t = rdf_cut.Mean("t");
+          DISANA_BOOK("Mean", Form("xB/Q2/t cell %zu,%zu,%zu", ix, iq, it), (std::vector<std::string>{"xB", "Q2", "t"}));
+          double mean_xB = DISANA_WATCH(rdf_cut, "Mean(xB,Q2,t)", r_xB.GetValue());
+          double mean_Q2 = r_Q2.GetValue();
+          double mean_t = r_t.GetValue();
 
           result[ix][iq][it] = std::make_tuple(mean_xB, mean_Q2, mean_t);
         }
@@ -176,7 +213,7 @@ class DISANAcomparer {
     }
 
     canvas->Update();
-    canvas->SaveAs((outputDir + "KinematicComparison_phiAna.pdf").c_str());
+    renderer_.Save(canvas, outputDir + "KinematicComparison_phiAna.pdf");
 
     // Optionally save individual plots
     if (plotIndividual) {
@@ -207,7 +244,7 @@ class DISANAcomparer {
     }
 
     canvas->Update();
-    canvas->SaveAs((outputDir + "KinematicComparison.pdf").c_str());
+    renderer_.Save(canvas, outputDir + "KinematicComparison.pdf");
 
     // Optionally save individual plots
     if (plotIndividual) {
@@ -235,7 +272,7 @@ class DISANAcomparer {
     styleKin_.StylePad((TPad*)gPad);
 
     for (size_t i = 0; i < plotters.size(); ++i) {
-      const auto& histograms = plotters[i]->GetAllHistograms();
+      const auto& histograms = ModelHistograms(i);
       TH1* target = nullptr;
 
       for (TH1* h : histograms) {
@@ -282,7 +319,7 @@ class DISANAcomparer {
     bool first = true;
 
     for (size_t i = 0; i < plotters.size(); ++i) {
-      const auto& histograms = plotters[i]->GetAllHistograms();
+      const auto& histograms = ModelHistograms(i);
       TH1* target = nullptr;
 
       for (TH1* h : histograms) {
@@ -311,7 +348,7 @@ class DISANAcomparer {
 
     legend->Draw();
     canvas->Update();
-    canvas->SaveAs((outputDir + "/compare_" + type + "_" + var + ".pdf").c_str());
+    renderer_.Save(canvas, outputDir + "/compare_" + type + "_" + var + ".pdf");
     delete canvas;
   }
 
@@ -325,8 +362,13 @@ class DISANAcomparer {
     TCanvas* canvas = new TCanvas("DVCSVars", "DVCS Kinematic Comparison", 1800, 1400);
     canvas->Divide(3, 2);
 
+    // every variable of a model in one event loop
+    std::vector<std::vector<TH1*>> distributions;
+    for (size_t i = 0; i < plotters.size(); ++i) distributions.push_back(KinematicDistributions(i, variables));
+
     int pad = 1;
-    for (const auto& var : variables) {
+    for (size_t v = 0; v < variables.size(); ++v) {
+      const auto& var = variables[v];
       canvas->cd(pad++);
       styleDVCS_.StylePad((TPad*)gPad);
 
@@ -339,25 +381,15 @@ class DISANAcomparer {
       std::vector<TH1D*> histos_to_draw;
 
       for (size_t i = 0; i < plotters.size(); ++i) {
-        auto rdf = plotters[i]->GetRDF();
-        if (!rdf.HasColumn(var)) {
+        if (!plotters[i]->GetRDF().HasColumn(var)) {
           std::cerr << "[ERROR] Column " << var << " not found in RDF for model " << labels[i] << "\n";
           continue;
         }
 
-        double min = *(rdf.Min(var));
-        double max = *(rdf.Max(var));
-        if (min == max) {
-          min -= 0.1;
-          max += 0.1;
-        }
-        double margin = std::max(1e-3, 0.05 * (max - min));
-
-        // Get histogram (RResultPtr) and clone it
-        auto htmp = rdf.Histo1D({Form("h_%s_%zu", var.c_str(), i), titles[var].c_str(), 100, min - margin, max + margin}, var);
-        auto h = (TH1D*)htmp->Clone(Form("h_%s_%zu_clone", var.c_str(), i));
+        auto h = (TH1D*)distributions[i][v];
 
         if (!h) continue;  // guard against failed clone
+        h->SetTitle(titles[var].c_str());
 
         h->SetDirectory(0);  // prevent ROOT from managing ownership
         NormalizeHistogram(h);
@@ -385,7 +417,8 @@ class DISANAcomparer {
     }
     canvas->cd(pad);
     auto rdf = plotters.front()->GetRDF();
-    auto h2d = rdf.Histo2D({"h_Q2_vs_t", "Q^{2} vs t;-t[GeV^{2}];Q^{2} [GeV^{2}]", 60, 0, 8.0, 60, 0, 10.0}, "t", "Q2");
+    TH1* h2d = CachedHisto(0, "Histo2D Q2:t 60 0 8.0 60 0 10.0", [&] { return (TH1*)rdf.Histo2D({"h_Q2_vs_t", "", 60, 0, 8.0, 60, 0, 10.0}, "t", "Q2")->Clone(); });
+    h2d->SetTitle("Q^{2} vs t;-t[GeV^{2}];Q^{2} [GeV^{2}]");
 
     styleDVCS_.StylePad((TPad*)gPad);
     gPad->SetRightMargin(0.16);
@@ -410,8 +443,9 @@ class DISANAcomparer {
     h2d->GetZaxis()->SetTitleSize(0.06);
     TGaxis::SetMaxDigits(3);
     h2d->DrawCopy("COLZ");
+    delete h2d;
     // Final save and cleanup
-    canvas->SaveAs((outputDir + "/PhiAna_Kinematics_Comparison.pdf").c_str());
+    renderer_.Save(canvas, outputDir + "/PhiAna_Kinematics_Comparison.pdf");
     std::cout << "Saved DVCS kinematics comparison to: " << outputDir + "/PhiAna_Kinematics_Comparison.pdf" << std::endl;
     delete canvas;
     TGaxis::SetMaxDigits(oldMaxDigits);
@@ -427,8 +461,13 @@ class DISANAcomparer {
     TCanvas* canvas = new TCanvas("DVCSVars", "DVCS Kinematic Comparison", 1800, 1400);
     canvas->Divide(3, 2);
 
+    // every variable of a model in one event loop
+    std::vector<std::vector<TH1*>> distributions;
+    for (size_t i = 0; i < plotters.size(); ++i) distributions.push_back(KinematicDistributions(i, variables));
+
     int pad = 1;
-    for (const auto& var : variables) {
+    for (size_t v = 0; v < variables.size(); ++v) {
+      const auto& var = variables[v];
       canvas->cd(pad++);
       styleDVCS_.StylePad((TPad*)gPad);
 
@@ -440,25 +479,15 @@ class DISANAcomparer {
       std::vector<TH1D*> histos_to_draw;
 
       for (size_t i = 0; i < plotters.size(); ++i) {
-        auto rdf = plotters[i]->GetRDF();
-        if (!rdf.HasColumn(var)) {
+        if (!plotters[i]->GetRDF().HasColumn(var)) {
           std::cerr << "[ERROR] Column " << var << " not found in RDF for model " << labels[i] << "\n";
           continue;
         }
 
-        double min = *(rdf.Min(var));
-        double max = *(rdf.Max(var));
-        if (min == max) {
-          min -= 0.1;
-          max += 0.1;
-        }
-        double margin = std::max(1e-3, 0.05 * (max - min));
-
-        // Get histogram (RResultPtr) and clone it
-        auto htmp = rdf.Histo1D({Form("h_%s_%zu", var.c_str(), i), titles[var].c_str(), 100, min - margin, max + margin}, var);
-        auto h = (TH1D*)htmp->Clone(Form("h_%s_%zu_clone", var.c_str(), i));
+        auto h = (TH1D*)distributions[i][v];
 
         if (!h) continue;  // guard against failed clone
+        h->SetTitle(titles[var].c_str());
 
         h->SetDirectory(0);  // prevent ROOT from managing ownership
         NormalizeHistogram(h);
@@ -486,7 +515,8 @@ class DISANAcomparer {
     }
     canvas->cd(pad);
     auto rdf = plotters.front()->GetRDF();
-    auto h2d = rdf.Histo2D({"h_Q2_vs_xB", "Q^{2} vs x_{B};x_{B};Q^{2} [GeV^{2}]", 60, 0, 1.0, 60, 0, 10.0}, "xB", "Q2");
+    TH1* h2d = CachedHisto(0, "Histo2D Q2:xB 60 0 1.0 60 0 10.0", [&] { return (TH1*)rdf.Histo2D({"h_Q2_vs_xB", "", 60, 0, 1.0, 60, 0, 10.0}, "xB", "Q2")->Clone(); });
+    h2d->SetTitle("Q^{2} vs x_{B};x_{B};Q^{2} [GeV^{2}]");
 
     styleDVCS_.StylePad((TPad*)gPad);
     gPad->SetRightMargin(0.16);
@@ -511,8 +541,9 @@ class DISANAcomparer {
     h2d->GetZaxis()->SetTitleSize(0.06);
     TGaxis::SetMaxDigits(3);
     h2d->DrawCopy("COLZ");
+    delete h2d;
     // Final save and cleanup
-    canvas->SaveAs((outputDir + "/DVCS_Kinematics_Comparison.pdf").c_str());
+    renderer_.Save(canvas, outputDir + "/DVCS_Kinematics_Comparison.pdf");
     std::cout << "Saved DVCS kinematics comparison to: " << outputDir + "/DVCS_Kinematics_Comparison.pdf" << std::endl;
     delete canvas;
     TGaxis::SetMaxDigits(oldMaxDigits);
@@ -530,7 +561,8 @@ class DISANAcomparer {
 
     canvas->cd(1);
     auto rdf = plotters.front()->GetRDF();
-    auto h2d = rdf.Histo2D({"h_Q2_vs_xB", "Q^{2} vs x_{B};x_{B};Q^{2} [GeV^{2}]", 500, 0, 1.0, 500, 0, 10.0}, "xB", "Q2");
+    TH1* h2d = CachedHisto(0, "Histo2D Q2:xB 500 0 1.0 500 0 10.0", [&] { return (TH1*)rdf.Histo2D({"h_Q2_vs_xB", "", 500, 0, 1.0, 500, 0, 10.0}, "xB", "Q2")->Clone(); });
+    h2d->SetTitle("Q^{2} vs x_{B};x_{B};Q^{2} [GeV^{2}]");
 
     styleDVCS_.StylePad((TPad*)gPad);
     gPad->SetRightMargin(0.16);
@@ -555,9 +587,11 @@ class DISANAcomparer {
     h2d->GetZaxis()->SetTitleSize(0.06);
     TGaxis::SetMaxDigits(3);
     h2d->DrawCopy("COLZ");
+    delete h2d;
 
     canvas->cd(2);
-    auto h2d2 = rdf.Histo2D({"h_Q2_vs_t", "Q^{2} vs -t;-t[GeV^{2}];Q^{2} [GeV^{2}]", 500, 0, 1.0, 500, 0, 10.0}, "t", "Q2");
+    TH1* h2d2 = CachedHisto(0, "Histo2D Q2:t 500 0 1.0 500 0 10.0", [&] { return (TH1*)rdf.Histo2D({"h_Q2_vs_t", "", 500, 0, 1.0, 500, 0, 10.0}, "t", "Q2")->Clone(); });
+    h2d2->SetTitle("Q^{2} vs -t;-t[GeV^{2}];Q^{2} [GeV^{2}]");
 
     styleDVCS_.StylePad((TPad*)gPad);
     gPad->SetRightMargin(0.16);
@@ -580,9 +614,11 @@ class DISANAcomparer {
     h2d2->GetZaxis()->SetTitleSize(0.06);
     TGaxis::SetMaxDigits(3);
     h2d2->DrawCopy("COLZ");
+    delete h2d2;
 
     canvas->cd(3);
-    auto h2d3 = rdf.Histo2D({"h_xB_vs_t", "x_{B} vs -t;-t[GeV^{2}];x_{B}", 500, 0, 1.0, 500, 0, 1.0}, "t", "xB");
+    TH1* h2d3 = CachedHisto(0, "Histo2D xB:t 500 0 1.0 500 0 1.0", [&] { return (TH1*)rdf.Histo2D({"h_xB_vs_t", "", 500, 0, 1.0, 500, 0, 1.0}, "t", "xB")->Clone(); });
+    h2d3->SetTitle("x_{B} vs -t;-t[GeV^{2}];x_{B}");
 
     styleDVCS_.StylePad((TPad*)gPad);
     gPad->SetRightMargin(0.16);
@@ -605,8 +641,9 @@ class DISANAcomparer {
     h2d3->GetZaxis()->SetTitleSize(0.06);
     TGaxis::SetMaxDigits(3);
     h2d3->DrawCopy("COLZ");
+    delete h2d3;
     // Final save and cleanup
-    canvas->SaveAs((outputDir + "/xBQ2tBin.pdf").c_str());
+    renderer_.Save(canvas, outputDir + "/xBQ2tBin.pdf");
     std::cout << "Saved xBQ2tBin kinematics to: " << outputDir + "/xBQ2tBin.pdf" << std::endl;
     delete canvas;
     TGaxis::SetMaxDigits(oldMaxDigits);
@@ -649,14 +686,18 @@ class DISANAcomparer {
         bool first = true;
 
         for (size_t m = 0; m < plotters.size(); ++m) {
-          auto rdf_cut = plotters[m]->GetRDF().Filter(cutExpr, cutLabel);
-          if (!rdf_cut.HasColumn(var)) continue;
-
-          auto h = rdf_cut.Histo1D({Form("h_%s_%s_%zu", var.c_str(), cleanName.c_str(), m), (title + ";" + xlabel + ";Counts").c_str(), 100, xmin, xmax}, var);
-          h.GetValue();
-
-          TH1D* h_clone = (TH1D*)h.GetPtr()->Clone();
+          if (!plotters[m]->GetRDF().HasColumn(var)) continue;
+
+          TH1D* h_clone = (TH1D*)CachedHisto(m, Form("Histo1D %s where %s 100 %.17g %.17g", var.c_str(), cutExpr.c_str(), xmin, xmax), [&]() -> TH1* {
+            auto rdf_cut = plotters[m]->GetRDF().Filter(cutExpr, cutLabel);
+            DISANA_JIT(cutExpr);
+            auto h = rdf_cut.Histo1D({Form("h_%s_%s_%zu", var.c_str(), cleanName.c_str(), m), "", 100, xmin, xmax}, var);
+            DISANA_BOOK("Histo1D", var + " [" + cutLabel + "]", std::vector<std::string>{var});
+            DISANA_WATCH(rdf_cut, "Histo1D(" + var + ")", (void)h.GetValue());
+            return (TH1*)h.GetPtr()->Clone();
+          });
           h_clone->SetDirectory(0);
+          h_clone->SetTitle((title + ";" + xlabel + ";Counts").c_str());
           NormalizeHistogram(h_clone);
 
           styleKin_.StyleTH1(h_clone);
@@ -694,7 +735,7 @@ class DISANAcomparer {
       }
 
       std::string outpath = outputDir + "/Exclusivity_" + cleanName + ".pdf";
-      canvas->SaveAs(outpath.c_str());
+      renderer_.Save(canvas, outpath);
       std::cout << "Saved detector-specific comparison to: " << outpath << "\n";
       delete canvas;
     }
@@ -738,14 +779,18 @@ class DISANAcomparer {
         bool first = true;
 
         for (size_t m = 0; m < plotters.size(); ++m) {
-          auto rdf_cut = plotters[m]->GetRDF().Filter(cutExpr, cutLabel);
-          if (!rdf_cut.HasColumn(var)) continue;
-
-          auto h = rdf_cut.Histo1D({Form("h_%s_%s_%zu", var.c_str(), cleanName.c_str(), m), (title + ";" + xlabel + ";Counts").c_str(), 100, xmin, xmax}, var);
-          h.GetValue();
-
-          TH1D* h_clone = (TH1D*)h.GetPtr()->Clone();
+          if (!plotters[m]->GetRDF().HasColumn(var)) continue;
+
+          TH1D* h_clone = (TH1D*)CachedHisto(m, Form("Histo1D %s where %s 100 %.17g %.17g", var.c_str(), cutExpr.c_str(), xmin, xmax), [&]() -> TH1* {
+            auto rdf_cut = plotters[m]->GetRDF().Filter(cutExpr, cutLabel);
+            DISANA_JIT(cutExpr);
+            auto h = rdf_cut.Histo1D({Form("h_%s_%s_%zu", var.c_str(), cleanName.c_str(), m), "", 100, xmin, xmax}, var);
+            DISANA_BOOK("Histo1D", var + " [" + cutLabel + "]", std::vector<std::string>{var});
+            DISANA_WATCH(rdf_cut, "Histo1D(" + var + ")", (void)h.GetValue());
+            return (TH1*)h.GetPtr()->Clone();
+          });
           h_clone->SetDirectory(0);
+          h_clone->SetTitle((title + ";" + xlabel + ";Counts").c_str());
           NormalizeHistogram(h_clone);
 
           styleKin_.StyleTH1(h_clone);
@@ -783,7 +828,7 @@ class DISANAcomparer {
       }
 
       std::string outpath = outputDir + "/Exclusivity_Phi_Ana" + cleanName + ".pdf";
-      canvas->SaveAs(outpath.c_str());
+      renderer_.Save(canvas, outpath);
       std::cout << "Saved detector-specific comparison to: " << outpath << "\n";
       delete canvas;
     }
@@ -803,24 +848,33 @@ class DISANAcomparer {
     std::vector<std::vector<std::vector<std::vector<std::tuple<double, double, double>>>>> allBSAmeans;
 
     for (auto& p : plotters) {
+      const size_t m = &p - &plotters.front();
+      const std::string corrections = Form("pi0corr %d acccorr %d ", p->getDoPi0Corr(), p->getDoAccCorr());
       if (plotBSA) {
-        auto h = p->ComputeBSA(fXbins, luminosity, pol);
+        auto h = CachedResult<DISANAresultcache::Cube>(m, "BSA " + corrections + Form("lumi %.17g pol %.17g", luminosity, pol), [&] {
+          PreviewYields(m, "BSA", pol);
+          return p->ComputeBSA(fXbins, luminosity, pol);
+        });
         allBSA.push_back(std::move(h));
       }
       if (plotDVCSCross) {
-        auto hists = p->ComputeDVCS_CrossSection(fXbins, luminosity);
+        auto hists = CachedResult<DISANAresultcache::Cube>(m, "DVCS_CrossSection " + corrections + Form("lumi %.17g", luminosity),
+                                                           [&] {
+                                                             PreviewYields(m, "DVCS_CrossSection");
+                                                             return p->ComputeDVCS_CrossSection(fXbins, luminosity);
+                                                           });
         allDVCSCross.push_back(std::move(hists));
       }
       if (plotPi0Corr) {
-        auto hcorr = p->ComputePi0Corr(fXbins);
+        auto hcorr = CachedResult<DISANAresultcache::Cube>(m, "Pi0Corr", [&] { return p->ComputePi0Corr(fXbins); });
         allPi0Corr.push_back(std::move(hcorr));
       }
       if (plotAccCorr) {
-        auto hacc = p->ComputeAccCorr(fXbins);
+        auto hacc = CachedResult<DISANAresultcache::Cube>(m, "AccCorr", [&] { return p->ComputeAccCorr(fXbins); });
         allAccCorr.push_back(std::move(hacc));
       }
       if (meanKinVar) {
-        allBSAmeans.push_back(getMeanQ2xBt(fXbins, p));
+        allBSAmeans.push_back(CachedResult<DISANAresultcache::MeanCube>(m, "MeanQ2xBt", [&] { return getMeanQ2xBt(fXbins, p); }));
       }
     }
 
@@ -1113,7 +1167,7 @@ class DISANAcomparer {
         }
       }
       TString outfile = Form("%s/%s_t_%.2f-%.2f.%s", outputDir.c_str(), observableName.c_str(), t_edges[t_bin], t_edges[t_bin + 1], suffix.c_str());
-      c->SaveAs(outfile);
+      renderer_.Save(c, outfile.Data());
 
       // std::cout << "Saved: " << outfile << '\n';
 
@@ -1222,7 +1276,7 @@ class DISANAcomparer {
         TString out = hasW
             ? Form("%s/phi_dsdt_Q%zu_W%zu.pdf", outputDir.c_str(), iq, iw)
             : Form("%s/phi_dsdt_Q%zu.pdf", outputDir.c_str(), iq);
-        c->SaveAs(out);
+        renderer_.Save(c, out.Data());
 
         delete leg;
         delete c;
@@ -1246,6 +1300,154 @@ class DISANAcomparer {
 
 
  private:
+  // Input files and selection chains of model m, empty (not cached) without declared inputs
+  const std::string& ModelIdentity(size_t m) {
+    auto it = modelIdentity_.find(m);
+    if (it != modelIdentity_.end()) return it->second;
+    std::string identity;
+    auto inputs = modelInputs_.find(labels[m]);
+    if (inputs == modelInputs_.end()) {
+      std::cout << "[DISANAcomparer] No inputs declared for model " << labels[m] << " (SetModelInputs), its results are not cached." << std::endl;
+    } else {
+      identity = DISANAresultcache::InputIdentity(inputs->second);
+      for (auto& node : plotters[m]->GetInputNodes()) identity += "chain\n" + DISANAresultcache::ChainIdentity(node);
+    }
+    return modelIdentity_[m] = identity;
+  }
+
+  // Result of compute() for model m, read back from the result cache when an entry with the same
+  // model identity, what and binning exists; what describes everything else the result depends on
+  template <typename Result, typename Compute>
+  Result CachedResult(size_t m, const std::string& what, Compute compute) {
+    if (!resultCache_ || ModelIdentity(m).empty()) return compute();
+    std::ostringstream text;
+    text << what << "\nbins";
+    for (const auto* edges : {&fXbins.GetXBBins(), &fXbins.GetQ2Bins(), &fXbins.GetTBins(), &fXbins.GetWBins()}) {
+      text << " |";
+      for (double edge : *edges) text << " " << std::setprecision(17) << edge;
+    }
+    const std::string key = resultCache_->Key(ModelIdentity(m), text.str());
+    Result result;
+    if (resultCache_->Load(key, result)) return result;
+    result = compute();
+    resultCache_->Store(key, labels[m] + ": " + text.str(), result);
+    return result;
+  }
+
+  // One filled histogram; compute() returns a detached histogram, as does the cache
+  template <typename Compute>
+  TH1* CachedHisto(size_t m, const std::string& what, Compute compute) {
+    auto histos = CachedResult<std::vector<TH1*>>(m, what, [&] { return std::vector<TH1*>{compute()}; });
+    return histos.empty() ? nullptr : histos.front();
+  }
+
+  // Source entries of model m for the preview, 0 (no preview) when not declared
+  ULong64_t PreviewEntries(size_t m) {
+    if (!preview_) return 0;
+    auto it = modelEntries_.find(labels[m]);
+    if (it != modelEntries_.end()) return it->second;
+    std::cout << "[DISANAcomparer] No entries declared for model " << labels[m] << " (SetModelEntries), it is not previewed." << std::endl;
+    modelEntries_[labels[m]] = 0;
+    return 0;
+  }
+
+  // 100-bin distributions of the variables for model m, detached; nullptr where the model has no
+  // such column. The ranges come from a Min/Max pass, or are the fixed preview ranges.
+  std::vector<TH1*> KinematicDistributions(size_t m, const std::vector<std::string>& variables) {
+    std::ostringstream what;
+    what << "Histo1D 100";
+    for (const auto& var : variables) {
+      what << " " << var;
+      if (preview_) what << " [" << std::setprecision(17) << previewRanges_[var].first << ", " << previewRanges_[var].second << "]";
+    }
+    return CachedResult<std::vector<TH1*>>(m, what.str(), [&] {
+      auto rdf = plotters[m]->GetRDF();
+      std::vector<std::pair<double, double>> ranges(variables.size());
+      if (preview_) {
+        for (size_t v = 0; v < variables.size(); ++v) ranges[v] = previewRanges_[variables[v]];
+      } else {
+        // all Min/Max booked first: one pass for the ranges of every variable
+        std::vector<ROOT::RDF::RResultPtr<double>> minR(variables.size()), maxR(variables.size());
+        for (size_t v = 0; v < variables.size(); ++v) {
+          if (!rdf.HasColumn(variables[v])) continue;
+          minR[v] = rdf.Min(variables[v]);
+          maxR[v] = rdf.Max(variables[v]);
+          DISANA_BOOK("Min/Max", variables[v], std::vector<std::string>{variables[v]});
+        }
+        for (size_t v = 0; v < variables.size(); ++v) {
+          if (!minR[v]) continue;
+          double min = DISANA_WATCH(rdf, "Min/Max(" + variables[v] + ")", *minR[v]);
+          double max = *maxR[v];
+          if (min == max) {
+            min -= 0.1;
+            max += 0.1;
+          }
+          double margin = std::max(1e-3, 0.05 * (max - min));
+          ranges[v] = {min - margin, max + margin};
+        }
+      }
+
+      std::vector<ROOT::RDF::RResultPtr<TH1D>> booked(variables.size());
+      for (size_t v = 0; v < variables.size(); ++v) {
+        if (!rdf.HasColumn(variables[v])) continue;
+        booked[v] = rdf.Histo1D({Form("h_%s_%zu", variables[v].c_str(), m), "", 100, ranges[v].first, ranges[v].second}, variables[v]);
+        DISANA_BOOK("Histo1D", variables[v], std::vector<std::string>{variables[v]});
+      }
+      if (const ULong64_t entries = PreviewEntries(m)) preview_->Track(rdf, entries, "DVCSKinematics_" + labels[m], booked);
+
+      std::vector<TH1*> histos(variables.size(), nullptr);
+      for (size_t v = 0; v < variables.size(); ++v) {
+        if (!booked[v]) continue;
+        histos[v] = DISANA_WATCH(rdf, "Histo1D(" + variables[v] + ")", (TH1*)booked[v]->Clone(Form("h_%s_%zu_clone", variables[v].c_str(), m)));
+        histos[v]->SetDirectory(0);
+      }
+      return histos;
+    });
+  }
+
+  // Booked on the model's dataframe just before the BSA / cross section loop runs: the (xB, Q2, t)
+  // cell x phi yields, per helicity for the BSA (pol > 0) with their asymmetry A_LU next to them
+  void PreviewYields(size_t m, const std::string& name, double pol = 0) {
+    const ULong64_t entries = PreviewEntries(m);
+    if (!entries) return;
+    const auto &xb = fXbins.GetXBBins(), &q2 = fXbins.GetQ2Bins(), &t = fXbins.GetTBins();
+    const int nCells = static_cast<int>((xb.size() - 1) * (q2.size() - 1) * (t.size() - 1));
+    auto cell = [xb, q2, t](double xB, double Q2, double mt) {
+      auto bin = [](double x, const std::vector<double>& edges) -> int {
+        auto it = std::upper_bound(edges.begin(), edges.end(), x);
+        return (it == edges.begin() || it == edges.end()) ? -1 : static_cast<int>(it - edges.begin()) - 1;
+      };
+      const int ix = bin(xB, xb), iq = bin(Q2, q2), it = bin(mt, t);
+      if (ix < 0 || iq < 0 || it < 0) return -1.0;
+      return static_cast<double>((ix * (q2.size() - 1) + iq) * (t.size() - 1) + it);
+    };
+    auto df = plotters[m]->GetRDF().Define("preview_cell", cell, {"xB", "Q2", "t"});
+    const std::string title = ";(x_{B}, Q^{2}, -t) cell (x_{B} slowest);#phi [deg]";
+    if (pol <= 0) {
+      auto yields = df.Histo2D({("yields_" + name).c_str(), title.c_str(), nCells, 0, double(nCells), 18, 0, 360}, "preview_cell", "phi");
+      preview_->Track(df, entries, name + "_" + labels[m], std::vector{yields});
+      return;
+    }
+    auto pos = df.Filter("REC_Event_helicity ==  1").Histo2D({("yields_pos_" + name).c_str(), title.c_str(), nCells, 0, double(nCells), 18, 0, 360}, "preview_cell", "phi");
+    auto neg = df.Filter("REC_Event_helicity == -1").Histo2D({("yields_neg_" + name).c_str(), title.c_str(), nCells, 0, double(nCells), 18, 0, 360}, "preview_cell", "phi");
+    preview_->Track(df, entries, name + "_" + labels[m], std::vector{pos, neg}, [pol](const std::vector<TH1*>& yields) {
+      std::vector<TH1*> derived;
+      if (yields.size() != 2) return derived;
+      TH1* asymmetry = yields[0]->GetAsymmetry(yields[1]);
+      asymmetry->SetName("ALU");
+      asymmetry->Scale(1.0 / pol);
+      derived.push_back(asymmetry);
+      return derived;
+    });
+  }
+
+  // The plotter's kinematic and DIS histograms, filled (or read back) once per model
+  const std::vector<TH1*>& ModelHistograms(size_t m) {
+    auto it = modelHistos_.find(m);
+    if (it != modelHistos_.end()) return it->second;
+    return modelHistos_[m] = CachedResult<std::vector<TH1*>>(m, "Kinematics\n" + plotters[m]->GetBookedSpec(), [&] { return plotters[m]->GetAllHistograms(); });
+  }
+
   BinManager fXbins;
   bool plotIndividual = false;
   bool useFittedYields_ = true;
@@ -1257,6 +1459,7 @@ class DISANAcomparer {
   DrawStyle styleCrossSection_;  // Cross-section plot style
   DrawStyle styleBSA_;           // BSA plot style
 
+  DISANArenderer renderer_;
 
   THnSparseD* correctionHist = nullptr;
 
@@ -1266,6 +1469,15 @@ class DISANAcomparer {
   std::vector<std::unique_ptr<DISANAplotter>> plotters;
   std::vector<std::string> labels;
 
+  std::unique_ptr<DISANAresultcache> resultCache_;
+  std::map<std::string, std::vector<std::string>> modelInputs_;  // by model label
+  std::map<size_t, std::string> modelIdentity_;
+  std::map<size_t, std::vector<TH1*>> modelHistos_;
+
+  std::unique_ptr<DISANApreview> preview_;
+  std::map<std::string, ULong64_t> modelEntries_;  // source entries, by model label
+  std::map<std::string, std::pair<double, double>> previewRanges_ = {{"Q2", {0.0, 12.0}}, {"xB", {0.0, 1.0}}, {"t", {0.0, 4.0}}, {"W", {1.0, 5.0}}, {"phi", {0.0, 360.0}}};
+
   std::vector<std::string> particleName = {"e", "p", "#gamma"};
   std::map<std::string, std::string> typeToParticle = {{"el", "electron"}, {"pro", "proton"}, {"pho", "#gamma"}, {"kMinus", "K^{-}"}, {"kPlus", "K^{+}"}};
   std::map<std::string, std::string> VarName = {{"p", "p (GeV/#it{c})"}, {"theta", "#theta (rad)"}, {"phi", "#phi(rad)"}};
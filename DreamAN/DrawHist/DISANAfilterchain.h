@@ -0,0 +1,167 @@
+#ifndef DISANA_FILTERCHAIN_H
+#define DISANA_FILTERCHAIN_H
+
+// Selectivity-ordered chain of RDataFrame filters.
+//
+// The criteria of a final selection are a conjunction, so their order never changes which
+// events pass, only how much work is spent on rejected ones: an RDataFrame filter stops the
+// event at the first failing criterion, and the columns of later criteria are never defined
+// for it. Calibrate() runs every criterion alone on a warm-up sample of the input, measures
+// its time per event (over a bare loop on the same sample) and its rejection rate, and orders
+// the chain by time per rejected event, so the criteria that reject most for the least work run
+// first. The result can be saved and reloaded so later runs skip the warm-up. The rejection
+// rates depend on the sample, so keep one chain and one file per dataset.
+//
+//   static DISANAfilterchain sel({{"Q2 > 1.0", "Cut: Q2 > 1 GeV^2"}, {"W > 2.0", "Cut: W > 2 GeV"}});
+//   if (!sel.Load(outputDir + "/final_cutorder.txt")) { sel.Calibrate(df); sel.Save(outputDir + "/final_cutorder.txt"); }
+//   auto dfFinal = sel.Apply(df);
+//
+// The filters keep their labels, so df.Report() still works; its cut flow is in the new order.
+// Apply() records every criterion with its label for the result cache keys (DISANAresultcache.h).
+
+#include <ROOT/RDataFrame.hxx>
+#include <TROOT.h>
+#include <TStopwatch.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "DISANAresultcache.h"
+
+class DISANAfilterchain {
+ public:
+  struct Criterion {
+    std::string expression;
+    std::string label;
+    double nsPerEvent = 0;  // measured cost, 0 until calibrated
+    double rejection = 0;   // fraction of the warm-up sample failing this criterion alone
+  };
+
+  explicit DISANAfilterchain(const std::vector<std::pair<std::string, std::string>>& criteria) {
+    for (const auto& [expression, label] : criteria) criteria_.push_back({expression, label});
+    for (size_t i = 0; i < criteria_.size(); ++i) order_.push_back(i);
+  }
+
+  // Warm-up on the first nEvents entries of df. Range() is not available under implicit MT, there
+  // the sample is the entries with rdfentry_ < nEvents: the loops still visit every entry, but
+  // the criteria and their columns only run on the sample. For a TTree source that is its first
+  // nEvents entries; keep the filters of df after the calibration, they would run on every entry.
+  // One untimed loop JITs every criterion, then the bare loop and each criterion are timed once.
+  void Calibrate(ROOT::RDF::RNode df, ULong64_t nEvents = 20000) {
+    const bool range = !ROOT::IsImplicitMTEnabled();
+    ROOT::RDF::RNode sample = range ? df.Range(nEvents) : df.Filter([nEvents](ULong64_t entry) { return entry < nEvents; }, {"rdfentry_"});
+    std::vector<ROOT::RDF::RNode> filtered;
+    for (const auto& c : criteria_) filtered.push_back(sample.Filter(c.expression));
+    auto timedCount = [](ROOT::RDF::RNode node, ULong64_t& count) {
+      TStopwatch watch;
+      count = node.Count().GetValue();
+      return watch.RealTime();
+    };
+
+    ULong64_t nSample = 0;
+    timedCount(sample, nSample);  // jits the booked filters of the whole graph
+    const double base = timedCount(sample, nSample);
+    if (nSample == 0) {
+      std::cerr << "[DISANAfilterchain] Empty warm-up sample, keeping the given order." << std::endl;
+      return;
+    }
+    for (size_t i = 0; i < criteria_.size(); ++i) {
+      ULong64_t nPass = 0;
+      const double t = timedCount(filtered[i], nPass);
+      criteria_[i].nsPerEvent = std::max(t - base, 0.0) * 1e9 / nSample;
+      criteria_[i].rejection = 1.0 - static_cast<double>(nPass) / nSample;
+    }
+    Reorder();
+    std::cout << "[DISANAfilterchain] Calibrated on " << nSample << " events" << (range ? "" : " (implicit MT: entries below " + std::to_string(nEvents) + ")") << ":" << std::endl;
+    Print();
+  }
+
+  // Applies the criteria in the current order (the given order until calibrated or loaded)
+  ROOT::RDF::RNode Apply(ROOT::RDF::RNode df) const {
+    for (size_t i : order_) {
+      DISANAresultcache::RecordExpression(criteria_[i].label, criteria_[i].expression);
+      df = df.Filter(criteria_[i].expression, criteria_[i].label);
+    }
+    return df;
+  }
+
+  // One line per criterion: nsPerEvent rejection expression. Returns false (and keeps the
+  // current order) if the file is missing or does not list exactly this chain's criteria.
+  bool Load(const std::string& file) {
+    std::ifstream in(file);
+    if (!in) return false;
+    std::vector<Criterion> loaded = criteria_;
+    std::vector<bool> seen(criteria_.size(), false);
+    std::string line;
+    while (std::getline(in, line)) {
+      std::istringstream is(line);
+      double ns = 0, rejection = 0;
+      std::string expression;
+      if (!(is >> ns >> rejection) || !std::getline(is >> std::ws, expression)) continue;
+      auto it = std::find_if(criteria_.begin(), criteria_.end(), [&](const Criterion& c) { return c.expression == expression; });
+      if (it == criteria_.end()) {
+        std::cerr << "[DISANAfilterchain] " << file << " lists an unknown criterion '" << expression << "', ignoring the file." << std::endl;
+        return false;
+      }
+      const size_t i = it - criteria_.begin();
+      loaded[i].nsPerEvent = ns;
+      loaded[i].rejection = rejection;
+      seen[i] = true;
+    }
+    if (std::find(seen.begin(), seen.end(), false) != seen.end()) {
+      std::cerr << "[DISANAfilterchain] " << file << " does not cover every criterion, ignoring the file." << std::endl;
+      return false;
+    }
+    criteria_ = std::move(loaded);
+    Reorder();
+    return true;
+  }
+
+  void Save(const std::string& file) const {
+    std::ofstream out(file);
+    if (!out) {
+      std::cerr << "[DISANAfilterchain] Cannot write " << file << std::endl;
+      return;
+    }
+    for (size_t i : order_) out << criteria_[i].nsPerEvent << " " << criteria_[i].rejection << " " << criteria_[i].expression << "\n";
+  }
+
+  void Print() const {
+    const auto precision = std::cout.precision();
+    for (size_t i : order_) {
+      const auto& c = criteria_[i];
+      std::cout << "  " << std::left << std::setw(40) << c.label << std::right << " rejects " << std::setw(6) << std::fixed << std::setprecision(2) << 100 * c.rejection
+                << "%  " << std::setw(8) << c.nsPerEvent << " ns/event" << std::endl;
+    }
+    std::cout.unsetf(std::ios::floatfield);
+    std::cout.precision(precision);
+  }
+
+  const std::vector<Criterion>& Criteria() const { return criteria_; }
+  const std::vector<size_t>& Order() const { return order_; }
+
+ private:
+  // By time per rejected event, then by rejection; criteria that reject nothing go last,
+  // cheapest first. The stable sort keeps the given order for full ties.
+  void Reorder() {
+    for (size_t i = 0; i < order_.size(); ++i) order_[i] = i;
+    auto costPerReject = [this](size_t i) { return criteria_[i].rejection > 0 ? criteria_[i].nsPerEvent / criteria_[i].rejection : HUGE_VAL; };
+    std::stable_sort(order_.begin(), order_.end(), [&](size_t a, size_t b) {
+      if (costPerReject(a) != costPerReject(b)) return costPerReject(a) < costPerReject(b);
+      if (criteria_[a].rejection != criteria_[b].rejection) return criteria_[a].rejection > criteria_[b].rejection;
+      return criteria_[a].nsPerEvent < criteria_[b].nsPerEvent;
+    });
+  }
+
+  std::vector<Criterion> criteria_;
+  std::vector<size_t> order_;
+};
+
+#endif  // DISANA_FILTERCHAIN_H
@@ -46,6 +46,13 @@ DISANAplotter(
   }
    
 ROOT::RDF::RNode GetRDF() { return rdf; }
+// every dataframe the model was built from, e.g. for result cache keys
+std::vector<ROOT::RDF::RNode> GetInputNodes() {
+  std::vector<ROOT::RDF::RNode> nodes = {rdf};
+  for (auto* node : {&rdf_pi0_data, &rdf_dvcs_pi0mc, &rdf_pi0_pi0mc, &rdf_gen_dvcsmc, &rdf_accept_dvcsmc})
+    if (*node) nodes.push_back(**node);
+  return nodes;
+}
 // ---------------- NEW: phi mass-fit results & acceptance provider ---------------
   struct PhiMassFitResult {
     double mu{};     // peak position
@@ -72,6 +79,9 @@ void SetAccEffProvider(AccEffProvider f) { accEffProvider_ = std::move(f); }
 void SetPlotApplyCorrection(bool apply) {dopi0corr = apply;}
 void SetPlotApplyAcceptanceCorrection(bool apply) {doacceptcorr = apply;}
 bool getDoPi0Corr() const { return dopi0corr; }
+bool getDoAccCorr() const { return doacceptcorr; }
+// name column nbins min max of every histogram GetAllHistograms() returns, in order
+std::string GetBookedSpec() const { return kinSpec + disSpec; }
   // --- in public: add a const accessor ---
 const std::vector<std::vector<TH1D*>>& GetPhiDSigmaDt3D() const { return phi_dsdt_QW_; }
 std::vector<std::vector<TH1D*>>& GetPhiDSigmaDt3D() { return phi_dsdt_QW_; } // (optional mutable)
@@ -91,7 +101,8 @@ std::vector<std::vector<TH1D*>>& GetPhiDSigmaDt3D() { return phi_dsdt_QW_; } //
       } else {
         auto minVal = rdf.Min(base);
         auto maxVal = rdf.Max(base);
-        double lo = *minVal;
+        DISANA_BOOK("Min/Max", base, std::vector<std::string>{base});
+        double lo = DISANA_WATCH(rdf, "Min/Max(" + base + ")", *minVal);
         double hi = *maxVal;
         double margin = std::max(1e-3, 0.05 * (hi - lo));
         histMin = lo - margin;
@@ -101,7 +112,9 @@ std::vector<std::vector<TH1D*>>& GetPhiDSigmaDt3D() { return phi_dsdt_QW_; } //
     
        // auto h_all = rdf.Histo1D({(base + "_all").c_str(), "", 100, histMin, histMax}, base);
     auto h_acc = rdf.Histo1D({(base).c_str(), "", 100, histMin, histMax}, base);
+    DISANA_BOOK("Histo1D", base, std::vector<std::string>{base});
     kinematicHistos.push_back(h_acc);
+    kinSpec += "kin " + base + " 100 " + std::to_string(histMin) + " " + std::to_string(histMax) + "\n";
     }
 
   std::map<std::string, std::pair<double, double>> cachedRanges;
@@ -111,7 +124,9 @@ std::vector<std::vector<TH1D*>>& GetPhiDSigmaDt3D() { return phi_dsdt_QW_; } //
     double histMax = axisRanges[var].second;
     // auto h_all = rdf.Histo1D({(var + "_all").c_str(), (var + " All").c_str(), 100, histMin, histMax}, var);
     auto h_acc = rdf.Histo1D({var.c_str(), var.c_str(), 100, histMin, histMax}, var);
+    DISANA_BOOK("Histo1D", var, std::vector<std::string>{var});
     disHistos.push_back(h_acc);
+    disSpec += "dis " + var + " 100 " + std::to_string(histMin) + " " + std::to_string(histMax) + "\n";
 
     //auto h_acceptance = dynamic_cast<TH1*>(h_acc->Clone((var + "_acceptance").c_str()));
     //h_acceptance->SetTitle(("Acceptance for " + var).c_str());
@@ -365,7 +380,8 @@ std::vector<std::vector<TH1D*>>& GetPhiDSigmaDt3D() { return phi_dsdt_QW_; } //
     // 1) Make & materialize the histogram (unique name under MT)
     auto hname = Form("hM_tmp_%lu", uid.fetch_add(1));
     auto hR = dfBin.Histo1D(ROOT::RDF::TH1DModel(hname, ";M_{K^{+}K^{-}} [GeV];Counts", (unsigned)nBins, mMin, mMax), massCol);
-    hR.GetValue();  // force event loop
+    DISANA_BOOK("Histo1D", hname, std::vector<std::string>{massCol});
+    DISANA_WATCH(dfBin, "Histo1D(phi mass fit)", (void)hR.GetValue());  // force event loop
     TH1D* h = hR.GetPtr();
     if (!h || h->GetEntries() == 0) return out;
 
@@ -397,7 +413,7 @@ std::vector<std::vector<TH1D*>>& GetPhiDSigmaDt3D() { return phi_dsdt_QW_; } //
 
     // 4) Count data in ±3σ directly from the dataframe (keeps cuts consistent)
     auto dfWin = dfBin.Filter([&](float m) { return m > out.mLo && m < out.mHi; }, {massCol});
-    out.Nwin = *dfWin.Count();
+    out.Nwin = DISANA_WATCH(dfWin, "Count(phi mass window)", *dfWin.Count());
 
     // 5) Background under the window:
     //    Use the background component evaluated at bin centers and summed over bins in [mLo,mHi]
@@ -569,7 +585,8 @@ inline std::vector<std::vector<std::vector<PhiMassDraw>>> MakePhiMassFitCanvases
         auto hR = df_bin.Histo1D(ROOT::RDF::TH1DModel(hname, ";M_{K^{+}K^{-}} [GeV];Counts",
                                                       (unsigned)nMassBins, mMin, mMax),
                                  "invMass_KpKm");
-        hR.GetValue();
+        DISANA_BOOK("Histo1D", hname, std::vector<std::string>{"invMass_KpKm"});
+        DISANA_WATCH(df_bin, "Histo1D(phi mass per bin)", (void)hR.GetValue());
         TH1D* h = (TH1D*)hR.GetPtr();
         if (!h || h->GetEntries() == 0) {
           // still record an empty point in dσ/dt if we're computing it
@@ -642,7 +659,7 @@ inline std::vector<std::vector<std::vector<PhiMassDraw>>> MakePhiMassFitCanvases
 
         // window counts & signal
         auto dfWin     = df_bin.Filter([=](float m){ return m > mLo && m < mHi; }, {"invMass_KpKm"});
-        const ULong64_t Nwin = *dfWin.Count();
+        const ULong64_t Nwin = DISANA_WATCH(dfWin, "Count(phi mass window)", *dfWin.Count());
         const double Nsig    = std::max(0.0, static_cast<double>(Nwin) - Nbkg);
         const double dNsig   = std::hypot(std::sqrt(std::max(0.0, (double)Nwin)), 0.10 * Nbkg);
 
@@ -761,6 +778,7 @@ inline std::vector<std::vector<std::vector<PhiMassDraw>>> MakePhiMassFitCanvases
   bool doacceptcorr = false;
   std::string ttreeName;
   std::vector<ROOT::RDF::RResultPtr<TH1>> kinematicHistos, disHistos;
+  std::string kinSpec, disSpec;
   std::vector<std::vector<TH1D*>> phi_dsdt_QW_;
   std::vector<std::shared_ptr<TH1>> acceptHistos;
   ROOT::RDF::RNode rdf;
@@ -0,0 +1,250 @@
+#ifndef DISANA_PREVIEW_H
+#define DISANA_PREVIEW_H
+
+// Progressive previews of histograms while their event loop runs.
+//
+// Track() hooks the results of a loop (OnPartialResultSlot): every slot copies its partial
+// histograms every few thousand entries, and each time the copies cover another `every` of the
+// source entries they are merged, scaled to the full sample and written to
+// <directory>/<name>_<percent>.root. The scaled bin contents estimate the final counts and the
+// bin errors are the statistical errors of that estimate (scale * sqrt(n)). The loop is never
+// paused, and a run can be interrupted as soon as the trend is clear: the previews already
+// written stay on disk.
+//
+// A preview is only representative if the events seen first are a random sample, and the files
+// are read front to back (with implicit MT too: the clusters of a file are handed out in order).
+// ShuffleClusters() writes a copy of a file with its clusters in random order, once per input, so
+// any prefix of the copy is a random set of clusters from the whole file; Shuffled() then mixes
+// the files.
+//
+//   std::vector<std::string> files;
+//   for (const auto& f : {"skim_000.root", "skim_001.root"}) files.push_back(DISANApreview::ShuffleClusters(f, "dfSelected_afterFid", "./shuffled"));
+//   ROOT::RDataFrame df("dfSelected_afterFid", DISANApreview::Shuffled(files));
+//   DISANApreview preview("./preview", 0.05);
+//   auto hQ2 = df.Histo1D({"hQ2", ";Q^{2}", 100, 0, 12}, "Q2");
+//   preview.Track(df, DISANApreview::CountEntries("dfSelected_afterFid", files), "Q2", std::vector{hQ2});
+
+#include <TChain.h>
+#include <TDirectory.h>
+#include <TFile.h>
+#include <TH1.h>
+#include <TKey.h>
+#include <TNamed.h>
+#include <TTree.h>
+
+#include <ROOT/RDataFrame.hxx>
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+class DISANApreview {
+ public:
+  // Extra histograms made from the scaled previews and written with them, e.g. the asymmetry of
+  // two helicity yields; they are deleted after writing
+  using Derive = std::function<std::vector<TH1*>(const std::vector<TH1*>&)>;
+
+  explicit DISANApreview(const std::string& directory, double every = 0.05) : directory_(directory), every_(every) {
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+    if (ec) std::cerr << "[DISANApreview] Cannot create " << directory_ << ": " << ec.message() << std::endl;
+  }
+
+  const std::string& GetDirectory() const { return directory_; }
+  double GetEvery() const { return every_; }
+
+  // files in random order (seed 0: a new order every run)
+  static std::vector<std::string> Shuffled(std::vector<std::string> files, unsigned int seed = 0) {
+    std::mt19937 rng(seed ? seed : std::random_device{}());
+    std::shuffle(files.begin(), files.end(), rng);
+    return files;
+  }
+
+  // Copy of tree (and the TNamed notes next to it, e.g. the OutputEncoding manifest) in file with
+  // its clusters in random order, written to <directory>/<file name> unless that copy is already
+  // newer than file; returns the copy, or file itself when it cannot be written
+  static std::string ShuffleClusters(const std::string& file, const std::string& tree, const std::string& directory, unsigned int seed = 0) {
+    namespace fs = std::filesystem;
+    const std::string target = (fs::path(directory) / fs::path(file).filename()).string();
+    std::error_code ec;
+    if (fs::exists(target, ec) && fs::last_write_time(target, ec) > fs::last_write_time(file, ec) && !ec) return target;
+    fs::create_directories(directory, ec);
+
+    std::unique_ptr<TFile> in(TFile::Open(file.c_str(), "READ"));
+    auto* source = in && !in->IsZombie() ? in->Get<TTree>(tree.c_str()) : nullptr;
+    if (!source) {
+      std::cerr << "[DISANApreview] No " << tree << " in " << file << ", not shuffled." << std::endl;
+      return file;
+    }
+    std::vector<std::pair<Long64_t, Long64_t>> clusters;
+    auto it = source->GetClusterIterator(0);
+    for (Long64_t first; (first = it()) < source->GetEntries();) clusters.emplace_back(first, it.GetNextEntry());
+    std::mt19937 rng(seed ? seed : std::random_device{}());
+    std::shuffle(clusters.begin(), clusters.end(), rng);
+
+    const std::string tmp = target + ".tmp";
+    {
+      TFile out(tmp.c_str(), "RECREATE");
+      if (out.IsZombie()) {
+        std::cerr << "[DISANApreview] Cannot write " << tmp << ", " << file << " not shuffled." << std::endl;
+        return file;
+      }
+      out.SetCompressionSettings(in->GetCompressionSettings());
+      TTree* copy = source->CloneTree(0);
+      for (const auto& [first, end] : clusters)
+        for (Long64_t i = first; i < end; ++i) {
+          source->GetEntry(i);
+          copy->Fill();
+        }
+      copy->Write();
+      for (auto* key : *in->GetListOfKeys()) {
+        std::unique_ptr<TObject> object(static_cast<TKey*>(key)->ReadObj());
+        if (object && object->IsA() == TNamed::Class()) out.WriteTObject(object.get());
+      }
+      out.Close();
+    }
+    fs::rename(tmp, target, ec);
+    if (ec) {
+      std::cerr << "[DISANApreview] Could not write " << target << ": " << ec.message() << std::endl;
+      return file;
+    }
+    std::cout << "[DISANApreview] " << file << ": " << clusters.size() << " clusters shuffled -> " << target << std::endl;
+    return target;
+  }
+
+  // Entries of the tree in the files, from the file headers
+  static ULong64_t CountEntries(const std::string& tree, const std::vector<std::string>& files) {
+    TChain chain(tree.c_str());
+    for (const auto& file : files) chain.Add(file.c_str());
+    return static_cast<ULong64_t>(chain.GetEntries());
+  }
+
+  // Call after booking results on df and before its loop runs. nEntries counts the entries of
+  // df's source, the unit the progress is measured in; invalid (default) results are skipped.
+  template <typename H>
+  void Track(ROOT::RDF::RNode df, ULong64_t nEntries, const std::string& name, const std::vector<ROOT::RDF::RResultPtr<H>>& results, Derive derive = nullptr) const {
+    std::vector<ROOT::RDF::RResultPtr<H>> valid;
+    for (const auto& r : results)
+      if (r) valid.push_back(r);
+    if (valid.empty() || nEntries == 0) return;
+
+    const unsigned int nSlots = std::max(1u, df.GetNSlots());
+    auto state = std::make_shared<State>();
+    state->name = name;
+    std::replace(state->name.begin(), state->name.end(), ' ', '_');
+    state->directory = directory_;
+    state->nEntries = nEntries;
+    state->step = std::max<ULong64_t>(1, static_cast<ULong64_t>(every_ * nEntries));
+    state->next = state->step;
+    state->chunk = std::max<ULong64_t>(1, state->step / (2 * nSlots));  // about two copies per slot and step
+    state->slotEntries.assign(nSlots, 0);
+    state->partial.resize(nSlots);
+    for (auto& slot : state->partial) slot.resize(valid.size());
+    state->derive = std::move(derive);
+
+    for (size_t j = 0; j < valid.size(); ++j) {
+      valid[j].OnPartialResultSlot(state->chunk, [state, j](unsigned int slot, H& partial) {
+        std::vector<std::unique_ptr<TH1>> merged;
+        ULong64_t seen = 0;
+        {
+          std::lock_guard<std::mutex> lock(state->mutex);
+          auto& copy = state->partial[slot][j];
+          if (!copy) {
+            TDirectory::TContext context(nullptr);
+            copy.reset(static_cast<TH1*>(partial.Clone()));
+          } else {
+            copy->Reset();
+            copy->Add(&partial);
+          }
+          // the results of a slot are called back in booking order at the same entry
+          if (j + 1 != state->partial[slot].size()) return;
+          state->slotEntries[slot] += state->chunk;
+          seen = std::accumulate(state->slotEntries.begin(), state->slotEntries.end(), ULong64_t(0));
+          if (seen < state->next || seen >= state->nEntries) return;
+          merged = Merge(*state);
+          state->next = (seen / state->step + 1) * state->step;
+        }
+        // the other slots go on copying while this one writes
+        Write(*state, seen, std::move(merged));
+      });
+    }
+  }
+
+ private:
+  struct State {
+    std::string name, directory;
+    ULong64_t nEntries = 0, step = 1, next = 1, chunk = 1;
+    std::vector<ULong64_t> slotEntries;                      // source entries of each slot at its last copy
+    std::vector<std::vector<std::unique_ptr<TH1>>> partial;  // [slot][result], guarded by mutex
+    Derive derive;
+    std::mutex mutex;
+  };
+
+  // Sum of the slot copies of every result; called with the mutex held
+  static std::vector<std::unique_ptr<TH1>> Merge(const State& state) {
+    TDirectory::TContext context(nullptr);
+    std::vector<std::unique_ptr<TH1>> merged(state.partial.front().size());
+    for (const auto& slot : state.partial)
+      for (size_t j = 0; j < slot.size(); ++j) {
+        if (!slot[j]) continue;
+        if (!merged[j]) {
+          merged[j].reset(static_cast<TH1*>(slot[j]->Clone()));
+        } else {
+          merged[j]->Add(slot[j].get());
+        }
+      }
+    return merged;
+  }
+
+  // Scales the merged results to the full sample and writes them next to the target, renamed
+  // into place so a reader never sees a half-written preview; reads only the constant part of state
+  static void Write(const State& state, ULong64_t seen, std::vector<std::unique_ptr<TH1>> merged) {
+    TDirectory::TContext context(nullptr);
+    const double scale = static_cast<double>(state.nEntries) / seen;
+    std::vector<TH1*> scaled;
+    for (auto& h : merged) {
+      if (!h) continue;
+      h->Sumw2();
+      h->Scale(scale);
+      scaled.push_back(h.get());
+    }
+    std::vector<std::unique_ptr<TH1>> derived;
+    if (state.derive)
+      for (TH1* h : state.derive(scaled)) derived.emplace_back(h);
+
+    const int percent = static_cast<int>(100.0 * seen / state.nEntries + 0.5);
+    const std::string target = (std::filesystem::path(state.directory) / Form("%s_%03d.root", state.name.c_str(), percent)).string();
+    const std::string tmp = target + ".tmp";
+    {
+      TFile file(tmp.c_str(), "RECREATE");
+      if (file.IsZombie()) {
+        std::cerr << "[DISANApreview] Cannot write " << tmp << std::endl;
+        return;
+      }
+      TNamed progress("progress", Form("%llu of %llu entries, scaled by %g", static_cast<unsigned long long>(seen), static_cast<unsigned long long>(state.nEntries), scale));
+      file.WriteTObject(&progress);
+      for (TH1* h : scaled) file.WriteTObject(h);
+      for (auto& h : derived)
+        if (h) file.WriteTObject(h.get());
+      file.Close();
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, target, ec);
+    if (ec) {
+      std::cerr << "[DISANApreview] Could not write " << target << ": " << ec.message() << std::endl;
+      return;
+    }
+    std::cout << "[DISANApreview] " << state.name << ": " << percent << "% of " << state.nEntries << " entries -> " << target << std::endl;
+  }
+
+  std::string directory_;
+  double every_;
+};
+
+#endif  // DISANA_PREVIEW_H
@@ -0,0 +1,208 @@
+#ifndef DISANA_RENDERER_H
+#define DISANA_RENDERER_H
+
+// Parallel off-screen rendering of finished canvases.
+//
+// Building a comparison canvas (filling pads, styling, fitting) is cheap next to painting it into
+// a PDF or PNG, and the large ones (the 5400x1800 xBQ2tBin canvas, one tiled grid per t bin) are
+// painted one after the other on the main thread. With workers enabled, Save() does not paint:
+// it streams the canvas (pads, histograms, functions, legends and the color table) together with
+// the current gStyle and TGaxis digit setting into a job file in the temp directory and returns,
+// so the canvas can be deleted right away. Flush() then starts a pool of new `root -b -q`
+// processes (posix_spawn, no fork of the possibly multi-threaded analysis process) running a
+// small render macro written next to the job file; every worker reads its share of the jobs
+// back (largest canvases spread first) and writes the files. With 0 or 1 worker Save() is a
+// plain SaveAs.
+//
+//   DISANArenderer renderer;
+//   renderer.SetWorkers(8);
+//   renderer.Save(canvas, "./xBQ2tBin.pdf");
+//   delete canvas;
+//   ...
+//   renderer.Flush();   // also done by the destructor
+
+#include <TCanvas.h>
+#include <TDirectory.h>
+#include <TFile.h>
+#include <TGaxis.h>
+#include <TNamed.h>
+#include <TParameter.h>
+#include <TROOT.h>
+#include <TStyle.h>
+#include <TSystem.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+extern char** environ;
+
+class DISANArenderer {
+ public:
+  DISANArenderer() = default;
+  DISANArenderer(const DISANArenderer&) = delete;
+  DISANArenderer& operator=(const DISANArenderer&) = delete;
+  ~DISANArenderer() { Flush(); }
+
+  // nWorkers <= 1 renders immediately in Save(); the job file goes to jobDir (default: the temp directory)
+  void SetWorkers(int nWorkers, const std::string& jobDir = "") {
+    Flush();
+    nWorkers_ = nWorkers;
+    jobDir_ = jobDir.empty() ? gSystem->TempDirectory() : jobDir;
+  }
+  int GetWorkers() const { return nWorkers_; }
+
+  void Save(TCanvas* canvas, const std::string& path) {
+    if (!canvas) return;
+    if (nWorkers_ <= 1) {
+      canvas->SaveAs(path.c_str());
+      return;
+    }
+    TDirectory::TContext keepDirectory;  // histograms booked later must not land in the job file
+    if (!jobFile_) {
+      jobName_ = "disana_render_" + std::to_string(getpid());
+      jobPath_ = jobDir_ + "/" + jobName_ + ".root";
+      jobFile_.reset(TFile::Open(jobPath_.c_str(), "RECREATE", "", 101));  // fast compression, the file is temporary
+      if (!jobFile_ || jobFile_->IsZombie()) {
+        std::cerr << "[DISANArenderer] Cannot create " << jobPath_ << ", rendering serially." << std::endl;
+        jobFile_.reset();
+        nWorkers_ = 1;
+        canvas->SaveAs(path.c_str());
+        return;
+      }
+    }
+    const std::string key = "job" + std::to_string(jobs_.size());
+    jobFile_->WriteObject(canvas, (key + "_canvas").c_str());
+    jobFile_->WriteObject(gStyle, (key + "_style").c_str());
+    TNamed target((key + "_path").c_str(), path.c_str());
+    jobFile_->WriteTObject(&target);
+    TParameter<int> maxDigits((key + "_maxdigits").c_str(), TGaxis::GetMaxDigits());
+    jobFile_->WriteTObject(&maxDigits);
+    jobs_.push_back({key, path, static_cast<double>(canvas->GetWw()) * canvas->GetWh()});
+  }
+
+  // Renders every pending job; returns false if a worker failed
+  bool Flush() {
+    if (jobs_.empty()) {
+      jobFile_.reset();
+      return true;
+    }
+    jobFile_->Close();
+    jobFile_.reset();
+
+    const int nWorkers = std::min<int>(nWorkers_, jobs_.size());
+    // largest canvas first to the least loaded worker
+    std::vector<size_t> order(jobs_.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) { return jobs_[a].pixels > jobs_[b].pixels; });
+    std::vector<std::vector<size_t>> share(nWorkers);
+    std::vector<double> load(nWorkers, 0);
+    for (size_t i : order) {
+      const int w = std::min_element(load.begin(), load.end()) - load.begin();
+      share[w].push_back(i);
+      load[w] += jobs_[i].pixels;
+    }
+
+    const std::string macroPath = jobDir_ + "/" + jobName_ + ".C";
+    if (!WriteMacro(macroPath)) {
+      std::cerr << "[DISANArenderer] Cannot write " << macroPath << ", jobs kept in " << jobPath_ << std::endl;
+      jobs_.clear();
+      return false;
+    }
+
+    std::cout.flush();
+    std::cerr.flush();
+    const std::string root = std::string(TROOT::GetBinDir().Data()) + "/root";
+    std::vector<pid_t> children;
+    bool ok = true;
+    for (int w = 0; w < nWorkers; ++w) {
+      const std::string call = Call(macroPath, share[w], true);
+      std::vector<std::string> args = {root, "-b", "-l", "-q", call};
+      std::vector<char*> argv;
+      for (auto& a : args) argv.push_back(&a[0]);
+      argv.push_back(nullptr);
+      pid_t pid = 0;
+      if (posix_spawn(&pid, root.c_str(), nullptr, nullptr, argv.data(), environ) != 0) {
+        std::cerr << "[DISANArenderer] Cannot start " << root << ", rendering worker " << w << " in this process." << std::endl;
+        ok = gROOT->ProcessLine((".x " + Call(macroPath, share[w], false)).c_str()) == 0 && ok;
+        continue;
+      }
+      children.push_back(pid);
+    }
+    for (pid_t pid : children) {
+      int status = 0;
+      waitpid(pid, &status, 0);
+      if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) ok = false;
+    }
+    if (!ok) std::cerr << "[DISANArenderer] Some canvases were not rendered, the jobs are kept in " << jobPath_ << std::endl;
+    std::cout << "[DISANArenderer] Rendered " << jobs_.size() << " canvases with " << nWorkers << " workers." << std::endl;
+    if (ok) std::remove(jobPath_.c_str());
+    std::remove(macroPath.c_str());
+    jobs_.clear();
+    return ok;
+  }
+
+ private:
+  struct Job {
+    std::string key;
+    std::string path;
+    double pixels;
+  };
+
+  // The worker: paints the listed jobs of the job file and returns the number it could not read;
+  // run by `root -b -q` it exits with 1 instead, so the function is named after the macro file.
+  bool WriteMacro(const std::string& macroPath) const {
+    std::ofstream macro(macroPath);
+    macro << "#include <TCanvas.h>\n#include <TFile.h>\n#include <TGaxis.h>\n#include <TNamed.h>\n#include <TParameter.h>\n#include <TROOT.h>\n"
+          << "#include <TStyle.h>\n#include <TSystem.h>\n#include <iostream>\n#include <memory>\n#include <sstream>\n#include <string>\n\n"
+          << "int " << jobName_ << "(const char* jobPath, const char* keys, bool worker) {\n"
+          << "  gROOT->SetBatch(kTRUE);\n"
+          << "  std::unique_ptr<TFile> file(TFile::Open(jobPath, \"READ\"));\n"
+          << "  int missing = 0;\n"
+          << "  if (!file || file->IsZombie()) missing = 1;\n"
+          << "  std::istringstream list(keys);\n"
+          << "  for (std::string key; file && !file->IsZombie() && list >> key;) {\n"
+          << "    std::unique_ptr<TStyle> style(file->Get<TStyle>((key + \"_style\").c_str()));\n"
+          << "    std::unique_ptr<TCanvas> canvas(file->Get<TCanvas>((key + \"_canvas\").c_str()));\n"
+          << "    std::unique_ptr<TNamed> path(file->Get<TNamed>((key + \"_path\").c_str()));\n"
+          << "    std::unique_ptr<TParameter<int>> maxDigits(file->Get<TParameter<int>>((key + \"_maxdigits\").c_str()));\n"
+          << "    if (!canvas || !path) {\n"
+          << "      std::cerr << \"[DISANArenderer] \" << key << \" missing in \" << jobPath << std::endl;\n"
+          << "      ++missing;\n"
+          << "      continue;\n"
+          << "    }\n"
+          << "    if (style) style->Copy(*gStyle);\n"
+          << "    if (maxDigits) TGaxis::SetMaxDigits(maxDigits->GetVal());\n"
+          << "    canvas->Draw();\n"
+          << "    canvas->SaveAs(path->GetTitle());\n"
+          << "  }\n"
+          << "  if (worker && missing) gSystem->Exit(1);\n"
+          << "  return missing;\n"
+          << "}\n";
+    macro.close();
+    return static_cast<bool>(macro);
+  }
+
+  // macro("jobfile", "job3 job7 ...", worker)
+  std::string Call(const std::string& macroPath, const std::vector<size_t>& share, bool worker) const {
+    std::string keys;
+    for (size_t i : share) keys += (keys.empty() ? "" : " ") + jobs_[i].key;
+    return macroPath + "(\"" + jobPath_ + "\", \"" + keys + "\", " + (worker ? "true" : "false") + ")";
+  }
+
+  int nWorkers_ = 1;
+  std::string jobDir_ = gSystem->TempDirectory();
+  std::string jobName_;  // disana_render_<pid>, also the name of the render macro
+  std::string jobPath_;
+  std::unique_ptr<TFile> jobFile_;
+  std::vector<Job> jobs_;
+};
+
+#endif  // DISANA_RENDERER_H
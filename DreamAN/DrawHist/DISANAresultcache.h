@@ -0,0 +1,349 @@
+#ifndef DISANA_RESULTCACHE_H
+#define DISANA_RESULTCACHE_H
+
+// On-disk cache of the histograms DISANAcomparer fills from the RDataFrames.
+//
+// Every histogram (or bin cube of histograms, e.g. the BSA of every xB/Q2/t cell) is stored in
+// <directory>/<key>.root, the key hashing
+//   - the identity (path, size, modification time) of the model's input files,
+//   - the selection chain of each of the model's dataframes: the labels of every Define and
+//     Filter between the source and the node, as in ROOT::RDF::SaveGraph, each followed by the
+//     expressions recorded under it (RecordExpression; DISANAfilterchain::Apply records its criteria),
+//   - what is filled: expression, extra cut, binning, luminosity, corrections,
+//   - the code: the contents of the DrawHist and Math headers and of the given sources (the
+//     macro, or a compiled binary),
+//   - the cache tag and kFormatVersion.
+// A later run that only changes the drawing (DrawStyle, titles, pad layout) reads the results
+// back without an event loop; new input files or a changed chain give new keys, so only the
+// affected entries are refilled. The labels do not show a lambda filter's code or a string
+// Filter edited under an unchanged label; the code hash does, as long as the file it is in is
+// one of the sources. Any edit of the macro (a title too) therefore refills everything.
+//
+//   comparer.SetResultCache("./.disana_results", "final_v3", {__FILE__});
+//   comparer.SetModelInputs("Sp18 Inb", {filename_afterFid_inb_data, filename_afterFid_inb_MC});
+//
+// Models without declared inputs are never cached. Looking up the chain lets RDataFrame jit the
+// pending string expressions, a few seconds, once.
+
+#include <TFile.h>
+#include <TH1.h>
+#include <TNamed.h>
+#include <TVectorD.h>
+
+#include <ROOT/RDFHelpers.hxx>
+#include <ROOT/RDataFrame.hxx>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+class DISANAresultcache {
+ public:
+  static constexpr int kFormatVersion = 2;  // part of every key; bump when a cached computation changes its output
+
+  using Cube = std::vector<std::vector<std::vector<TH1D*>>>;
+  using MeanCube = std::vector<std::vector<std::vector<std::tuple<double, double, double>>>>;
+
+  // sources: files (or directories of files) whose code fills the results, besides the headers
+  explicit DISANAresultcache(const std::string& directory, const std::string& tag = "", const std::vector<std::string>& sources = {})
+      : directory_(directory), tag_(tag) {
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+    if (ec) std::cerr << "[DISANAresultcache] Cannot create " << directory_ << ": " << ec.message() << std::endl;
+    std::vector<std::string> code = sources;
+    const auto headers = std::filesystem::path(__FILE__).parent_path();
+    for (const auto& dir : {headers, headers.parent_path() / "Math"}) code.push_back(dir.string());
+    code_ = CodeIdentity(code);
+  }
+
+  const std::string& GetDirectory() const { return directory_; }
+
+  // path size mtime of every file; a directory stands for the files in it
+  static std::string InputIdentity(const std::vector<std::string>& files) {
+    namespace fs = std::filesystem;
+    std::ostringstream text;
+    auto add = [&text](const fs::path& file) {
+      std::error_code ec;
+      const auto path = fs::weakly_canonical(file, ec);
+      const auto size = fs::file_size(file, ec);
+      const auto mtime = ec ? 0 : fs::last_write_time(file, ec).time_since_epoch().count();
+      text << (path.empty() ? file : path).string() << " " << (ec ? 0 : size) << " " << (ec ? 0 : mtime) << "\n";
+    };
+    for (const auto& file : files) {
+      std::error_code ec;
+      if (!fs::is_directory(file, ec)) {
+        add(file);
+        continue;
+      }
+      std::vector<fs::path> content;
+      for (const auto& entry : fs::directory_iterator(file, ec))
+        if (entry.is_regular_file()) content.push_back(entry.path());
+      std::sort(content.begin(), content.end());
+      for (const auto& path : content) add(path);
+    }
+    return text.str();
+  }
+
+  // Content hash of every file; a directory stands for the files in it. A file that cannot be
+  // read is keyed by its name and reported, its edits are not seen.
+  static std::string CodeIdentity(const std::vector<std::string>& files) {
+    namespace fs = std::filesystem;
+    std::ostringstream text;
+    auto add = [&text](const fs::path& file) {
+      std::ifstream in(file, std::ios::binary);
+      if (!in) {
+        std::cerr << "[DISANAresultcache] Cannot read " << file.string() << ", its edits do not change the keys" << std::endl;
+        text << file.string() << " unread\n";
+        return;
+      }
+      std::ostringstream content;
+      content << in.rdbuf();
+      char hash[17];
+      std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(Hash(content.str())));
+      text << file.filename().string() << " " << hash << "\n";
+    };
+    for (const auto& file : files) {
+      std::error_code ec;
+      if (!fs::is_directory(file, ec)) {
+        add(file);
+        continue;
+      }
+      std::vector<fs::path> content;
+      for (const auto& entry : fs::directory_iterator(file, ec))
+        if (entry.is_regular_file()) content.push_back(entry.path());
+      std::sort(content.begin(), content.end());
+      for (const auto& path : content) add(path);
+    }
+    return text.str();
+  }
+
+  // Expression applied under a Filter/Define label; call before the keys are computed
+  static void RecordExpression(const std::string& label, const std::string& expression) {
+    std::lock_guard<std::mutex> lock(ExpressionMutex());
+    Expressions()[label].insert(expression);
+  }
+
+  // Labels of the computation graph from the source to node, in graph order, each with the
+  // expressions recorded under it. The node ids of the graph are left out: they depend on what
+  // else has been booked.
+  static std::string ChainIdentity(ROOT::RDF::RNode node) {
+    const std::string graph = ROOT::RDF::SaveGraph(node);
+    std::lock_guard<std::mutex> lock(ExpressionMutex());
+    std::string labels;
+    for (size_t pos = graph.find("label=\""); pos != std::string::npos; pos = graph.find("label=\"", pos)) {
+      pos += 7;
+      const size_t end = graph.find('"', pos);
+      const std::string label = graph.substr(pos, end - pos);
+      labels += label + "\n";
+      auto it = Expressions().find(label);
+      if (it != Expressions().end())
+        for (const auto& expression : it->second) labels += "  = " + expression + "\n";
+      pos = end;
+    }
+    return labels;
+  }
+
+  std::string Key(const std::string& identity, const std::string& what) const {
+    std::ostringstream text;
+    text << "v" << kFormatVersion << " " << tag_ << "\n" << what << "\n" << identity << "code\n" << code_;
+    char key[17];
+    std::snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(Hash(text.str())));
+    return key;
+  }
+
+  // Loaded histograms are detached (SetDirectory(0)) and owned by the caller
+  bool Load(const std::string& key, std::vector<TH1*>& histos) {
+    auto file = Open(key);
+    std::unique_ptr<TNamed> count(file ? file->Get<TNamed>("count") : nullptr);
+    if (!count) return Miss();
+    std::vector<TH1*> loaded(std::stoul(count->GetTitle()), nullptr);
+    for (size_t i = 0; i < loaded.size(); ++i) loaded[i] = Detach(file->Get<TH1>(Form("h_%zu", i)));
+    histos = std::move(loaded);
+    return Hit();
+  }
+
+  bool Load(const std::string& key, Cube& cube) {
+    auto file = Open(key);
+    std::unique_ptr<TNamed> shape(file ? file->Get<TNamed>("shape") : nullptr);
+    if (!shape || !Reshape(shape->GetTitle(), cube)) return Miss();
+    for (size_t i = 0; i < cube.size(); ++i)
+      for (size_t j = 0; j < cube[i].size(); ++j)
+        for (size_t k = 0; k < cube[i][j].size(); ++k) cube[i][j][k] = static_cast<TH1D*>(Detach(file->Get<TH1D>(Form("c_%zu_%zu_%zu", i, j, k))));
+    return Hit();
+  }
+
+  bool Load(const std::string& key, MeanCube& means) {
+    auto file = Open(key);
+    std::unique_ptr<TNamed> shape(file ? file->Get<TNamed>("shape") : nullptr);
+    std::unique_ptr<TVectorD> values(file ? file->Get<TVectorD>("means") : nullptr);
+    if (!shape || !values || !Reshape(shape->GetTitle(), means)) return Miss();
+    int n = 0;
+    for (auto& plane : means)
+      for (auto& row : plane)
+        for (auto& cell : row) {
+          if (n + 2 >= values->GetNrows()) return Miss();
+          cell = std::make_tuple((*values)[n], (*values)[n + 1], (*values)[n + 2]);
+          n += 3;
+        }
+    return Hit();
+  }
+
+  // what is kept in the entry as a note of its content
+  void Store(const std::string& key, const std::string& what, const std::vector<TH1*>& histos) const {
+    Write(key, what, [&](TFile& file) {
+      TNamed count("count", std::to_string(histos.size()).c_str());
+      file.WriteTObject(&count);
+      for (size_t i = 0; i < histos.size(); ++i)
+        if (histos[i]) file.WriteObject(histos[i], Form("h_%zu", i));
+    });
+  }
+
+  void Store(const std::string& key, const std::string& what, const Cube& cube) const {
+    Write(key, what, [&](TFile& file) {
+      TNamed shape("shape", Shape(cube).c_str());
+      file.WriteTObject(&shape);
+      for (size_t i = 0; i < cube.size(); ++i)
+        for (size_t j = 0; j < cube[i].size(); ++j)
+          for (size_t k = 0; k < cube[i][j].size(); ++k)
+            if (cube[i][j][k]) file.WriteObject(cube[i][j][k], Form("c_%zu_%zu_%zu", i, j, k));
+    });
+  }
+
+  void Store(const std::string& key, const std::string& what, const MeanCube& means) const {
+    std::vector<double> flat;
+    for (const auto& plane : means)
+      for (const auto& row : plane)
+        for (const auto& [a, b, c] : row) flat.insert(flat.end(), {a, b, c});
+    Write(key, what, [&](TFile& file) {
+      TNamed shape("shape", Shape(means).c_str());
+      file.WriteTObject(&shape);
+      TVectorD values(static_cast<int>(flat.size()), flat.data());
+      file.WriteObject(&values, "means");
+    });
+  }
+
+  void Clear() const {
+    std::error_code ec;
+    size_t removed = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(directory_, ec))
+      if (entry.path().extension() == ".root") removed += std::filesystem::remove(entry.path(), ec);
+    std::cout << "[DISANAresultcache] Removed " << removed << " entries from " << directory_ << std::endl;
+  }
+
+  void Print() const { std::cout << "[DISANAresultcache] " << directory_ << ": " << hits_ << " results read back, " << misses_ << " filled" << std::endl; }
+
+ private:
+  // FNV-1a, 64 bit (as StageCache)
+  static uint64_t Hash(const std::string& text) {
+    uint64_t h = 1469598103934665603ULL;
+    for (unsigned char c : text) {
+      h ^= c;
+      h *= 1099511628211ULL;
+    }
+    return h;
+  }
+
+  static std::map<std::string, std::set<std::string>>& Expressions() {
+    static std::map<std::string, std::set<std::string>> expressions;
+    return expressions;
+  }
+  static std::mutex& ExpressionMutex() {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+  std::string Path(const std::string& key) const { return (std::filesystem::path(directory_) / (key + ".root")).string(); }
+
+  std::unique_ptr<TFile> Open(const std::string& key) const {
+    std::error_code ec;
+    if (!std::filesystem::exists(Path(key), ec)) return nullptr;
+    std::unique_ptr<TFile> file(TFile::Open(Path(key).c_str(), "READ"));
+    if (!file || file->IsZombie()) return nullptr;
+    return file;
+  }
+
+  // written next to the entry and renamed into place, so a crash never leaves a partial entry
+  template <typename Fill>
+  void Write(const std::string& key, const std::string& what, Fill fill) const {
+    const std::string target = Path(key), tmp = target + ".tmp";
+    {
+      TFile file(tmp.c_str(), "RECREATE");
+      if (file.IsZombie()) {
+        std::cerr << "[DISANAresultcache] Cannot write " << tmp << std::endl;
+        return;
+      }
+      TNamed note("what", what.c_str());
+      file.WriteTObject(&note);
+      fill(file);
+      file.Close();
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, target, ec);
+    if (ec) {
+      std::cerr << "[DISANAresultcache] Could not store " << target << ": " << ec.message() << std::endl;
+      std::filesystem::remove(tmp, ec);
+    }
+  }
+
+  static TH1* Detach(TH1* h) {
+    if (h) h->SetDirectory(nullptr);
+    return h;
+  }
+
+  // n0, then the size of every row, then the size of every cell list
+  template <typename T>
+  static std::string Shape(const std::vector<std::vector<std::vector<T>>>& cube) {
+    std::ostringstream shape;
+    shape << cube.size();
+    for (const auto& plane : cube) shape << " " << plane.size();
+    for (const auto& plane : cube)
+      for (const auto& row : plane) shape << " " << row.size();
+    return shape.str();
+  }
+
+  template <typename T>
+  static bool Reshape(const std::string& text, std::vector<std::vector<std::vector<T>>>& cube) {
+    std::istringstream shape(text);
+    size_t n0 = 0;
+    if (!(shape >> n0)) return false;
+    cube.assign(n0, {});
+    for (auto& plane : cube) {
+      size_t n1 = 0;
+      if (!(shape >> n1)) return false;
+      plane.resize(n1);
+    }
+    for (auto& plane : cube)
+      for (auto& row : plane) {
+        size_t n2 = 0;
+        if (!(shape >> n2)) return false;
+        row.resize(n2);
+      }
+    return true;
+  }
+
+  bool Hit() {
+    ++hits_;
+    return true;
+  }
+  bool Miss() {
+    ++misses_;
+    return false;
+  }
+
+  std::string directory_;
+  std::string tag_;
+  std::string code_;  // CodeIdentity of the sources and headers
+  size_t hits_ = 0, misses_ = 0;
+};
+
+#endif  // DISANA_RESULTCACHE_H
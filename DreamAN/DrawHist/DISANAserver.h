@@ -0,0 +1,413 @@
+#ifndef DISANA_SERVER_H
+#define DISANA_SERVER_H
+
+// Long-lived re-plotting server.
+//
+// The selected candidates of every model are pulled once from their RDataFrame into a
+// compact in-memory columnar cache, one array per column in its native precision: float
+// columns stay float, double columns double, and integer and bool columns are kept as exact
+// 64-bit integers, so event numbers and high-precision kinematics are not truncated. Cut / binning /
+// histogram requests are then answered from memory with a multithreaded scan, so
+// iterating on a cut no longer re-reads, re-defines and re-JITs the whole chain.
+//
+// Protocol (one request per line on a local UNIX socket, answers end with "\n"):
+//   MODELS                                         -> OK <n> <label> ...
+//   COLUMNS <model>                                -> OK <n> <column> ...
+//   COUNT <model> [WHERE <cut>]                    -> OK <count>
+//   HIST  <model> <col> <nbins> <lo> <hi> [WHERE <cut>]
+//                                                  -> OK <nbins> <underflow> <overflow> <c1> ... <cn>
+//   HIST2 <model> <colx> <nx> <xlo> <xhi> <coly> <ny> <ylo> <yhi> [WHERE <cut>]
+//                                                  -> OK <nx> <ny> <c(1,1)> <c(2,1)> ... (x fastest)
+//   QUIT | SHUTDOWN
+// with <cut> := <col> <op> <value> [AND <col> <op> <value> ...], op one of < <= > >= == !=
+// Errors come back as "ERR <message>". Every client is served by its own thread, so several
+// shells or notebooks can query the same cache; QUIT closes the connection and SHUTDOWN stops
+// the server.
+//
+// Usage from a plotting macro, after InitKinematics and the final selections:
+//   DISANAserver server;
+//   server.AddModel("Sp18 Inb", df_final_inb, {"Q2", "xB", "t", "phi", "W", "Mx2_epg", "pho_det_region", "pro_det_region"});
+//   server.Serve("/tmp/disana.sock");
+// and from a shell:  echo "HIST Sp18_Inb t 50 0 2 WHERE Q2 > 2 AND pho_det_region == 1" | socat - UNIX-CONNECT:/tmp/disana.sock
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <ROOT/RDataFrame.hxx>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+class DISANAserver {
+ public:
+  struct CutTerm {
+    size_t column = 0;
+    std::string op;
+    double value = 0;
+    Long64_t integer = 0;   // the value as written, compared exactly against integer columns
+    bool isInteger = false;
+  };
+
+  explicit DISANAserver(unsigned int nThreads = std::max(1u, std::thread::hardware_concurrency())) : nThreads_(nThreads) {}
+
+  // Pull the requested scalar columns into memory. All columns are booked first so the
+  // model costs a single event loop. Spaces in labels are replaced by '_' for the protocol.
+  void AddModel(const std::string& label, ROOT::RDF::RNode df, const std::vector<std::string>& columns) {
+    auto start = std::chrono::steady_clock::now();
+    Model model;
+    std::vector<std::function<void(Column&)>> fetchers;
+    for (const auto& col : columns) {
+      if (!df.HasColumn(col)) {
+        std::cerr << "[DISANAserver] Column " << col << " not found for model " << label << ", skipping." << std::endl;
+        continue;
+      }
+      auto fetch = BookColumn(df, col);
+      if (!fetch) {
+        std::cerr << "[DISANAserver] Column " << col << " has unsupported type " << df.GetColumnType(col) << ", skipping." << std::endl;
+        continue;
+      }
+      model.names.push_back(col);
+      fetchers.push_back(std::move(fetch));
+    }
+    model.columns.resize(fetchers.size());
+    for (size_t i = 0; i < fetchers.size(); ++i) fetchers[i](model.columns[i]);  // first call triggers the loop
+    model.nRows = model.columns.empty() ? 0 : model.columns.front().Size();
+    size_t bytes = 0;
+    for (const auto& column : model.columns) bytes += column.Bytes();
+
+    std::string key = label;
+    std::replace(key.begin(), key.end(), ' ', '_');
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "[DISANAserver] Cached model " << key << ": " << model.nRows << " candidates x " << model.names.size() << " columns ("
+              << bytes / (1024.0 * 1024.0) << " MB) in " << seconds << " s" << std::endl;
+    models_[key] = std::move(model);
+  }
+
+  // Answer a single request line; used by Serve() and handy for in-process scripting.
+  std::string Query(const std::string& line) const {
+    std::istringstream in(line);
+    std::string cmd;
+    in >> cmd;
+    try {
+      if (cmd == "MODELS") {
+        std::ostringstream out;
+        out << "OK " << models_.size();
+        for (const auto& [name, m] : models_) out << " " << name;
+        return out.str();
+      }
+      if (cmd == "COLUMNS") {
+        const Model& m = GetModel(in);
+        std::ostringstream out;
+        out << "OK " << m.names.size();
+        for (const auto& n : m.names) out << " " << n;
+        return out.str();
+      }
+      if (cmd == "COUNT") {
+        const Model& m = GetModel(in);
+        auto cuts = ParseCuts(m, in);
+        auto counts = Scan(m, cuts, [](const Model&, size_t, std::vector<double>& acc) { acc[0] += 1; }, 1);
+        return "OK " + std::to_string(static_cast<unsigned long long>(counts[0]));
+      }
+      if (cmd == "HIST") {
+        const Model& m = GetModel(in);
+        std::string col;
+        int nbins = 0;
+        double lo = 0, hi = 0;
+        in >> col >> nbins >> lo >> hi;
+        if (!in || nbins <= 0 || hi <= lo) return "ERR usage: HIST <model> <col> <nbins> <lo> <hi> [WHERE ...]";
+        const size_t ic = ColumnIndex(m, col);
+        auto cuts = ParseCuts(m, in);
+        const double scale = nbins / (hi - lo);
+        // layout: [0] underflow, [1..nbins] bins, [nbins+1] overflow
+        auto counts = Scan(
+            m, cuts,
+            [=](const Model& mm, size_t row, std::vector<double>& acc) {
+              const double x = mm.columns[ic].Value(row);
+              if (x < lo) acc[0] += 1;
+              else if (x >= hi) acc[nbins + 1] += 1;
+              else acc[1 + std::min(nbins - 1, static_cast<int>((x - lo) * scale))] += 1;
+            },
+            nbins + 2);
+        std::ostringstream out;
+        out << "OK " << nbins << " " << counts[0] << " " << counts[nbins + 1];
+        for (int b = 1; b <= nbins; ++b) out << " " << counts[b];
+        return out.str();
+      }
+      if (cmd == "HIST2") {
+        const Model& m = GetModel(in);
+        std::string cx, cy;
+        int nx = 0, ny = 0;
+        double xlo = 0, xhi = 0, ylo = 0, yhi = 0;
+        in >> cx >> nx >> xlo >> xhi >> cy >> ny >> ylo >> yhi;
+        if (!in || nx <= 0 || ny <= 0 || xhi <= xlo || yhi <= ylo) return "ERR usage: HIST2 <model> <colx> <nx> <xlo> <xhi> <coly> <ny> <ylo> <yhi> [WHERE ...]";
+        const size_t ix = ColumnIndex(m, cx), iy = ColumnIndex(m, cy);
+        auto cuts = ParseCuts(m, in);
+        const double sx = nx / (xhi - xlo), sy = ny / (yhi - ylo);
+        auto counts = Scan(
+            m, cuts,
+            [=](const Model& mm, size_t row, std::vector<double>& acc) {
+              const double x = mm.columns[ix].Value(row), y = mm.columns[iy].Value(row);
+              if (x < xlo || x >= xhi || y < ylo || y >= yhi) return;
+              acc[std::min(ny - 1, static_cast<int>((y - ylo) * sy)) * nx + std::min(nx - 1, static_cast<int>((x - xlo) * sx))] += 1;
+            },
+            static_cast<size_t>(nx) * ny);
+        std::ostringstream out;
+        out << "OK " << nx << " " << ny;
+        for (double c : counts) out << " " << c;
+        return out.str();
+      }
+    } catch (const std::exception& e) {
+      return std::string("ERR ") + e.what();
+    }
+    return "ERR unknown command '" + cmd + "'";
+  }
+
+  // Blocking accept loop on a local UNIX socket. Every client gets its own thread and may send
+  // many requests; the cache is read-only once serving starts, so the clients never wait on each
+  // other. SHUTDOWN from any client closes the other connections and returns.
+  void Serve(const std::string& socketPath) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) throw std::runtime_error("DISANAserver: cannot create socket");
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(addr.sun_path)) throw std::runtime_error("DISANAserver: socket path too long: " + socketPath);
+    std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(socketPath.c_str());
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, 16) < 0) {
+      close(fd);
+      throw std::runtime_error("DISANAserver: cannot listen on " + socketPath);
+    }
+    std::cout << "[DISANAserver] Listening on " << socketPath << " with " << nThreads_ << " scan threads" << std::endl;
+
+    std::atomic<bool> shutdown{false};
+    std::mutex mutex;  // guards clients and the log
+    std::set<int> clients;
+    std::vector<std::thread> sessions;
+    while (!shutdown) {
+      int client = accept(fd, nullptr, nullptr);
+      if (shutdown) {
+        if (client >= 0) close(client);
+        break;
+      }
+      if (client < 0) continue;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        clients.insert(client);
+      }
+      sessions.emplace_back([&, client] {
+        Session(client, mutex, shutdown);
+        std::lock_guard<std::mutex> lock(mutex);
+        clients.erase(client);
+        close(client);
+        if (!shutdown) return;
+        // wake up accept() and the reads of the other clients
+        ::shutdown(fd, SHUT_RDWR);
+        for (int other : clients) ::shutdown(other, SHUT_RDWR);
+      });
+    }
+    for (auto& session : sessions) session.join();
+    close(fd);
+    unlink(socketPath.c_str());
+    std::cout << "[DISANAserver] Shut down." << std::endl;
+  }
+
+ private:
+  // One cached column; only the array of its kind is filled
+  struct Column {
+    enum Kind { kFloat, kDouble, kInteger } kind = kFloat;
+    std::vector<float> f;
+    std::vector<double> d;
+    std::vector<Long64_t> i;
+
+    size_t Size() const { return kind == kFloat ? f.size() : kind == kDouble ? d.size() : i.size(); }
+    size_t Bytes() const { return f.size() * sizeof(float) + d.size() * sizeof(double) + i.size() * sizeof(Long64_t); }
+    double Value(size_t row) const { return kind == kFloat ? f[row] : kind == kDouble ? d[row] : static_cast<double>(i[row]); }
+  };
+
+  struct Model {
+    std::vector<std::string> names;
+    std::vector<Column> columns;
+    size_t nRows = 0;
+  };
+
+  template <typename T>
+  static std::function<void(Column&)> Fetcher(ROOT::RDF::RNode& df, const std::string& col) {
+    auto result = df.Take<T>(col);
+    return [result](Column& out) mutable {
+      const auto& values = *result;
+      if constexpr (std::is_same_v<T, float>) {
+        out.kind = Column::kFloat;
+        out.f.assign(values.begin(), values.end());
+      } else if constexpr (std::is_same_v<T, double>) {
+        out.kind = Column::kDouble;
+        out.d.assign(values.begin(), values.end());
+      } else {
+        out.kind = Column::kInteger;
+        out.i.assign(values.begin(), values.end());
+      }
+    };
+  }
+
+  // Unsigned 64-bit columns do not fit the integer array exactly and are refused
+  static std::function<void(Column&)> BookColumn(ROOT::RDF::RNode& df, const std::string& col) {
+    const std::string type = df.GetColumnType(col);
+    if (type == "double" || type == "Double_t") return Fetcher<double>(df, col);
+    if (type == "float" || type == "Float_t") return Fetcher<float>(df, col);
+    if (type == "int" || type == "Int_t") return Fetcher<int>(df, col);
+    if (type == "unsigned int" || type == "UInt_t") return Fetcher<unsigned int>(df, col);
+    if (type == "short" || type == "Short_t") return Fetcher<short>(df, col);
+    if (type == "Long64_t" || type == "long long") return Fetcher<Long64_t>(df, col);
+    if (type == "long" || type == "Long_t") return Fetcher<long>(df, col);
+    if (type == "bool" || type == "Bool_t") return Fetcher<bool>(df, col);
+    return {};
+  }
+
+  // Reads the requests of one client until it quits or disconnects
+  void Session(int client, std::mutex& mutex, std::atomic<bool>& shutdown) const {
+    std::string buffer;
+    char chunk[4096];
+    while (!shutdown) {
+      ssize_t n = read(client, chunk, sizeof(chunk));
+      if (n <= 0) return;
+      buffer.append(chunk, static_cast<size_t>(n));
+      size_t pos;
+      while ((pos = buffer.find('\n')) != std::string::npos) {
+        std::string line = buffer.substr(0, pos);
+        buffer.erase(0, pos + 1);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+        if (line == "QUIT") return;
+        if (line == "SHUTDOWN") {
+          shutdown = true;
+          return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        std::string reply = Query(line) + "\n";
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          std::cout << "[DISANAserver] " << line << "  (" << ms << " ms)" << std::endl;
+        }
+        WriteAll(client, reply);
+      }
+    }
+  }
+
+  const Model& GetModel(std::istringstream& in) const {
+    std::string name;
+    in >> name;
+    auto it = models_.find(name);
+    if (it == models_.end()) throw std::runtime_error("unknown model '" + name + "'");
+    return it->second;
+  }
+
+  static size_t ColumnIndex(const Model& m, const std::string& col) {
+    auto it = std::find(m.names.begin(), m.names.end(), col);
+    if (it == m.names.end()) throw std::runtime_error("column '" + col + "' is not cached");
+    return static_cast<size_t>(it - m.names.begin());
+  }
+
+  static std::vector<CutTerm> ParseCuts(const Model& m, std::istringstream& in) {
+    std::vector<CutTerm> cuts;
+    std::string word;
+    if (!(in >> word)) return cuts;
+    if (word != "WHERE") throw std::runtime_error("expected WHERE, got '" + word + "'");
+    while (true) {
+      CutTerm term;
+      std::string col, value;
+      if (!(in >> col >> term.op >> value)) throw std::runtime_error("malformed cut");
+      char* end = nullptr;
+      term.value = std::strtod(value.c_str(), &end);
+      if (end == value.c_str() || *end) throw std::runtime_error("malformed value '" + value + "'");
+      term.integer = std::strtoll(value.c_str(), &end, 10);
+      term.isInteger = !*end;
+      static const std::vector<std::string> ops = {"<", "<=", ">", ">=", "==", "!="};
+      if (std::find(ops.begin(), ops.end(), term.op) == ops.end()) throw std::runtime_error("unknown operator '" + term.op + "'");
+      term.column = ColumnIndex(m, col);
+      cuts.push_back(term);
+      if (!(in >> word)) break;
+      if (word != "AND") throw std::runtime_error("expected AND, got '" + word + "'");
+    }
+    return cuts;
+  }
+
+  template <typename T, typename V>
+  static bool Pass(const std::string& op, T x, V value) {
+    switch (op[0]) {
+      case '<': return op.size() == 1 ? x < value : x <= value;
+      case '>': return op.size() == 1 ? x > value : x >= value;
+      case '=': return x == value;
+      default: return x != value;
+    }
+  }
+
+  // Applies one cut to the rows [begin, end) in the column's own type; integer columns compare
+  // exactly when the cut value is an integer
+  static void Mask(const Column& column, const CutTerm& c, size_t begin, size_t end, unsigned char* mask) {
+    switch (column.kind) {
+      case Column::kFloat:
+        for (size_t r = begin; r < end; ++r) mask[r - begin] &= Pass(c.op, column.f[r], static_cast<float>(c.value));
+        break;
+      case Column::kDouble:
+        for (size_t r = begin; r < end; ++r) mask[r - begin] &= Pass(c.op, column.d[r], c.value);
+        break;
+      case Column::kInteger:
+        if (c.isInteger) {
+          for (size_t r = begin; r < end; ++r) mask[r - begin] &= Pass(c.op, column.i[r], c.integer);
+        } else {
+          for (size_t r = begin; r < end; ++r) mask[r - begin] &= Pass(c.op, static_cast<double>(column.i[r]), c.value);
+        }
+        break;
+    }
+  }
+
+  // Split the rows into one contiguous block per thread; each block builds its selection
+  // mask cut-by-cut (column at a time) and fills a private accumulator, merged at the end.
+  template <typename Fill>
+  std::vector<double> Scan(const Model& m, const std::vector<CutTerm>& cuts, Fill fill, size_t accSize) const {
+    const unsigned int nThreads = static_cast<unsigned int>(std::min<size_t>(nThreads_, std::max<size_t>(1, m.nRows / 65536 + 1)));
+    std::vector<std::vector<double>> partial(nThreads, std::vector<double>(accSize, 0.0));
+    auto work = [&](unsigned int t) {
+      const size_t begin = m.nRows * t / nThreads, end = m.nRows * (t + 1) / nThreads;
+      std::vector<unsigned char> mask(end - begin, 1);
+      for (const auto& c : cuts) Mask(m.columns[c.column], c, begin, end, mask.data());
+      for (size_t r = begin; r < end; ++r)
+        if (mask[r - begin]) fill(m, r, partial[t]);
+    };
+    std::vector<std::thread> pool;
+    for (unsigned int t = 1; t < nThreads; ++t) pool.emplace_back(work, t);
+    work(0);
+    for (auto& th : pool) th.join();
+    for (unsigned int t = 1; t < nThreads; ++t)
+      for (size_t i = 0; i < accSize; ++i) partial[0][i] += partial[t][i];
+    return partial[0];
+  }
+
+  static void WriteAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+      ssize_t n = write(fd, data.data() + sent, data.size() - sent);
+      if (n <= 0) return;
+      sent += static_cast<size_t>(n);
+    }
+  }
+
+  unsigned int nThreads_;
+  std::map<std::string, Model> models_;
+};
+
+#endif  // DISANA_SERVER_H
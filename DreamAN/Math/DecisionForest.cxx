@@ -0,0 +1,164 @@
+#include "DecisionForest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+#include "../core/StageCache.h"
+
+namespace {
+struct Node {
+  int feature = -1;  // -1: leaf
+  float threshold = 0.f;
+  int yes = -1;
+  int no = -1;
+  int missing = -1;  // where NaN goes, yes when not given
+  float value = 0.f;
+};
+using Tree = std::map<int, Node>;  // by node id, root 0
+
+// Depth of the subtree below id; > kMaxDepth also stops a cycle
+int Depth(const Tree& tree, int id, int level, const std::string& where) {
+  if (level > DecisionForest::kMaxDepth) throw std::runtime_error(where + "tree deeper than " + std::to_string(DecisionForest::kMaxDepth) + " levels (or cyclic)");
+  auto it = tree.find(id);
+  if (it == tree.end()) throw std::runtime_error(where + "node " + std::to_string(id) + " is referenced but not defined");
+  if (it->second.feature < 0) return 0;
+  return 1 + std::max(Depth(tree, it->second.yes, level + 1, where), Depth(tree, it->second.no, level + 1, where));
+}
+}  // namespace
+
+DecisionForest DecisionForest::Load(const std::string& filename) {
+  std::ifstream in(filename);
+  if (!in) throw std::runtime_error("[DecisionForest] Cannot open " + filename);
+
+  DecisionForest forest;
+  std::map<std::string, int> featureIndex;
+  std::vector<Tree> trees;
+  std::vector<std::string> treeWhere;
+  std::string contents, line;
+  for (int lineNumber = 1; std::getline(in, line); ++lineNumber) {
+    contents += line + "\n";
+    const std::string where = "[DecisionForest] " + filename + ":" + std::to_string(lineNumber) + ": ";
+    line = line.substr(0, line.find('#'));
+    std::istringstream is(line);
+    std::string key;
+    if (!(is >> key)) continue;
+
+    if (key == "features") {
+      for (std::string name; is >> name;) {
+        if (featureIndex.count(name)) throw std::runtime_error(where + "feature " + name + " listed twice");
+        featureIndex[name] = static_cast<int>(forest.fFeatures.size());
+        forest.fFeatures.push_back(name);
+      }
+    } else if (key == "objective") {
+      std::string objective;
+      is >> objective;
+      if (objective != "logistic" && objective != "raw") throw std::runtime_error(where + "objective must be logistic or raw");
+      forest.fLogistic = objective == "logistic";
+    } else if (key == "base_score") {
+      if (!(is >> forest.fBaseScore)) throw std::runtime_error(where + "base_score needs a value");
+    } else if (key == "tree") {
+      trees.emplace_back();
+      treeWhere.push_back(where);
+    } else {
+      if (trees.empty()) throw std::runtime_error(where + "node line before the first tree");
+      Node node;
+      std::string feature;
+      int id;
+      try {
+        id = std::stoi(key);
+      } catch (const std::exception&) {
+        throw std::runtime_error(where + "unknown keyword " + key);
+      }
+      if (!(is >> feature)) throw std::runtime_error(where + "node " + key + " has no feature");
+      if (feature == "leaf") {
+        if (!(is >> node.value)) throw std::runtime_error(where + "leaf " + key + " has no value");
+      } else {
+        auto it = featureIndex.find(feature);
+        if (it == featureIndex.end()) throw std::runtime_error(where + "feature " + feature + " is not in the features line");
+        node.feature = it->second;
+        if (!(is >> node.threshold >> node.yes >> node.no)) throw std::runtime_error(where + "split " + key + " needs threshold yes no");
+        if (!(is >> node.missing)) node.missing = node.yes;
+        if (node.missing != node.yes && node.missing != node.no) throw std::runtime_error(where + "split " + key + ": missing must be its yes or no node");
+      }
+      if (!trees.back().emplace(id, node).second) throw std::runtime_error(where + "node " + key + " defined twice");
+    }
+  }
+  if (forest.fFeatures.empty()) throw std::runtime_error("[DecisionForest] " + filename + ": no features line");
+  if (trees.empty()) throw std::runtime_error("[DecisionForest] " + filename + ": no trees");
+
+  for (size_t t = 0; t < trees.size(); ++t) forest.fDepth = std::max(forest.fDepth, Depth(trees[t], 0, 0, treeWhere[t]));
+  forest.fNTrees = trees.size();
+  forest.fNLeaves = size_t(1) << forest.fDepth;
+  forest.fNInner = forest.fNLeaves - 1;
+  forest.fOffset.assign(forest.fNTrees * forest.fNInner, 0);
+  forest.fThreshold.assign(forest.fNTrees * forest.fNInner, std::numeric_limits<float>::infinity());
+  forest.fMissingNo.assign(forest.fNTrees * forest.fNInner, 0);
+  forest.fLeaf.assign(forest.fNTrees * forest.fNLeaves, 0.f);
+
+  // node id -> position in the complete tree (children of pos at 2 pos + 1, 2 pos + 2)
+  for (size_t t = 0; t < trees.size(); ++t) {
+    int32_t* offset = &forest.fOffset[t * forest.fNInner];
+    float* threshold = &forest.fThreshold[t * forest.fNInner];
+    int32_t* missingNo = &forest.fMissingNo[t * forest.fNInner];
+    float* leaf = &forest.fLeaf[t * forest.fNLeaves];
+    std::function<void(int, size_t, int)> fill = [&](int id, size_t pos, int level) {
+      const Node& node = trees[t].at(id);
+      if (level == forest.fDepth) {
+        leaf[pos - forest.fNInner] = node.value;
+      } else if (node.feature < 0) {  // padding: always yes, same value everywhere below
+        fill(id, 2 * pos + 1, level + 1);
+        fill(id, 2 * pos + 2, level + 1);
+      } else {
+        offset[pos] = node.feature * static_cast<int32_t>(kBlock);
+        threshold[pos] = node.threshold;
+        missingNo[pos] = node.missing == node.no && node.no != node.yes;
+        fill(node.yes, 2 * pos + 1, level + 1);
+        fill(node.no, 2 * pos + 2, level + 1);
+      }
+    };
+    fill(0, 0, 0);
+  }
+
+  std::ostringstream fingerprint;
+  fingerprint << "forest " << filename << " " << contents.size() << " " << std::hex << StageCache::Hash(contents);
+  forest.fFingerprint = fingerprint.str();
+  return forest;
+}
+
+void DecisionForest::ScoreBlock(const float* x, size_t n, float* out) const {
+  // lane loops run to the runtime n: with the constant kBlock GCC unrolls them before the
+  // vectoriser sees them and the loads of x stay scalar instead of becoming gathers
+  const int lanes = static_cast<int>(std::min(n, kBlock));
+  const int32_t nInner = static_cast<int32_t>(fNInner);
+  float margin[kBlock];
+  int32_t node[kBlock];
+  for (int c = 0; c < lanes; ++c) margin[c] = fBaseScore;
+
+  for (size_t t = 0; t < fNTrees; ++t) {
+    const int32_t* offset = fOffset.data() + t * fNInner;
+    const float* threshold = fThreshold.data() + t * fNInner;
+    const int32_t* missingNo = fMissingNo.data() + t * fNInner;
+    const float* leaf = fLeaf.data() + t * fNLeaves;
+    for (int c = 0; c < lanes; ++c) node[c] = 0;
+    for (int level = 0; level < fDepth; ++level) {
+      for (int c = 0; c < lanes; ++c) {
+        const int32_t i = node[c];
+        const float v = x[offset[i] + c];
+        node[c] = 2 * i + 1 + ((v >= threshold[i]) | (missingNo[i] & (v != v)));  // NaN fails the comparison
+      }
+    }
+    for (int c = 0; c < lanes; ++c) margin[c] += leaf[node[c] - nInner];
+  }
+
+  if (fLogistic) {
+    for (int c = 0; c < lanes; ++c) out[c] = 1.f / (1.f + std::exp(-margin[c]));
+  } else {
+    for (int c = 0; c < lanes; ++c) out[c] = margin[c];
+  }
+}
@@ -0,0 +1,66 @@
+#ifndef DECISIONFOREST_H
+#define DECISIONFOREST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Gradient-boosted decision trees, compiled into flat arrays for in-loop evaluation.
+//
+// Model file (text, '#' starts a comment):
+//
+//   features p theta e_pcal sf       # names, in any order
+//   objective logistic               # score = 1 / (1 + exp(-margin)); "raw" returns the margin
+//   base_score 0.0                   # added to the margin (logit of xgboost's base_score)
+//   tree                             # one block per tree, root first
+//   0 e_pcal 0.25 1 2 2              # node feature threshold yes no [missing]: x < threshold -> yes
+//   1 leaf 0.42                      # node leaf value
+//   2 leaf -0.17
+//
+// The node lines are the rows of xgboost's Booster.trees_to_dataframe(): Node, Feature, Split
+// and the node numbers of Yes, No and Missing ("3-7" -> 7); a Leaf row has its value in Gain.
+// A feature value of NaN goes to the missing node, `yes` when the column is left out.
+//
+// Every tree is padded to a complete tree of the forest's depth: a leaf above the last level
+// becomes a split that always goes to `yes` (threshold +inf) with the value copied into every
+// leaf below it. Evaluation is then the same fixed number of steps for every candidate,
+//     node = 2 node + 1 + (x[feature[node]] >= threshold[node])
+// with no data-dependent branch. ScoreBlock walks up to kBlock candidates side by side, one
+// level at a time, so nothing is mispredicted and the loads of the candidates overlap; with -O3
+// and an -march that has gathers (AVX2) the lane loops also vectorise (no intrinsics, as
+// FastMath).
+class DecisionForest {
+ public:
+  static constexpr size_t kBlock = 16;  // candidates per ScoreBlock call
+  static constexpr int kMaxDepth = 10;  // padded trees have 2^depth leaves
+
+  // Throws std::runtime_error with file:line on a malformed model
+  static DecisionForest Load(const std::string& filename);
+
+  // n <= kBlock candidates, x feature-major: x[f * kBlock + c] is feature f of candidate c
+  void ScoreBlock(const float* x, size_t n, float* out) const;
+
+  const std::vector<std::string>& GetFeatures() const { return fFeatures; }
+  size_t GetNTrees() const { return fNTrees; }
+  int GetDepth() const { return fDepth; }
+  bool IsLogistic() const { return fLogistic; }
+  // Model file and contents (FNV-1a, as StageCache), e.g. for cache keys
+  std::string Fingerprint() const { return fFingerprint; }
+
+ private:
+  std::vector<std::string> fFeatures;
+  bool fLogistic = true;
+  float fBaseScore = 0.f;
+  size_t fNTrees = 0;
+  int fDepth = 0;
+  size_t fNInner = 0;   // 2^depth - 1 split nodes per tree
+  size_t fNLeaves = 1;  // 2^depth leaves per tree
+  std::vector<int32_t> fOffset;    // [tree * fNInner + node]: feature * kBlock, 32 bit for vector gathers
+  std::vector<float> fThreshold;   // [tree * fNInner + node]
+  std::vector<int32_t> fMissingNo;  // [tree * fNInner + node]: 1 if NaN goes to no
+  std::vector<float> fLeaf;        // [tree * fNLeaves + leaf]
+  std::string fFingerprint;
+};
+
+#endif  // DECISIONFOREST_H
@@ -0,0 +1,238 @@
+#ifndef EXCLUSIVECANDIDATES_H
+#define EXCLUSIVECANDIDATES_H
+
+#include <ROOT/RDF/RInterface.hxx>
+#include <ROOT/RVec.hxx>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Ranked exclusive candidates: every assignment of the event's particles to the final state.
+//
+// The plotting chain used to take the first passing particle of each pid (the hardest photon
+// for DVCS), so an event with two protons or several photons got whatever came first in the
+// bank. Here the passing particles are bucketed by pid in one pass, every combination with one
+// particle per slot is scored by an exclusivity chi2
+//     ((Mx2_all - 0) / s1)^2 + (Emiss / s2)^2 + (PTmiss / s3)^2 + ((Mx2_ep - M_X^2) / s4)^2
+// (missing mass squared, energy and transverse momentum of e p -> e' p' X..., missing mass
+// squared of e p -> e' p' X against the mass of the undetected system of the topology), and the
+// kMaxRanked lowest scores are kept. Buckets hold at most kMaxPerSlot particles (the highest
+// momenta); an event with more is flagged `truncated`. Buckets, combinations and the ranking
+// live in fixed-size arrays, so the per-event work does no heap allocation.
+//
+//   ExclusiveCandidates<DVCSCandidates> builder(beam_energy);
+//   df = builder.DefineBest(df);     // ele_px ... pho_pz, ele_index ..., cand_score, cand_n
+//   df = builder.DefineKinematics(df);  // cand_Q2, cand_nu, cand_xB, cand_W, cand_t
+//   df = builder.DefineRanked(df);   // RVec columns, one entry per ranked candidate
+//
+// Inputs are the REC_Particle_pid/px/py/pz/pass columns of the dfSelected outputs.
+
+struct DVCSCandidates {  // e p -> e' p' gamma
+  static constexpr const char* kName = "DVCS";
+  static constexpr int kPids[] = {11, 2212, 22};
+  static constexpr const char* kSlots[] = {"ele", "pro", "pho"};
+  static constexpr double kMasses[] = {0.000511, 0.938272, 0.0};
+  static constexpr double kMx2ep = 0.0;  // e p -> e' p' X with X = gamma
+};
+
+struct PhiCandidates {  // e p -> e' p' K+ K-
+  static constexpr const char* kName = "Phi";
+  static constexpr int kPids[] = {11, 2212, 321, -321};
+  static constexpr const char* kSlots[] = {"ele", "pro", "kPlus", "kMinus"};
+  static constexpr double kMasses[] = {0.000511, 0.938272, 0.493677, 0.493677};
+  static constexpr double kMx2ep = 1.019461 * 1.019461;  // X = phi
+};
+
+template <typename Topology, size_t kMaxPerSlot = 6, size_t kMaxRanked = 8>
+class ExclusiveCandidates {
+ public:
+  static constexpr size_t kNSlots = sizeof(Topology::kPids) / sizeof(int);
+
+  struct Candidate {
+    std::array<int, kNSlots> index;  // REC_Particle row of every slot
+    float score;
+    float mx2;     // missing mass squared of everything detected
+    float emiss;   // missing energy
+    float ptmiss;  // missing transverse momentum
+    float mx2ep;   // missing mass squared of e p -> e' p' X
+  };
+
+  struct Ranked {
+    size_t n = 0;             // ranked candidates in best[0..n), lowest score first
+    size_t nEnumerated = 0;   // combinations scored
+    bool truncated = false;   // a pid bucket was full
+    std::array<Candidate, kMaxRanked> best;
+  };
+
+  explicit ExclusiveCandidates(double beamEnergy) : beamEnergy_(beamEnergy) {}
+
+  // Resolutions of the chi2 terms (GeV^2, GeV, GeV, GeV^2)
+  void SetResolutions(double mx2, double emiss, double ptmiss, double mx2ep) { sigma_ = {mx2, emiss, ptmiss, mx2ep}; }
+
+  Ranked operator()(const ROOT::RVec<int>& pid, const ROOT::RVec<float>& px, const ROOT::RVec<float>& py, const ROOT::RVec<float>& pz, const ROOT::RVec<bool>& pass) const {
+    Ranked ranked;
+    Bucket buckets[kNSlots];
+    for (size_t i = 0; i < pid.size(); ++i) {
+      if (!pass[i]) continue;
+      for (size_t s = 0; s < kNSlots; ++s) {
+        if (pid[i] == Topology::kPids[s]) buckets[s].Add(static_cast<int>(i), px[i], py[i], pz[i], Topology::kMasses[s], ranked.truncated);
+      }
+    }
+    for (size_t s = 0; s < kNSlots; ++s)
+      if (buckets[s].n == 0) return ranked;
+
+    // odometer over the slots
+    std::array<size_t, kNSlots> pos{};
+    while (true) {
+      if (Distinct(buckets, pos)) Score(buckets, pos, ranked);
+      size_t s = 0;
+      while (s < kNSlots && ++pos[s] == buckets[s].n) pos[s++] = 0;
+      if (s == kNSlots) break;
+    }
+    return ranked;
+  }
+
+  // Best candidate as flat columns with the names of the first-match defines (<slot>_px/py/pz),
+  // plus <slot>_index, <prefix>_score, <prefix>_n; events without a candidate are dropped.
+  ROOT::RDF::RNode DefineBest(ROOT::RDF::RNode df, const std::string& prefix = "cand") const {
+    const std::string col = prefix + "_ranked";
+    df = df.Define(col, *this, {"REC_Particle_pid", "REC_Particle_px", "REC_Particle_py", "REC_Particle_pz", "REC_Particle_pass"})
+             .Filter([](const Ranked& r) { return r.n > 0; }, {col}, std::string(Topology::kName) + " candidate");
+    for (size_t s = 0; s < kNSlots; ++s) {
+      const std::string slot = Topology::kSlots[s];
+      df = df.Define(slot + "_index", [s](const Ranked& r) { return r.best[0].index[s]; }, {col});
+      df = df.Define(slot + "_px", [](const ROOT::RVec<float>& v, int i) { return v[i]; }, {"REC_Particle_px", slot + "_index"});
+      df = df.Define(slot + "_py", [](const ROOT::RVec<float>& v, int i) { return v[i]; }, {"REC_Particle_py", slot + "_index"});
+      df = df.Define(slot + "_pz", [](const ROOT::RVec<float>& v, int i) { return v[i]; }, {"REC_Particle_pz", slot + "_index"});
+    }
+    return df.Define(prefix + "_score", [](const Ranked& r) { return r.best[0].score; }, {col})
+        .Define(prefix + "_n", [](const Ranked& r) { return static_cast<int>(r.n); }, {col})
+        .Define(prefix + "_truncated", [](const Ranked& r) { return r.truncated; }, {col});
+  }
+
+  // DIS kinematics of the best candidate (DefineBest) from its e' and p' (slots 0 and 1):
+  // <prefix>_Q2, _nu, _xB, _W and _t (-t from the recoil proton)
+  ROOT::RDF::RNode DefineKinematics(ROOT::RDF::RNode df, const std::string& prefix = "cand") const {
+    const std::string e = Topology::kSlots[0], p = Topology::kSlots[1];
+    const double beam = beamEnergy_, M = Topology::kMasses[1];
+    const std::vector<std::string> electron = {e + "_px", e + "_py", e + "_pz"};
+    return df
+        .Define(prefix + "_Q2", [beam](float x, float y, float z) { return static_cast<float>(2 * beam * (std::sqrt(double(x) * x + double(y) * y + double(z) * z) - z)); }, electron)
+        .Define(prefix + "_nu", [beam](float x, float y, float z) { return static_cast<float>(beam - std::sqrt(double(x) * x + double(y) * y + double(z) * z)); }, electron)
+        .Define(prefix + "_xB", [M](float Q2, float nu) { return nu > 0 ? static_cast<float>(Q2 / (2 * M * nu)) : -999.f; }, {prefix + "_Q2", prefix + "_nu"})
+        .Define(prefix + "_W", [M](float Q2, float nu) { return static_cast<float>(std::sqrt(std::max(0.0, M * M + 2 * M * nu - Q2))); }, {prefix + "_Q2", prefix + "_nu"})
+        .Define(prefix + "_t", [M](float x, float y, float z) { return static_cast<float>(2 * M * (std::sqrt(double(x) * x + double(y) * y + double(z) * z + M * M) - M)); },
+                {p + "_px", p + "_py", p + "_pz"});
+  }
+
+  // Every ranked candidate: <slot>_index, <prefix>_score, _mx2, _emiss, _ptmiss, _mx2ep as RVecs
+  // in rank order (the per-event vectors are the only allocation, outside the enumeration)
+  ROOT::RDF::RNode DefineRanked(ROOT::RDF::RNode df, const std::string& prefix = "cand") const {
+    const std::string col = prefix + "_ranked";
+    df = df.Define(col, *this, {"REC_Particle_pid", "REC_Particle_px", "REC_Particle_py", "REC_Particle_pz", "REC_Particle_pass"});
+    for (size_t s = 0; s < kNSlots; ++s) {
+      df = df.Define(std::string(Topology::kSlots[s]) + "_index", [s](const Ranked& r) { return Collect(r, [s](const Candidate& c) { return c.index[s]; }); }, {col});
+    }
+    return df.Define(prefix + "_score", [](const Ranked& r) { return Collect(r, [](const Candidate& c) { return c.score; }); }, {col})
+        .Define(prefix + "_mx2", [](const Ranked& r) { return Collect(r, [](const Candidate& c) { return c.mx2; }); }, {col})
+        .Define(prefix + "_emiss", [](const Ranked& r) { return Collect(r, [](const Candidate& c) { return c.emiss; }); }, {col})
+        .Define(prefix + "_ptmiss", [](const Ranked& r) { return Collect(r, [](const Candidate& c) { return c.ptmiss; }); }, {col})
+        .Define(prefix + "_mx2ep", [](const Ranked& r) { return Collect(r, [](const Candidate& c) { return c.mx2ep; }); }, {col})
+        .Define(prefix + "_n", [](const Ranked& r) { return static_cast<int>(r.n); }, {col});
+  }
+
+ private:
+  // Particles of one pid; when full, the lowest momentum one is replaced
+  struct Bucket {
+    size_t n = 0;
+    std::array<int, kMaxPerSlot> index;
+    std::array<float, kMaxPerSlot> E, px, py, pz, p2;
+
+    void Add(int i, float x, float y, float z, double mass, bool& truncated) {
+      const float pp = x * x + y * y + z * z;
+      size_t at = n;
+      if (n == kMaxPerSlot) {
+        truncated = true;
+        at = 0;
+        for (size_t k = 1; k < n; ++k)
+          if (p2[k] < p2[at]) at = k;
+        if (pp <= p2[at]) return;
+      } else {
+        ++n;
+      }
+      index[at] = i;
+      px[at] = x;
+      py[at] = y;
+      pz[at] = z;
+      p2[at] = pp;
+      E[at] = std::sqrt(pp + static_cast<float>(mass * mass));
+    }
+  };
+
+  // Slots with the same pid take distinct particles, in increasing row order
+  static bool Distinct(const Bucket (&buckets)[kNSlots], const std::array<size_t, kNSlots>& pos) {
+    for (size_t a = 0; a < kNSlots; ++a)
+      for (size_t b = a + 1; b < kNSlots; ++b)
+        if (Topology::kPids[a] == Topology::kPids[b] && buckets[a].index[pos[a]] >= buckets[b].index[pos[b]]) return false;
+    return true;
+  }
+
+  void Score(const Bucket (&buckets)[kNSlots], const std::array<size_t, kNSlots>& pos, Ranked& ranked) const {
+    ++ranked.nEnumerated;
+    // initial state: beam along z, target proton at rest
+    const double mp = 0.938272;
+    double E = beamEnergy_ + mp, x = 0, y = 0, z = beamEnergy_;
+    double Eep = E, xep = 0, yep = 0, zep = z;
+    Candidate c;
+    for (size_t s = 0; s < kNSlots; ++s) {
+      const Bucket& b = buckets[s];
+      const size_t k = pos[s];
+      c.index[s] = b.index[k];
+      E -= b.E[k];
+      x -= b.px[k];
+      y -= b.py[k];
+      z -= b.pz[k];
+      if (s < 2) {  // slots 0 and 1 are e' and p'
+        Eep -= b.E[k];
+        xep -= b.px[k];
+        yep -= b.py[k];
+        zep -= b.pz[k];
+      }
+    }
+    c.mx2 = static_cast<float>(E * E - x * x - y * y - z * z);
+    c.emiss = static_cast<float>(E);
+    c.ptmiss = static_cast<float>(std::sqrt(x * x + y * y));
+    c.mx2ep = static_cast<float>(Eep * Eep - xep * xep - yep * yep - zep * zep);
+    const double t0 = c.mx2 / sigma_[0], t1 = c.emiss / sigma_[1], t2 = c.ptmiss / sigma_[2], t3 = (c.mx2ep - Topology::kMx2ep) / sigma_[3];
+    c.score = static_cast<float>(t0 * t0 + t1 * t1 + t2 * t2 + t3 * t3);
+
+    // insertion into the fixed-size ranking
+    size_t at = ranked.n;
+    if (ranked.n == kMaxRanked) {
+      if (c.score >= ranked.best[kMaxRanked - 1].score) return;
+      at = kMaxRanked - 1;
+    } else {
+      ++ranked.n;
+    }
+    while (at > 0 && ranked.best[at - 1].score > c.score) {
+      ranked.best[at] = ranked.best[at - 1];
+      --at;
+    }
+    ranked.best[at] = c;
+  }
+
+  template <typename Get>
+  static auto Collect(const Ranked& r, Get get) {
+    ROOT::RVec<decltype(get(r.best[0]))> out(r.n);
+    for (size_t i = 0; i < r.n; ++i) out[i] = get(r.best[i]);
+    return out;
+  }
+
+  double beamEnergy_;
+  std::array<double, 4> sigma_ = {0.02, 0.5, 0.1, 0.4};
+};
+
+#endif  // EXCLUSIVECANDIDATES_H
@@ -0,0 +1,153 @@
+#ifndef FASTMATH_H
+#define FASTMATH_H
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Single-precision kernels for the per-particle / per-hit hot loops.
+//
+// The scalar functions are branch-free polynomial evaluations (select instead of if) and
+// avoid the argument checks and slow paths of libm. They are written so the array versions
+// below can be auto-vectorised, which needs -O3 (or -O2 -ftree-vectorize): the CMake build
+// defaults to Release at -O3, a Debug build gets the cheaper scalar evaluation only. Max errors measured against the double-precision libm result rounded to float
+// (Acos, Sin/Cos exhaustively over every float in the domain, Atan2 on 2e8 random pairs):
+//
+//   Atan2(y, x)   all finite (y, x)          <= 3 ulp   (abs error <= 3.3e-7 rad)
+//   Acos(x)       [-1, 1]                    <= 3 ulp   (abs error <= 3.5e-7 rad)
+//   Sin/Cos(x)    |x| <= kTrigMaxArg         abs error <= 9.3e-8, libm beyond
+//                 |x| <= 2 pi                sin <= 2 ulp, cos <= 14 ulp (only next to its zero at 3 pi / 2)
+//   Sqrt(x)       x >= 0                        0 ulp   (hardware sqrt, correctly rounded)
+//
+// Exact mode is the default: every call goes through libm, so output columns such as
+// RECParticletheta/phi stay bit-identical to the libm values. SetExact(false) opts in to the
+// kernels, before the event loop starts. For cuts, use InRangeGuarded: the fast value decides
+// the cut unless it lies within kGuard of a boundary, in which case the libm value is
+// recomputed, so the selection is bit-identical to the libm selection in either mode.
+namespace FastMath {
+
+constexpr float kPi = 3.14159265358979323846f;
+constexpr float kPiO2 = 1.57079632679489661923f;
+constexpr float kRadToDeg = 57.2957795130823208768f;
+constexpr float kTrigMaxArg = 8192.f;  // Cody-Waite reduction is exact enough below this
+// largest abs error of the angle kernels above (rad), with margin for the phi += 2 pi rounding; used for boundary guards
+constexpr float kGuard = 1e-6f;
+
+inline std::atomic<bool>& ExactFlag() {
+  static std::atomic<bool> exact{true};
+  return exact;
+}
+inline void SetExact(bool exact) { ExactFlag().store(exact, std::memory_order_relaxed); }
+inline bool IsExact() { return ExactFlag().load(std::memory_order_relaxed); }
+
+inline float Sqrt(float x) { return std::sqrt(x); }
+
+// atan on [0, 1]: odd minimax polynomial in a (degree 17)
+inline float AtanUnit(float a) {
+  const float t = a * a;
+  float u = 0.00282363896258175373077393f;
+  u = u * t - 0.0159569028764963150024414f;
+  u = u * t + 0.0425049886107444763183594f;
+  u = u * t - 0.0748900920152664184570312f;
+  u = u * t + 0.106347933411598205566406f;
+  u = u * t - 0.142027363181114196777344f;
+  u = u * t + 0.199926957488059997558594f;
+  u = u * t - 0.333331018686294555664062f;
+  return a + a * t * u;
+}
+
+inline float Atan2Fast(float y, float x) {
+  const float ax = std::fabs(x), ay = std::fabs(y);
+  const float hi = ax > ay ? ax : ay;
+  const float lo = ax > ay ? ay : ax;
+  const float a = hi > 0.f ? lo / hi : 0.f;
+  float r = AtanUnit(a);
+  r = ay > ax ? kPiO2 - r : r;
+  r = std::signbit(x) ? kPi - r : r;
+  return std::copysign(r, y);
+}
+
+inline float Atan2(float y, float x) { return IsExact() ? std::atan2(y, x) : Atan2Fast(y, x); }
+
+// acos(x) = atan2(sqrt((1 - x)(1 + x)), x); the factored form keeps precision near |x| = 1
+inline float AcosFast(float x) { return Atan2Fast(std::sqrt((1.f - x) * (1.f + x)), x); }
+inline float Acos(float x) { return IsExact() ? std::acos(x) : AcosFast(x); }
+
+// sin and cos of the same argument: pi/2 Cody-Waite reduction, minimax polynomials on [-pi/4, pi/4]
+inline void SinCosFast(float x, float& s, float& c) {
+  const float k = std::nearbyint(x * 0.636619772367581343f);
+  float r = x - k * 1.5703125f;
+  r = r - k * 4.837512969970703125e-4f;
+  r = r - k * 7.54978995489188216e-8f;
+  const float r2 = r * r;
+  const float ps = r + r * r2 * (-1.6666654611e-1f + r2 * (8.3321608736e-3f + r2 * -1.9515295891e-4f));
+  const float pc = 1.f - 0.5f * r2 + r2 * r2 * (4.166664568298827e-2f + r2 * (-1.388731625493765e-3f + r2 * 2.443315711809948e-5f));
+  const int q = static_cast<int>(static_cast<int64_t>(k) & 3);
+  const float sq = (q & 1) ? pc : ps;
+  const float cq = (q & 1) ? ps : pc;
+  s = (q & 2) ? -sq : sq;
+  c = ((q + 1) & 2) ? -cq : cq;
+}
+
+inline void SinCos(float x, float& s, float& c) {
+  if (IsExact() || !(std::fabs(x) <= kTrigMaxArg)) {
+    s = std::sin(x);
+    c = std::cos(x);
+    return;
+  }
+  SinCosFast(x, s, c);
+}
+inline float Sin(float x) {
+  float s, c;
+  SinCos(x, s, c);
+  return s;
+}
+inline float Cos(float x) {
+  float s, c;
+  SinCos(x, s, c);
+  return c;
+}
+
+// Array kernels, out may alias an input
+inline void Atan2(const float* y, const float* x, float* out, size_t n) {
+  if (IsExact()) {
+    for (size_t i = 0; i < n; ++i) out[i] = std::atan2(y[i], x[i]);
+    return;
+  }
+  for (size_t i = 0; i < n; ++i) out[i] = Atan2Fast(y[i], x[i]);
+}
+
+inline void Acos(const float* x, float* out, size_t n) {
+  if (IsExact()) {
+    for (size_t i = 0; i < n; ++i) out[i] = std::acos(x[i]);
+    return;
+  }
+  for (size_t i = 0; i < n; ++i) out[i] = AcosFast(x[i]);
+}
+
+inline void Sqrt(const float* x, float* out, size_t n) {
+  for (size_t i = 0; i < n; ++i) out[i] = std::sqrt(x[i]);
+}
+
+inline void SinCos(const float* x, float* s, float* c, size_t n) {
+  for (size_t i = 0; i < n; ++i) SinCos(x[i], s[i], c[i]);
+}
+
+inline bool NearEdge(float value, float lo, float hi, float guard = kGuard) { return std::fabs(value - lo) < guard || std::fabs(value - hi) < guard; }
+
+// lo <= fast <= hi, recomputing with exact() when fast is within kGuard of lo or hi.
+// Bit-identical to lo <= exact() <= hi as long as |fast - exact| < kGuard.
+template <typename Exact>
+inline bool InRangeGuarded(float fast, float lo, float hi, Exact&& exact) {
+  if (NearEdge(fast, lo, hi)) {
+    const float v = exact();
+    return v >= lo && v <= hi;
+  }
+  return fast >= lo && fast <= hi;
+}
+
+}  // namespace FastMath
+
+#endif  // FASTMATH_H
@@ -1,5 +1,6 @@
 #include "RECParticleKinematic.h"
 #include <cmath>
+#include "FastMath.h"
 #include "MathKinematicVariable.h"
 #include "ParticleMassTable.h"
 
@@ -17,11 +18,12 @@ RECStoreType RECParticletheta() {
               const std::vector<float>& chi2pid,
               const std::vector<short>& status) -> std::vector<float> {
         
-        std::vector<float> theta_values;
+        // libm unless FastMath::SetExact(false) selected the kernel (within 3 ulp of libm)
+        std::vector<float> theta_values(pid.size());
         for (size_t i = 0; i < pid.size(); ++i) {
-            float theta = std::atan2(std::sqrt(px[i] * px[i] + py[i] * py[i]), pz[i]);
-            theta_values.push_back(theta);
+            theta_values[i] = std::sqrt(px[i] * px[i] + py[i] * py[i]);
         }
+        FastMath::Atan2(theta_values.data(), pz.data(), theta_values.data(), pid.size());
         return theta_values;
     };
 }
@@ -40,13 +42,12 @@ RECStoreType RECParticlephi() {
               const std::vector<float>& chi2pid,
               const std::vector<short>& status) -> std::vector<float> {
         
-        std::vector<float> phi_values;
+        std::vector<float> phi_values(pid.size());
+        FastMath::Atan2(py.data(), px.data(), phi_values.data(), pid.size());
         for (size_t i = 0; i < pid.size(); ++i) {
-            float phi = std::atan2(py[i], px[i]);
-            if (phi < 0) {
-                phi += 2 * M_PI;
+            if (phi_values[i] < 0) {
+                phi_values[i] += 2 * M_PI;
             }
-            phi_values.push_back(phi);
         }
         return phi_values;
     };
@@ -43,6 +43,7 @@ struct RECCalorimeter {
     >;
 };
 
+// One bank scan per column; the table form (RECDetectorTable.h) reads the pivoted REC_Calorimeter_table
 std::function<std::vector<float>(const std::vector<int16_t>&,      // index
                                  const std::vector<int16_t>&,      // pindex
                                  const std::vector<int16_t>&,      // detector
@@ -0,0 +1,206 @@
+#include "RECDetectorTable.h"
+
+#include <stdexcept>
+
+DetectorSlots::DetectorSlots() : fLookup(kMaxDetector * kMaxLayer, -1) {}
+
+DetectorSlots::DetectorSlots(std::initializer_list<std::pair<int, int>> slots) : DetectorSlots() {
+    for (const auto& [detector, layer] : slots) Add(detector, layer);
+}
+
+int DetectorSlots::Add(int detector, int layer) {
+    if (detector < 0 || detector >= kMaxDetector || layer < 0 || layer >= kMaxLayer)
+        throw std::runtime_error("DetectorSlots: (detector, layer) = (" + std::to_string(detector) + ", " + std::to_string(layer) + ") out of range");
+    int8_t& slot = fLookup[detector * kMaxLayer + layer];
+    if (slot >= 0) return slot;
+    if (Size() >= kMaxSlots) throw std::runtime_error("DetectorSlots: more than " + std::to_string(kMaxSlots) + " slots");
+    slot = static_cast<int8_t>(fSlots.size());
+    fSlots.emplace_back(detector, layer);
+    return slot;
+}
+
+int DetectorSlots::Require(int detector, int layer) const {
+    const int slot = Slot(detector, layer);
+    if (slot < 0) throw std::runtime_error("DetectorSlots: (detector, layer) = (" + std::to_string(detector) + ", " + std::to_string(layer) + ") is not in the layout");
+    return slot;
+}
+
+const std::vector<std::string>& RECDetectorTable::TrajColumns() {
+    static const std::vector<std::string> names = {
+        "REC_Traj_pindex",
+        "REC_Traj_detector",
+        "REC_Traj_layer",
+        "REC_Traj_x",
+        "REC_Traj_y",
+        "REC_Traj_z",
+        "REC_Traj_cx",
+        "REC_Traj_cy",
+        "REC_Traj_cz",
+        "REC_Traj_path",
+        "REC_Traj_edge",
+        "REC_Particle_num"
+    };
+    return names;
+}
+
+const std::vector<std::string>& RECDetectorTable::CaloColumns() {
+    static const std::vector<std::string> names = {
+        "REC_Calorimeter_pindex",
+        "REC_Calorimeter_detector",
+        "REC_Calorimeter_layer",
+        "REC_Calorimeter_energy",
+        "REC_Calorimeter_lu",
+        "REC_Calorimeter_lv",
+        "REC_Calorimeter_lw",
+        "REC_Particle_num"
+    };
+    return names;
+}
+
+const std::vector<std::string>& RECDetectorTable::TrackColumns() {
+    static const std::vector<std::string> names = {
+        "REC_Track_pindex",
+        "REC_Track_detector",
+        "REC_Track_sector",
+        "REC_Track_chi2",
+        "REC_Track_NDF",
+        "REC_Particle_num"
+    };
+    return names;
+}
+
+ROOT::RDF::RNode RECDetectorTable::Define(ROOT::RDF::RNode df, const DetectorSlots& traj, const DetectorSlots& calo, const DetectorSlots& track) {
+    if (!traj.Empty()) df = df.Define("REC_Traj_table", RECTrajPivot(traj), TrajColumns());
+    if (!calo.Empty()) df = df.Define("REC_Calorimeter_table", RECCalorimeterPivot(calo), CaloColumns());
+    if (!track.Empty()) df = df.Define("REC_Track_table", RECTrackPivot(track), TrackColumns());
+    return df;
+}
+
+// Rows that do not belong to a registered slot or point outside REC::Particle are skipped.
+// As in the per-column defines, a later hit in the same slot overwrites an earlier one.
+
+std::function<RECTrajTable(const std::vector<int16_t>& pindex,
+                           const std::vector<int16_t>& detector,
+                           const std::vector<int16_t>& layer,
+                           const std::vector<float>& x,
+                           const std::vector<float>& y,
+                           const std::vector<float>& z,
+                           const std::vector<float>& cx,
+                           const std::vector<float>& cy,
+                           const std::vector<float>& cz,
+                           const std::vector<float>& path,
+                           const std::vector<float>& edge,
+                           const int& REC_Particle_num)> RECTrajPivot(const DetectorSlots& slots) {
+    return [slots](const std::vector<int16_t>& pindex,
+                   const std::vector<int16_t>& detector,
+                   const std::vector<int16_t>& layer,
+                   const std::vector<float>& x,
+                   const std::vector<float>& y,
+                   const std::vector<float>& z,
+                   const std::vector<float>& cx,
+                   const std::vector<float>& cy,
+                   const std::vector<float>& cz,
+                   const std::vector<float>& path,
+                   const std::vector<float>& edge,
+                   const int& REC_Particle_num) -> RECTrajTable {
+        RECTrajTable table;
+        table.Reset(REC_Particle_num, slots.Size());
+        for (size_t i = 0; i < pindex.size(); ++i) {
+            const int slot = slots.Slot(detector[i], layer[i]);
+            const int p = pindex[i];
+            if (slot < 0 || p < 0 || p >= REC_Particle_num) continue;
+            table.At(p, slot, RECTrajTable::kX) = x[i];
+            table.At(p, slot, RECTrajTable::kY) = y[i];
+            table.At(p, slot, RECTrajTable::kZ) = z[i];
+            table.At(p, slot, RECTrajTable::kCX) = cx[i];
+            table.At(p, slot, RECTrajTable::kCY) = cy[i];
+            table.At(p, slot, RECTrajTable::kCZ) = cz[i];
+            table.At(p, slot, RECTrajTable::kPath) = path[i];
+            table.At(p, slot, RECTrajTable::kEdge) = edge[i];
+            table.valid[p] |= 1ULL << slot;
+        }
+        return table;
+    };
+}
+
+std::function<RECCaloTable(const std::vector<int16_t>& pindex,
+                           const std::vector<int16_t>& detector,
+                           const std::vector<int16_t>& layer,
+                           const std::vector<float>& energy,
+                           const std::vector<float>& lu,
+                           const std::vector<float>& lv,
+                           const std::vector<float>& lw,
+                           const int& REC_Particle_num)> RECCalorimeterPivot(const DetectorSlots& slots) {
+    return [slots](const std::vector<int16_t>& pindex,
+                   const std::vector<int16_t>& detector,
+                   const std::vector<int16_t>& layer,
+                   const std::vector<float>& energy,
+                   const std::vector<float>& lu,
+                   const std::vector<float>& lv,
+                   const std::vector<float>& lw,
+                   const int& REC_Particle_num) -> RECCaloTable {
+        RECCaloTable table;
+        table.Reset(REC_Particle_num, slots.Size());
+        for (size_t i = 0; i < pindex.size(); ++i) {
+            const int slot = slots.Slot(detector[i], layer[i]);
+            const int p = pindex[i];
+            if (slot < 0 || p < 0 || p >= REC_Particle_num) continue;
+            table.At(p, slot, RECCaloTable::kLU) = lu[i];
+            table.At(p, slot, RECCaloTable::kLV) = lv[i];
+            table.At(p, slot, RECCaloTable::kLW) = lw[i];
+            table.At(p, slot, RECCaloTable::kEnergy) = energy[i];
+            table.valid[p] |= 1ULL << slot;
+        }
+        return table;
+    };
+}
+
+std::function<RECTrackTable(const std::vector<int16_t>& pindex,
+                            const std::vector<int16_t>& detector,
+                            const std::vector<int16_t>& sector,
+                            const std::vector<float>& chi2,
+                            const std::vector<int16_t>& NDF,
+                            const int& REC_Particle_num)> RECTrackPivot(const DetectorSlots& slots) {
+    return [slots](const std::vector<int16_t>& pindex,
+                   const std::vector<int16_t>& detector,
+                   const std::vector<int16_t>& sector,
+                   const std::vector<float>& chi2,
+                   const std::vector<int16_t>& NDF,
+                   const int& REC_Particle_num) -> RECTrackTable {
+        RECTrackTable table;
+        table.Reset(REC_Particle_num, slots.Size());
+        for (size_t i = 0; i < pindex.size(); ++i) {
+            const int slot = slots.Slot(detector[i], 0);
+            const int p = pindex[i];
+            // a track without degrees of freedom keeps 9999 and is not valid
+            if (slot < 0 || p < 0 || p >= REC_Particle_num || NDF[i] <= 0) continue;
+            table.At(p, slot, RECTrackTable::kChi2NDF) = chi2[i] / NDF[i];
+            table.valid[p] |= 1ULL << slot;
+        }
+        return table;
+    };
+}
+
+std::function<ROOT::RVec<float>(const RECTrajTable&)> RECTrajXYZ(const DetectorSlots& slots, int target_detector, int target_layer, int xyz) {
+    if (xyz < 1 || xyz > 3) throw std::runtime_error("RECTrajXYZ: xyz must be 1, 2 or 3");
+    const int slot = slots.Require(target_detector, target_layer);
+    const int component = RECTrajTable::kX + xyz - 1;
+    return [slot, component](const RECTrajTable& table) { return table.View(slot, component); };
+}
+
+std::function<ROOT::RVec<float>(const RECTrajTable&)> RECTrajedge(const DetectorSlots& slots, int target_detector, int target_layer) {
+    const int slot = slots.Require(target_detector, target_layer);
+    return [slot](const RECTrajTable& table) { return table.View(slot, RECTrajTable::kEdge); };
+}
+
+std::function<ROOT::RVec<float>(const RECCaloTable&)> RECCalorimeterluvw(const DetectorSlots& slots, int target_detector, int target_layer, int uvw) {
+    if (uvw < 1 || uvw > 3) throw std::runtime_error("RECCalorimeterluvw: uvw must be 1, 2 or 3");
+    const int slot = slots.Require(target_detector, target_layer);
+    const int component = RECCaloTable::kLU + uvw - 1;
+    return [slot, component](const RECCaloTable& table) { return table.View(slot, component); };
+}
+
+std::function<ROOT::RVec<float>(const RECTrackTable&)> RECTrackchi2perndf(const DetectorSlots& slots, int target_detector) {
+    const int slot = slots.Require(target_detector, 0);
+    return [slot](const RECTrackTable& table) { return table.View(slot, RECTrackTable::kChi2NDF); };
+}
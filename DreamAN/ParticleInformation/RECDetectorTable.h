@@ -0,0 +1,154 @@
+#ifndef RECDETECTORTABLE_H
+#define RECDETECTORTABLE_H
+
+#include <ROOT/RDF/RInterface.hxx>
+#include <ROOT/RVec.hxx>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Pivoted per-particle detector-crossing tables.
+//
+// The bank forms of RECTrajXYZ, RECTrajedge, RECCalorimeterluvw and RECTrackchi2perndf each scan
+// the full bank for a single (detector, layer, component) and return a fresh 9999-filled vector.
+// Here each bank is scanned once per event into a dense table of every registered slot, a slot
+// being one (detector, layer) pair of a DetectorSlots layout, with one validity bit per particle
+// and slot, so a particle without a hit is distinguishable from a real 9999.
+//
+// The table is stored slot x component major: the values of one (slot, component) for every
+// particle are contiguous, and the table forms of the four functions above return them as an RVec
+// over the table's memory, without a copy or an allocation. Such a view is valid for the entry it
+// was made in; Take or Cache of the column store owning copies.
+//
+//   DetectorSlots traj{{6, 6}, {6, 18}, {6, 36}};  // DC regions 1-3
+//   df = RECDetectorTable::Define(df, traj, {}, {});  // REC_Traj_table, built once per event
+//   df = df.Define("REC_Traj_edge_DC1", RECTrajedge(traj, 6, 6), {"REC_Traj_table"});
+//   df = df.Define("REC_Traj_x_DC1", RECTrajXYZ(traj, 6, 6, 1), {"REC_Traj_table"});
+
+class DetectorSlots {
+public:
+    static constexpr int kMaxDetector = 32;
+    static constexpr int kMaxLayer = 128;
+    static constexpr int kMaxSlots = 64;  // one validity bit per slot
+
+    DetectorSlots();
+    DetectorSlots(std::initializer_list<std::pair<int, int>> slots);
+
+    // Registers (detector, layer) and returns its slot; registering twice returns the same slot
+    int Add(int detector, int layer);
+    // Slot of (detector, layer), -1 when not registered. Layer 0 is used for per-detector banks (REC::Track)
+    int Slot(int detector, int layer) const {
+        if (detector < 0 || detector >= kMaxDetector || layer < 0 || layer >= kMaxLayer) return -1;
+        return fLookup[detector * kMaxLayer + layer];
+    }
+    // As Slot, but an unregistered (detector, layer) is an error of the layout
+    int Require(int detector, int layer) const;
+    int Size() const { return static_cast<int>(fSlots.size()); }
+    bool Empty() const { return fSlots.empty(); }
+    const std::pair<int, int>& At(int slot) const { return fSlots[slot]; }
+
+private:
+    std::vector<std::pair<int, int>> fSlots;
+    std::vector<int8_t> fLookup;  // detector * kMaxLayer + layer -> slot
+};
+
+template <int NComponents>
+struct RECPivotTable {
+    static constexpr int kNComponents = NComponents;
+
+    int nParticles = 0;
+    int nSlots = 0;
+    std::vector<float> values;    // [(slot * NComponents + component) * nParticles + particle]
+    std::vector<uint64_t> valid;  // per particle, bit per slot
+
+    void Reset(int particles, int slots) {
+        nParticles = particles;
+        nSlots = slots;
+        values.assign(static_cast<size_t>(particles) * slots * NComponents, 9999.f);
+        valid.assign(particles, 0);
+    }
+    float& At(int particle, int slot, int component) { return values[(static_cast<size_t>(slot) * NComponents + component) * nParticles + particle]; }
+    float Get(int particle, int slot, int component) const { return values[(static_cast<size_t>(slot) * NComponents + component) * nParticles + particle]; }
+    bool IsValid(int particle, int slot) const { return (valid[particle] >> slot) & 1ULL; }
+    // Every particle's value of one (slot, component), over the table's memory
+    ROOT::RVec<float> View(int slot, int component) const {
+        if (nParticles == 0) return {};
+        return ROOT::RVec<float>(const_cast<float*>(&values[(static_cast<size_t>(slot) * NComponents + component) * nParticles]), nParticles);
+    }
+};
+
+struct RECTrajTable : RECPivotTable<8> {
+    enum Component { kX, kY, kZ, kCX, kCY, kCZ, kPath, kEdge };
+};
+
+struct RECCaloTable : RECPivotTable<4> {
+    enum Component { kLU, kLV, kLW, kEnergy };
+};
+
+struct RECTrackTable : RECPivotTable<1> {
+    enum Component { kChi2NDF };
+};
+
+struct RECDetectorTable {
+    // Minimal bank columns read by the pivots, in argument order
+    static const std::vector<std::string>& TrajColumns();
+    static const std::vector<std::string>& CaloColumns();
+    static const std::vector<std::string>& TrackColumns();
+
+    // The pivot stage: REC_Traj_table, REC_Calorimeter_table and REC_Track_table, one scan of
+    // their bank per event, for every layout that is not empty. Needs REC_Particle_num.
+    static ROOT::RDF::RNode Define(ROOT::RDF::RNode df, const DetectorSlots& traj, const DetectorSlots& calo, const DetectorSlots& track);
+};
+
+std::function<RECTrajTable(const std::vector<int16_t>& pindex,
+                           const std::vector<int16_t>& detector,
+                           const std::vector<int16_t>& layer,
+                           const std::vector<float>& x,
+                           const std::vector<float>& y,
+                           const std::vector<float>& z,
+                           const std::vector<float>& cx,
+                           const std::vector<float>& cy,
+                           const std::vector<float>& cz,
+                           const std::vector<float>& path,
+                           const std::vector<float>& edge,
+                           const int& REC_Particle_num)> RECTrajPivot(const DetectorSlots& slots);
+
+std::function<RECCaloTable(const std::vector<int16_t>& pindex,
+                           const std::vector<int16_t>& detector,
+                           const std::vector<int16_t>& layer,
+                           const std::vector<float>& energy,
+                           const std::vector<float>& lu,
+                           const std::vector<float>& lv,
+                           const std::vector<float>& lw,
+                           const int& REC_Particle_num)> RECCalorimeterPivot(const DetectorSlots& slots);
+
+// Track slots are registered with layer 0: DetectorSlots{{5, 0}, {6, 0}} for CVT and DC
+std::function<RECTrackTable(const std::vector<int16_t>& pindex,
+                            const std::vector<int16_t>& detector,
+                            const std::vector<int16_t>& sector,
+                            const std::vector<float>& chi2,
+                            const std::vector<int16_t>& NDF,
+                            const int& REC_Particle_num)> RECTrackPivot(const DetectorSlots& slots);
+
+// Table forms of the per-bank column functions (RECTraj.h, RECCalorimeter.h, RECTrack.h): the same
+// values, 9999 where the particle has no hit, read from the pivot table of slots
+std::function<ROOT::RVec<float>(const RECTrajTable&)> RECTrajXYZ(const DetectorSlots& slots, int target_detector, int target_layer, int xyz);
+std::function<ROOT::RVec<float>(const RECTrajTable&)> RECTrajedge(const DetectorSlots& slots, int target_detector, int target_layer);
+std::function<ROOT::RVec<float>(const RECCaloTable&)> RECCalorimeterluvw(const DetectorSlots& slots, int target_detector, int target_layer, int uvw);
+std::function<ROOT::RVec<float>(const RECTrackTable&)> RECTrackchi2perndf(const DetectorSlots& slots, int target_detector);
+
+// Validity bit of one slot for every particle
+template <typename Table>
+std::function<ROOT::RVec<int>(const Table&)> RECPivotValid(const DetectorSlots& slots, int detector, int layer) {
+    const int slot = slots.Require(detector, layer);
+    return [slot](const Table& table) -> ROOT::RVec<int> {
+        ROOT::RVec<int> out(table.nParticles);
+        for (int i = 0; i < table.nParticles; ++i) out[i] = table.IsValid(i, slot);
+        return out;
+    };
+}
+
+#endif // RECDETECTORTABLE_H
@@ -19,6 +19,7 @@ struct RECTrack {
     >;
 };
 
+// One bank scan per column; the table form (RECDetectorTable.h) reads the pivoted REC_Track_table
 std::function<std::vector<float>(const std::vector<int16_t>& pindex,
                                  const std::vector<int16_t>& detector,
                                  const std::vector<int16_t>& sector,
@@ -150,16 +150,17 @@ get_RECTraj_float_var(int target_detector, int target_layer, int target_pid, int
                const std::vector<int>& charge,
                const std::vector<float>& p,
                const std::vector<int>& trackpass) -> std::vector<float> {
+        // one scan of the hits counts the matches per particle, then the output keeps the particle order
+        std::vector<int> nHits(pid.size(), 0);
+        for (size_t j = 0; j < detector.size(); ++j) {
+            if (detector[j] == target_detector && layer[j] == target_layer && pindex[j] >= 0 && static_cast<size_t>(pindex[j]) < pid.size()) {
+                ++nHits[pindex[j]];
+            }
+        }
         std::vector<float> out;
         for (size_t i = 0; i < pid.size(); ++i) {
-            for (size_t j = 0; j < detector.size(); ++j) {
-                if (detector[j] == target_detector && layer[j] == target_layer &&
-                    pindex[j] == i &&
-                    pid[i] == target_pid && static_cast<int8_t>(charge[i]) == target_charge &&
-                    p[i] > 0.02 && trackpass[i] == 1) {
-                    out.push_back(var[i]);
-                }
-            }
+            if (nHits[i] == 0 || pid[i] != target_pid || static_cast<int8_t>(charge[i]) != target_charge || !(p[i] > 0.02) || trackpass[i] != 1) continue;
+            out.insert(out.end(), nHits[i], var[i]);
         }
         return out;
     };
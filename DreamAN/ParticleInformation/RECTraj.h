@@ -27,6 +27,8 @@ struct RECTraj {
     >;
 };
 
+// Single (detector, layer) columns, one bank scan each. When several are needed, build the pivot
+// table once (RECDetectorTable.h) and use the table forms of RECTrajXYZ and RECTrajedge
 std::function<std::vector<float>(const std::vector<int16_t>& pindex,
                                  const std::vector<int16_t>& index,
                                  const std::vector<int16_t>& detector,
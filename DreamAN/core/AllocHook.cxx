@@ -0,0 +1,57 @@
+// Allocation counting for StageProfiler: replaces the malloc family of the executable and
+// counts calls and requested bytes per thread before handing over to glibc. Only compiled in
+// with -DDISANA_ALLOC_HOOK=ON, so normal builds keep the plain allocator.
+
+#include <cerrno>
+#include <cstddef>
+
+#include "StageProfiler.h"
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+
+static inline void CountAlloc(size_t bytes) {
+  auto& counters = StageProfiler::ThreadAllocs();
+  ++counters.calls;
+  counters.bytes += bytes;
+}
+
+void* malloc(size_t size) {
+  CountAlloc(size);
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size) {
+  CountAlloc(n * size);
+  return __libc_calloc(n, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+  CountAlloc(size);
+  return __libc_realloc(ptr, size);
+}
+
+void* memalign(size_t alignment, size_t size) {
+  CountAlloc(size);
+  return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+  CountAlloc(size);
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size) {
+  CountAlloc(size);
+  void* p = __libc_memalign(alignment, size);
+  if (!p) return ENOMEM;
+  *ptr = p;
+  return 0;
+}
+
+void free(void* ptr) { __libc_free(ptr); }
+}
@@ -1,4 +1,140 @@
 #include "AnalysisTask.h"
 
+#include <ROOT/RDataFrame.hxx>
+#include <filesystem>
+#include <iostream>
+
+#include "AnalysisTaskManager.h"
+#include "BitmapIndex.h"
+#include "EventIndex.h"
+
 AnalysisTask::AnalysisTask() = default;
 AnalysisTask::~AnalysisTask() = default;
+
+bool AnalysisTask::UseCachedStage(ROOT::RDF::RNode& node, const std::string& tree, const std::string& stage, const std::string& config) {
+  if (!fStageCache || !fTaskManager || fTaskManager->GetInputFiles().empty()) return false;
+  const auto& inputs = fTaskManager->GetInputFiles();
+  const auto& samples = fTaskManager->GetInputSamples();
+  // one entry per input file when the events can be traced back to their file, one for the set otherwise
+  const bool perInput = samples.size() == inputs.size();
+  if (perInput && fInputSamples.empty())
+    for (size_t i = 0; i < samples.size(); ++i) fInputSamples.emplace_back(samples[i] + "/", static_cast<int>(i));
+
+  CachedStage entry{stage, config, {}};
+  if (perInput) {
+    for (size_t i = 0; i < inputs.size(); ++i) entry.parts.push_back({static_cast<int>(i), fStageCache->Key(stage, config, inputs[i])});
+  } else {
+    entry.parts.push_back({-1, fStageCache->Key(stage, config, inputs)});
+  }
+  size_t hits = 0;
+  for (auto& part : entry.parts) {
+    if (part.key.empty()) {
+      std::cout << "[StageCache] " << stage << " not cached: " << (part.input < 0 ? std::string("an input file") : inputs[part.input]) << " cannot be inspected" << std::endl;
+      fCachedStages.erase(tree);
+      return false;
+    }
+    part.file = fStageCache->Find(stage, part.key);
+    if (!part.file.empty()) ++hits;
+  }
+
+  if (hits < entry.parts.size()) {
+    std::cout << "[StageCache] " << stage << ": " << hits << " of " << entry.parts.size() << " entries cached, computing it" << std::endl;
+    if (perInput && !node.HasColumn(StageCache::kInputColumn)) {
+      node = node.DefinePerSample(StageCache::kInputColumn, [prefixes = fInputSamples](unsigned int, const ROOT::RDF::RSampleInfo& info) {
+        const std::string id = info.AsString();
+        for (const auto& [prefix, input] : prefixes)
+          if (id.rfind(prefix, 0) == 0) return input;
+        return -1;
+      });
+    }
+    fCachedStages[tree] = std::move(entry);
+    return false;
+  }
+
+  std::vector<std::string> files;
+  for (const auto& part : entry.parts) files.push_back(part.file);
+  // a later stage traces the events read back from an entry to the entry's input file
+  if (perInput)
+    for (const auto& part : entry.parts) fInputSamples.emplace_back(part.file + "/", part.input);
+  std::cout << "[StageCache] " << stage << " read from " << files.size() << " cached entries" << std::endl;
+  node = ROOT::RDataFrame(tree, files);
+  fCachedStages.erase(tree);
+  return true;
+}
+
+std::shared_ptr<AnalysisTask::CachedStage> AnalysisTask::BookStage(ROOT::RDF::RNode df, const std::string& tree, const std::vector<std::string>& columns) {
+  auto it = fCachedStages.find(tree);
+  if (!fStageCache || it == fCachedStages.end()) return nullptr;
+  auto stage = std::make_shared<CachedStage>(std::move(it->second));
+  fCachedStages.erase(it);
+
+  // the entries keep the input order under ImplicitMT too, as OrderedSnapshot does: written with
+  // the rdfentry_ tag and merged in order before they are stored
+  const bool tagged = ROOT::IsImplicitMTEnabled();
+  ROOT::RDF::RNode source = tagged ? df.Define(OrderedSnapshot::kTagColumn, [](ULong64_t entry) { return entry; }, {"rdfentry_"}) : df;
+  std::vector<std::string> entryColumns = columns;
+  if (tagged) entryColumns.push_back(OrderedSnapshot::kTagColumn);
+  ROOT::RDF::RSnapshotOptions options;
+  options.fLazy = true;
+  for (auto& part : stage->parts) {
+    if (!part.file.empty()) continue;
+    const int input = part.input;
+    ROOT::RDF::RNode selected = input < 0 ? source : source.Filter([input](int eventInput) { return eventInput == input; }, {StageCache::kInputColumn});
+    const std::string pending = fStageCache->PendingPath(stage->stage, part.key);
+    part.written = tagged ? pending + ".unordered.tmp" : pending;
+    part.tagged = tagged;
+    DISANA_BOOK("Snapshot", tree + " -> " + part.written, entryColumns);
+    part.snapshot = selected.Snapshot(tree, part.written, entryColumns, options);
+  }
+  return stage;
+}
+
+void AnalysisTask::StoreStage(const CachedStage& stage, const std::string& tree) const {
+  const auto& inputs = fTaskManager->GetInputFiles();
+  for (const auto& part : stage.parts) {
+    if (!part.snapshot) continue;
+    const std::string pending = fStageCache->PendingPath(stage.stage, part.key);
+    std::error_code ec;
+    if (part.tagged) {
+      try {
+        OrderedSnapshot::MergeInOrder(part.written, tree, pending);
+      } catch (const std::exception& e) {
+        std::cerr << "[StageCache] " << stage.stage << " (" << part.key << ") not stored: " << e.what() << std::endl;
+        std::filesystem::remove(part.written, ec);
+        continue;
+      }
+      std::filesystem::remove(part.written, ec);
+    }
+    const std::string input = part.input < 0 ? std::to_string(inputs.size()) + " input files" : inputs[part.input];
+    fStageCache->Store(stage.stage, part.key, pending, stage.config + "\ninput " + input);
+  }
+}
+
+ROOT::RDF::RNode AnalysisTask::AsRVec(ROOT::RDF::RNode df, const std::vector<std::string>& columns) {
+  for (const auto& column : columns) {
+    const std::string type = df.GetColumnType(column);
+    const size_t open = type.find('<'), close = type.rfind('>');
+    if (type.find("RVec<") != std::string::npos || open == std::string::npos || close < open) continue;
+    const std::string element = type.substr(open + 1, close - open - 1);
+    df = df.Redefine(column, "ROOT::RVec<" + element + ">(" + column + ".begin(), " + column + ".end())");
+  }
+  return df;
+}
+
+void AnalysisTask::WriteEventIndex(const std::string& tree, const std::string& filename, ROOT::RDF::RResultPtr<std::vector<EventIndex::Entry>> booked) const {
+  if (!fEventIndex) return;
+  const EventIndex index = booked ? EventIndex::FromBooked(*booked, filename, tree) : EventIndex::FromTree({filename}, tree);
+  index.Write(filename + ".idx");
+}
+
+void AnalysisTask::WriteBitmapIndex(const std::string& tree, const std::string& filename) const {
+  if (!fBitmapIndex) return;
+  BitmapIndex::Build(filename, tree).Write(filename + ".bmi");
+}
+
+void AnalysisTask::Defer(const std::string& label, std::function<void()> job) const {
+  if (fOutputWriter)
+    fOutputWriter->Submit(label, std::move(job));
+  else
+    job();
+}
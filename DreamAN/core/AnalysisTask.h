@@ -3,12 +3,25 @@
 
 #include <TFile.h>
 #include <TH1F.h>
+#include <TROOT.h>
 #include <TTree.h>
 
 #include <ROOT/RDF/RInterface.hxx>
+#include <functional>
 #include <map>
+#include <memory>
 #include <string>
 
+#include "ClusteredSnapshot.h"
+#include "EventIndex.h"
+#include "EventLoopDiagnostics.h"
+#include "NumpyExport.h"
+#include "OrderedSnapshot.h"
+#include "OutputEncoding.h"
+#include "OutputWriter.h"
+#include "PartitionedSnapshot.h"
+#include "StageCache.h"
+#include "StageProfiler.h"
 #include "RHipoDS.hxx"
 
 class AnalysisTaskManager;  // forward declare
@@ -30,6 +43,12 @@ class AnalysisTask {
   virtual void SetOutputDir(const std::string& dir) {}
   template <typename Lambda>
   ROOT::RDF::RNode DefineOrRedefine(ROOT::RDF::RNode df, const std::string& name, Lambda&& lambda, const std::vector<std::string>& columns) {
+    if (StageProfiler::Get().IsEnabled()) return DefineOrRedefineColumn(df, name, StageProfiler::Get().Wrap(name, std::forward<Lambda>(lambda)), columns);
+    return DefineOrRedefineColumn(df, name, std::forward<Lambda>(lambda), columns);
+  }
+
+  template <typename Lambda>
+  ROOT::RDF::RNode DefineOrRedefineColumn(ROOT::RDF::RNode df, const std::string& name, Lambda&& lambda, const std::vector<std::string>& columns) {
     auto existingCols = df.GetColumnNames();
     if (std::find(existingCols.begin(), existingCols.end(), name) != existingCols.end()) {
       return df.Redefine(name, std::forward<Lambda>(lambda), columns);
@@ -42,16 +61,128 @@ class AnalysisTask {
     std::vector<std::string> outputCols;
 
     for (const auto& col : allCols) {
+      // DISANA_* columns are helpers of the framework (e.g. the EventSampler sample key), never output
+      if (col.rfind("DISANA_", 0) == 0) continue;
       if (std::find(excludeCols.begin(), excludeCols.end(), col) == excludeCols.end()) {
         outputCols.push_back(col);
       }
     }
 
-    df.Snapshot(treename, filename, outputCols);
+    // the partition selections and the clustered keys read the raw pid/status/pass, so their columns are defined before encoding
+    ROOT::RDF::RNode source = fPartitioning && fPartitioning->IsActive() ? PartitionedSnapshot::DefineColumns(df) : df;
+    if (fNumpyExport) fNumpyExport->Book(DefineExportColumns(df), treename, NumpyExport::Directory(filename));
+    // the index is filled by the snapshot's loop when the file keeps the rdfentry_ order, read back from the file otherwise
+    ROOT::RDF::RResultPtr<std::vector<EventIndex::Entry>> indexRecords;
+    if (fEventIndex && !fClusteredOutput && (fOrderedOutput || !ROOT::IsImplicitMTEnabled())) {
+      indexRecords = EventIndex::Book(df);
+      if (indexRecords) DISANA_BOOK("Take", "event index of " + treename, std::vector<std::string>{"RUN_config_run", "RUN_config_event"});
+    }
+    // the cache entries of a computed stage are filled by the loop of the snapshot below
+    auto stage = BookStage(df, treename, outputCols);
+    if (fClusteredOutput) source = fClusteredOutput->DefineColumns(source);
+    ROOT::RDF::RNode out = fEncoding ? fEncoding->Encode(source, treename, outputCols) : source;
+    if (fPartitioning) fPartitioning->Book(out, treename, filename, outputCols);  // filled by the loop of the snapshot below
+    DISANA_BOOK("Snapshot", treename + " -> " + filename, outputCols);
+    if (fClusteredOutput) {
+      DISANA_WATCH(out, "Snapshot(" + treename + ", clustered)", fClusteredOutput->Write(out, treename, filename, outputCols, fOrderedOutput));
+    } else if (fOrderedOutput) {
+      DISANA_WATCH(out, "Snapshot(" + treename + ", ordered)", OrderedSnapshot::Write(out, treename, filename, outputCols));
+    } else {
+      DISANA_WATCH(out, "Snapshot(" + treename + ")", (void)out.Snapshot(treename, filename, outputCols));
+    }
+    std::vector<std::string> encodedFiles = {filename};
+    if (fPartitioning)
+      for (const auto& file : fPartitioning->WriteManifest(treename)) encodedFiles.push_back(file);
+    if (fNumpyExport) fNumpyExport->Finish(treename);
+    if (fEncoding) fEncoding->WriteManifest(treename, encodedFiles);
+    WriteBitmapIndex(treename, filename);  // runs its own event loop, so not on the writer thread
+    // the cache entries are moved in and the index reads the closed file, they can overlap with the next event loop
+    Defer("finish " + filename, [this, treename, filename, indexRecords, stage] {
+      if (stage) StoreStage(*stage, treename);
+      WriteEventIndex(treename, filename, indexRecords);
+    });
   }
 
+  // Keep the rdfentry_ order in the snapshots even when ImplicitMT is on
+  void SetOrderedOutput(bool ordered) { fOrderedOutput = ordered; }
+
+  // Output jobs go to this writer thread instead of running inline, see OutputWriter.h
+  void SetOutputWriter(std::shared_ptr<OutputWriter> writer) { fOutputWriter = std::move(writer); }
+
+  // Writes <file>.idx, the (run, event) -> entry index of every snapshot, see EventIndex.h
+  void SetEventIndex(bool index) { fEventIndex = index; }
+
+  // Writes <file>.bmi, bitmaps of the helicity/topology/sector/run/pass values of every snapshot, see BitmapIndex.h
+  void SetBitmapIndex(bool index) { fBitmapIndex = index; }
+
+  // Snapshots grouped by kinematic cell with a zone map for range-skipping reads, see ClusteredSnapshot.h
+  void SetClusteredOutput(std::shared_ptr<ClusteredSnapshot> clustered) { fClusteredOutput = std::move(clustered); }
+
+  // Every snapshot is also written split into partitions (topology, run period, ...), see PartitionedSnapshot.h
+  void SetPartitioning(std::shared_ptr<PartitionedSnapshot> partitioning) { fPartitioning = std::move(partitioning); }
+
+  // Snapshot columns are stored within a precision policy and decoded on read, see OutputEncoding.h
+  void SetOutputEncoding(std::shared_ptr<OutputEncoding> encoding) { fEncoding = std::move(encoding); }
+
+  // Numeric scalar columns of every snapshot, with the task's candidate columns, also go to <file>_npy/*.npy, see NumpyExport.h
+  void SetNumpyExport(std::shared_ptr<NumpyExport> exporter) { fNumpyExport = std::move(exporter); }
+
+  // Stage outputs (the snapshot trees) are looked up in / stored to this cache, see StageCache.h
+  void SetStageCache(std::shared_ptr<StageCache> cache) { fStageCache = std::move(cache); }
+
  protected:
+  // Replaces node by the cached output of the stage written to tree when the cache has it for this
+  // configuration and every input file; otherwise the missing entries are stored from the stage's
+  // snapshot. Returns true on a hit.
+  bool UseCachedStage(ROOT::RDF::RNode& node, const std::string& tree, const std::string& stage, const std::string& config);
+  // Columns the NumpyExport adds to a snapshot's own: the task's best exclusive candidate and its
+  // kinematics, one row per event with a candidate. The default exports the snapshot's columns.
+  virtual ROOT::RDF::RNode DefineExportColumns(ROOT::RDF::RNode df) const { return df; }
+  // Redefines the columns that are not RVecs (std::vector of the HIPO source and of the cut
+  // results) as RVec copies, for the candidate builders that read RVecs
+  static ROOT::RDF::RNode AsRVec(ROOT::RDF::RNode df, const std::vector<std::string>& columns);
+  // From the records booked with EventIndex::Book when given, from the written file otherwise
+  void WriteEventIndex(const std::string& tree, const std::string& filename, ROOT::RDF::RResultPtr<std::vector<EventIndex::Entry>> booked = {}) const;
+  void WriteBitmapIndex(const std::string& tree, const std::string& filename) const;
+  // Runs job on the output writer when there is one, right away otherwise. Jobs may capture the
+  // task (this): that is safe only because the manager flushes the writer in SaveOutput and in
+  // its destructor, while it still owns the tasks.
+  void Defer(const std::string& label, std::function<void()> job) const;
+
   AnalysisTaskManager* fTaskManager = nullptr;
+  bool fOrderedOutput = false;
+  bool fEventIndex = false;
+  bool fBitmapIndex = false;
+  std::shared_ptr<StageCache> fStageCache;
+  std::shared_ptr<OutputWriter> fOutputWriter;
+  std::shared_ptr<PartitionedSnapshot> fPartitioning;
+  std::shared_ptr<ClusteredSnapshot> fClusteredOutput;
+  std::shared_ptr<OutputEncoding> fEncoding;
+  std::shared_ptr<NumpyExport> fNumpyExport;
+
+ private:
+  using SnapshotResult = ROOT::RDF::RResultPtr<ROOT::RDF::RInterface<ROOT::Detail::RDF::RLoopManager>>;
+  // One cache entry of a stage: the output of one input file, or of the whole input set when the
+  // source cannot tell the input file of an event
+  struct StagePart {
+    int input = -1;  // index in the input files, -1 for the whole set
+    std::string key;
+    std::string file;     // cached entry, empty on a miss
+    std::string written;  // of a miss, the booked snapshot's file
+    bool tagged = false;  // written unordered with the OrderedSnapshot tag, merged before storing
+    SnapshotResult snapshot;
+  };
+  struct CachedStage {
+    std::string stage;
+    std::string config;
+    std::vector<StagePart> parts;
+  };
+  // Lazy snapshots of the missing entries of tree's stage into the cache; null when nothing is missing
+  std::shared_ptr<CachedStage> BookStage(ROOT::RDF::RNode df, const std::string& tree, const std::vector<std::string>& columns);
+  void StoreStage(const CachedStage& stage, const std::string& tree) const;
+
+  std::map<std::string, CachedStage> fCachedStages;  // by tree name, the stages computed in this run
+  std::vector<std::pair<std::string, int>> fInputSamples;  // sample id prefix -> input file, of the inputs and of the cache entries read back
 };
 
 #endif
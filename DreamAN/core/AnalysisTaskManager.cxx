@@ -1,22 +1,52 @@
 #include "AnalysisTaskManager.h"
 #include "AnalysisTask.h"
+#include "EventLoopDiagnostics.h"
+#include "NumpyExport.h"
+#include "OutputEncoding.h"
+#include "OutputWriter.h"
+#include "StageProfiler.h"
 #include <TFile.h>
 
 AnalysisTaskManager::AnalysisTaskManager() {}
 AnalysisTaskManager::~AnalysisTaskManager() {
+    // queued jobs hold raw task pointers (AnalysisTask::Defer), run them while the tasks exist
+    if (outputWriter) outputWriter->Flush();
 }
 
 void AnalysisTaskManager::AddTask(std::unique_ptr<AnalysisTask> task) {
     task->SetTaskManager(this);
+    ConfigureTask(*task);
     tasks.push_back(std::move(task));
 }
 
+// The output settings shape the graphs the tasks build in UserExec (and their stage cache keys),
+// so they are pushed when a task is added and again before Execute, for setters called in between
+void AnalysisTaskManager::ConfigureTask(AnalysisTask& task) const {
+    task.SetOrderedOutput(orderedOutput);
+    task.SetEventIndex(eventIndex);
+    task.SetBitmapIndex(bitmapIndex);
+    task.SetOutputWriter(outputWriter);
+    task.SetPartitioning(partitioning);
+    task.SetClusteredOutput(clusteredOutput);
+    task.SetOutputEncoding(encoding);
+    task.SetNumpyExport(numpyExport);
+    task.SetStageCache(stageCache);
+}
+
+void AnalysisTaskManager::SetStageCache(std::shared_ptr<StageCache> cache) {
+    stageCache = std::move(cache);
+    for (auto& task : tasks) task->SetStageCache(stageCache);
+}
+
 void AnalysisTaskManager::UserCreateOutputObjects() {
     for (auto& task : tasks) task->UserCreateOutputObjects();
 }
 
 void AnalysisTaskManager::Execute(ROOT::RDF::RNode& df) {
-    for (auto& task : tasks) task->UserExec(df);
+    for (auto& task : tasks) {
+        ConfigureTask(*task);
+        task->UserExec(df);
+    }
 }
 
 void AnalysisTaskManager::SetOututDir(const std::string& Outputdir,const std::string& filename, const std::string& directory) {
@@ -43,9 +73,26 @@ void AnalysisTaskManager::SetOutputFileForTasks() {
     for (auto& task : tasks) {
         task->SetOutputDir(outputDir);
         task->SetOutputFile(outputFile.get());
+        ConfigureTask(*task);
     }
 }
 
+void AnalysisTaskManager::EnableEventLoopDiagnostics(unsigned int loopBudget) {
+    diagnostics = true;
+    EventLoopDiagnostics::Get().Enable();
+    EventLoopDiagnostics::Get().SetStrict(loopBudget);
+}
+
+void AnalysisTaskManager::EnableAsyncOutput(size_t maxQueued) {
+    outputWriter = std::make_shared<OutputWriter>(maxQueued);
+}
+
+void AnalysisTaskManager::EnableStageProfiling(bool perSlot) {
+    profiling = true;
+    profilePerSlot = perSlot;
+    StageProfiler::Get().Enable();
+}
+
 void AnalysisTaskManager::SaveOutput() {
     if (!outputFile) {
         std::cerr << "[SaveOutput] No output file!" << std::endl;
@@ -56,6 +103,11 @@ void AnalysisTaskManager::SaveOutput() {
     for (size_t i = 0; i < tasks.size(); ++i) {
         tasks[i]->SaveOutput();
     }
+    // every task's post-snapshot jobs were queued right after its own loop and overlapped with
+    // the loops of the later snapshots; the deferred jobs capture the task (this), so wait for
+    // them before anything can go away. After that the writer is idle and the registered
+    // histograms and trees are written here.
+    if (outputWriter) outputWriter->Flush();
     for (const auto& [name, hist] : histograms) {
         if (hist) {
             hist->Write(name.c_str());
@@ -74,5 +126,7 @@ void AnalysisTaskManager::SaveOutput() {
     }
     outputFile->Close();
     std::cout << "Outuput file saved: " << outputFile->GetName() << std::endl;
+    if (diagnostics) EventLoopDiagnostics::Get().PrintSummary();
+    if (profiling) StageProfiler::Get().PrintSummary(profilePerSlot);
 }
 
@@ -11,6 +11,12 @@
 #include <TTree.h>
 
 class AnalysisTask;
+class ClusteredSnapshot;
+class NumpyExport;
+class OutputEncoding;
+class OutputWriter;
+class PartitionedSnapshot;
+class StageCache;
 
 class AnalysisTaskManager {
 public:
@@ -30,18 +36,80 @@ public:
     // New: Notify tasks of output file
     void SetOutputFileForTasks();
 
+    // Event-loop bookkeeping: prints a summary after SaveOutput; loopBudget > 0 turns on strict mode
+    void EnableEventLoopDiagnostics(unsigned int loopBudget = 0);
+
+    // Cycles, instructions, cache/branch misses and mallocs of every DefineOrRedefine functor,
+    // printed after SaveOutput; call before the tasks build their graphs (see StageProfiler.h)
+    void EnableStageProfiling(bool perSlot = false);
+
+    // Snapshots keep the rdfentry_ order under ImplicitMT (k-way merge after writing); see OrderedSnapshot.h
+    void SetOrderedOutput(bool ordered) { orderedOutput = ordered; }
+
+    // Snapshot post-processing (stage cache entries, event index, sampler metadata) is handed to a
+    // writer thread with a bounded queue as soon as each snapshot's loop ends, so it overlaps with
+    // the next snapshot's loop; flushed and timed in SaveOutput before the histograms and trees,
+    // which are still written synchronously there (see OutputWriter.h)
+    void EnableAsyncOutput(size_t maxQueued = 16);
+    OutputWriter* GetOutputWriter() const { return outputWriter.get(); }
+
+    // Every snapshot gets a (run, event) -> entry index next to it, <file>.idx (see EventIndex.h)
+    void SetEventIndex(bool index) { eventIndex = index; }
+
+    // Every snapshot gets bitmap indexes of its categorical columns, <file>.bmi (see BitmapIndex.h)
+    void SetBitmapIndex(bool index) { bitmapIndex = index; }
+
+    // Snapshots are written grouped by (xB, Q2, t) cell with a per-zone min/max map (see ClusteredSnapshot.h)
+    void SetClusteredOutput(std::shared_ptr<ClusteredSnapshot> clustered) { clusteredOutput = std::move(clustered); }
+
+    // Snapshots are also written split by topology / run period / helicity (see PartitionedSnapshot.h)
+    void SetPartitioning(std::shared_ptr<PartitionedSnapshot> parts) { partitioning = std::move(parts); }
+
+    // Snapshot columns are written within a precision policy, e.g. OutputEncoding::Physics() (see OutputEncoding.h)
+    void SetOutputEncoding(std::shared_ptr<OutputEncoding> enc) { encoding = std::move(enc); }
+
+    // Candidate columns of the snapshots are also written as .npy for Python (see NumpyExport.h)
+    void SetNumpyExport(std::shared_ptr<NumpyExport> exporter) { numpyExport = std::move(exporter); }
+
+    // Stage outputs are read back from / stored to the cache, keyed by configuration and input files
+    void SetStageCache(std::shared_ptr<StageCache> cache);
+    // samples: per input file, the file the RDataFrame sample ids of its events start with, so a
+    // stage is cached per input file; empty when the source cannot tell (one entry for the set)
+    void SetInputFiles(const std::vector<std::string>& files, const std::vector<std::string>& samples = {}) {
+        inputFiles = files;
+        inputSamples = samples;
+    }
+    const std::vector<std::string>& GetInputFiles() const { return inputFiles; }
+    const std::vector<std::string>& GetInputSamples() const { return inputSamples; }
+
     //Getters
     std::string GetOutputDir() const { return outputDir; }
     std::string GetOutputRootDir() const { return outputRootDir; }
     TFile* GetOutputFile() const { return outputFile.get(); }
 
 private:
+    void ConfigureTask(AnalysisTask& task) const;
+
     std::vector<std::unique_ptr<AnalysisTask>> tasks;
     std::map<std::string, TH1*> histograms;
     std::map<std::string, TTree*> trees;
+    std::vector<std::string> inputFiles;
+    std::vector<std::string> inputSamples;
+    std::shared_ptr<StageCache> stageCache;
+    std::shared_ptr<OutputWriter> outputWriter;
+    std::shared_ptr<PartitionedSnapshot> partitioning;
+    std::shared_ptr<ClusteredSnapshot> clusteredOutput;
+    std::shared_ptr<OutputEncoding> encoding;
+    std::shared_ptr<NumpyExport> numpyExport;
     std::unique_ptr<TFile> outputFile;
     std::string outputDir;
     std::string outputRootDir;
+    bool diagnostics = false;
+    bool profiling = false;
+    bool profilePerSlot = false;
+    bool orderedOutput = false;
+    bool eventIndex = false;
+    bool bitmapIndex = false;
 };
 
 #endif
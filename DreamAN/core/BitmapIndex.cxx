@@ -0,0 +1,433 @@
+#include "BitmapIndex.h"
+
+#include <TInterpreter.h>
+
+#include <ROOT/RDataFrame.hxx>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+
+#include "ClusteredSnapshot.h"
+#include "OutputEncoding.h"
+
+namespace {
+const char kMagic[8] = {'D', 'I', 'S', 'A', 'N', 'A', 'B', 'M'};
+
+template <typename T>
+void WriteValue(std::ostream& out, const T& value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool ReadValue(std::istream& in, T& value) {
+  return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+void WriteString(std::ostream& out, const std::string& text) {
+  WriteValue(out, static_cast<uint32_t>(text.size()));
+  out.write(text.data(), text.size());
+}
+
+bool ReadString(std::istream& in, std::string& text) {
+  uint32_t size = 0;
+  if (!ReadValue(in, size)) return false;
+  text.resize(size);
+  return static_cast<bool>(in.read(&text[0], size));
+}
+
+// First element of a per-event vector (RUN_config_*, REC_Event_*) or the value of a scalar column
+void DeclareHelpers() {
+  static const bool declared = gInterpreter->Declare(R"(
+    namespace DISANA_Bitmap {
+    template <typename T> auto First(const T& v, int) -> decltype(v.size(), int()) { return v.size() == 0 ? 0 : int(v[0]); }
+    template <typename T> int First(const T& v, long) { return int(v); }
+    template <typename T> int First(const T& v) { return First(v, 0); }
+    })");
+  (void)declared;
+}
+
+// Sector of the first passing particle of pid, from the detector bank that points back to it
+std::string SectorExpression(int pid, const std::string& bank) {
+  return "[&] { for (size_t i = 0; i < REC_Particle_pid.size(); ++i) if (REC_Particle_pid[i] == " + std::to_string(pid) + " && REC_Particle_pass[i]) { for (size_t j = 0; j < " +
+         bank + "_pindex.size(); ++j) if (" + bank + "_pindex[j] == int(i)) return int(" + bank + "_sector[j]); return 0; } return 0; }()";
+}
+}  // namespace
+
+// ---------------------------------------------------------------- EntryBitmap
+
+void EntryBitmap::Container::Add(uint16_t low) {
+  if (IsBitmap()) {
+    uint64_t& word = bits[low >> 6];
+    const uint64_t mask = uint64_t(1) << (low & 63);
+    if (!(word & mask)) {
+      word |= mask;
+      ++cardinality;
+    }
+    return;
+  }
+  if (array.empty() || low > array.back()) {
+    array.push_back(low);  // entries usually arrive in increasing order
+  } else {
+    auto it = std::lower_bound(array.begin(), array.end(), low);
+    if (it != array.end() && *it == low) return;
+    array.insert(it, low);
+  }
+  if (++cardinality > kArrayMax) ToBitmap();
+}
+
+bool EntryBitmap::Container::Contains(uint16_t low) const {
+  if (IsBitmap()) return (bits[low >> 6] >> (low & 63)) & 1;
+  return std::binary_search(array.begin(), array.end(), low);
+}
+
+void EntryBitmap::Container::ToBitmap() {
+  bits.assign(kWords, 0);
+  for (uint16_t low : array) bits[low >> 6] |= uint64_t(1) << (low & 63);
+  array.clear();
+  array.shrink_to_fit();
+}
+
+void EntryBitmap::Container::Normalize() {
+  if (!IsBitmap() || cardinality > kArrayMax) return;
+  array.clear();
+  array.reserve(cardinality);
+  for (uint32_t w = 0; w < kWords; ++w)
+    for (uint64_t word = bits[w]; word; word &= word - 1) array.push_back(static_cast<uint16_t>(w * 64 + __builtin_ctzll(word)));
+  bits.clear();
+  bits.shrink_to_fit();
+}
+
+EntryBitmap::Container EntryBitmap::Combine(const Container& a, const Container& b, int op) {
+  Container out;
+  out.key = a.key;
+  if (!a.IsBitmap() && !b.IsBitmap()) {
+    if (op == 0)
+      std::set_intersection(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), std::back_inserter(out.array));
+    else if (op == 1)
+      std::set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), std::back_inserter(out.array));
+    else
+      std::set_difference(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), std::back_inserter(out.array));
+    out.cardinality = static_cast<uint32_t>(out.array.size());
+    if (out.cardinality > kArrayMax) out.ToBitmap();
+    return out;
+  }
+  Container wa = a, wb = b;
+  if (!wa.IsBitmap()) wa.ToBitmap();
+  if (!wb.IsBitmap()) wb.ToBitmap();
+  out.bits.resize(kWords);
+  for (uint32_t w = 0; w < kWords; ++w) {
+    out.bits[w] = op == 0 ? (wa.bits[w] & wb.bits[w]) : op == 1 ? (wa.bits[w] | wb.bits[w]) : (wa.bits[w] & ~wb.bits[w]);
+    out.cardinality += __builtin_popcountll(out.bits[w]);
+  }
+  out.Normalize();
+  return out;
+}
+
+void EntryBitmap::Add(uint32_t entry) {
+  const uint16_t key = entry >> 16;
+  if (fContainers.empty() || fContainers.back().key < key) {
+    fContainers.emplace_back();
+    fContainers.back().key = key;
+    fContainers.back().Add(entry & 0xFFFF);
+    return;
+  }
+  auto it = std::lower_bound(fContainers.begin(), fContainers.end(), key, [](const Container& c, uint16_t k) { return c.key < k; });
+  if (it == fContainers.end() || it->key != key) {
+    it = fContainers.insert(it, Container());
+    it->key = key;
+  }
+  it->Add(entry & 0xFFFF);
+}
+
+bool EntryBitmap::Contains(uint32_t entry) const {
+  const uint16_t key = entry >> 16;
+  auto it = std::lower_bound(fContainers.begin(), fContainers.end(), key, [](const Container& c, uint16_t k) { return c.key < k; });
+  return it != fContainers.end() && it->key == key && it->Contains(entry & 0xFFFF);
+}
+
+uint64_t EntryBitmap::Cardinality() const {
+  uint64_t n = 0;
+  for (const auto& c : fContainers) n += c.cardinality;
+  return n;
+}
+
+size_t EntryBitmap::SizeInBytes() const {
+  size_t bytes = 0;
+  for (const auto& c : fContainers) bytes += 8 + (c.IsBitmap() ? kWords * sizeof(uint64_t) : c.array.size() * sizeof(uint16_t));
+  return bytes;
+}
+
+EntryBitmap EntryBitmap::operator&(const EntryBitmap& other) const {
+  EntryBitmap out;
+  size_t i = 0, j = 0;
+  while (i < fContainers.size() && j < other.fContainers.size()) {
+    const auto& a = fContainers[i];
+    const auto& b = other.fContainers[j];
+    if (a.key < b.key) {
+      ++i;
+    } else if (b.key < a.key) {
+      ++j;
+    } else {
+      Container c = Combine(a, b, 0);
+      if (c.cardinality > 0) out.fContainers.push_back(std::move(c));
+      ++i;
+      ++j;
+    }
+  }
+  return out;
+}
+
+EntryBitmap EntryBitmap::operator|(const EntryBitmap& other) const {
+  EntryBitmap out;
+  size_t i = 0, j = 0;
+  while (i < fContainers.size() || j < other.fContainers.size()) {
+    if (j == other.fContainers.size() || (i < fContainers.size() && fContainers[i].key < other.fContainers[j].key)) {
+      out.fContainers.push_back(fContainers[i++]);
+    } else if (i == fContainers.size() || other.fContainers[j].key < fContainers[i].key) {
+      out.fContainers.push_back(other.fContainers[j++]);
+    } else {
+      out.fContainers.push_back(Combine(fContainers[i++], other.fContainers[j++], 1));
+    }
+  }
+  return out;
+}
+
+EntryBitmap EntryBitmap::AndNot(const EntryBitmap& other) const {
+  EntryBitmap out;
+  size_t j = 0;
+  for (const auto& a : fContainers) {
+    while (j < other.fContainers.size() && other.fContainers[j].key < a.key) ++j;
+    if (j == other.fContainers.size() || other.fContainers[j].key != a.key) {
+      out.fContainers.push_back(a);
+      continue;
+    }
+    Container c = Combine(a, other.fContainers[j], 2);
+    if (c.cardinality > 0) out.fContainers.push_back(std::move(c));
+  }
+  return out;
+}
+
+EntryBitmap EntryBitmap::Range(uint32_t begin, uint32_t end) {
+  EntryBitmap out;
+  for (uint32_t entry = begin; entry < end; ++entry) out.Add(entry);
+  return out;
+}
+
+std::vector<uint32_t> EntryBitmap::Entries() const {
+  std::vector<uint32_t> entries;
+  entries.reserve(Cardinality());
+  for (const auto& c : fContainers) {
+    const uint32_t high = uint32_t(c.key) << 16;
+    if (!c.IsBitmap()) {
+      for (uint16_t low : c.array) entries.push_back(high | low);
+      continue;
+    }
+    for (uint32_t w = 0; w < kWords; ++w)
+      for (uint64_t word = c.bits[w]; word; word &= word - 1) entries.push_back(high | (w * 64 + __builtin_ctzll(word)));
+  }
+  return entries;
+}
+
+void EntryBitmap::Write(std::ostream& out) const {
+  WriteValue(out, static_cast<uint32_t>(fContainers.size()));
+  for (const auto& c : fContainers) {
+    WriteValue(out, c.key);
+    WriteValue(out, c.cardinality);
+    WriteValue(out, static_cast<uint8_t>(c.IsBitmap()));
+    if (c.IsBitmap())
+      out.write(reinterpret_cast<const char*>(c.bits.data()), kWords * sizeof(uint64_t));
+    else
+      out.write(reinterpret_cast<const char*>(c.array.data()), c.array.size() * sizeof(uint16_t));
+  }
+}
+
+bool EntryBitmap::Read(std::istream& in) {
+  uint32_t n = 0;
+  if (!ReadValue(in, n)) return false;
+  fContainers.assign(n, Container());
+  for (auto& c : fContainers) {
+    uint8_t isBitmap = 0;
+    if (!ReadValue(in, c.key) || !ReadValue(in, c.cardinality) || !ReadValue(in, isBitmap)) return false;
+    if (isBitmap) {
+      c.bits.resize(kWords);
+      if (!in.read(reinterpret_cast<char*>(c.bits.data()), kWords * sizeof(uint64_t))) return false;
+    } else {
+      c.array.resize(c.cardinality);
+      if (!in.read(reinterpret_cast<char*>(c.array.data()), c.array.size() * sizeof(uint16_t))) return false;
+    }
+  }
+  return true;
+}
+
+// ---------------------------------------------------------------- BitmapIndex
+
+std::vector<BitmapIndex::Column> BitmapIndex::DefaultColumns() {
+  const std::vector<std::string> particles = {"REC_Particle_pid", "REC_Particle_pass"};
+  auto with = [&particles](std::vector<std::string> more) {
+    more.insert(more.begin(), particles.begin(), particles.end());
+    return more;
+  };
+  return {
+      {"helicity", "DISANA_Bitmap::First(REC_Event_helicity)", {"REC_Event_helicity"}},
+      {"run", "DISANA_Bitmap::First(RUN_config_run)", {"RUN_config_run"}},
+      {"topology", ClusteredSnapshot::TopologyExpression(), with({"REC_Particle_status"})},
+      {"ele_sector", SectorExpression(11, "REC_Track"), with({"REC_Track_pindex", "REC_Track_sector"})},
+      {"pro_sector", SectorExpression(2212, "REC_Track"), with({"REC_Track_pindex", "REC_Track_sector"})},
+      {"pho_sector", SectorExpression(22, "REC_Calorimeter"), with({"REC_Calorimeter_pindex", "REC_Calorimeter_sector"})},
+      {"event_pass", "DISANA_Bitmap::First(REC_Event_pass)", {"REC_Event_pass"}},
+      {"daughter_pass", "int(std::any_of(REC_DaughterParticle_pass.begin(), REC_DaughterParticle_pass.end(), [](bool p) { return p; }))", {"REC_DaughterParticle_pass"}},
+  };
+}
+
+BitmapIndex BitmapIndex::Build(const std::string& filename, const std::string& treename, const std::vector<Column>& columns) {
+  DeclareHelpers();
+  BitmapIndex index;
+  ROOT::RDataFrame rdf(treename, filename);
+  ROOT::RDF::RNode df = OutputEncoding::Decode(rdf, filename, treename);
+
+  // one event loop for every column; the Takes of one loop are aligned entry by entry
+  std::vector<std::string> names;
+  std::vector<ROOT::RDF::RResultPtr<std::vector<int>>> values;
+  for (const auto& column : columns) {
+    const bool available = std::all_of(column.inputs.begin(), column.inputs.end(), [&df](const std::string& input) { return df.HasColumn(input); });
+    if (!available) continue;
+    const std::string defined = "DISANA_bitmap_" + column.name;
+    df = df.Define(defined, "int(" + column.expression + ")");
+    names.push_back(column.name);
+    values.push_back(df.Take<int>(defined));
+  }
+  auto entries = df.Take<ULong64_t>("rdfentry_");
+  const auto& entry = *entries;
+
+  index.fFile = filename;
+  index.fTree = treename;
+  index.fEntries = entry.size();
+  std::vector<size_t> order(entry.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&entry](size_t a, size_t b) { return entry[a] < entry[b]; });
+  for (size_t c = 0; c < names.size(); ++c) {
+    const auto& v = *values[c];
+    auto& bitmaps = index.fColumns[names[c]];
+    for (size_t i : order) bitmaps[v[i]].Add(static_cast<uint32_t>(entry[i]));
+  }
+  return index;
+}
+
+bool BitmapIndex::Write(const std::string& indexFile) const {
+  const std::string tmp = indexFile + ".tmp";
+  std::ofstream out(tmp, std::ios::binary);
+  if (!out) {
+    std::cerr << "[BitmapIndex] Cannot write " << indexFile << std::endl;
+    return false;
+  }
+  out.write(kMagic, sizeof(kMagic));
+  WriteValue(out, static_cast<uint32_t>(kFormatVersion));
+  WriteString(out, fFile);
+  WriteString(out, fTree);
+  WriteValue(out, fEntries);
+  WriteValue(out, static_cast<uint32_t>(fColumns.size()));
+  size_t bytes = 0;
+  for (const auto& [name, bitmaps] : fColumns) {
+    WriteString(out, name);
+    WriteValue(out, static_cast<uint32_t>(bitmaps.size()));
+    for (const auto& [value, bitmap] : bitmaps) {
+      WriteValue(out, static_cast<int32_t>(value));
+      bitmap.Write(out);
+      bytes += bitmap.SizeInBytes();
+    }
+  }
+  out.close();
+  if (!out || std::rename(tmp.c_str(), indexFile.c_str()) != 0) {
+    std::cerr << "[BitmapIndex] Could not write " << indexFile << std::endl;
+    std::remove(tmp.c_str());
+    return false;
+  }
+  std::cout << "[BitmapIndex] " << fColumns.size() << " columns of " << fEntries << " entries, " << bytes / 1024.0 << " kB -> " << indexFile << std::endl;
+  return true;
+}
+
+BitmapIndex BitmapIndex::Read(const std::string& indexFile) {
+  BitmapIndex index;
+  std::ifstream in(indexFile, std::ios::binary);
+  char magic[sizeof(kMagic)] = {};
+  uint32_t version = 0, nColumns = 0;
+  if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 || !ReadValue(in, version) || version != kFormatVersion) {
+    std::cerr << "[BitmapIndex] " << indexFile << " is not a bitmap index of version " << kFormatVersion << std::endl;
+    return index;
+  }
+  bool ok = ReadString(in, index.fFile) && ReadString(in, index.fTree) && ReadValue(in, index.fEntries) && ReadValue(in, nColumns);
+  for (uint32_t c = 0; ok && c < nColumns; ++c) {
+    std::string name;
+    uint32_t nValues = 0;
+    ok = ReadString(in, name) && ReadValue(in, nValues);
+    auto& bitmaps = index.fColumns[name];
+    for (uint32_t v = 0; ok && v < nValues; ++v) {
+      int32_t value = 0;
+      ok = ReadValue(in, value) && bitmaps[value].Read(in);
+    }
+  }
+  if (!ok) {
+    std::cerr << "[BitmapIndex] " << indexFile << " is truncated." << std::endl;
+    return BitmapIndex();
+  }
+  return index;
+}
+
+const std::map<int, EntryBitmap>* BitmapIndex::Find(const std::string& column) const {
+  auto it = fColumns.find(column);
+  if (it != fColumns.end()) return &it->second;
+  std::cerr << "[BitmapIndex] No index for column " << column << std::endl;
+  return nullptr;
+}
+
+EntryBitmap BitmapIndex::Equal(const std::string& column, int value) const {
+  const auto* bitmaps = Find(column);
+  if (!bitmaps) return EntryBitmap();
+  auto it = bitmaps->find(value);
+  return it == bitmaps->end() ? EntryBitmap() : it->second;
+}
+
+EntryBitmap BitmapIndex::In(const std::string& column, const std::vector<int>& values) const {
+  EntryBitmap out;
+  for (int value : values) out = out | Equal(column, value);
+  return out;
+}
+
+EntryBitmap BitmapIndex::Range(const std::string& column, int min, int max) const {
+  EntryBitmap out;
+  const auto* bitmaps = Find(column);
+  if (!bitmaps) return out;
+  for (auto it = bitmaps->lower_bound(min); it != bitmaps->end() && it->first <= max; ++it) out = out | it->second;
+  return out;
+}
+
+std::vector<int> BitmapIndex::Values(const std::string& column) const {
+  std::vector<int> values;
+  if (const auto* bitmaps = Find(column))
+    for (const auto& entry : *bitmaps) values.push_back(entry.first);
+  return values;
+}
+
+ROOT::RDF::RNode BitmapIndex::Open(const EntryBitmap& selection) {
+  fChain = std::make_unique<TChain>(fTree.c_str());
+  fChain->Add(fFile.c_str());
+  fChain->LoadTree(0);
+  fList = std::make_unique<TEntryList>("bitmap", "entries of the bitmap selection");
+  fList->SetTree(fChain->GetTree());
+  for (uint32_t entry : selection.Entries()) fList->Enter(entry);
+  fChain->SetEntryList(fList.get());
+  std::cout << "[BitmapIndex] " << fTree << ": reading " << selection.Cardinality() << " of " << fEntries << " entries" << std::endl;
+  return OutputEncoding::Decode(ROOT::RDataFrame(*fChain), fFile, fTree);
+}
+
+void BitmapIndex::Print() const {
+  std::cout << "[BitmapIndex] " << fFile << " (" << fTree << ", " << fEntries << " entries)" << std::endl;
+  for (const auto& [name, bitmaps] : fColumns) {
+    size_t bytes = 0;
+    for (const auto& entry : bitmaps) bytes += entry.second.SizeInBytes();
+    std::cout << "  " << name << ": " << bitmaps.size() << " values, " << bytes / 1024.0 << " kB" << std::endl;
+  }
+}
@@ -0,0 +1,113 @@
+#ifndef BITMAPINDEX_H
+#define BITMAPINDEX_H
+
+#include <Rtypes.h>
+#include <TChain.h>
+#include <TEntryList.h>
+
+#include <ROOT/RDF/RInterface.hxx>
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Compressed set of tree entries, roaring layout: the entry space is cut into chunks of 2^16
+// entries; a chunk holding at most 4096 entries is a sorted array of 16-bit offsets, a fuller one
+// a 1024-word bitmap. AND/OR/AND-NOT work container by container.
+class EntryBitmap {
+ public:
+  void Add(uint32_t entry);
+  bool Contains(uint32_t entry) const;
+  uint64_t Cardinality() const;
+  size_t SizeInBytes() const;
+
+  EntryBitmap operator&(const EntryBitmap& other) const;
+  EntryBitmap operator|(const EntryBitmap& other) const;
+  EntryBitmap AndNot(const EntryBitmap& other) const;
+  static EntryBitmap Range(uint32_t begin, uint32_t end);  // [begin, end)
+
+  std::vector<uint32_t> Entries() const;  // increasing
+
+  void Write(std::ostream& out) const;
+  bool Read(std::istream& in);
+
+ private:
+  static constexpr uint32_t kArrayMax = 4096;
+  static constexpr uint32_t kWords = 1024;
+
+  struct Container {
+    uint16_t key = 0;  // entry >> 16
+    uint32_t cardinality = 0;
+    std::vector<uint16_t> array;  // sorted, while cardinality <= kArrayMax
+    std::vector<uint64_t> bits;   // kWords words otherwise
+
+    bool IsBitmap() const { return !bits.empty(); }
+    void Add(uint16_t low);
+    bool Contains(uint16_t low) const;
+    void ToBitmap();
+    void Normalize();  // back to an array when it got sparse
+  };
+  static Container Combine(const Container& a, const Container& b, int op);  // 0 and, 1 or, 2 and-not
+
+  std::vector<Container> fContainers;  // sorted by key
+};
+
+// Bitmap indexes of the categorical columns of a snapshot: for every column and value, the
+// EntryBitmap of the entries with that value. Built from the written file right after the
+// snapshot (so the entries are those of the file, whatever the thread scheduling) and stored next
+// to it as <file>.bmi. Plot selections that are conjunctions of categories become bitmap
+// AND/ORs, and Open() reads only the matching entries:
+//
+//   mgr.SetBitmapIndex(true);   // every snapshot gets <file>.bmi with the DefaultColumns()
+//
+//   auto index = BitmapIndex::Read("dfSelected.root.bmi");
+//   auto sel = index.Equal("helicity", 1) & index.In("topology", {2, 12}) & index.Range("run", 5032, 5419);
+//   auto df = index.Open(sel);   // TEntryList over the matching entries only
+//
+// A column is an integer JIT expression over the columns of the file; columns whose inputs are
+// missing are skipped.
+class BitmapIndex {
+ public:
+  struct Column {
+    std::string name;
+    std::string expression;
+    std::vector<std::string> inputs;  // columns the expression reads
+  };
+  static constexpr int kFormatVersion = 1;
+
+  // helicity, run, topology (10 * photon region + proton region), ele/pro/pho_sector,
+  // event_pass (REC_Event_pass), daughter_pass (any REC_DaughterParticle_pass)
+  static std::vector<Column> DefaultColumns();
+
+  static BitmapIndex Build(const std::string& filename, const std::string& treename, const std::vector<Column>& columns = DefaultColumns());
+  bool Write(const std::string& indexFile) const;
+  static BitmapIndex Read(const std::string& indexFile);
+
+  EntryBitmap All() const { return EntryBitmap::Range(0, static_cast<uint32_t>(fEntries)); }
+  EntryBitmap Equal(const std::string& column, int value) const;
+  EntryBitmap In(const std::string& column, const std::vector<int>& values) const;
+  EntryBitmap Range(const std::string& column, int min, int max) const;  // inclusive
+  EntryBitmap Not(const EntryBitmap& selection) const { return All().AndNot(selection); }
+
+  // RDataFrame over the selected entries of the indexed file; the index owns the chain and the
+  // entry list and must outlive the returned node
+  ROOT::RDF::RNode Open(const EntryBitmap& selection);
+
+  bool IsValid() const { return !fFile.empty(); }
+  std::vector<int> Values(const std::string& column) const;
+  void Print() const;
+
+ private:
+  const std::map<int, EntryBitmap>* Find(const std::string& column) const;
+
+  std::string fFile;
+  std::string fTree;
+  uint64_t fEntries = 0;
+  std::map<std::string, std::map<int, EntryBitmap>> fColumns;
+  std::unique_ptr<TChain> fChain;
+  std::unique_ptr<TEntryList> fList;
+};
+
+#endif  // BITMAPINDEX_H
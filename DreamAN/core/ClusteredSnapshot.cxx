@@ -0,0 +1,355 @@
+#include "ClusteredSnapshot.h"
+
+#include <TBranch.h>
+#include <TFile.h>
+#include <TLeaf.h>
+#include <TROOT.h>
+#include <TStopwatch.h>
+#include <TTree.h>
+
+#include <ROOT/RDataFrame.hxx>
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#include "../DrawHist/DISANAMath.h"
+#include "OrderedSnapshot.h"
+#include "OutputEncoding.h"
+
+namespace {
+constexpr const char* kCellColumn = "DISANA_cell";
+
+// Numeric value of a scalar branch, whatever its type
+TLeaf* ScalarLeaf(TTree* tree, const std::string& name) {
+  TBranch* branch = tree->GetBranch(name.c_str());
+  if (!branch) return nullptr;
+  TLeaf* leaf = branch->GetLeaf(name.c_str());
+  return leaf ? leaf : static_cast<TLeaf*>(branch->GetListOfLeaves()->At(0));
+}
+
+std::string Number(double value) {
+  std::ostringstream os;
+  os.precision(17);
+  os << value;
+  return os.str();
+}
+}  // namespace
+
+ClusteredSnapshot ClusteredSnapshot::DVCS(double beamEnergy) { return DVCS(beamEnergy, BinManager()); }
+
+ClusteredSnapshot ClusteredSnapshot::DVCS(double beamEnergy, const BinManager& bins) {
+  ClusteredSnapshot clustered;
+  clustered.AddKey({"key_xB", KinematicExpression("xB", beamEnergy), bins.GetXBBins()});
+  clustered.AddKey({"key_Q2", KinematicExpression("Q2", beamEnergy), bins.GetQ2Bins()});
+  clustered.AddKey({"key_t", KinematicExpression("t", beamEnergy), bins.GetTBins()});
+  clustered.AddKey({"key_W", KinematicExpression("W", beamEnergy), {}});
+  clustered.AddKey({"key_topology", TopologyExpression(), {}});
+  return clustered;
+}
+
+ClusteredSnapshot ClusteredSnapshot::Phi(double beamEnergy) { return Phi(beamEnergy, BinManager()); }
+
+ClusteredSnapshot ClusteredSnapshot::Phi(double beamEnergy, const BinManager& bins) {
+  ClusteredSnapshot clustered;
+  clustered.AddKey({"key_xB", KinematicExpression("xB", beamEnergy), bins.GetXBBins()});
+  clustered.AddKey({"key_Q2", KinematicExpression("Q2", beamEnergy), bins.GetQ2Bins()});
+  clustered.AddKey({"key_t", KinematicExpression("t", beamEnergy), bins.GetTBins()});
+  clustered.AddKey({"key_W", KinematicExpression("W", beamEnergy), {}});
+  clustered.AddKey({"key_MKK", KinematicExpression("MKK", beamEnergy), {}});
+  return clustered;
+}
+
+std::string ClusteredSnapshot::Fingerprint() const {
+  std::ostringstream os;
+  for (const auto& key : fKeys) {
+    os << "clustered " << key.name << " " << key.expression;
+    for (double edge : key.edges) os << " " << Number(edge);
+    os << "\n";
+  }
+  os << "clustered zone " << fMaxZoneEntries << "\n";
+  return os.str();
+}
+
+// JIT so it reads std::vector (HIPO) and RVec (ROOT input) columns alike
+std::string ClusteredSnapshot::KinematicExpression(const std::string& variable, double beamEnergy) {
+  std::string result;
+  if (variable == "Q2")
+    result = "return float(Q2);";
+  else if (variable == "xB")
+    result = "return nu > 0 ? float(Q2 / (2 * M * nu)) : -999.f;";
+  else if (variable == "W")
+    result = "return float(std::sqrt(std::max(0.0, M * M + 2 * M * nu - Q2)));";
+  else if (variable == "t")
+    result =
+        "if (ip < 0) return -999.f; const double p2 = REC_Particle_px[ip] * REC_Particle_px[ip] + REC_Particle_py[ip] * REC_Particle_py[ip] + "
+        "REC_Particle_pz[ip] * REC_Particle_pz[ip]; return float(2 * M * (std::sqrt(p2 + M * M) - M));";
+  else if (variable == "MKK")
+    result =
+        "if (ikp < 0 || ikm < 0) return -999.f; const double mK = 0.493677; const double ax = REC_Particle_px[ikp], ay = REC_Particle_py[ikp], az = REC_Particle_pz[ikp]; "
+        "const double bx = REC_Particle_px[ikm], by = REC_Particle_py[ikm], bz = REC_Particle_pz[ikm]; "
+        "const double e = std::sqrt(ax * ax + ay * ay + az * az + mK * mK) + std::sqrt(bx * bx + by * by + bz * bz + mK * mK); "
+        "return float(std::sqrt(std::max(0.0, e * e - (ax + bx) * (ax + bx) - (ay + by) * (ay + by) - (az + bz) * (az + bz))));";
+  else
+    throw std::invalid_argument("ClusteredSnapshot: unknown kinematic variable " + variable);
+
+  return "[&] { int ie = -1, ip = -1, ikp = -1, ikm = -1; for (size_t i = 0; i < REC_Particle_pid.size(); ++i) { if (!REC_Particle_pass[i]) continue; "
+         "const int pid = REC_Particle_pid[i]; if (pid == 11 && ie < 0) ie = i; else if (pid == 2212 && ip < 0) ip = i; else if (pid == 321 && ikp < 0) ikp = i; "
+         "else if (pid == -321 && ikm < 0) ikm = i; } if (ie < 0) return -999.f; const double E = " +
+         Number(beamEnergy) +
+         ", M = 0.938272; const double ex = REC_Particle_px[ie], ey = REC_Particle_py[ie], ez = REC_Particle_pz[ie]; "
+         "const double ep = std::sqrt(ex * ex + ey * ey + ez * ez); const double nu = E - ep, Q2 = 2 * E * (ep - ez); " +
+         result + " }()";
+}
+
+std::string ClusteredSnapshot::TopologyExpression() {
+  // 10 * photon region + proton region, regions as PartitionedSnapshot: 0 FT, 1 FD, 2 CD, -1 none
+  return "[&] { auto region = [&](int pid) { for (size_t i = 0; i < REC_Particle_pid.size(); ++i) if (REC_Particle_pid[i] == pid && REC_Particle_pass[i]) { "
+         "const int s = std::abs(REC_Particle_status[i]); return s >= 1000 && s < 2000 ? 0 : s >= 2000 && s < 3000 ? 1 : s >= 4000 && s < 5000 ? 2 : -1; } return -1; }; "
+         "return 10 * region(22) + region(2212); }()";
+}
+
+ROOT::RDF::RNode ClusteredSnapshot::DefineColumns(ROOT::RDF::RNode df) const {
+  if (df.HasColumn(kCellColumn)) return df;
+  if (OutputEncoding::IsEncoded(df))
+    throw std::invalid_argument("ClusteredSnapshot: the key columns read the raw REC_Particle bank, define them (DefineColumns) before OutputEncoding::Encode");
+  std::string cell = "0";
+  for (const auto& key : fKeys) {
+    if (!df.HasColumn(key.name)) {
+      if (key.expression.empty()) {
+        std::cerr << "[ClusteredSnapshot] Key column " << key.name << " missing, not used." << std::endl;
+        continue;
+      }
+      df = df.Define(key.name, key.expression);
+    }
+    if (key.edges.empty()) continue;
+    // bin = number of edges at or below the value: 0 underflow, edges.size() overflow
+    std::string bin;
+    for (double edge : key.edges) bin += (bin.empty() ? "" : " + ") + std::string("int(") + key.name + " >= " + Number(edge) + ")";
+    cell = "(" + cell + ") * " + std::to_string(key.edges.size() + 1) + " + " + bin;
+  }
+  return df.Define(kCellColumn, "int(" + cell + ")");
+}
+
+void ClusteredSnapshot::Write(ROOT::RDF::RNode df, const std::string& treename, const std::string& filename, const std::vector<std::string>& columns, bool ordered) const {
+  ROOT::RDF::RNode node = DefineColumns(df);
+  auto outputColumns = columns;
+  size_t nCells = 1;
+  for (const auto& key : fKeys) {
+    if (!node.HasColumn(key.name)) continue;
+    if (std::find(outputColumns.begin(), outputColumns.end(), key.name) == outputColumns.end()) outputColumns.push_back(key.name);
+    if (!key.edges.empty()) nCells *= key.edges.size() + 1;
+  }
+
+  // one snapshot in loop order, with the cell (and the input entry) of every entry
+  const bool tagged = ordered && ROOT::IsImplicitMTEnabled();
+  auto unsortedColumns = outputColumns;
+  unsortedColumns.push_back(kCellColumn);
+  if (tagged) {
+    node = node.Define(OrderedSnapshot::kTagColumn, [](ULong64_t entry) { return entry; }, {"rdfentry_"});
+    unsortedColumns.push_back(OrderedSnapshot::kTagColumn);
+  }
+  TStopwatch timer;
+  const std::string unsorted = filename + ".unsorted.root";
+  node.Snapshot(treename, unsorted, unsortedColumns);
+  const double tSnapshot = timer.RealTime();
+
+  timer.Start();
+  size_t nZones = 0;
+  Long64_t nEntries = 0;
+  try {
+    nZones = CopyByCell(unsorted, treename, filename, tagged, nEntries);
+  } catch (...) {
+    std::remove(unsorted.c_str());
+    throw;
+  }
+  std::remove(unsorted.c_str());
+  const double tCopy = timer.RealTime();
+
+  std::cout << "[ClusteredSnapshot] " << treename << ": " << nEntries << " entries in " << nCells << " cells, " << nZones << " zones; snapshot " << tSnapshot
+            << " s, copy by cell " << tCopy << " s" << std::endl;
+}
+
+size_t ClusteredSnapshot::CopyByCell(const std::string& unsorted, const std::string& treename, const std::string& filename, bool tagged, Long64_t& nEntries) const {
+  std::unique_ptr<TFile> in(TFile::Open(unsorted.c_str(), "READ"));
+  auto* tree = in && !in->IsZombie() ? in->Get<TTree>(treename.c_str()) : nullptr;
+  if (!tree) throw std::runtime_error("ClusteredSnapshot: no snapshot of " + treename + " in " + unsorted);
+  nEntries = tree->GetEntries();
+
+  // the order of the output: by cell, then by input entry (tagged) or loop order; only the
+  // cell and tag branches are read for it
+  struct Position {
+    Int_t cell;
+    ULong64_t input;
+    Long64_t entry;
+  };
+  std::vector<Position> order(nEntries);
+  {
+    TLeaf* cellLeaf = ScalarLeaf(tree, kCellColumn);
+    TLeaf* tagLeaf = tagged ? ScalarLeaf(tree, OrderedSnapshot::kTagColumn) : nullptr;
+    if (!cellLeaf || (tagged && !tagLeaf)) throw std::runtime_error("ClusteredSnapshot: " + unsorted + " has no cell column");
+    for (Long64_t i = 0; i < nEntries; ++i) {
+      cellLeaf->GetBranch()->GetEntry(i);
+      if (tagLeaf) tagLeaf->GetBranch()->GetEntry(i);
+      order[i] = {static_cast<Int_t>(cellLeaf->GetValue()), tagLeaf ? static_cast<ULong64_t>(tagLeaf->GetValue()) : static_cast<ULong64_t>(i), i};
+    }
+    std::sort(order.begin(), order.end(), [](const Position& a, const Position& b) { return a.cell != b.cell ? a.cell < b.cell : a.input < b.input; });
+  }
+
+  tree->SetBranchStatus(kCellColumn, false);  // the cell is the position in the output, the tag the order within it
+  if (tagged) tree->SetBranchStatus(OrderedSnapshot::kTagColumn, false);
+  std::unique_ptr<TFile> out(TFile::Open(filename.c_str(), "RECREATE"));
+  if (!out || out->IsZombie()) throw std::runtime_error("ClusteredSnapshot: cannot create " + filename);
+  out->SetCompressionSettings(in->GetCompressionSettings());
+  out->cd();
+  TTree* clustered = tree->CloneTree(0);
+
+  std::vector<std::string> keys;
+  std::vector<TLeaf*> leaves;
+  for (const auto& key : fKeys)
+    if (TLeaf* leaf = ScalarLeaf(tree, key.name)) {
+      keys.push_back(key.name);
+      leaves.push_back(leaf);
+    }
+  Long64_t first = 0, entries = 0, bytes = 0;
+  Int_t cell = 0;
+  std::vector<double> minimum(keys.size(), std::numeric_limits<double>::max()), maximum(keys.size(), std::numeric_limits<double>::lowest());
+  auto* zoneMap = new TTree(ZoneMapName(treename).c_str(), "per zone entry range, compressed bytes and key column min/max");
+  zoneMap->Branch("first", &first);
+  zoneMap->Branch("entries", &entries);
+  zoneMap->Branch("bytes", &bytes);
+  zoneMap->Branch("cell", &cell);
+  for (size_t k = 0; k < keys.size(); ++k) {
+    zoneMap->Branch(("min_" + keys[k]).c_str(), &minimum[k]);
+    zoneMap->Branch(("max_" + keys[k]).c_str(), &maximum[k]);
+  }
+
+  Long64_t written = 0, zipBytes = 0;
+  size_t nZones = 0;
+  auto closeZone = [&] {
+    if (entries == 0) return;
+    clustered->FlushBaskets();  // the next zone starts in new baskets
+    bytes = clustered->GetZipBytes() - zipBytes;
+    zipBytes += bytes;
+    zoneMap->Fill();
+    ++nZones;
+    first = written;
+    entries = 0;
+    std::fill(minimum.begin(), minimum.end(), std::numeric_limits<double>::max());
+    std::fill(maximum.begin(), maximum.end(), std::numeric_limits<double>::lowest());
+  };
+
+  // the entries of a cell are spread over the snapshot: each of its baskets is read once per
+  // cell it holds entries of, so the copy costs grow with the number of cells
+  for (const auto& position : order) {
+    if (position.cell != cell || entries == fMaxZoneEntries) closeZone();  // zones never span two cells
+    cell = position.cell;
+    tree->GetEntry(position.entry);
+    clustered->Fill();
+    for (size_t k = 0; k < leaves.size(); ++k) {
+      const double v = leaves[k]->GetValue();
+      minimum[k] = std::min(minimum[k], v);
+      maximum[k] = std::max(maximum[k], v);
+    }
+    ++entries;
+    ++written;
+  }
+  closeZone();
+
+  out->cd();
+  clustered->Write();
+  zoneMap->Write();
+  out->Close();
+  return nZones;
+}
+
+ZoneMapReader::ZoneMapReader(const std::string& filename, const std::string& treename) : fFile(filename), fTree(treename) {
+  std::unique_ptr<TFile> file(TFile::Open(filename.c_str(), "READ"));
+  if (!file || file->IsZombie()) {
+    std::cerr << "[ZoneMapReader] Cannot open " << filename << std::endl;
+    return;
+  }
+  auto* map = file->Get<TTree>(ClusteredSnapshot::ZoneMapName(treename).c_str());
+  if (!map) {
+    std::cerr << "[ZoneMapReader] " << filename << " has no " << ClusteredSnapshot::ZoneMapName(treename) << ", nothing can be skipped." << std::endl;
+    return;
+  }
+  for (auto* object : *map->GetListOfBranches()) {
+    const std::string name = object->GetName();
+    if (name.rfind("min_", 0) == 0) fKeys.push_back(name.substr(4));
+  }
+  Zone zone;
+  zone.min.resize(fKeys.size());
+  zone.max.resize(fKeys.size());
+  map->SetBranchAddress("first", &zone.first);
+  map->SetBranchAddress("entries", &zone.entries);
+  map->SetBranchAddress("bytes", &zone.bytes);
+  for (size_t k = 0; k < fKeys.size(); ++k) {
+    map->SetBranchAddress(("min_" + fKeys[k]).c_str(), &zone.min[k]);
+    map->SetBranchAddress(("max_" + fKeys[k]).c_str(), &zone.max[k]);
+  }
+  for (Long64_t i = 0; i < map->GetEntries(); ++i) {
+    map->GetEntry(i);
+    fZones.push_back(zone);
+  }
+}
+
+bool ZoneMapReader::MayContain(const Zone& zone, const std::vector<Range>& ranges) const {
+  for (const auto& range : ranges) {
+    auto it = std::find(fKeys.begin(), fKeys.end(), range.column);
+    if (it == fKeys.end()) continue;
+    const size_t k = it - fKeys.begin();
+    if (zone.max[k] < range.min || zone.min[k] > range.max) return false;
+  }
+  return true;
+}
+
+std::vector<std::pair<Long64_t, Long64_t>> ZoneMapReader::Select(const std::vector<Range>& ranges) const {
+  std::vector<std::pair<Long64_t, Long64_t>> selected;
+  for (const auto& zone : fZones) {
+    if (!MayContain(zone, ranges)) continue;
+    if (!selected.empty() && selected.back().second == zone.first)
+      selected.back().second += zone.entries;
+    else
+      selected.emplace_back(zone.first, zone.first + zone.entries);
+  }
+  return selected;
+}
+
+ROOT::RDF::RNode ZoneMapReader::Open(const std::vector<Range>& ranges) {
+  fChain = std::make_unique<TChain>(fTree.c_str());
+  fChain->Add(fFile.c_str());
+
+  std::string selection;
+  for (const auto& range : ranges) {
+    if (!selection.empty()) selection += " && ";
+    selection += range.column + " >= " + Number(range.min) + " && " + range.column + " <= " + Number(range.max);
+  }
+
+  if (fZones.empty()) {
+    ROOT::RDF::RNode df = OutputEncoding::Decode(ROOT::RDataFrame(*fChain), fFile, fTree);
+    return selection.empty() ? df : df.Filter(selection, "zone map ranges");
+  }
+
+  fList = std::make_unique<TEntryList>("zones", "entries of the selected zones");
+  Long64_t kept = 0, keptBytes = 0, allEntries = 0, allBytes = 0;
+  for (const auto& zone : fZones) {
+    allEntries += zone.entries;
+    allBytes += zone.bytes;
+    if (!MayContain(zone, ranges)) continue;
+    kept += zone.entries;
+    keptBytes += zone.bytes;
+  }
+  fChain->LoadTree(0);
+  fList->SetTree(fChain->GetTree());
+  for (const auto& [begin, end] : Select(ranges))
+    for (Long64_t i = begin; i < end; ++i) fList->Enter(i);
+  fChain->SetEntryList(fList.get());
+  std::cout << "[ZoneMapReader] " << fTree << ": reading " << kept << " of " << allEntries << " entries, " << keptBytes / (1024.0 * 1024.0) << " of "
+            << allBytes / (1024.0 * 1024.0) << " MB" << std::endl;
+
+  ROOT::RDF::RNode df = OutputEncoding::Decode(ROOT::RDataFrame(*fChain), fFile, fTree);
+  return selection.empty() ? df : df.Filter(selection, "zone map ranges");
+}
@@ -0,0 +1,120 @@
+#ifndef CLUSTEREDSNAPSHOT_H
+#define CLUSTEREDSNAPSHOT_H
+
+#include <TChain.h>
+#include <TEntryList.h>
+
+#include <ROOT/RDF/RInterface.hxx>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+class BinManager;
+
+// Snapshots sorted by kinematic cell, with a zone map for range-skipping reads.
+//
+// Every entry gets a cell from the bins of the binned key columns (xB, Q2, t by default). One event
+// loop writes a single temporary snapshot with the cell of every entry; the cell column alone is
+// read back to order the entries, and the tree is copied cell by cell into the output. That copy
+// reads each basket of the temporary snapshot once per cell it holds entries of, so keep the
+// binning coarse (the BinManager default is 5 x 5 x 5 cells). The baskets are flushed at every
+// zone boundary: a zone is the entries of one cell, split after SetMaxZoneEntries() entries. Next to the tree, <tree>_zonemap holds per zone the entry range,
+// the compressed bytes and the min/max of every key column, the binned ones and the zone-map-only
+// ones (W, M_KK, topology).
+// The key columns are defined from the REC_Particle bank (first passing e, p, K+, K-; key_topology
+// = 10 * pho_det_region + pro_det_region) and written with the tree, under a key_ prefix so they
+// do not collide with the columns the plotting macros define.
+//
+//   mgr.SetClusteredOutput(std::make_shared<ClusteredSnapshot>(ClusteredSnapshot::DVCS(10.6)));
+//
+//   ZoneMapReader reader("dfSelected_afterFid.root", "dfSelected_afterFid");
+//   auto df = reader.Open({{"key_xB", 0.1, 0.2}, {"key_Q2", 1.0, 2.0}});  // only the zones of the window
+//
+// Open() reads the selected zones through a TEntryList, so the skipped zones are never read, and
+// filters exactly on the key columns of the ranges. A range on a variable the macros recompute
+// differently (another photon, corrected momenta) should be widened by its resolution.
+class ClusteredSnapshot {
+ public:
+  struct Key {
+    std::string name;
+    std::string expression;     // defines the column when df does not have it; empty = must exist
+    std::vector<double> edges;  // cell bins (plus under/overflow); empty = zone map only
+  };
+
+  void AddKey(const Key& key) { fKeys.push_back(key); }
+  void SetMaxZoneEntries(Long64_t n) { fMaxZoneEntries = n > 0 ? n : 1; }
+  const std::vector<Key>& GetKeys() const { return fKeys; }
+  std::string Fingerprint() const;  // part of the stage cache configuration
+
+  // Keys: xB, Q2, t binned with the edges of bins (default BinManager), W and key_topology as zone map only
+  static ClusteredSnapshot DVCS(double beamEnergy);
+  static ClusteredSnapshot DVCS(double beamEnergy, const BinManager& bins);
+  // Keys: xB, Q2, t binned as DVCS, W and M_KK zone map only
+  static ClusteredSnapshot Phi(double beamEnergy);
+  static ClusteredSnapshot Phi(double beamEnergy, const BinManager& bins);
+  // JIT expression of Q2, xB, t (|t|), W or MKK from the first passing e, p, K+, K- (-999 when absent)
+  static std::string KinematicExpression(const std::string& variable, double beamEnergy);
+  static std::string TopologyExpression();
+
+  // df with the key columns and the cell of every entry. The key expressions read the raw
+  // REC_Particle pid/pass/status, so with an OutputEncoding they are defined on the node before
+  // Encode (AnalysisTask::SafeSnapshot does); an encoded node without them is rejected.
+  ROOT::RDF::RNode DefineColumns(ROOT::RDF::RNode df) const;
+
+  // Snapshot of df into filename, grouped by cell, with the zone map; the key columns are defined
+  // here when df does not have them yet. With ordered under ImplicitMT the rdfentry_ order within a
+  // cell is restored (as OrderedSnapshot).
+  void Write(ROOT::RDF::RNode df, const std::string& treename, const std::string& filename, const std::vector<std::string>& columns, bool ordered = false) const;
+
+  static std::string ZoneMapName(const std::string& treename) { return treename + "_zonemap"; }
+
+ private:
+  // Copies the unsorted snapshot into filename in cell order, one zone-map row per zone; returns
+  // the number of zones
+  size_t CopyByCell(const std::string& unsorted, const std::string& treename, const std::string& filename, bool tagged, Long64_t& nEntries) const;
+
+  std::vector<Key> fKeys;
+  Long64_t fMaxZoneEntries = 20000;
+};
+
+class ZoneMapReader {
+ public:
+  struct Range {
+    std::string column;
+    double min;
+    double max;
+  };
+  struct Zone {
+    Long64_t first;
+    Long64_t entries;
+    Long64_t bytes;
+    std::vector<double> min, max;  // per key column
+  };
+
+  ZoneMapReader(const std::string& filename, const std::string& treename);
+  bool IsValid() const { return !fZones.empty(); }
+
+  // [first, end) entry ranges of the zones that can hold entries inside every range (adjacent
+  // zones merged). Ranges on columns without a zone map prune nothing.
+  std::vector<std::pair<Long64_t, Long64_t>> Select(const std::vector<Range>& ranges) const;
+
+  // RDataFrame over the selected zones only, filtered exactly on the ranges. The reader owns the
+  // chain and the entry list and must outlive the returned node.
+  ROOT::RDF::RNode Open(const std::vector<Range>& ranges);
+
+  const std::vector<std::string>& GetKeys() const { return fKeys; }
+  const std::vector<Zone>& GetZones() const { return fZones; }
+
+ private:
+  bool MayContain(const Zone& zone, const std::vector<Range>& ranges) const;
+
+  std::string fFile;
+  std::string fTree;
+  std::vector<std::string> fKeys;
+  std::vector<Zone> fZones;
+  std::unique_ptr<TChain> fChain;
+  std::unique_ptr<TEntryList> fList;
+};
+
+#endif  // CLUSTEREDSNAPSHOT_H
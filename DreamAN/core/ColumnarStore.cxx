@@ -0,0 +1,246 @@
+#include "ColumnarStore.h"
+
+#include <TROOT.h>
+#include <TStopwatch.h>
+
+#include <ROOT/RDataFrame.hxx>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "RHipoDS.hxx"
+#include "StageCache.h"
+#include "reader.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr const char* kSourceFile = "source.txt";
+
+// "REC::*" matches every REC bank, anything else one bank
+bool Matches(const std::string& pattern, const std::string& bank) {
+  if (!pattern.empty() && pattern.back() == '*') return bank.compare(0, pattern.size() - 1, pattern, 0, pattern.size() - 1) == 0;
+  return pattern == bank;
+}
+
+// REC::Particle -> REC_Particle, the prefix of its RHipoDS columns
+std::string TreeName(const std::string& bank) {
+  std::string name = bank;
+  for (size_t pos; (pos = name.find("::")) != std::string::npos;) name.replace(pos, 2, "_");
+  return name;
+}
+
+Long64_t ModificationTime(const std::string& path) {
+  std::error_code ec;
+  const auto mtime = fs::last_write_time(path, ec).time_since_epoch().count();
+  return ec ? 0 : static_cast<Long64_t>(mtime);
+}
+
+ULong64_t DirectoryBytes(const std::string& directory) {
+  ULong64_t bytes = 0;
+  std::error_code ec;
+  for (const auto& file : fs::directory_iterator(directory, ec))
+    if (file.is_regular_file(ec)) bytes += file.file_size(ec);
+  return bytes;
+}
+}  // namespace
+
+std::string ColumnarStore::DefaultDirectory(const std::string& hipoDirectory) { return (fs::path(hipoDirectory) / "columnar").string(); }
+
+std::string ColumnarStore::EntryDirectory(const std::string& hipoFile) const {
+  std::error_code ec;
+  const auto path = fs::weakly_canonical(hipoFile, ec);
+  char hash[9];
+  std::snprintf(hash, sizeof(hash), "%08llx", static_cast<unsigned long long>(StageCache::Hash((path.empty() ? fs::path(hipoFile) : path).string()) & 0xffffffffULL));
+  return (fs::path(fDirectory) / (fs::path(hipoFile).stem().string() + "-" + hash)).string();
+}
+
+ColumnarStore::Entry ColumnarStore::Find(const std::string& hipoFile) const {
+  Entry entry;
+  entry.hipo = hipoFile;
+  entry.directory = EntryDirectory(hipoFile);
+  std::ifstream in(fs::path(entry.directory) / kSourceFile);
+  if (!in) return entry;
+
+  Entry stored = entry;
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream is(line);
+    std::string key;
+    is >> key;
+    if (key == "bytes")
+      is >> stored.bytes;
+    else if (key == "mtime")
+      is >> stored.mtime;
+    else if (key == "events")
+      is >> stored.events;
+    else if (key == "banks")
+      stored.banks.assign(std::istream_iterator<std::string>(is), std::istream_iterator<std::string>());
+  }
+  std::error_code ec;
+  const ULong64_t bytes = fs::file_size(hipoFile, ec);
+  if (ec || bytes != stored.bytes || ModificationTime(hipoFile) != stored.mtime) return entry;  // changed since the conversion
+  return stored;
+}
+
+bool ColumnarStore::Covers(const std::vector<std::string>& hipoFiles) const {
+  if (hipoFiles.empty()) return false;
+  return std::all_of(hipoFiles.begin(), hipoFiles.end(), [this](const std::string& file) { return Find(file).events >= 0; });
+}
+
+bool ColumnarStore::ConvertFile(const std::string& hipoFile, const std::vector<std::string>& banks, Entry& entry) const {
+  entry.hipo = hipoFile;
+  entry.directory = EntryDirectory(hipoFile);
+  std::error_code ec;
+  entry.bytes = fs::file_size(hipoFile, ec);
+  entry.mtime = ModificationTime(hipoFile);
+
+  std::vector<std::string> selected;
+  {
+    hipo::reader reader;
+    reader.open(hipoFile.c_str());
+    hipo::dictionary dictionary;
+    reader.readDictionary(dictionary);
+    for (const auto& bank : dictionary.getSchemaList())
+      if (std::any_of(banks.begin(), banks.end(), [&bank](const std::string& pattern) { return Matches(pattern, bank); })) selected.push_back(TreeName(bank));
+  }
+  std::sort(selected.begin(), selected.end());
+  if (selected.empty()) {
+    std::cerr << "[ColumnarStore] " << hipoFile << " has none of the requested banks." << std::endl;
+    return false;
+  }
+
+  // written next to the entry and renamed when complete, so an interrupted conversion leaves no entry
+  const std::string tmp = entry.directory + ".tmp";
+  fs::remove_all(tmp, ec);
+  fs::create_directories(tmp, ec);
+  if (ec) {
+    std::cerr << "[ColumnarStore] Cannot create " << tmp << ": " << ec.message() << std::endl;
+    return false;
+  }
+
+  ROOT::RDataFrame rdf(std::make_unique<RHipoDS>(std::vector<std::string>{hipoFile}));
+  const auto columns = rdf.GetColumnNames();
+  ROOT::RDF::RSnapshotOptions options;
+  options.fLazy = true;
+  std::vector<ROOT::RDF::RResultPtr<ROOT::RDF::RInterface<ROOT::Detail::RDF::RLoopManager>>> snapshots;
+  for (const auto& tree : selected) {
+    std::vector<std::string> items;
+    for (const auto& column : columns)
+      if (column.compare(0, tree.size() + 1, tree + "_") == 0) items.push_back(column);
+    if (items.empty()) continue;
+    snapshots.push_back(rdf.Snapshot(tree, (fs::path(tmp) / (tree + ".root")).string(), items, options));
+    entry.banks.push_back(tree);
+  }
+  auto events = rdf.Count();
+  entry.events = *events;  // one pass over the HIPO file fills every bank file
+
+  {
+    std::ofstream source(fs::path(tmp) / kSourceFile);
+    source << "path " << hipoFile << "\nbytes " << entry.bytes << "\nmtime " << entry.mtime << "\nevents " << entry.events << "\nbanks";
+    for (const auto& bank : entry.banks) source << " " << bank;
+    source << "\n";
+  }
+  fs::remove_all(entry.directory, ec);
+  fs::rename(tmp, entry.directory, ec);
+  if (ec) {
+    std::cerr << "[ColumnarStore] Could not move " << tmp << " to " << entry.directory << ": " << ec.message() << std::endl;
+    fs::remove_all(tmp, ec);
+    return false;
+  }
+  return true;
+}
+
+size_t ColumnarStore::Convert(const std::vector<std::string>& hipoFiles, unsigned int threads, const std::vector<std::string>& banks) {
+  std::error_code ec;
+  fs::create_directories(fDirectory, ec);
+  if (ec) {
+    std::cerr << "[ColumnarStore] Cannot create " << fDirectory << ": " << ec.message() << std::endl;
+    return 0;
+  }
+  std::vector<std::string> todo;
+  for (const auto& file : hipoFiles)
+    if (Find(file).events < 0) todo.push_back(file);
+  const size_t present = hipoFiles.size() - todo.size();
+  if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = static_cast<unsigned int>(std::min<size_t>(threads, std::max<size_t>(todo.size(), 1)));
+  std::cout << "[ColumnarStore] " << present << " of " << hipoFiles.size() << " files up to date in " << fDirectory << ", converting " << todo.size() << " with "
+            << threads << " threads" << std::endl;
+  if (todo.empty()) return present;
+
+  // one file per worker: every worker has its own RHipoDS and event loop
+  ROOT::EnableThreadSafety();
+  std::atomic<size_t> next{0}, converted{0};
+  std::atomic<ULong64_t> inBytes{0}, outBytes{0}, events{0};
+  std::mutex print;
+  TStopwatch watch;
+  auto work = [&] {
+    for (size_t i; (i = next++) < todo.size();) {
+      TStopwatch fileWatch;
+      Entry entry;
+      const bool ok = ConvertFile(todo[i], banks, entry);
+      const double seconds = fileWatch.RealTime();
+      const ULong64_t written = ok ? DirectoryBytes(entry.directory) : 0;
+      if (ok) {
+        ++converted;
+        inBytes += entry.bytes;
+        outBytes += written;
+        events += entry.events;
+      }
+      std::lock_guard<std::mutex> lock(print);
+      if (ok)
+        std::cout << "[ColumnarStore] " << fs::path(todo[i]).filename().string() << ": " << entry.events << " events, " << entry.banks.size() << " banks, "
+                  << entry.bytes / (1024.0 * 1024.0) << " -> " << written / (1024.0 * 1024.0) << " MB in " << seconds << " s" << std::endl;
+      else
+        std::cerr << "[ColumnarStore] " << todo[i] << " not converted." << std::endl;
+    }
+  };
+  std::vector<std::thread> workers;
+  for (unsigned int t = 1; t < threads; ++t) workers.emplace_back(work);
+  work();
+  for (auto& worker : workers) worker.join();
+
+  const double seconds = std::max(watch.RealTime(), 1e-9);
+  std::cout << "[ColumnarStore] " << converted << " files, " << events << " events in " << seconds << " s: " << events / seconds << " events/s, "
+            << inBytes / (1024.0 * 1024.0) / seconds << " MB/s of HIPO, store " << outBytes / (1024.0 * 1024.0) << " MB" << std::endl;
+  return present + converted;
+}
+
+ROOT::RDF::RNode ColumnarStore::Open(const std::vector<std::string>& hipoFiles) {
+  fChains.clear();
+  fEntries = 0;
+  std::vector<Entry> entries;
+  for (const auto& file : hipoFiles) {
+    Entry entry = Find(file);
+    if (entry.events < 0) {
+      std::cerr << "[ColumnarStore] " << file << " is not converted (or changed since), skipped." << std::endl;
+      continue;
+    }
+    fEntries += entry.events;
+    entries.push_back(std::move(entry));
+  }
+  if (entries.empty()) throw std::runtime_error("[ColumnarStore] none of the input files is in " + fDirectory);
+
+  std::vector<std::string> banks = entries.front().banks;
+  for (const auto& entry : entries) {
+    std::vector<std::string> common;
+    std::set_intersection(banks.begin(), banks.end(), entry.banks.begin(), entry.banks.end(), std::back_inserter(common));
+    banks = std::move(common);
+  }
+  if (banks.empty()) throw std::runtime_error("[ColumnarStore] the entries in " + fDirectory + " have no bank in common");
+  for (const auto& bank : banks) {
+    fChains.push_back(std::make_unique<TChain>(bank.c_str()));
+    for (const auto& entry : entries) fChains.back()->Add((fs::path(entry.directory) / (bank + ".root")).string().c_str());
+    if (fChains.size() > 1) fChains.front()->AddFriend(fChains.back().get());
+  }
+  std::cout << "[ColumnarStore] " << entries.size() << " files, " << fEntries << " events, " << banks.size() << " banks from " << fDirectory << std::endl;
+  return ROOT::RDataFrame(*fChains.front());
+}
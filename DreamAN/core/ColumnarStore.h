@@ -0,0 +1,64 @@
+#ifndef COLUMNARSTORE_H
+#define COLUMNARSTORE_H
+
+#include <Rtypes.h>
+#include <TChain.h>
+
+#include <ROOT/RDF/RInterface.hxx>
+#include <memory>
+#include <string>
+#include <vector>
+
+// One-time columnar copy of raw HIPO files, so later passes do not decode HIPO again.
+//
+// Every HIPO file becomes an entry directory <store>/<stem>-<hash>/ with one ROOT file per bank
+// (REC_Particle.root, REC_Calorimeter.root, RUN_config.root, ...), one entry per event. A bank file
+// is a column family: every item is its own branch, jagged per event through the basket entry
+// offsets, so a pass reads only the banks and items it uses. The files are written by snapshotting
+// RHipoDS, so the columns have the names and types the HIPO input gives the pipeline.
+// <entry>/source.txt (path, size, mtime, events, banks) is written last and marks a complete entry;
+// a changed HIPO file is converted again.
+//
+//   ./ConvertHipo /path/to/hipo/ 1000          # into /path/to/hipo/columnar, all cores
+//   ./AnalysisDVCS /path/to/hipo/ 1000         # Events reads the store when it has every input file
+//   ./ConvertHipo --compare /path/to/hipo/ 10  # read time of the DVCS banks, HIPO vs store
+class ColumnarStore {
+ public:
+  struct Entry {
+    std::string hipo;
+    std::string directory;
+    ULong64_t bytes = 0;
+    Long64_t mtime = 0;
+    Long64_t events = -1;  // -1 while not converted
+    std::vector<std::string> banks;  // tree names, REC_Particle, ...
+  };
+
+  explicit ColumnarStore(const std::string& directory) : fDirectory(directory) {}
+  static std::string DefaultDirectory(const std::string& hipoDirectory);
+  // REC::*, MC::* and the RUN::config header
+  static std::vector<std::string> DefaultBanks() { return {"REC::*", "MC::*", "RUN::config"}; }
+
+  // Converts the files without an up-to-date entry, `threads` files at a time (0: all cores);
+  // returns the number of files in the store afterwards
+  size_t Convert(const std::vector<std::string>& hipoFiles, unsigned int threads = 0, const std::vector<std::string>& banks = DefaultBanks());
+
+  // Up-to-date entry of a HIPO file; events < 0 when there is none
+  Entry Find(const std::string& hipoFile) const;
+  bool Covers(const std::vector<std::string>& hipoFiles) const;
+
+  // RDataFrame over the entries of the files, in their order: one chain per bank, joined as friends.
+  // Only banks present in every entry are included. The store owns the chains and must outlive the node.
+  ROOT::RDF::RNode Open(const std::vector<std::string>& hipoFiles);
+  Long64_t GetEntries() const { return fEntries; }  // of the last Open
+  const std::string& GetDirectory() const { return fDirectory; }
+
+ private:
+  std::string EntryDirectory(const std::string& hipoFile) const;
+  bool ConvertFile(const std::string& hipoFile, const std::vector<std::string>& banks, Entry& entry) const;
+
+  std::string fDirectory;
+  Long64_t fEntries = 0;
+  std::vector<std::unique_ptr<TChain>> fChains;
+};
+
+#endif  // COLUMNARSTORE_H
@@ -0,0 +1,206 @@
+#include "CutComparison.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#include "AnalysisTaskManager.h"
+
+namespace {
+
+// indices where two per-particle masks disagree, a missing entry counts as 0
+template <typename T>
+std::vector<int> DiffIndices(const std::vector<T>& a, const std::vector<T>& b) {
+  std::vector<int> out;
+  const size_t n = std::max(a.size(), b.size());
+  for (size_t i = 0; i < n; ++i) {
+    const bool va = i < a.size() && a[i];
+    const bool vb = i < b.size() && b[i];
+    if (va != vb) out.push_back(static_cast<int>(i));
+  }
+  return out;
+}
+
+int LeadingIndex(const std::vector<bool>& mask) {
+  for (size_t i = 0; i < mask.size(); ++i)
+    if (mask[i]) return static_cast<int>(i);
+  return -1;
+}
+
+// fiducial indices that differ and matter: all of them when the event decision differs,
+// otherwise those whose candidate selection differs too
+template <typename T>
+std::vector<int> RelevantIndices(const std::vector<T>& maskA, const std::vector<T>& maskB, const EventCutResult& a, const EventCutResult& b) {
+  auto idx = DiffIndices(maskA, maskB);
+  if (a.eventPass != b.eventPass) return idx;
+  const auto candidates = DiffIndices(a.particlePass, b.particlePass);
+  idx.erase(std::remove_if(idx.begin(), idx.end(), [&](int i) { return std::find(candidates.begin(), candidates.end(), i) == candidates.end(); }), idx.end());
+  return idx;
+}
+
+void AppendIndices(std::ostringstream& os, const char* what, const std::vector<int>& idx) {
+  if (idx.empty()) return;
+  if (os.tellp() > 0) os << "; ";
+  os << what << " [";
+  for (size_t i = 0; i < idx.size(); ++i) os << (i ? "," : "") << idx[i];
+  os << "]";
+}
+
+}  // namespace
+
+CutComparison::CutComparison(bool IsMC) : IsMC(IsMC), fOutFile(nullptr) {}
+CutComparison::~CutComparison() {}
+
+void CutComparison::UserCreateOutputObjects() {}
+
+ROOT::RDF::RNode CutComparison::DefineConfig(ROOT::RDF::RNode df, int which, const std::string& tag) {
+  const Config& cfg = fConfig[which];
+  fTrackCutsUsed[which] = std::make_shared<TrackCut>(*cfg.trackCuts);
+  if (cfg.doFiducial) {
+    fTrackCutsUsed[which]->SetDoFiducialCut(true);
+    fTrackCutsUsed[which]->SetFiducialCutOptions(true, true);  // apply both DC and ECAL cuts
+  }
+  const auto& cuts = fTrackCutsUsed[which];
+
+  auto trajCols = CombineColumns(RECTraj::All(), std::vector<std::string>{"REC_Particle_pid"}, std::vector<std::string>{"REC_Particle_num"});
+  auto caloCols = CombineColumns(RECCalorimeter::All(), std::vector<std::string>{"REC_Particle_pid"}, std::vector<std::string>{"REC_Particle_p"}, std::vector<std::string>{"REC_Particle_num"});
+  auto fwdtagCols = CombineColumns(RECForwardTagger::All(), std::vector<std::string>{"REC_Particle_pid"}, std::vector<std::string>{"REC_Particle_num"});
+
+  const std::string traj = "REC_Traj_pass_" + tag;
+  const std::string calo = "REC_Calorimeter_pass_" + tag;
+  const std::string ft = "REC_ForwardTagger_pass_" + tag;
+  const std::string track = "REC_Track_pass_" + tag;
+
+  df = DefineOrRedefine(df, traj, cuts->RECTrajPass(), trajCols);
+  if (cfg.doFiducial) {
+    df = DefineOrRedefine(df, calo, cuts->RECCalorimeterPass(), caloCols);
+  } else {
+    df = DefineOrRedefine(df, calo, [](const int& n) { return std::vector<int>(n, 1); }, {"REC_Particle_num"});
+  }
+  if (cfg.doFiducial && fFTonConfig) {
+    df = DefineOrRedefine(df, ft, cuts->RECForwardTaggerPass(), fwdtagCols);
+  } else {
+    df = DefineOrRedefine(df, ft, [](const int& n) { return std::vector<int>(n, 1); }, {"REC_Particle_num"});
+  }
+  df = DefineOrRedefine(df, track, Columns::LogicalAND2(), {traj, calo});
+  df = DefineOrRedefine(df, track, Columns::LogicalAND2(), {track, ft});
+
+  const std::string result = "EventCutResult_" + tag;
+  // the diff needs the full result of failing events too, so never stop at the first failing cut
+  EventCut eventCuts = *cfg.eventCuts;
+  eventCuts.SetAdaptiveOrder(false);
+  df = DefineOrRedefine(df, result, eventCuts, CombineColumns(RECParticle::All(), std::vector<std::string>{track}));
+  df = DefineOrRedefine(df, "AB_eventPass_" + tag, [](const EventCutResult& r) { return r.eventPass; }, {result});
+  df = DefineOrRedefine(df, "AB_particlePass_" + tag, [](const EventCutResult& r) { return r.particlePass; }, {result});
+  return df;
+}
+
+void CutComparison::UserExec(ROOT::RDF::RNode& df) {
+  for (const auto& cfg : fConfig)
+    if (!cfg.trackCuts || !cfg.eventCuts) throw std::runtime_error("CutComparison: configuration A and B both need a TrackCut and an EventCut.");
+
+  // Shared decoding and kinematics, evaluated once for both configurations
+  auto dfDefs = df;
+  dfDefs = DefineOrRedefine(dfDefs, "REC_Particle_num", [](const std::vector<int>& pid) { return static_cast<int>(pid.size()); }, {"REC_Particle_pid"});
+  dfDefs = DefineOrRedefine(dfDefs, "REC_Particle_theta", RECParticletheta(), RECParticle::All());
+  dfDefs = DefineOrRedefine(dfDefs, "REC_Particle_phi", RECParticlephi(), RECParticle::All());
+  dfDefs = DefineOrRedefine(dfDefs, "REC_Particle_p", RECParticleP(), RECParticle::All());
+
+  dfDefs = DefineConfig(dfDefs, 0, "A");
+  dfDefs = DefineConfig(dfDefs, 1, "B");
+
+  dfDefs = DefineOrRedefine(dfDefs, "AB_changedParticles",
+                            [](const EventCutResult& a, const EventCutResult& b, const std::vector<int>& trackA, const std::vector<int>& trackB) {
+                              auto idx = DiffIndices(a.particlePass, b.particlePass);
+                              for (int i : DiffIndices(trackA, trackB))
+                                if (std::find(idx.begin(), idx.end(), i) == idx.end()) idx.push_back(i);
+                              std::sort(idx.begin(), idx.end());
+                              return idx;
+                            },
+                            {"EventCutResult_A", "EventCutResult_B", "REC_Track_pass_A", "REC_Track_pass_B"});
+
+  // per-criterion reasons; the named cuts are matched by name since A and B may define different
+  // sets, and only the cuts of both configurations are compared
+  const auto namesA = fConfig[0].eventCuts->GetCutNames();
+  const auto namesB = fConfig[1].eventCuts->GetCutNames();
+  std::vector<std::pair<size_t, size_t>> shared;  // (index in A, index in B)
+  for (size_t i = 0; i < namesA.size(); ++i) {
+    auto it = std::find(namesB.begin(), namesB.end(), namesA[i]);
+    if (it != namesB.end()) shared.emplace_back(i, static_cast<size_t>(it - namesB.begin()));
+  }
+  auto countOf = [](const EventCutResult& r, size_t i) { return i < r.cutCounts.size() ? r.cutCounts[i] : -1; };
+  auto diffMask = [shared, countOf](const EventCutResult& a, const EventCutResult& b, const std::vector<int>& trajA, const std::vector<int>& trajB,
+                                    const std::vector<int>& caloA, const std::vector<int>& caloB, const std::vector<int>& ftA, const std::vector<int>& ftB) {
+    int mask = 0;
+    if (a.eventPass != b.eventPass) mask |= kEventPass;
+    if (a.particlePass != b.particlePass) mask |= kCandidates;
+    if (LeadingIndex(a.MaxPhotonEnergyPass) != LeadingIndex(b.MaxPhotonEnergyPass)) mask |= kLeadingPhoton;
+    for (const auto& [ia, ib] : shared)
+      if (countOf(a, ia) != countOf(b, ib)) mask |= kCutCount;
+    // a fiducial difference only counts when it changes a selected particle or the event decision
+    if (!RelevantIndices(trajA, trajB, a, b).empty()) mask |= kTrajFid;
+    if (!RelevantIndices(caloA, caloB, a, b).empty()) mask |= kCaloFid;
+    if (!RelevantIndices(ftA, ftB, a, b).empty()) mask |= kFTFid;
+    return mask;
+  };
+  auto diffReason = [namesA, shared, countOf](int mask, const EventCutResult& a, const EventCutResult& b, const std::vector<int>& trajA, const std::vector<int>& trajB,
+                                              const std::vector<int>& caloA, const std::vector<int>& caloB, const std::vector<int>& ftA, const std::vector<int>& ftB) {
+    std::ostringstream os;
+    if (mask == 0) return os.str();
+    if (mask & kEventPass) os << "event " << (a.eventPass ? "pass" : "fail") << "->" << (b.eventPass ? "pass" : "fail");
+    if (mask & kCutCount) {
+      for (const auto& [ia, ib] : shared) {
+        const int ca = countOf(a, ia), cb = countOf(b, ib);
+        if (ca == cb) continue;
+        if (os.tellp() > 0) os << "; ";
+        os << namesA[ia] << " count " << ca << "->" << cb;
+      }
+    }
+    if (mask & kLeadingPhoton) {
+      if (os.tellp() > 0) os << "; ";
+      os << "leading photon " << LeadingIndex(a.MaxPhotonEnergyPass) << "->" << LeadingIndex(b.MaxPhotonEnergyPass);
+    }
+    AppendIndices(os, "candidates", DiffIndices(a.particlePass, b.particlePass));
+    AppendIndices(os, "traj fid", RelevantIndices(trajA, trajB, a, b));
+    AppendIndices(os, "calo fid", RelevantIndices(caloA, caloB, a, b));
+    AppendIndices(os, "FT fid", RelevantIndices(ftA, ftB, a, b));
+    return os.str();
+  };
+  const std::vector<std::string> diffCols = {"EventCutResult_A",       "EventCutResult_B",       "REC_Traj_pass_A",         "REC_Traj_pass_B",
+                                             "REC_Calorimeter_pass_A", "REC_Calorimeter_pass_B", "REC_ForwardTagger_pass_A", "REC_ForwardTagger_pass_B"};
+  dfDefs = DefineOrRedefine(dfDefs, "AB_diffMask", diffMask, diffCols);
+  dfDefs = DefineOrRedefine(dfDefs, "AB_diffReason", diffReason, CombineColumns(std::vector<std::string>{"AB_diffMask"}, diffCols));
+
+  dfBoth = dfDefs;
+  dfDiff = dfBoth->Filter([](int mask) { return mask != 0; }, {"AB_diffMask"}, "AB differs");
+}
+
+void CutComparison::SaveOutput() {
+  if (!fOutFile || fOutFile->IsZombie()) {
+    std::cerr << "CutComparison::SaveOutput: No valid output file!" << std::endl;
+    return;
+  }
+  if (!dfBoth.has_value() || !dfDiff.has_value()) {
+    std::cerr << "CutComparison::SaveOutput: UserExec has not been run!" << std::endl;
+    return;
+  }
+
+  // Book the counts before the snapshot so everything is filled in the same event loop
+  auto nAll = dfBoth->Count();
+  auto nPassA = dfBoth->Filter([](bool a) { return a; }, {"AB_eventPass_A"}).Count();
+  auto nPassB = dfBoth->Filter([](bool b) { return b; }, {"AB_eventPass_B"}).Count();
+  auto nOnlyA = dfBoth->Filter([](bool a, bool b) { return a && !b; }, {"AB_eventPass_A", "AB_eventPass_B"}).Count();
+  auto nOnlyB = dfBoth->Filter([](bool a, bool b) { return !a && b; }, {"AB_eventPass_A", "AB_eventPass_B"}).Count();
+  auto nDiff = dfDiff->Count();
+  DISANA_BOOK("Count", "A/B comparison summary", std::vector<std::string>{"AB_eventPass_A", "AB_eventPass_B", "AB_diffMask"});
+
+  SafeSnapshot(*dfDiff, "dfABDiff", Form("%s/%s", fOutputDir.c_str(), "dfABDiff.root"), {"EventCutResult_A", "EventCutResult_B"});
+
+  std::cout << "[CutComparison] events " << DISANA_WATCH(*dfBoth, "Count(dfABBoth)", nAll.GetValue()) << ", pass A " << nPassA.GetValue() << ", pass B "
+            << nPassB.GetValue() << ", only A " << nOnlyA.GetValue() << ", only B " << nOnlyB.GetValue() << ", written (any difference) " << nDiff.GetValue()
+            << std::endl;
+  fOutFile->cd();
+}
+
+void CutComparison::SetOutputFile(TFile* file) { fOutFile = file; }
+void CutComparison::SetOutputDir(const std::string& dir) { fOutputDir = dir; }
@@ -0,0 +1,79 @@
+#ifndef CUTCOMPARISON_H
+#define CUTCOMPARISON_H
+
+#include <ROOT/RDF/RInterface.hxx>
+#include <ROOT/RDataFrame.hxx>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "../Cuts/EventCut.h"
+#include "../Cuts/TrackCut.h"
+#include "../Math/RECParticleKinematic.h"
+#include "../ParticleInformation/RECCalorimeter.h"
+#include "../ParticleInformation/RECForwardTagger.h"
+#include "../ParticleInformation/RECParticle.h"
+#include "../ParticleInformation/RECTraj.h"
+#include "../core/Columns.h"
+#include "AnalysisTask.h"
+
+// Side-by-side comparison of two cut configurations in one event loop.
+//
+// Configuration A and B each bring their own TrackCut and EventCut. The banks and the common
+// kinematics (REC_Particle_num/theta/phi/p) are defined once; the fiducial masks and the
+// EventCutResult are evaluated per configuration on the same node. Only the events where the
+// two configurations disagree are written to dfABDiff.root, with:
+//   AB_eventPass_A/B      event decision of each configuration
+//   AB_particlePass_A/B   selected candidates of each configuration
+//   AB_changedParticles   indices whose candidate assignment or track mask differs
+//   AB_diffMask           bit mask of the criteria that differ (see DiffBit)
+//   AB_diffReason         human readable per-criterion reasons, e.g. "photon count 2->1; calo fid [3]"
+class CutComparison : public AnalysisTask {
+ public:
+  enum DiffBit {
+    kEventPass = 1 << 0,      // event decision
+    kCandidates = 1 << 1,     // selected particles
+    kLeadingPhoton = 1 << 2,  // most energetic selected photon
+    kCutCount = 1 << 3,       // count of at least one named particle cut defined in both configurations
+    kTrajFid = 1 << 4,        // DC/CVT trajectory fiducial mask, where it changes a selected particle or the event decision
+    kCaloFid = 1 << 5,        // calorimeter fiducial mask, idem
+    kFTFid = 1 << 6           // forward tagger fiducial mask, idem
+  };
+
+  CutComparison(bool IsMC = false);
+  virtual ~CutComparison();
+
+  void UserCreateOutputObjects() override;
+  void UserExec(ROOT::RDF::RNode &df) override;
+  void SaveOutput() override;
+
+  void SetConfigA(std::shared_ptr<TrackCut> trackCuts, EventCut *evtCuts, bool doFiducial = true) { fConfig[0] = {std::move(trackCuts), evtCuts, doFiducial}; }
+  void SetConfigB(std::shared_ptr<TrackCut> trackCuts, EventCut *evtCuts, bool doFiducial = true) { fConfig[1] = {std::move(trackCuts), evtCuts, doFiducial}; }
+  void SetFTonConfig(bool config) { fFTonConfig = config; }
+
+  void SetOutputFile(TFile *file) override;
+  void SetOutputDir(const std::string &dir) override;
+
+ private:
+  struct Config {
+    std::shared_ptr<TrackCut> trackCuts;
+    EventCut *eventCuts = nullptr;
+    bool doFiducial = true;
+  };
+
+  ROOT::RDF::RNode DefineConfig(ROOT::RDF::RNode df, int which, const std::string &tag);
+
+  bool IsMC = false;
+  bool fFTonConfig = true;
+  Config fConfig[2];
+  std::shared_ptr<TrackCut> fTrackCutsUsed[2];  // copies with the fiducial options applied
+
+  std::optional<ROOT::RDF::RNode> dfBoth;  // every event, with both configurations evaluated
+  std::optional<ROOT::RDF::RNode> dfDiff;  // events where A and B disagree
+  std::string fOutputDir;
+
+  TFile *fOutFile = nullptr;  // Output file pointer set by manager
+};
+
+#endif
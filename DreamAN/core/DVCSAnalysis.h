@@ -9,6 +9,8 @@
 #include <ROOT/RVec.hxx>
 
 #include "../Cuts/EventCut.h"
+#include "../Cuts/PhotonClassifier.h"
+#include "../Cuts/TopologyEventCut.h"
 #include "../Cuts/TrackCut.h"
 #include "../Correction/MomentumCorrection.h"
 #include "../Math/ParticleMassTable.h"
@@ -20,6 +22,7 @@
 #include "../ParticleInformation/RECForwardTagger.h"
 #include "../core/Columns.h"
 #include "AnalysisTask.h"
+#include "EventSampler.h"
 
 class DVCSAnalysis : public AnalysisTask {
  public:
@@ -29,13 +32,21 @@ class DVCSAnalysis : public AnalysisTask {
   void UserCreateOutputObjects() override;
   void UserExec(ROOT::RDF::RNode &df) override;
   void SaveOutput() override;
-  void SetMaxEvents(size_t n) { fMaxEvents = n; }
+  void SetMaxEvents(size_t n) { fSampler.SetMaxEvents(n); }
+  void SetMaxEventsPerFile(size_t n) { fSampler.SetMaxEventsPerFile(n); }
+  void SetSamplingFraction(double fraction, ULong64_t seed = 0) { fSampler.SetFraction(fraction, seed); }
   // Bad for raw pointer setup
   void SetTrackCuts(std::shared_ptr<TrackCut> cuts) { fTrackCuts = std::move(cuts); };
 
   void SetEventCuts(EventCut *evtCuts) { fEventCuts = evtCuts; };
   void SetDoInvMassCut(bool cut) { fDoInvMassCut = cut; };
   void SetAcceptEverything(bool accept) { fAcceptAll = accept; };
+  // REC_Photon_score of every particle, before the event selection; see PhotonClassifier.h
+  void SetPhotonClassifier(std::shared_ptr<PhotonClassifier> classifier) { fPhotonClassifier = std::move(classifier); }
+  // EventCutResult from TopologyEventCut<Topology> (e.g. DVCSTopology, Pi0Topology with
+  // SetDoInvMassCut) instead of EventCut; same outputs, built from the event cuts in UserExec
+  template <typename Topology>
+  void SetTopology() { fTopologyCut = &MakeTopologyEventCut<Topology>; }
  
   void SetDoFiducialCut(bool cut) { fFiducialCut = cut; };
 
@@ -51,7 +62,12 @@ class DVCSAnalysis : public AnalysisTask {
 
 
 
+ protected:
+  ROOT::RDF::RNode DefineExportColumns(ROOT::RDF::RNode df) const override;
+
  private:
+  std::string StageConfig(const TrackCut &trackCuts, bool motherCut) const;
+
   bool IsMC = false;
   bool fDoInvMassCut = false;  // Flag to indicate if invMass cut is applied
   bool fAcceptAll = false;  // Flag to indicate if all events are accepted without cuts
@@ -60,7 +76,7 @@ class DVCSAnalysis : public AnalysisTask {
   bool fFiducialCut = false;  // Flag to indicate if fiducial cut is applied
   bool fFTonConfig = true;
   bool fDoMomentumCorrection = false;  // Flag to indicate if momentum correction is applied
-  size_t fMaxEvents{0}; // Maximum number of events to process, 0 means no limit
+  EventSampler fSampler;  // event cap / sampling, replaces df.Range so it works with ImplicitMT
 
   std::optional<ROOT::RDF::RNode> dforginal;
 
@@ -79,6 +95,8 @@ class DVCSAnalysis : public AnalysisTask {
   std::shared_ptr<TrackCut> fTrackCutsWithFid;
 
   std::shared_ptr<MomentumCorrection> fMomCorr = nullptr;  // Pointer to momentum correction object
+  std::shared_ptr<PhotonClassifier> fPhotonClassifier;  // REC_Photon_score when set
+  EventCutFunction (*fTopologyCut)(const EventCut &, bool) = nullptr;  // SetTopology
   
 
   TFile *fOutFile = nullptr;  // Output file pointer set by manager
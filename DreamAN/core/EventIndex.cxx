@@ -0,0 +1,288 @@
+#include "EventIndex.h"
+
+#include <TChain.h>
+#include <TEntryList.h>
+#include <TFile.h>
+#include <TTree.h>
+#include <TTreeReader.h>
+#include <TTreeReaderArray.h>
+#include <TTreeReaderValue.h>
+
+#include <ROOT/RDataFrame.hxx>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+#include "reader.h"
+#include "writer.h"
+
+namespace {
+const char kMagic[8] = {'D', 'I', 'S', 'A', 'N', 'A', 'I', 'X'};
+static_assert(sizeof(EventIndex::Entry) == 24, "the entries are written as raw 24-byte records");
+
+template <typename T>
+void WriteValue(std::ofstream& out, const T& value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool ReadValue(std::ifstream& in, T& value) {
+  return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+void WriteString(std::ofstream& out, const std::string& text) {
+  WriteValue(out, static_cast<uint32_t>(text.size()));
+  out.write(text.data(), text.size());
+}
+
+bool ReadString(std::ifstream& in, std::string& text) {
+  uint32_t size = 0;
+  if (!ReadValue(in, size)) return false;
+  text.resize(size);
+  return static_cast<bool>(in.read(&text[0], size));
+}
+
+// RUN_config_* are per-event vectors in the RHipoDS snapshots, plain ints in flattened trees
+class FirstInt {
+ public:
+  FirstInt(TTreeReader& reader, TTree* tree, const char* name) {
+    TBranch* branch = tree->GetBranch(name);
+    if (!branch) return;
+    if (std::strlen(branch->GetClassName()) > 0)
+      fArray = std::make_unique<TTreeReaderArray<int>>(reader, name);
+    else
+      fValue = std::make_unique<TTreeReaderValue<int>>(reader, name);
+  }
+  bool IsValid() const { return fArray || fValue; }
+  int Get() {
+    if (fArray) return fArray->GetSize() > 0 ? (*fArray)[0] : 0;
+    return **fValue;
+  }
+
+ private:
+  std::unique_ptr<TTreeReaderArray<int>> fArray;
+  std::unique_ptr<TTreeReaderValue<int>> fValue;
+};
+}  // namespace
+
+void EventIndex::Sort() {
+  std::stable_sort(fEntries.begin(), fEntries.end(), [](const Entry& a, const Entry& b) { return a.run != b.run ? a.run < b.run : a.event < b.event; });
+}
+
+EventIndex EventIndex::FromTree(const std::vector<std::string>& files, const std::string& treeName) {
+  EventIndex index;
+  index.fTreeName = treeName;
+  for (const auto& path : files) {
+    std::unique_ptr<TFile> file(TFile::Open(path.c_str(), "READ"));
+    TTree* tree = (file && !file->IsZombie()) ? file->Get<TTree>(treeName.c_str()) : nullptr;
+    if (!tree) {
+      std::cerr << "[EventIndex] " << path << " has no tree " << treeName << ", not indexed." << std::endl;
+      continue;
+    }
+    TTreeReader reader(tree);
+    FirstInt run(reader, tree, "RUN_config_run");
+    FirstInt event(reader, tree, "RUN_config_event");
+    if (!run.IsValid() || !event.IsValid()) {
+      std::cerr << "[EventIndex] " << path << " has no RUN_config_run/RUN_config_event, not indexed." << std::endl;
+      continue;
+    }
+    const uint32_t fileId = index.fFiles.size();
+    index.fFiles.push_back(path);
+    while (reader.Next()) index.fEntries.push_back({run.Get(), fileId, event.Get(), reader.GetCurrentEntry()});
+  }
+  index.Sort();
+  return index;
+}
+
+ROOT::RDF::RResultPtr<std::vector<EventIndex::Entry>> EventIndex::Book(ROOT::RDF::RNode df) {
+  if (!df.HasColumn("RUN_config_run") || !df.HasColumn("RUN_config_event")) return {};
+  const std::vector<std::string> columns = {"RUN_config_run", "RUN_config_event", "rdfentry_"};
+  // per-event vectors as in the RHipoDS input, plain ints in flattened trees (as FirstInt)
+  if (df.GetColumnType("RUN_config_run").find('<') != std::string::npos) {
+    return df
+        .Define("DISANA_index_record",
+                [](const std::vector<int>& run, const std::vector<int>& event, ULong64_t entry) {
+                  return Entry{run.empty() ? 0 : run[0], 0, event.empty() ? 0 : event[0], static_cast<int64_t>(entry)};
+                },
+                columns)
+        .Take<Entry>("DISANA_index_record");
+  }
+  return df.Define("DISANA_index_record", [](int run, int event, ULong64_t entry) { return Entry{run, 0, event, static_cast<int64_t>(entry)}; }, columns)
+      .Take<Entry>("DISANA_index_record");
+}
+
+EventIndex EventIndex::FromBooked(std::vector<Entry> records, const std::string& file, const std::string& treeName) {
+  EventIndex index;
+  index.fTreeName = treeName;
+  index.fFiles.push_back(file);
+  std::sort(records.begin(), records.end(), [](const Entry& a, const Entry& b) { return a.entry < b.entry; });
+  for (size_t i = 0; i < records.size(); ++i) records[i].entry = static_cast<int64_t>(i);
+  index.fEntries = std::move(records);
+  index.Sort();
+  return index;
+}
+
+EventIndex EventIndex::FromHipo(const std::vector<std::string>& files) {
+  EventIndex index;
+  for (const auto& path : files) {
+    hipo::reader reader;
+    reader.open(path.c_str());
+    hipo::dictionary dictionary;
+    reader.readDictionary(dictionary);
+    if (!dictionary.hasSchema("RUN::config")) {
+      std::cerr << "[EventIndex] " << path << " has no RUN::config bank, not indexed." << std::endl;
+      continue;
+    }
+    hipo::bank config(dictionary.getSchema("RUN::config"));
+    hipo::event event;
+    const uint32_t fileId = index.fFiles.size();
+    index.fFiles.push_back(path);
+    int64_t position = 0;
+    while (reader.next()) {
+      reader.read(event);
+      event.getStructure(config);
+      if (config.getRows() > 0) index.fEntries.push_back({config.getInt("run", 0), fileId, config.getInt("event", 0), position});
+      ++position;
+    }
+  }
+  index.Sort();
+  return index;
+}
+
+bool EventIndex::Write(const std::string& indexFile) const {
+  const std::string tmp = indexFile + ".tmp";
+  std::ofstream out(tmp, std::ios::binary);
+  if (!out) {
+    std::cerr << "[EventIndex] Cannot write " << indexFile << std::endl;
+    return false;
+  }
+  out.write(kMagic, sizeof(kMagic));
+  WriteValue(out, static_cast<uint32_t>(kFormatVersion));
+  WriteString(out, fTreeName);
+  WriteValue(out, static_cast<uint32_t>(fFiles.size()));
+  for (const auto& f : fFiles) WriteString(out, f);
+  WriteValue(out, static_cast<uint64_t>(fEntries.size()));
+  out.write(reinterpret_cast<const char*>(fEntries.data()), fEntries.size() * sizeof(Entry));
+  out.close();
+  if (!out || std::rename(tmp.c_str(), indexFile.c_str()) != 0) {
+    std::cerr << "[EventIndex] Could not write " << indexFile << std::endl;
+    std::remove(tmp.c_str());
+    return false;
+  }
+  std::cout << "[EventIndex] " << fEntries.size() << " events of " << fFiles.size() << " files -> " << indexFile << std::endl;
+  return true;
+}
+
+EventIndex EventIndex::Read(const std::string& indexFile) {
+  EventIndex index;
+  std::ifstream in(indexFile, std::ios::binary);
+  char magic[sizeof(kMagic)] = {};
+  uint32_t version = 0, nFiles = 0;
+  if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 || !ReadValue(in, version) || version != kFormatVersion) {
+    std::cerr << "[EventIndex] " << indexFile << " is not an event index of version " << kFormatVersion << std::endl;
+    return index;
+  }
+  std::vector<std::string> files;
+  bool ok = ReadString(in, index.fTreeName) && ReadValue(in, nFiles);
+  for (uint32_t i = 0; ok && i < nFiles; ++i) {
+    std::string f;
+    ok = ReadString(in, f);
+    files.push_back(f);
+  }
+  uint64_t nEntries = 0;
+  ok = ok && ReadValue(in, nEntries);
+  if (ok) {
+    index.fEntries.resize(nEntries);
+    ok = static_cast<bool>(in.read(reinterpret_cast<char*>(index.fEntries.data()), nEntries * sizeof(Entry)));
+  }
+  if (!ok) {
+    std::cerr << "[EventIndex] " << indexFile << " is truncated." << std::endl;
+    return EventIndex();
+  }
+  index.fFiles = std::move(files);
+  return index;
+}
+
+std::vector<EventIndex::Entry> EventIndex::Lookup(int run, int64_t event) const {
+  const Entry key{run, 0, event, 0};
+  auto range = std::equal_range(fEntries.begin(), fEntries.end(), key, [](const Entry& a, const Entry& b) { return a.run != b.run ? a.run < b.run : a.event < b.event; });
+  return std::vector<Entry>(range.first, range.second);
+}
+
+// Hits of all requested events, in file then entry order so every file is read forward once
+std::vector<EventIndex::Entry> EventIndex::Collect(const std::vector<std::pair<int, int64_t>>& events) const {
+  std::vector<Entry> hits;
+  for (const auto& [run, event] : events) {
+    auto found = Lookup(run, event);
+    if (found.empty()) std::cerr << "[EventIndex] Run " << run << " event " << event << " is not in the index." << std::endl;
+    hits.insert(hits.end(), found.begin(), found.end());
+  }
+  std::sort(hits.begin(), hits.end(), [](const Entry& a, const Entry& b) { return a.file != b.file ? a.file < b.file : a.entry < b.entry; });
+  hits.erase(std::unique(hits.begin(), hits.end(), [](const Entry& a, const Entry& b) { return a.file == b.file && a.entry == b.entry; }), hits.end());
+  return hits;
+}
+
+Long64_t EventIndex::Fetch(const std::vector<std::pair<int, int64_t>>& events, const std::string& outFile) const {
+  const auto hits = Collect(events);
+  if (hits.empty()) return 0;
+  const Long64_t written = IsHipo() ? FetchHipo(hits, outFile) : FetchTree(hits, outFile);
+  std::cout << "[EventIndex] " << written << " events -> " << outFile << std::endl;
+  return written;
+}
+
+Long64_t EventIndex::FetchTree(const std::vector<Entry>& hits, const std::string& outFile) const {
+  TChain chain(fTreeName.c_str());
+  for (const auto& f : fFiles) chain.Add(f.c_str());
+  chain.GetEntries();  // fills the tree offsets
+  TEntryList list("fetch", "fetched events");
+  for (const auto& hit : hits) list.Enter(chain.GetTreeOffset()[hit.file] + hit.entry, &chain);
+  chain.SetEntryList(&list);
+
+  TFile out(outFile.c_str(), "RECREATE");
+  // CopyTree reads only the entries of the list
+  TTree* copy = chain.CopyTree("");
+  if (!copy) return 0;
+  const Long64_t written = copy->GetEntries();
+  copy->Write();
+  out.Close();
+  return written;
+}
+
+Long64_t EventIndex::FetchHipo(const std::vector<Entry>& hits, const std::string& outFile) const {
+  hipo::writer writer;
+  Long64_t written = 0;
+  hipo::event event;
+  uint32_t current = hits.front().file;
+  auto reader = std::make_unique<hipo::reader>();
+  reader->open(fFiles[current].c_str());
+  hipo::dictionary dictionary;
+  reader->readDictionary(dictionary);
+  for (const auto& name : dictionary.getSchemaList()) writer.getDictionary().addSchema(dictionary.getSchema(name.c_str()));
+  writer.open(outFile.c_str());
+
+  for (const auto& hit : hits) {
+    if (hit.file != current) {
+      current = hit.file;
+      reader = std::make_unique<hipo::reader>();
+      reader->open(fFiles[current].c_str());
+    }
+    if (!reader->gotoEvent(static_cast<int>(hit.entry))) {
+      std::cerr << "[EventIndex] " << fFiles[current] << " has no event at " << hit.entry << ", the index is stale." << std::endl;
+      continue;
+    }
+    reader->read(event);
+    writer.addEvent(event);
+    ++written;
+  }
+  writer.close();
+  return written;
+}
+
+void EventIndex::Print() const {
+  std::cout << "[EventIndex] " << fEntries.size() << " events in " << fFiles.size() << (IsHipo() ? " HIPO files" : " files, tree " + fTreeName) << std::endl;
+  if (!fEntries.empty()) std::cout << "  runs " << fEntries.front().run << " - " << fEntries.back().run << std::endl;
+  for (const auto& f : fFiles) std::cout << "  " << f << std::endl;
+}
@@ -0,0 +1,74 @@
+#ifndef EVENTINDEX_H
+#define EVENTINDEX_H
+
+#include <Rtypes.h>
+
+#include <ROOT/RDF/RInterface.hxx>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Sorted (run, event) -> (file, entry) index for random access into processed outputs.
+//
+// For a ROOT output the entry is the tree entry in its file; for HIPO it is the event position
+// in the file (what hipo::reader::gotoEvent takes). The index is written as a small binary file
+// (24 bytes per event) next to the output, e.g. dfSelected.root.idx, and a lookup is a binary
+// search, so pulling a few odd events out of a large production reads only those events:
+//
+//   mgr.SetEventIndex(true);   // every snapshot gets <file>.idx, filled by the loop that writes it
+//   auto index = EventIndex::Read("dfSelected.root.idx");
+//   index.Fetch({{5700, 1234567}, {5702, 42}}, "odd_events.root");
+//
+// and from the shell: FetchEvents dfSelected.root.idx odd_events.root 5700:1234567,5702:42
+class EventIndex {
+ public:
+  struct Entry {
+    int32_t run;
+    uint32_t file;  // position in Files()
+    int64_t event;
+    int64_t entry;
+  };
+  static constexpr int kFormatVersion = 1;
+
+  // Index of the tree in the files, from the RUN_config_run / RUN_config_event columns
+  static EventIndex FromTree(const std::vector<std::string>& files, const std::string& treeName);
+  // Index of HIPO files, from the RUN::config bank (one pass that reads only that bank)
+  static EventIndex FromHipo(const std::vector<std::string>& files);
+
+  // (run, event, rdfentry_) of every event reaching df, booked so the loop of a snapshot of df
+  // fills it; invalid (no RResultPtr) without the RUN_config_run/RUN_config_event columns
+  static ROOT::RDF::RResultPtr<std::vector<Entry>> Book(ROOT::RDF::RNode df);
+  // Index of a snapshot written in rdfentry_ order (single thread, or OrderedSnapshot) from the
+  // booked records: the i-th record by rdfentry_ is entry i of the file
+  static EventIndex FromBooked(std::vector<Entry> records, const std::string& file, const std::string& treeName);
+
+  bool Write(const std::string& indexFile) const;
+  static EventIndex Read(const std::string& indexFile);
+
+  // Every entry of (run, event); more than one if the event was processed more than once
+  std::vector<Entry> Lookup(int run, int64_t event) const;
+
+  // Copies the requested events (the ones found) into outFile: a tree of the same name for ROOT,
+  // a HIPO file with the same dictionary for HIPO. Returns the number of events written.
+  Long64_t Fetch(const std::vector<std::pair<int, int64_t>>& events, const std::string& outFile) const;
+
+  bool IsHipo() const { return fTreeName.empty(); }
+  bool IsValid() const { return !fFiles.empty(); }
+  const std::string& TreeName() const { return fTreeName; }
+  const std::vector<std::string>& Files() const { return fFiles; }
+  size_t Size() const { return fEntries.size(); }
+  void Print() const;
+
+ private:
+  void Sort();
+  std::vector<Entry> Collect(const std::vector<std::pair<int, int64_t>>& events) const;
+  Long64_t FetchTree(const std::vector<Entry>& hits, const std::string& outFile) const;
+  Long64_t FetchHipo(const std::vector<Entry>& hits, const std::string& outFile) const;
+
+  std::string fTreeName;  // empty for a HIPO index
+  std::vector<std::string> fFiles;
+  std::vector<Entry> fEntries;  // sorted by run, event
+};
+
+#endif  // EVENTINDEX_H
@@ -0,0 +1,181 @@
+#ifndef EVENTLOOPDIAGNOSTICS_H
+#define EVENTLOOPDIAGNOSTICS_H
+
+#include <ROOT/RDF/RInterface.hxx>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Records which RDataFrame actions get booked and which calls actually trigger
+// an event loop, so that accidental extra passes over the data (eager Min/Max,
+// GetValue inside bin loops, Count after Snapshot, ...) show up in a summary.
+//
+// Header-only on purpose: the DrawHist headers and the ROOT macros use it too.
+//
+// Usage:
+//   auto& diag = EventLoopDiagnostics::Get();
+//   diag.Enable();
+//   diag.SetStrict(2);   // throw once more than 2 event loops are run
+//   DISANA_BOOK("Histo1D", "recel_p", {"recel_p"});
+//   auto n = DISANA_WATCH(df, "Count", df.Count().GetValue());
+//   diag.PrintSummary();
+class EventLoopDiagnostics {
+ public:
+  struct SourceLocation {
+    const char* file = "";
+    int line = 0;
+    const char* function = "";
+  };
+
+  struct BookedAction {
+    std::string action;
+    std::string detail;
+    SourceLocation where;
+  };
+
+  struct LoopRecord {
+    std::string trigger;
+    SourceLocation where;
+    unsigned int nLoops = 0;
+    size_t nActions = 0;  // actions booked since the previous loop
+    double seconds = 0;
+  };
+
+  static EventLoopDiagnostics& Get() {
+    static EventLoopDiagnostics instance;
+    return instance;
+  }
+
+  void Enable(bool on = true) { fEnabled = on; }
+  bool IsEnabled() const { return fEnabled; }
+
+  // Strict mode: more than loopBudget event loops in total is a hard error (0 disables).
+  void SetStrict(unsigned int loopBudget) { fLoopBudget = loopBudget; }
+
+  void Reset() {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fBooked.clear();
+    fLoops.clear();
+    fJitted.clear();
+    fColumnsRead.clear();
+    fPendingActions = 0;
+    fTotalLoops = 0;
+  }
+
+  void RecordBooking(const std::string& action, const std::string& detail, const std::vector<std::string>& columns, SourceLocation where) {
+    if (!fEnabled) return;
+    std::lock_guard<std::mutex> lock(fMutex);
+    fBooked.push_back({action, detail, where});
+    fColumnsRead.insert(columns.begin(), columns.end());
+    ++fPendingActions;
+  }
+
+  // String expressions passed to Filter/Define are compiled by cling at the start of the next loop.
+  void RecordJIT(const std::string& expression, SourceLocation where) {
+    if (!fEnabled) return;
+    std::lock_guard<std::mutex> lock(fMutex);
+    fJitted.push_back({"JIT", expression, where});
+  }
+
+  // Runs fn and records how many event loops it triggered on the graph that owns node.
+  template <typename Node, typename Fn>
+  auto Watch(Node& node, const std::string& trigger, SourceLocation where, Fn&& fn) -> decltype(fn()) {
+    if (!fEnabled) return fn();
+
+    const unsigned int runsBefore = node.GetNRuns();
+    const auto start = std::chrono::steady_clock::now();
+    if constexpr (std::is_void_v<decltype(fn())>) {
+      fn();
+      Finish(node.GetNRuns() - runsBefore, trigger, where, start);
+    } else {
+      auto result = fn();
+      Finish(node.GetNRuns() - runsBefore, trigger, where, start);
+      return result;
+    }
+  }
+
+  unsigned int GetLoopCount() const { return fTotalLoops; }
+
+  void PrintSummary(std::ostream& os = std::cout) const {
+    std::lock_guard<std::mutex> lock(fMutex);
+    os << "[EventLoopDiagnostics] ================ Event loop summary ================" << std::endl;
+    os << "[EventLoopDiagnostics] Event loops run   : " << fTotalLoops << std::endl;
+    os << "[EventLoopDiagnostics] Actions booked    : " << fBooked.size() << std::endl;
+    os << "[EventLoopDiagnostics] JIT expressions   : " << fJitted.size() << std::endl;
+    os << "[EventLoopDiagnostics] Columns read      : " << fColumnsRead.size() << std::endl;
+
+    for (size_t i = 0; i < fLoops.size(); ++i) {
+      const auto& l = fLoops[i];
+      os << "  loop " << std::setw(3) << i << " : " << std::setw(2) << l.nLoops << " run(s), " << std::setw(4) << l.nActions << " action(s), " << std::fixed << std::setprecision(2)
+         << l.seconds << " s  <- " << l.trigger << " at " << Format(l.where) << std::endl;
+    }
+    if (!fJitted.empty()) {
+      os << "[EventLoopDiagnostics] JIT-compiled expressions:" << std::endl;
+      for (const auto& j : fJitted) os << "  \"" << j.detail << "\" at " << Format(j.where) << std::endl;
+    }
+    if (!fColumnsRead.empty()) {
+      os << "[EventLoopDiagnostics] Columns read by booked actions:" << std::endl << " ";
+      for (const auto& c : fColumnsRead) os << " " << c;
+      os << std::endl;
+    }
+    // A loop that served a single action is usually a candidate for lazy booking.
+    size_t nLonely = 0;
+    for (const auto& l : fLoops)
+      if (l.nActions <= 1) ++nLonely;
+    if (nLonely > 1) {
+      os << "[EventLoopDiagnostics] Warning: " << nLonely << " loops served at most one booked action; book them lazily and trigger once." << std::endl;
+    }
+  }
+
+ private:
+  EventLoopDiagnostics() = default;
+
+  static std::string Format(const SourceLocation& where) {
+    std::ostringstream ss;
+    ss << where.file << ":" << where.line << " (" << where.function << ")";
+    return ss.str();
+  }
+
+  void Finish(unsigned int nLoops, const std::string& trigger, SourceLocation where, std::chrono::steady_clock::time_point start) {
+    if (nLoops == 0) return;
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    unsigned int total = 0;
+    {
+      std::lock_guard<std::mutex> lock(fMutex);
+      fLoops.push_back({trigger, where, nLoops, fPendingActions, seconds});
+      fPendingActions = 0;
+      fTotalLoops += nLoops;
+      total = fTotalLoops;
+    }
+    if (fLoopBudget > 0 && total > fLoopBudget) {
+      throw std::runtime_error("EventLoopDiagnostics: loop budget of " + std::to_string(fLoopBudget) + " exceeded by '" + trigger + "' at " + Format(where));
+    }
+  }
+
+  mutable std::mutex fMutex;
+  bool fEnabled = false;
+  unsigned int fLoopBudget = 0;
+  unsigned int fTotalLoops = 0;
+  size_t fPendingActions = 0;
+  std::vector<BookedAction> fBooked;
+  std::vector<BookedAction> fJitted;
+  std::vector<LoopRecord> fLoops;
+  std::set<std::string> fColumnsRead;
+};
+
+#define DISANA_HERE \
+  EventLoopDiagnostics::SourceLocation { __FILE__, __LINE__, __func__ }
+#define DISANA_BOOK(action, detail, columns) EventLoopDiagnostics::Get().RecordBooking(action, detail, columns, DISANA_HERE)
+#define DISANA_JIT(expression) EventLoopDiagnostics::Get().RecordJIT(expression, DISANA_HERE)
+#define DISANA_WATCH(node, trigger, expr) EventLoopDiagnostics::Get().Watch(node, trigger, DISANA_HERE, [&]() { return expr; })
+
+#endif  // EVENTLOOPDIAGNOSTICS_H
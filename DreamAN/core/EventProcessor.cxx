@@ -2,7 +2,7 @@
 
 #include <iostream>
 
-EventProcessor::EventProcessor(AnalysisTaskManager& taskMgr, const std::string& inputDirectory, bool fIsReprocessRootFile, const std::string& fInputROOTtreeName, const std::string& fInputROOTfileName, int nfiles ) : evt(inputDirectory,fIsReprocessRootFile, fInputROOTtreeName, fInputROOTfileName, nfiles), tasks(taskMgr) {}
+EventProcessor::EventProcessor(AnalysisTaskManager& taskMgr, const std::string& inputDirectory, bool fIsReprocessRootFile, const std::string& fInputROOTtreeName, const std::string& fInputROOTfileName, int nfiles, bool balanceFiles) : evt(inputDirectory,fIsReprocessRootFile, fInputROOTtreeName, fInputROOTfileName, nfiles, balanceFiles), tasks(taskMgr) {}
 
 void EventProcessor::ProcessEvents() {
   auto dfOpt = evt.getNode();
@@ -15,6 +15,7 @@ void EventProcessor::ProcessEvents() {
 
   ROOT::RDF::RNode df = dfOpt.value();
 
+  tasks.SetInputFiles(evt.getInputFiles(), evt.getInputSamples());
   tasks.UserCreateOutputObjects();
   tasks.Execute(df);
   tasks.SaveOutput();
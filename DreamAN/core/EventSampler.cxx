@@ -0,0 +1,136 @@
+#include "EventSampler.h"
+
+#include <TNamed.h>
+#include <TParameter.h>
+#include <TROOT.h>
+
+#include <ROOT/RDF/RSampleInfo.hxx>
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+EventSampler::EventSampler() : fState(std::make_shared<State>()) {}
+
+void EventSampler::SetFraction(double fraction, ULong64_t seed) {
+  if (fraction <= 0.0 || fraction > 1.0) throw std::runtime_error("EventSampler: sampling fraction must be in (0, 1]");
+  fFraction = fraction;
+  fSeed = seed;
+}
+
+// splitmix64 finaliser on the packed (run, event, seed) key, mapped to [0, 1)
+double EventSampler::Uniform(int run, ULong64_t event, ULong64_t seed) {
+  std::uint64_t x = (static_cast<std::uint64_t>(static_cast<std::uint32_t>(run)) << 40) ^ event ^ (seed * 0x9E3779B97F4A7C15ULL);
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  x ^= x >> 31;
+  return (x >> 11) * (1.0 / 9007199254740992.0);
+}
+
+bool EventSampler::Accept(int file, int run, ULong64_t event) const {
+  fState->seen.fetch_add(1, std::memory_order_relaxed);
+  if (fFraction < 1.0 && Uniform(run, event, fSeed) >= fFraction) return false;
+
+  if (fMaxEventsPerFile > 0) {
+    std::lock_guard<std::mutex> lock(fState->mutex);
+    auto& n = file >= 0 ? fState->acceptedPerFile[file] : fState->acceptedPerRun[run];
+    if (n >= fMaxEventsPerFile) return false;
+    // the global cap is checked under the same lock so a rejected event never consumes a file slot
+    if (fMaxEvents > 0 && fState->accepted.load(std::memory_order_relaxed) >= fMaxEvents) return false;
+    ++n;
+    fState->accepted.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+  if (fMaxEvents > 0) {
+    ULong64_t n = fState->accepted.load(std::memory_order_relaxed);
+    do {
+      if (n >= fMaxEvents) return false;
+    } while (!fState->accepted.compare_exchange_weak(n, n + 1, std::memory_order_relaxed));
+    return true;
+  }
+  fState->accepted.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+int EventSampler::BeginSample(const std::string& file, const std::string& sample) const {
+  std::lock_guard<std::mutex> lock(fState->mutex);
+  // every sample is processed once per loop, and the loops of a graph never overlap
+  if (!fState->samples.insert(sample).second) {
+    fState->samples = {sample};
+    fState->seen = 0;
+    fState->accepted = 0;
+    std::fill(fState->acceptedPerFile.begin(), fState->acceptedPerFile.end(), 0);
+    fState->acceptedPerRun.clear();
+  }
+  if (file.empty()) return -1;
+  const auto [it, added] = fState->files.emplace(file, static_cast<int>(fState->files.size()));
+  if (added) fState->acceptedPerFile.push_back(0);
+  return it->second;
+}
+
+ROOT::RDF::RNode EventSampler::DefineSample(ROOT::RDF::RNode df, const EventSampler& sampler) {
+  return df.DefinePerSample(SampleColumn, [sampler](unsigned int, const ROOT::RDF::RSampleInfo& info) {
+    const auto range = info.EntryRange();
+    return sampler.BeginSample(info.AsString(), info.AsString() + Form(" [%llu, %llu)", range.first, range.second));
+  });
+}
+
+ROOT::RDF::RNode EventSampler::Apply(ROOT::RDF::RNode df) {
+  if (!IsActive()) return df;
+  // fresh counters for every graph the sampler is applied to
+  fState = std::make_shared<State>();
+  df = DefineSample(df, *this);
+  // without MT the global cap is a Range, which ends the event loop at the cap
+  const bool range = fMaxEvents > 0 && !ROOT::IsImplicitMTEnabled();
+  EventSampler sampler = *this;
+  if (range) sampler.fMaxEvents = 0;
+  if (!range) return SamplingFilter(df, sampler);
+
+  if (sampler.IsActive()) {
+    // Range stops right after the cap-th accepted event, so the filter counts are already final
+    return SamplingFilter(df, sampler).Range(fMaxEvents);
+  }
+  auto state = fState;
+  return df.Range(fMaxEvents).Filter(
+      [state](int) {
+        state->seen.fetch_add(1, std::memory_order_relaxed);
+        state->accepted.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      },
+      {SampleColumn}, "EventSampler");
+}
+
+ROOT::RDF::RNode EventSampler::SamplingFilter(ROOT::RDF::RNode df, const EventSampler& sampler) {
+  if (df.HasColumn("RUN_config_run") && df.HasColumn("RUN_config_event")) {
+    return df.Filter(
+        [sampler](int file, const std::vector<int>& run, const std::vector<int>& event) {
+          const int r = run.empty() ? 0 : run[0];
+          const ULong64_t e = event.empty() ? 0 : static_cast<ULong64_t>(event[0]);
+          return sampler.Accept(file, r, e);
+        },
+        {SampleColumn, "RUN_config_run", "RUN_config_event"}, "EventSampler");
+  }
+  std::cout << "[EventSampler] RUN_config bank not available, sampling on the entry number." << std::endl;
+  return df.Filter([sampler](int file, ULong64_t entry) { return sampler.Accept(file, 0, entry); }, {SampleColumn, "rdfentry_"}, "EventSampler");
+}
+
+double EventSampler::GetLuminosityScale() const {
+  const ULong64_t accepted = GetAccepted();
+  return accepted > 0 ? static_cast<double>(GetSeen()) / accepted : 0.0;
+}
+
+void EventSampler::WriteMetadata(TDirectory* dir) const {
+  if (!dir || !IsActive()) return;
+  TDirectory::TContext ctx(dir);
+  TNamed("SamplingConfig", Form("maxEvents=%llu maxEventsPerFile=%llu fraction=%g seed=%llu", fMaxEvents, fMaxEventsPerFile, fFraction, fSeed)).Write();
+  TParameter<Long64_t>("SamplingEventsSeen", static_cast<Long64_t>(GetSeen())).Write();
+  TParameter<Long64_t>("SamplingEventsAccepted", static_cast<Long64_t>(GetAccepted())).Write();
+  TParameter<double>("SamplingLumiScale", GetLuminosityScale()).Write();
+}
+
+void EventSampler::Print() const {
+  if (!IsActive()) return;
+  std::cout << "[EventSampler] seen " << GetSeen() << ", accepted " << GetAccepted() << " (fraction " << fFraction << ", cap " << fMaxEvents << ", per-file cap "
+            << fMaxEventsPerFile << "), luminosity scale " << GetLuminosityScale() << std::endl;
+}
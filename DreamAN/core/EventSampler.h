@@ -0,0 +1,93 @@
+#ifndef EVENTSAMPLER_H
+#define EVENTSAMPLER_H
+
+#include <TDirectory.h>
+
+#include <ROOT/RDF/RInterface.hxx>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+// Event limiting and sampling that works with ImplicitMT and file-parallel ingestion.
+//
+//  - global cap     : at most N accepted events in total. Without ImplicitMT this is df.Range(n),
+//                     which stops the event loop once the cap is reached, so a capped run only
+//                     reads what it keeps (the head of the input). Range is not available under
+//                     MT, where the cap becomes a filter and the whole input is still read.
+//  - per-file cap   : at most N accepted events per input file, keyed by the sample RDataFrame
+//                     reports (file/tree). A data source without file names (RHipoDS reads its
+//                     file list as one source) is keyed by RUN_config_run instead, which is the
+//                     same thing for the usual one-run-per-file HIPO layout.
+//  - fraction       : deterministic pseudo-random selection of a fraction of the events,
+//                     decided by a hash of (run, event, seed). The decision does not depend
+//                     on file order or thread scheduling, so every file and run is sampled
+//                     with the same rate and reruns pick the same events.
+//
+// The counters belong to one event loop: a task that snapshots several nodes of the graph runs
+// one loop per snapshot, and each loop starts from empty counters (a sample seen twice means a
+// new loop has started). Every snapshot is therefore capped on its own and the luminosity scale
+// is the one of the last loop, which read the same input as the others.
+//
+// The caps are exact in count but, under MT, which events fill a filter cap depends on
+// scheduling (the first events of every slot), a biased sample that also differs between the
+// loops of one job; combine it with a fraction when the sample matters. A filter cap does not
+// shorten the I/O: every event still reaches the filter, which is what makes the luminosity
+// scale (seen/accepted) correct. Use a fraction for quick looks.
+class EventSampler {
+ public:
+  EventSampler();
+
+  void SetMaxEvents(ULong64_t n) { fMaxEvents = n; }
+  void SetMaxEventsPerFile(ULong64_t n) { fMaxEventsPerFile = n; }
+  void SetFraction(double fraction, ULong64_t seed = 0);
+
+  bool IsActive() const { return fMaxEvents > 0 || fMaxEventsPerFile > 0 || fFraction < 1.0; }
+
+  // Adds the sampling filter (and the Range of a single-threaded global cap). Uses
+  // RUN_config_run/RUN_config_event when present, rdfentry_ otherwise. Defines SampleColumn,
+  // which the snapshots leave out.
+  ROOT::RDF::RNode Apply(ROOT::RDF::RNode df);
+
+  static constexpr const char* SampleColumn = "DISANA_sample";
+
+  // Counts of the last event loop, valid once it has run.
+  ULong64_t GetSeen() const { return fState->seen.load(); }
+  ULong64_t GetAccepted() const { return fState->accepted.load(); }
+  double GetLuminosityScale() const;
+
+  // Stores the configuration and the scale next to the analysis output.
+  void WriteMetadata(TDirectory* dir) const;
+  void Print() const;
+
+ private:
+  struct State {
+    std::atomic<ULong64_t> seen{0};
+    std::atomic<ULong64_t> accepted{0};
+    std::mutex mutex;
+    std::set<std::string> samples;           // samples started in the current loop
+    std::map<std::string, int> files;        // file key -> index, kept across loops
+    std::vector<ULong64_t> acceptedPerFile;  // by file index
+    std::map<int, ULong64_t> acceptedPerRun;  // files without a name, by run
+  };
+
+  // file: index of the input file of the event, -1 when the source has no file names
+  bool Accept(int file, int run, ULong64_t event) const;
+  // Per-sample callback: starts a new loop when the sample was already seen, returns its file index
+  int BeginSample(const std::string& file, const std::string& sample) const;
+  static ROOT::RDF::RNode DefineSample(ROOT::RDF::RNode df, const EventSampler& sampler);
+  static ROOT::RDF::RNode SamplingFilter(ROOT::RDF::RNode df, const EventSampler& sampler);
+  static double Uniform(int run, ULong64_t event, ULong64_t seed);
+
+  ULong64_t fMaxEvents = 0;
+  ULong64_t fMaxEventsPerFile = 0;
+  double fFraction = 1.0;
+  ULong64_t fSeed = 0;
+  std::shared_ptr<State> fState;  // shared by the filter copies RDataFrame keeps per slot
+};
+
+#endif  // EVENTSAMPLER_H
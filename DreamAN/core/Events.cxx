@@ -7,56 +7,70 @@
 #include <string>
 #include <vector>
 
+#include "InputFiles.h"
 #include "ROOT/RDF/RInterface.hxx"
 #include "ROOT/RDataFrame.hxx"
 
 // Constructor
-Events::Events(const std::string& directory, bool fIsReprocessRootFile, const std::string& fInputROOTtreeName, const std::string& fInputROOTfileName, const int nfiles)
+Events::Events(const std::string& directory, bool fIsReprocessRootFile, const std::string& fInputROOTtreeName, const std::string& fInputROOTfileName, const int nfiles,
+               bool balanceFiles)
     : fIsReprocessRootFile(fIsReprocessRootFile), fInputROOTtreeName(fInputROOTtreeName), fInputROOTfileName(fInputROOTfileName), fnfiles(nfiles) {
+  ULong64_t totalEntries = 0;
   if (fIsReprocessRootFile) {
-    std::string inputfile_Root = directory + fInputROOTfileName;
     std::cout << "Reprocessing ROOT files is enabled." << std::endl;
 
-    auto rdf = ROOT::RDataFrame(fInputROOTtreeName, inputfile_Root);
+    // one file, a glob or a list/catalog (see InputFiles.h), chained instead of hadd-ed
+    inputFiles = InputFiles::Resolve(directory, fInputROOTfileName, nfiles);
+    if (balanceFiles) InputFiles::BalanceBySize(inputFiles);
+    auto infos = InputFiles::Inspect(inputFiles, fInputROOTtreeName);
+    inputFiles.clear();
+    for (const auto& info : infos) {
+      if (info.entries < 0) continue;  // a missing tree would stop the whole chain
+      inputFiles.push_back(info.path);
+      totalEntries += info.entries;
+    }
+    InputFiles::PrintSummary(infos);
+    if (inputFiles.empty()) {
+      std::cerr << "No ROOT file with tree " << fInputROOTtreeName << " for " << directory << fInputROOTfileName << std::endl;
+      return;
+    }
+
+    inputSamples = inputFiles;
+    auto rdf = ROOT::RDataFrame(fInputROOTtreeName, inputFiles);
     dfNodePtr = std::make_shared<ROOT::RDF::RNode>(rdf);
   } else {
     std::cout << "Reprocessing ROOT files is disabled." << std::endl;
 
-    inputFiles = GetHipoFilesInPath(directory, nfiles);
+    inputFiles = InputFiles::Scan(directory, ".hipo", nfiles);
     if (inputFiles.empty()) {
       std::cerr << "No .hipo files found in directory: " << directory << std::endl;
       return;
     }
+    if (balanceFiles) InputFiles::BalanceBySize(inputFiles);
 
-    std::cout << "Creating RHipoDS from input files..." << std::endl;
-    dataSource = std::make_unique<RHipoDS>(inputFiles);
+    // converted once with ./ConvertHipo, see ColumnarStore.h
+    auto store = std::make_unique<ColumnarStore>(ColumnarStore::DefaultDirectory(directory));
+    if (store->Covers(inputFiles)) {
+      std::cout << "Reading the columnar store " << store->GetDirectory() << " instead of the HIPO files..." << std::endl;
+      dfNodePtr = std::make_shared<ROOT::RDF::RNode>(store->Open(inputFiles));
+      totalEntries = store->GetEntries();
+      for (const auto& file : inputFiles) inputSamples.push_back(store->Find(file).directory);
+      columnarStore = std::move(store);
+    } else {
+      std::cout << "Creating RHipoDS from input files..." << std::endl;
+      dataSource = std::make_unique<RHipoDS>(inputFiles);
 
-    auto rdf = ROOT::RDataFrame(std::move(dataSource));
-    dfNodePtr = std::make_shared<ROOT::RDF::RNode>(rdf);
+      auto rdf = ROOT::RDataFrame(std::move(dataSource));
+      dfNodePtr = std::make_shared<ROOT::RDF::RNode>(rdf);
+    }
   }
 
   dfNode = std::make_optional<ROOT::RDF::RNode>(*dfNodePtr);
+  progress = InputFiles::AttachProgress(*dfNode, totalEntries);
 
   std::cout << "DataFrame initialized with " << inputFiles.size() << " input files." << std::endl;
 }
 
-// Helper to get HIPO files in a path
-std::vector<std::string> Events::GetHipoFilesInPath(const std::string& directory, int nfiles) {
-  std::vector<std::string> files;
-  int count = 0;
-  for (const auto& entry : std::filesystem::recursive_directory_iterator(directory)) {
-    if (entry.path().extension() == ".hipo") {
-      files.push_back(entry.path().string());
-      count++;
-    }
-    if (count == nfiles) {
-      break;
-    }
-  }
-  std::cout << "================ " << files.size() << " Files Found ================" << std::endl;
-  return files;
-}
-
 // Accessor methods
 std::optional<ROOT::RDF::RNode> Events::getNode() const { return dfNode; }
 
@@ -4,6 +4,7 @@
 #include "ROOT/RDataFrame.hxx"
 #include "ROOT/RVec.hxx"
 #include "RHipoDS.hxx"
+#include "ColumnarStore.h"
 
 #include <string>
 #include <vector>
@@ -12,23 +13,30 @@
 
 class Events {
 public:
+  // In reprocessing mode fInputROOTfileName may also be a glob or an @list (see InputFiles.h).
+  // balanceFiles orders the inputs largest first.
   Events(const std::string& directory, bool fIsReprocessRootFile,
-         const std::string& fInputROOTtreeName, const std::string& fInputROOTfileName, int nfiles);
+         const std::string& fInputROOTtreeName, const std::string& fInputROOTfileName, int nfiles, bool balanceFiles = false);
 
   std::optional<ROOT::RDF::RNode> getNode() const;
   size_t getFileCount() const;
+  const std::vector<std::string>& getInputFiles() const { return inputFiles; }
+  // Per input file, the file the sample ids of its events start with; empty for RHipoDS, whose
+  // events cannot be traced back to their file
+  const std::vector<std::string>& getInputSamples() const { return inputSamples; }
 
 private:
-  std::vector<std::string> GetHipoFilesInPath(const std::string& directory, int nfiles);
-
   bool fIsReprocessRootFile;
   int fnfiles;
   std::string fInputROOTtreeName;
   std::string fInputROOTfileName;
   std::vector<std::string> inputFiles;
+  std::vector<std::string> inputSamples;
 
   std::unique_ptr<RHipoDS> dataSource;
+  std::unique_ptr<ColumnarStore> columnarStore;  // used instead of RHipoDS when it has every input file
   std::shared_ptr<ROOT::RDF::RNode> dfNodePtr;
   std::optional<ROOT::RDF::RNode> dfNode;
+  ROOT::RDF::RResultPtr<ULong64_t> progress;  // progress printout, filled by the first event loop
 };
 #endif // EVENTS_H
\ No newline at end of file
@@ -0,0 +1,170 @@
+#include "InputFiles.h"
+
+#include <TFile.h>
+#include <TTree.h>
+#include <fnmatch.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+std::vector<std::string> InputFiles::Scan(const std::string& directory, const std::string& extension, int nfiles) {
+  std::vector<std::string> files;
+  std::error_code ec;
+  for (const auto& entry : fs::recursive_directory_iterator(directory, ec)) {
+    if (entry.path().extension() == extension) files.push_back(entry.path().string());
+  }
+  std::sort(files.begin(), files.end());
+  if (nfiles > 0 && files.size() > static_cast<size_t>(nfiles)) files.resize(nfiles);
+  std::cout << "================ " << files.size() << " Files Found ================" << std::endl;
+  return files;
+}
+
+std::vector<std::string> InputFiles::Resolve(const std::string& directory, const std::string& spec, int nfiles) {
+  const auto inDirectory = [&directory](const std::string& path) { return fs::path(path).is_absolute() ? path : (fs::path(directory) / path).string(); };
+  std::vector<std::string> files;
+
+  if (!spec.empty() && spec[0] == '@') {
+    // list or catalog, with an optional ?key=value&... selection
+    const size_t q = spec.find('?');
+    const std::string list = inDirectory(spec.substr(1, q == std::string::npos ? std::string::npos : q - 1));
+    const std::string selection = q == std::string::npos ? "" : spec.substr(q + 1);
+    std::ifstream in(list);
+    if (!in) {
+      std::cerr << "[InputFiles] Cannot read file list " << list << std::endl;
+      return files;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+      line = line.substr(0, line.find('#'));
+      std::istringstream is(line);
+      std::string path;
+      if (!(is >> path)) continue;
+      std::string fields;
+      std::getline(is, fields);
+      if (!selection.empty() && !Selected(fields, selection)) continue;
+      files.push_back(inDirectory(path));
+    }
+  } else if (spec.find_first_of("*?[") != std::string::npos) {
+    std::error_code ec;
+    for (const auto& entry : fs::recursive_directory_iterator(directory, ec)) {
+      if (!entry.is_regular_file(ec)) continue;
+      const std::string relative = fs::relative(entry.path(), directory, ec).string();
+      if (fnmatch(spec.c_str(), relative.c_str(), 0) == 0) files.push_back(entry.path().string());
+    }
+    std::sort(files.begin(), files.end());
+  } else {
+    files.push_back(directory + spec);  // same as the single-file reprocessing input
+  }
+
+  if (nfiles > 0 && files.size() > static_cast<size_t>(nfiles)) files.resize(nfiles);
+  std::cout << "================ " << files.size() << " Files Found ================" << std::endl;
+  return files;
+}
+
+// key=value[&key=value...]; a value lo-hi is a numeric range
+bool InputFiles::Selected(const std::string& fields, const std::string& selection) {
+  std::map<std::string, std::string> values;
+  std::istringstream is(fields);
+  std::string field;
+  while (is >> field) {
+    const size_t eq = field.find('=');
+    if (eq != std::string::npos) values[field.substr(0, eq)] = field.substr(eq + 1);
+  }
+  std::istringstream ss(selection);
+  std::string term;
+  while (std::getline(ss, term, '&')) {
+    const size_t eq = term.find('=');
+    if (eq == std::string::npos) continue;
+    auto it = values.find(term.substr(0, eq));
+    if (it == values.end()) return false;
+    const std::string want = term.substr(eq + 1);
+    const size_t dash = want.find('-', 1);
+    if (dash != std::string::npos) {
+      try {
+        const double value = std::stod(it->second);
+        if (value < std::stod(want.substr(0, dash)) || value > std::stod(want.substr(dash + 1))) return false;
+        continue;
+      } catch (const std::exception&) {
+        // not numeric, compare as text
+      }
+    }
+    if (it->second != want) return false;
+  }
+  return true;
+}
+
+void InputFiles::BalanceBySize(std::vector<std::string>& files) {
+  std::vector<std::pair<uintmax_t, std::string>> sized;
+  for (const auto& f : files) {
+    std::error_code ec;
+    const auto bytes = fs::file_size(f, ec);
+    sized.emplace_back(ec ? 0 : bytes, f);
+  }
+  std::stable_sort(sized.begin(), sized.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+  for (size_t i = 0; i < files.size(); ++i) files[i] = sized[i].second;
+}
+
+std::vector<InputFileInfo> InputFiles::Inspect(const std::vector<std::string>& files, const std::string& treeName) {
+  std::vector<InputFileInfo> infos;
+  for (const auto& f : files) {
+    InputFileInfo info;
+    info.path = f;
+    std::error_code ec;
+    info.bytes = fs::file_size(f, ec);
+    std::unique_ptr<TFile> file(TFile::Open(f.c_str(), "READ"));
+    if (file && !file->IsZombie()) {
+      info.compressionSettings = file->GetCompressionSettings();
+      if (auto* tree = file->Get<TTree>(treeName.c_str())) {
+        info.entries = tree->GetEntries();
+        info.compression = tree->GetZipBytes() > 0 ? static_cast<double>(tree->GetTotBytes()) / tree->GetZipBytes() : 0;
+      }
+    }
+    if (info.entries < 0) std::cerr << "[InputFiles] " << f << " has no tree " << treeName << std::endl;
+    infos.push_back(info);
+  }
+  return infos;
+}
+
+void InputFiles::PrintSummary(const std::vector<InputFileInfo>& infos) {
+  Long64_t entries = 0;
+  ULong64_t bytes = 0;
+  for (const auto& info : infos) {
+    std::cout << "  " << std::setw(10) << info.entries << " entries  " << std::setw(9) << std::fixed << std::setprecision(1) << info.bytes / (1024.0 * 1024.0) << " MB  x"
+              << std::setprecision(2) << info.compression << "  (algo " << info.compressionSettings << ")  " << info.path << std::endl;
+    entries += std::max<Long64_t>(info.entries, 0);
+    bytes += info.bytes;
+  }
+  std::cout.unsetf(std::ios::floatfield);
+  std::cout << "[InputFiles] " << infos.size() << " files, " << entries << " entries, " << bytes / (1024.0 * 1024.0) << " MB" << std::endl;
+}
+
+ROOT::RDF::RResultPtr<ULong64_t> InputFiles::AttachProgress(ROOT::RDF::RNode df, ULong64_t totalEntries, ULong64_t every) {
+  struct State {
+    std::atomic<ULong64_t> processed{0};
+    std::mutex printMutex;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  };
+  auto state = std::make_shared<State>();
+  auto count = df.Count();
+  // called by every slot after each `every` of its own entries
+  count.OnPartialResultSlot(every, [state, totalEntries, every](unsigned int, ULong64_t&) {
+    const ULong64_t done = state->processed.fetch_add(every) + every;
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - state->start).count();
+    std::lock_guard<std::mutex> lock(state->printMutex);
+    std::cout << "[InputFiles] " << done << " entries";
+    if (totalEntries > 0) std::cout << " (" << std::min(100.0, 100.0 * done / totalEntries) << "%)";
+    std::cout << ", " << done / std::max(seconds, 1e-9) / 1e3 << " kHz" << std::endl;
+  });
+  return count;
+}
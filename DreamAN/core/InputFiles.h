@@ -0,0 +1,49 @@
+#ifndef INPUTFILES_H
+#define INPUTFILES_H
+
+#include <Rtypes.h>
+
+#include <ROOT/RDF/RInterface.hxx>
+#include <string>
+#include <vector>
+
+// Input file discovery, balancing and progress, shared by the HIPO and the ROOT reprocessing input.
+//
+// Reprocessing specs (relative to the input directory unless absolute):
+//   dfSelected.root                      one file (the old behaviour)
+//   run*/dfSelected.root                 glob, matched against the path below the directory
+//   @skims.txt                           list or catalog: one file per line, '#' starts a comment,
+//                                        optional key=value fields after the path
+//   @skims.txt?run=5000-5100&config=inb  catalog selection: numeric range or exact value per key
+// The files are chained (ROOT::RDataFrame over a file list), so there is no need to hadd the
+// per-run skims and ImplicitMT reads them cluster by cluster in parallel.
+struct InputFileInfo {
+  std::string path;
+  ULong64_t bytes = 0;
+  Long64_t entries = -1;    // -1 when the tree is missing
+  double compression = 0;   // uncompressed / compressed bytes of the tree
+  int compressionSettings = -1;
+};
+
+class InputFiles {
+ public:
+  // Recursive scan for files with the extension, sorted by path; nfiles <= 0 keeps all
+  static std::vector<std::string> Scan(const std::string& directory, const std::string& extension, int nfiles);
+  static std::vector<std::string> Resolve(const std::string& directory, const std::string& spec, int nfiles);
+
+  // Largest file first, so the big files are not left for the last tasks of the loop
+  static void BalanceBySize(std::vector<std::string>& files);
+
+  // Entries and compression of the tree in every file; files without the tree are reported
+  static std::vector<InputFileInfo> Inspect(const std::vector<std::string>& files, const std::string& treeName);
+  static void PrintSummary(const std::vector<InputFileInfo>& infos);
+
+  // Prints processed entries (and the fraction of totalEntries when known) during the first event
+  // loop over df. Keep the returned result alive until then, it is the booked counter.
+  static ROOT::RDF::RResultPtr<ULong64_t> AttachProgress(ROOT::RDF::RNode df, ULong64_t totalEntries = 0, ULong64_t every = 1000000);
+
+ private:
+  static bool Selected(const std::string& fields, const std::string& selection);
+};
+
+#endif  // INPUTFILES_H
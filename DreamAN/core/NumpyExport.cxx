@@ -0,0 +1,237 @@
+#include "NumpyExport.h"
+
+#include <TInterpreter.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+
+#include "EventLoopDiagnostics.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr size_t kHeaderBytes = 128;  // fixed, so the final shape is written over the placeholder
+
+struct DType {
+  const char* descr;
+  size_t size;
+};
+
+// Scalar column types and their NumPy dtypes (little-endian)
+bool FindDType(const std::string& type, DType& dtype) {
+  static const std::map<std::string, DType> types = {
+      {"float", {"<f4", 4}},         {"Float_t", {"<f4", 4}},        {"double", {"<f8", 8}},         {"Double_t", {"<f8", 8}},     {"bool", {"|b1", 1}},
+      {"Bool_t", {"|b1", 1}},        {"char", {"|i1", 1}},           {"Char_t", {"|i1", 1}},         {"signed char", {"|i1", 1}},  {"unsigned char", {"|u1", 1}},
+      {"UChar_t", {"|u1", 1}},       {"short", {"<i2", 2}},          {"Short_t", {"<i2", 2}},        {"unsigned short", {"<u2", 2}}, {"UShort_t", {"<u2", 2}},
+      {"int", {"<i4", 4}},           {"Int_t", {"<i4", 4}},          {"unsigned int", {"<u4", 4}},   {"UInt_t", {"<u4", 4}},       {"long", {"<i8", 8}},
+      {"Long_t", {"<i8", 8}},        {"long long", {"<i8", 8}},      {"Long64_t", {"<i8", 8}},       {"unsigned long", {"<u8", 8}}, {"ULong_t", {"<u8", 8}},
+      {"unsigned long long", {"<u8", 8}}, {"ULong64_t", {"<u8", 8}}};
+  auto it = types.find(type);
+  if (it == types.end()) return false;
+  dtype = it->second;
+  return true;
+}
+
+void WriteHeader(std::ofstream& file, const std::string& descr, ULong64_t rows) {
+  std::string dict = "{'descr': '" + descr + "', 'fortran_order': False, 'shape': (" + std::to_string(rows) + ",), }";
+  dict.resize(kHeaderBytes - 11, ' ');
+  dict += '\n';
+  std::string header = "\x93NUMPY";
+  header += '\x01';
+  header += '\x00';
+  const uint16_t length = static_cast<uint16_t>(dict.size());
+  header += static_cast<char>(length & 0xFF);
+  header += static_cast<char>(length >> 8);
+  file.write(header.data(), header.size());
+  file.write(dict.data(), dict.size());
+}
+
+// Packs the scalars of one row, in argument order, where next[slot] points in the slot's batch
+void DeclareHelpers() {
+  static const bool declared = gInterpreter->Declare(R"(
+    #include <cstring>
+    namespace DISANA_Npy {
+    template <typename... T> bool Pack(unsigned char* const* next, unsigned int slot, const T&... v) {
+      unsigned char* row = next[slot];
+      size_t offset = 0;
+      ((std::memcpy(row + offset, &v, sizeof(T)), offset += sizeof(T)), ...);
+      return true;
+    }
+    }  // namespace DISANA_Npy
+  )");
+  (void)declared;
+}
+}  // namespace
+
+std::string NumpyExport::Directory(const std::string& filename) {
+  fs::path path(filename);
+  return (path.parent_path() / (path.stem().string() + "_npy")).string();
+}
+
+// After a row was packed at next[slot]: the next row goes after it, or the full batch is flushed
+void NumpyExport::Booked::Commit(unsigned int slot) {
+  if (++filled[slot] < kBatchRows) {
+    next[slot] += rowSize;
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  Flush(slot);
+}
+
+// The slot's rows -> one contiguous block per column file; called with the mutex held
+void NumpyExport::Booked::Flush(unsigned int slot) {
+  const size_t n = filled[slot];
+  const auto& batch = batches[slot];
+  std::vector<unsigned char> block;
+  for (auto& column : columns) {
+    block.resize(n * column.size);
+    for (size_t r = 0; r < n; ++r) std::memcpy(&block[r * column.size], &batch[r * rowSize + column.offset], column.size);
+    column.file.write(reinterpret_cast<const char*>(block.data()), block.size());
+  }
+  rows += n;
+  filled[slot] = 0;
+  next[slot] = batches[slot].data();
+}
+
+void NumpyExport::Book(ROOT::RDF::RNode df, const std::string& tree, const std::string& directory) {
+  std::error_code ec;
+  fs::create_directories(directory, ec);
+  if (ec) {
+    std::cerr << "[NumpyExport] Cannot create " << directory << ": " << ec.message() << ", " << tree << " not exported." << std::endl;
+    return;
+  }
+  auto booked = std::make_shared<Booked>();
+  booked->directory = directory;
+
+  std::vector<std::string> names = {"rdfentry_"};
+  for (const auto& name : fColumns.empty() ? df.GetColumnNames() : fColumns)
+    if (name != "rdfentry_" && (!fColumns.empty() || name.rfind("DISANA_", 0) != 0)) names.push_back(name);
+  std::string pack;
+  std::vector<std::string> exported;
+  for (const auto& name : names) {
+    DType dtype;
+    const bool known = name == "rdfentry_" ? FindDType("ULong64_t", dtype) : df.HasColumn(name) && FindDType(df.GetColumnType(name), dtype);
+    if (!known) {
+      if (!fColumns.empty()) std::cerr << "[NumpyExport] " << name << " is missing or not a numeric scalar, not exported." << std::endl;
+      continue;
+    }
+    const std::string path = (fs::path(directory) / (name + ".npy")).string();
+    booked->columns.push_back({name, dtype.descr, dtype.size, booked->rowSize, std::ofstream(path, std::ios::binary)});
+    WriteHeader(booked->columns.back().file, dtype.descr, 0);
+    if (!booked->columns.back().file) {
+      std::cerr << "[NumpyExport] Cannot write " << path << ", " << tree << " not exported." << std::endl;
+      return;
+    }
+    booked->rowSize += dtype.size;
+    pack += (pack.empty() ? "" : ", ") + name;
+    exported.push_back(name);
+  }
+  if (booked->columns.size() < 2) {
+    std::cerr << "[NumpyExport] " << tree << " has no numeric scalar column to export." << std::endl;
+    return;
+  }
+
+  DeclareHelpers();
+  const unsigned int slots = df.GetNSlots();
+  booked->batches.assign(slots, std::vector<unsigned char>(kBatchRows * booked->rowSize));
+  booked->filled.assign(slots, 0);
+  for (auto& batch : booked->batches) booked->next.push_back(batch.data());
+  // the row is packed straight into the slot's batch; the booked state outlives the loop (captured below)
+  const std::string next = "reinterpret_cast<unsigned char* const*>(" + std::to_string(reinterpret_cast<std::uintptr_t>(booked->next.data())) + "ULL)";
+  const std::string row = "DISANA_npy_row";
+  auto sink = df.Define(row, "DISANA_Npy::Pack(" + next + ", rdfslot_, " + pack + ")").Filter(
+      [booked](unsigned int slot, bool) {
+        booked->Commit(slot);
+        return true;
+      },
+      {"rdfslot_", row});
+  DISANA_BOOK("NumpyExport", tree + " -> " + directory, exported);
+  booked->count = sink.Count();
+  fBooked[tree] = booked;
+}
+
+bool NumpyExport::Finish(const std::string& tree) {
+  auto it = fBooked.find(tree);
+  if (it == fBooked.end()) return false;
+  auto booked = it->second;
+  fBooked.erase(it);
+
+  std::lock_guard<std::mutex> lock(booked->mutex);
+  for (unsigned int slot = 0; slot < booked->batches.size(); ++slot)
+    if (booked->filled[slot] > 0) booked->Flush(slot);
+  // a failed write (disk or /dev/shm full) leaves the stream failed from then on
+  bool written = true;
+  std::ofstream list(fs::path(booked->directory) / "columns.txt");
+  for (auto& column : booked->columns) {
+    column.file.seekp(0);
+    WriteHeader(column.file, column.dtype, booked->rows);
+    column.file.close();
+    if (!column.file) {
+      std::cerr << "[NumpyExport] Could not write " << (fs::path(booked->directory) / (column.name + ".npy")).string() << std::endl;
+      written = false;
+    }
+    list << column.name << " " << column.dtype << "\n";
+  }
+  list.close();
+  if (!list) {
+    std::cerr << "[NumpyExport] Could not write " << (fs::path(booked->directory) / "columns.txt").string() << std::endl;
+    written = false;
+  }
+  if (!written) return false;
+  std::cout << "[NumpyExport] " << tree << ": " << booked->rows << " rows x " << booked->columns.size() << " columns -> " << booked->directory << std::endl;
+  return Verify(booked->directory);
+}
+
+bool NumpyExport::Write(ROOT::RDF::RNode df, const std::string& tree, const std::string& directory) {
+  Book(df, tree, directory);
+  auto it = fBooked.find(tree);
+  if (it == fBooked.end()) return false;
+  DISANA_WATCH(df, "NumpyExport(" + tree + ")", it->second->count.GetValue());
+  return Finish(tree);
+}
+
+bool NumpyExport::Verify(const std::string& directory) {
+  std::ifstream list(fs::path(directory) / "columns.txt");
+  if (!list) {
+    std::cerr << "[NumpyExport] No columns.txt in " << directory << std::endl;
+    return false;
+  }
+  long long rows = -1;
+  std::string name, dtype;
+  size_t columns = 0;
+  while (list >> name >> dtype) {
+    const std::string path = (fs::path(directory) / (name + ".npy")).string();
+    std::ifstream file(path, std::ios::binary);
+    char prefix[10] = {};
+    std::string error;
+    if (!file.read(prefix, sizeof(prefix)) || std::memcmp(prefix, "\x93NUMPY", 6) != 0 || prefix[6] != 1) {
+      error = "not a version 1 .npy file";
+    } else {
+      const size_t length = static_cast<unsigned char>(prefix[8]) | static_cast<unsigned char>(prefix[9]) << 8;
+      std::string header(length, ' ');
+      file.read(&header[0], length);
+      const size_t shape = header.find("'shape': (");
+      const long long n = shape == std::string::npos ? -1 : std::atoll(header.c_str() + shape + 10);
+      std::error_code ec;
+      const auto bytes = fs::file_size(path, ec);
+      const size_t itemsize = std::stoul(dtype.substr(2));
+      if (!file || header.find("'descr': '" + dtype + "'") == std::string::npos || header.find("'fortran_order': False") == std::string::npos)
+        error = "header does not match " + dtype;
+      else if (n < 0 || (rows >= 0 && n != rows))
+        error = "has " + std::to_string(n) + " rows, expected " + std::to_string(rows);
+      else if (ec || bytes != sizeof(prefix) + length + n * itemsize)
+        error = "size " + std::to_string(bytes) + " does not match its shape";
+      rows = n;
+    }
+    if (!error.empty()) {
+      std::cerr << "[NumpyExport] " << path << ": " << error << std::endl;
+      return false;
+    }
+    ++columns;
+  }
+  return columns > 0;
+}
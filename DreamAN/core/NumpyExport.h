@@ -0,0 +1,75 @@
+#ifndef NUMPYEXPORT_H
+#define NUMPYEXPORT_H
+
+#include <Rtypes.h>
+
+#include <ROOT/RDF/RInterface.hxx>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Candidate-level columns of a snapshot as NumPy .npy files, filled in the event loop of the
+// snapshot, for the Python classifier training:
+//
+//   mgr.SetNumpyExport(std::make_shared<NumpyExport>());  // every numeric scalar column
+//
+// The tasks export their best exclusive candidate with it (AnalysisTask::DefineExportColumns):
+// ele_px ... pho_pz, cand_score and cand_Q2/xB/W/t, one row per event with a candidate.
+//
+//   cols = {c: np.load(f"dfSelected_npy/{c}.npy", mmap_mode="r") for c in open("dfSelected_npy/columns.txt").read().split()[::2]}
+//
+// One little-endian 1-d array per column plus rdfentry_ (the input entry, to join back to the
+// snapshot); np.load with mmap_mode maps them without a copy. Every slot packs its rows in place
+// into its batch of kBatchRows; a full batch is scattered into the column files under a lock, so the files
+// stay row-aligned (in batch order, like a Snapshot under ImplicitMT). The directory can be on
+// /dev/shm for a shared-memory hand-off. Finish() writes the final shapes and checks the layout
+// with Verify(), which is also the reader for a copied directory. ./NumpyExportCheck writes known
+// values and reads them back with its own .npy reader.
+class NumpyExport {
+ public:
+  static constexpr size_t kBatchRows = 65536;
+
+  explicit NumpyExport(const std::vector<std::string>& columns = {}) : fColumns(columns) {}
+
+  // Books the export of tree into directory on df's next event loop
+  void Book(ROOT::RDF::RNode df, const std::string& tree, const std::string& directory);
+  // After that loop: flushes the partial batches, writes the shapes and columns.txt
+  bool Finish(const std::string& tree);
+  // Book + run the loop + Finish
+  bool Write(ROOT::RDF::RNode df, const std::string& tree, const std::string& directory);
+
+  // Every column file is a .npy of the dtype of columns.txt with the same number of rows
+  static bool Verify(const std::string& directory);
+  static std::string Directory(const std::string& filename);  // <stem>_npy next to the file
+
+ private:
+  struct Column {
+    std::string name;
+    std::string dtype;  // '<f4', '|b1', ...
+    size_t size;
+    size_t offset;  // in the packed row
+    std::ofstream file;
+  };
+  struct Booked {
+    std::string directory;
+    std::vector<Column> columns;
+    size_t rowSize = 0;
+    ULong64_t rows = 0;
+    std::vector<std::vector<unsigned char>> batches;  // per slot, kBatchRows packed rows
+    std::vector<size_t> filled;                       // per slot, rows in the batch
+    std::vector<unsigned char*> next;                 // per slot, where the next row is packed
+    std::mutex mutex;
+    ROOT::RDF::RResultPtr<ULong64_t> count;  // keeps the booked sink in the loop
+
+    void Commit(unsigned int slot);
+    void Flush(unsigned int slot);
+  };
+
+  std::vector<std::string> fColumns;
+  std::map<std::string, std::shared_ptr<Booked>> fBooked;  // by tree, until Finish
+};
+
+#endif  // NUMPYEXPORT_H
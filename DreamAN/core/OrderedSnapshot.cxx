@@ -0,0 +1,107 @@
+#include "OrderedSnapshot.h"
+
+#include <TBranch.h>
+#include <TFile.h>
+#include <TROOT.h>
+#include <TStopwatch.h>
+#include <TTree.h>
+
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+
+void OrderedSnapshot::Write(ROOT::RDF::RNode df, const std::string& treename, const std::string& filename, const std::vector<std::string>& columns) {
+  if (!ROOT::IsImplicitMTEnabled()) {
+    df.Snapshot(treename, filename, columns);  // single-threaded output is already in rdfentry_ order
+    return;
+  }
+
+  const std::string unorderedFile = filename + ".unordered.root";
+  auto tagged = df.Define(kTagColumn, [](ULong64_t entry) { return entry; }, {"rdfentry_"});
+  auto taggedColumns = columns;
+  taggedColumns.push_back(kTagColumn);
+
+  TStopwatch timer;
+  tagged.Snapshot(treename, unorderedFile, taggedColumns);
+  const double tSnapshot = timer.RealTime();
+
+  timer.Start();
+  const size_t nRuns = MergeInOrder(unorderedFile, treename, filename);
+  const double tMerge = timer.RealTime();
+  std::remove(unorderedFile.c_str());
+
+  std::cout << "[OrderedSnapshot] " << treename << ": unordered snapshot " << tSnapshot << " s, k-way merge of " << nRuns << " runs " << tMerge << " s ("
+            << (tSnapshot > 0 ? 100.0 * tMerge / tSnapshot : 0.0) << "% overhead)" << std::endl;
+}
+
+size_t OrderedSnapshot::MergeInOrder(const std::string& unorderedFile, const std::string& treename, const std::string& filename) {
+  std::unique_ptr<TFile> in(TFile::Open(unorderedFile.c_str(), "READ"));
+  if (!in || in->IsZombie()) throw std::runtime_error("OrderedSnapshot: cannot open " + unorderedFile);
+  auto* tree = in->Get<TTree>(treename.c_str());
+  if (!tree) throw std::runtime_error("OrderedSnapshot: tree " + treename + " not found in " + unorderedFile);
+
+  TBranch* tagBranch = tree->GetBranch(kTagColumn);
+  if (!tagBranch) throw std::runtime_error(std::string("OrderedSnapshot: missing tag column ") + kTagColumn);
+  ULong64_t tag = 0;
+  tree->SetBranchAddress(kTagColumn, &tag);
+
+  // 1) Find the sorted runs: every worker flush is increasing in the tag.
+  std::vector<std::pair<Long64_t, Long64_t>> runs;  // [begin, end)
+  const Long64_t nEntries = tree->GetEntries();
+  ULong64_t previous = 0;
+  for (Long64_t i = 0; i < nEntries; ++i) {
+    tagBranch->GetEntry(i);
+    if (i == 0 || tag <= previous) runs.emplace_back(i, i);
+    runs.back().second = i + 1;
+    previous = tag;
+  }
+
+  // 2) Output tree with every branch but the tag.
+  std::unique_ptr<TFile> out(TFile::Open(filename.c_str(), "RECREATE"));
+  if (!out || out->IsZombie()) throw std::runtime_error("OrderedSnapshot: cannot create " + filename);
+  out->SetCompressionSettings(in->GetCompressionSettings());
+  tree->SetBranchStatus(kTagColumn, false);
+  out->cd();
+  TTree* ordered = tree->CloneTree(0);
+  tree->SetBranchStatus(kTagColumn, true);
+  tree->SetBranchAddress(kTagColumn, &tag);
+
+  // 3) k-way merge, one buffered head tag per run. The run with the smallest head is copied
+  // sequentially up to the next head of the other runs, so reads only jump at range boundaries.
+  tree->SetCacheSize(64 * 1024 * 1024);
+  tree->AddBranchToCache("*", true);
+  using Head = std::pair<ULong64_t, size_t>;  // (tag, run index)
+  std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+  std::vector<Long64_t> cursor(runs.size());
+  for (size_t r = 0; r < runs.size(); ++r) {
+    cursor[r] = runs[r].first;
+    tagBranch->GetEntry(cursor[r]);
+    heads.emplace(tag, r);
+  }
+  size_t nSegments = 0;
+  while (!heads.empty()) {
+    const size_t r = heads.top().second;
+    heads.pop();
+    const ULong64_t bound = heads.empty() ? std::numeric_limits<ULong64_t>::max() : heads.top().first;
+    ++nSegments;
+    bool more = true;
+    do {
+      tree->GetEntry(cursor[r]);
+      ordered->Fill();
+      more = ++cursor[r] < runs[r].second;
+      if (more) tagBranch->GetEntry(cursor[r]);
+    } while (more && tag < bound);
+    if (more) heads.emplace(tag, r);
+  }
+  std::cout << "[OrderedSnapshot] " << treename << ": merged " << runs.size() << " runs in " << nSegments << " sequential segments" << std::endl;
+
+  ordered->Write();
+  out->Close();
+  in->Close();
+  return runs.size();
+}
@@ -0,0 +1,38 @@
+#ifndef ORDEREDSNAPSHOT_H
+#define ORDEREDSNAPSHOT_H
+
+#include <ROOT/RDF/RInterface.hxx>
+#include <string>
+#include <vector>
+
+// Deterministic output order for multithreaded snapshots.
+//
+// With ImplicitMT every worker flushes its own clusters, so the entry order of the
+// output depends on scheduling. In ordered mode each entry is tagged with its rdfentry_,
+// the snapshot is written unordered to a temporary file, and a streaming k-way merge over
+// the sorted runs written by the workers restores rdfentry_ order.
+//
+// rdfentry_ order is the input order only for TTree/TChain sources, where rdfentry_ is the
+// global entry number (file offset plus entry) under MT as well. A data source numbers the
+// entries itself: for the HIPO RDataSource (RHipoDS) rdfentry_ follows the entry ranges it
+// hands out, which is not the HIPO file order, and RUN_config_run/RUN_config_event are not
+// used to restore that order.
+//
+// Every worker processes whole entry ranges of the input, so the runs interleave only at
+// range boundaries. The merge therefore copies a run sequentially for as long as its tags
+// stay below the heads of all other runs, and only jumps between runs at those boundaries;
+// with the tree cache this keeps the reads basket by basket. Only one head tag per run is
+// buffered, so memory stays bounded by the number of runs.
+class OrderedSnapshot {
+ public:
+  static constexpr const char* kTagColumn = "DISANA_inputEntry";
+
+  // Snapshot df in rdfentry_ order. Falls back to a plain snapshot when ImplicitMT is off.
+  static void Write(ROOT::RDF::RNode df, const std::string& treename, const std::string& filename, const std::vector<std::string>& columns);
+
+  // Rewrites an unordered tree carrying the tag column into filename, sorted by tag and without the tag.
+  // Returns the number of sorted runs that were merged.
+  static size_t MergeInOrder(const std::string& unorderedFile, const std::string& treename, const std::string& filename);
+};
+
+#endif  // ORDEREDSNAPSHOT_H
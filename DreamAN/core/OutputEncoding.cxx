@@ -0,0 +1,380 @@
+#include "OutputEncoding.h"
+
+#include <TFile.h>
+#include <TInterpreter.h>
+#include <TNamed.h>
+
+#include <ROOT/RDataFrame.hxx>
+#include <ROOT/RVec.hxx>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace {
+constexpr long long kEmpty = OutputEncoding::Dictionary::kEmptySlot;
+
+// Encoders and decoders, templated so they take std::vector (HIPO) and RVec (ROOT input) columns alike
+void DeclareHelpers() {
+  static const bool declared = gInterpreter->Declare(R"(
+    #include <cmath>
+    #include <cstdint>
+    #include <cstring>
+    #include <type_traits>
+    #include <vector>
+    namespace DISANA_Encoding {
+    template <typename F, typename U, int kMantissaBits> F Round(F x, int bits) {
+      U u;
+      std::memcpy(&u, &x, sizeof(F));
+      const int drop = kMantissaBits - bits;
+      if (drop <= 0 || std::isnan(x) || std::isinf(x)) return x;
+      u += U(1) << (drop - 1);  // round half up; a carry into the exponent is the correct rounding
+      u &= ~((U(1) << drop) - 1);
+      std::memcpy(&x, &u, sizeof(F));
+      return x;
+    }
+    template <typename T> T RoundValue(T x, int bits) {
+      if constexpr (std::is_same_v<T, float>) return Round<float, uint32_t, 23>(x, bits);
+      else if constexpr (std::is_same_v<T, double>) return Round<double, uint64_t, 52>(x, bits);
+      else return x;
+    }
+    template <typename T> T Mantissa(const T& v, int bits) {
+      if constexpr (std::is_arithmetic_v<T>) return RoundValue(v, bits);
+      else {
+        T out(v.begin(), v.end());
+        for (auto& x : out) x = RoundValue(x, bits);
+        return out;
+      }
+    }
+
+    inline short Fixed(double x, double step) {
+      if (std::isnan(x)) return 0;
+      const double q = std::round(x / step);
+      return short(q > 32767 ? 32767 : q < -32767 ? -32767 : q);
+    }
+    template <typename T> auto ToFixed(const T& v, double step) {
+      if constexpr (std::is_arithmetic_v<T>) return Fixed(v, step);
+      else {
+        std::vector<short> out(v.size());
+        for (size_t i = 0; i < v.size(); ++i) out[i] = Fixed(v[i], step);
+        return out;
+      }
+    }
+    template <typename T, typename Q> T FromFixed(const Q& q, double step) {
+      if constexpr (std::is_arithmetic_v<T>) return T(q * step);
+      else {
+        T out(q.size());
+        for (size_t i = 0; i < q.size(); ++i) out[i] = q[i] * step;
+        return out;
+      }
+    }
+
+    // byte 0: unused bits of the last byte, then the flags 8 per byte
+    template <typename T> std::vector<unsigned char> ToBits(const T& v) {
+      std::vector<unsigned char> out(1 + (v.size() + 7) / 8, 0);
+      out[0] = (8 - v.size() % 8) % 8;
+      for (size_t i = 0; i < v.size(); ++i)
+        if (v[i]) out[1 + i / 8] |= 1 << (i % 8);
+      return out;
+    }
+    template <typename T, typename B> T FromBits(const B& b) {
+      const size_t n = b.empty() ? 0 : (b.size() - 1) * 8 - b[0];
+      T out(n);
+      for (size_t i = 0; i < n; ++i) out[i] = (b[1 + i / 8] >> (i % 8)) & 1;
+      return out;
+    }
+
+    }  // namespace DISANA_Encoding
+  )");
+  (void)declared;
+}
+
+const char* CodecName(OutputEncoding::Codec codec) {
+  switch (codec) {
+    case OutputEncoding::Codec::kMantissa: return "mantissa";
+    case OutputEncoding::Codec::kFixedPoint: return "fixed";
+    case OutputEncoding::Codec::kBits: return "bits";
+    case OutputEncoding::Codec::kDictionary: return "dictionary";
+  }
+  return "";
+}
+
+bool ParseCodec(const std::string& name, OutputEncoding::Codec& codec) {
+  for (auto c : {OutputEncoding::Codec::kMantissa, OutputEncoding::Codec::kFixedPoint, OutputEncoding::Codec::kBits, OutputEncoding::Codec::kDictionary}) {
+    if (name == CodecName(c)) {
+      codec = c;
+      return true;
+    }
+  }
+  return false;
+}
+
+// "ROOT::VecOps::RVec<float>" -> "float", "float" -> "float"
+std::string ElementType(const std::string& type) {
+  const size_t open = type.find('<');
+  const size_t close = type.rfind('>');
+  if (open == std::string::npos || close == std::string::npos || close < open) return type;
+  std::string element = type.substr(open + 1, close - open - 1);
+  element.erase(0, element.find_first_not_of(' '));
+  element.erase(element.find_last_not_of(' ') + 1);
+  return element;
+}
+
+bool IsFloat(const std::string& element) {
+  static const std::set<std::string> types = {"float", "Float_t", "double", "Double_t", "Float16_t", "Double32_t"};
+  return types.count(element) > 0;
+}
+
+bool IsInteger(const std::string& element) {
+  static const std::set<std::string> types = {"bool", "Bool_t", "char", "Char_t", "signed char", "unsigned char", "UChar_t", "short", "Short_t", "unsigned short", "UShort_t",
+                                              "int", "Int_t", "unsigned int", "UInt_t", "long", "Long_t", "long long", "Long64_t", "int8_t", "int16_t", "int32_t", "int64_t"};
+  return types.count(element) > 0;
+}
+
+bool Matches(const std::string& pattern, const std::string& column) {
+  if (!pattern.empty() && pattern.back() == '*') return column.compare(0, pattern.size() - 1, pattern, 0, pattern.size() - 1) == 0;
+  if (!pattern.empty() && pattern.front() == '*')
+    return column.size() >= pattern.size() - 1 && column.compare(column.size() - (pattern.size() - 1), pattern.size() - 1, pattern, 1, pattern.size() - 1) == 0;
+  return pattern == column;
+}
+
+std::string Number(double value) {
+  std::ostringstream os;
+  os.precision(17);
+  os << value;
+  return os.str();
+}
+
+// Calls f with a value of the C++ type of an integer column the dictionary codec takes (scalar,
+// std::vector or RVec); false for any other type
+template <typename F>
+bool WithIntegerType(const std::string& type, F&& f) {
+  const std::string element = ElementType(type);
+  const bool container = element != type;
+  auto visit = [&](auto value) {
+    using T = decltype(value);
+    if (!container)
+      f(T{});
+    else if (type.find("RVec") != std::string::npos)
+      f(ROOT::RVec<T>{});
+    else if (type.find("vector") != std::string::npos)
+      f(std::vector<T>{});
+    else
+      return false;
+    return true;
+  };
+  if (element == "int" || element == "Int_t" || element == "int32_t") return visit(int{});
+  if (element == "short" || element == "Short_t" || element == "int16_t") return visit(short{});
+  if (element == "char" || element == "Char_t") return visit(char{});
+  if (element == "signed char" || element == "int8_t") return visit(static_cast<signed char>(0));
+  if (element == "unsigned char" || element == "UChar_t") return visit(static_cast<unsigned char>(0));
+  if (element == "unsigned short" || element == "UShort_t") return visit(static_cast<unsigned short>(0));
+  if (element == "unsigned int" || element == "UInt_t") return visit(0u);
+  if (element == "long" || element == "Long_t") return visit(0L);
+  if (element == "long long" || element == "Long64_t" || element == "int64_t") return visit(0LL);
+  return false;
+}
+
+// Lock-free insert-or-find: codes 1..kDictionarySize are table slots. A value that finds the table
+// full fails the event loop, and with it the snapshot.
+unsigned char Code(long long value, OutputEncoding::Dictionary& dictionary) {
+  for (int i = 0; i < OutputEncoding::kDictionarySize; ++i) {
+    long long current = dictionary.values[i].load(std::memory_order_acquire);
+    if (current == value) return i + 1;
+    if (current == kEmpty && (dictionary.values[i].compare_exchange_strong(current, value) || current == value)) return i + 1;
+  }
+  throw std::runtime_error("OutputEncoding: " + dictionary.column + " has more than " + std::to_string(OutputEncoding::kDictionarySize) + " distinct values, use another codec");
+}
+
+template <typename T>
+auto ToCodes(const T& v, OutputEncoding::Dictionary& dictionary) {
+  if constexpr (std::is_arithmetic_v<T>)
+    return Code(v, dictionary);
+  else {
+    std::vector<unsigned char> out(v.size());
+    for (size_t i = 0; i < v.size(); ++i) out[i] = Code(v[i], dictionary);
+    return out;
+  }
+}
+
+long long Value(unsigned char code, const std::vector<long long>& values) {
+  if (code == 0 || code > values.size()) throw std::runtime_error("OutputEncoding: dictionary code " + std::to_string(code) + " outside the stored dictionary");
+  return values[code - 1];
+}
+
+template <typename T, typename C>
+T FromCodes(const C& c, const std::vector<long long>& values) {
+  if constexpr (std::is_arithmetic_v<T>)
+    return static_cast<T>(Value(c, values));
+  else {
+    T out(c.size());
+    for (size_t i = 0; i < c.size(); ++i) out[i] = Value(c[i], values);
+    return out;
+  }
+}
+
+}  // namespace
+
+OutputEncoding OutputEncoding::Physics() {
+  OutputEncoding encoding;
+  // 12 bits: 1e-4 relative, far below the 0.5-3 % momentum resolution
+  for (const char* p : {"REC_Particle_px", "REC_Particle_py", "REC_Particle_pz", "REC_Particle_beta"}) encoding.AddRule({p, Codec::kMantissa, 12});
+  for (const char* v : {"REC_Particle_vx", "REC_Particle_vy", "REC_Particle_vz", "REC_Particle_vt"}) encoding.AddRule({v, Codec::kFixedPoint, 0.01});  // 0.1 mm, 10 ps
+  encoding.AddRule({"REC_Particle_chi2pid", Codec::kMantissa, 8});
+  for (const char* d : {"REC_Particle_pid", "REC_Particle_charge", "REC_Particle_status"}) encoding.AddRule({d, Codec::kDictionary, 0});
+  encoding.AddRule({"*_pass_fid", Codec::kBits, 0});
+  encoding.AddRule({"*_pass", Codec::kBits, 0});
+  for (const char* bank : {"REC_Calorimeter_*", "REC_Traj_*", "REC_Track_*", "REC_ForwardTagger_*", "REC_Scintillator_*", "REC_Cherenkov_*"}) encoding.AddRule({bank, Codec::kMantissa, 12});
+  return encoding;
+}
+
+std::string OutputEncoding::Fingerprint() const {
+  std::ostringstream os;
+  for (const auto& rule : fRules) os << "encoding " << rule.pattern << " " << CodecName(rule.codec) << " " << Number(rule.parameter) << "\n";
+  return os.str();
+}
+
+const OutputEncoding::Rule* OutputEncoding::Match(const std::string& column, const std::string& type) const {
+  const std::string element = ElementType(type);
+  const bool container = element != type;
+  for (const auto& rule : fRules) {
+    if (!Matches(rule.pattern, column)) continue;
+    const bool fits = rule.codec == Codec::kMantissa || rule.codec == Codec::kFixedPoint ? IsFloat(element)
+                      : rule.codec == Codec::kBits                                     ? container && IsInteger(element)
+                                                                                       : IsInteger(element);
+    if (fits) return &rule;
+  }
+  return nullptr;
+}
+
+ROOT::RDF::RNode OutputEncoding::Encode(ROOT::RDF::RNode df, const std::string& tree, const std::vector<std::string>& columns) {
+  DeclareHelpers();
+  auto& booked = fBooked[tree];
+  booked.clear();
+  for (const auto& column : columns) {
+    const std::string type = df.GetColumnType(column);
+    const Rule* rule = Match(column, type);
+    if (!rule) continue;
+    Encoded encoded{column, type, *rule, nullptr};
+    std::string expression;
+    switch (rule->codec) {
+      case Codec::kMantissa:
+        expression = "DISANA_Encoding::Mantissa(" + column + ", " + std::to_string(static_cast<int>(rule->parameter)) + ")";
+        break;
+      case Codec::kFixedPoint:
+        expression = "DISANA_Encoding::ToFixed(" + column + ", " + Number(rule->parameter) + ")";
+        break;
+      case Codec::kBits:
+        expression = "DISANA_Encoding::ToBits(" + column + ")";
+        break;
+      case Codec::kDictionary: {
+        // typed, so the functor owns its dictionary; the manifest reads it after the loop
+        auto dictionary = std::make_shared<Dictionary>(column);
+        encoded.dictionary = dictionary;
+        const bool typed = WithIntegerType(type, [&](auto value) {
+          using T = decltype(value);
+          df = df.Redefine(column, [dictionary](const T& v) { return ToCodes(v, *dictionary); }, {column});
+        });
+        if (!typed) {
+          std::cerr << "[OutputEncoding] " << column << " of type " << type << " has no dictionary encoder, stored as is." << std::endl;
+          continue;
+        }
+        break;
+      }
+    }
+    if (!expression.empty()) df = df.Redefine(column, expression);
+    booked.push_back(std::move(encoded));
+  }
+  if (booked.empty()) {
+    fBooked.erase(tree);
+    return df;
+  }
+  return df.HasColumn(kEncodedColumn) ? df : df.Define(kEncodedColumn, [] { return true; });
+}
+
+void OutputEncoding::WriteManifest(const std::string& tree, const std::vector<std::string>& filenames) {
+  auto it = fBooked.find(tree);
+  if (it == fBooked.end()) return;
+  // column \t codec \t parameter \t original type [\t dictionary values]
+  std::ostringstream manifest;
+  std::map<std::string, int> counts;
+  for (const auto& encoded : it->second) {
+    manifest << encoded.column << '\t' << CodecName(encoded.rule.codec) << '\t' << Number(encoded.rule.parameter) << '\t' << encoded.type;
+    if (encoded.dictionary) {
+      manifest << '\t';
+      for (int i = 0; i < kDictionarySize && encoded.dictionary->values[i] != kEmpty; ++i) manifest << (i ? " " : "") << encoded.dictionary->values[i].load();
+    }
+    manifest << '\n';
+    ++counts[CodecName(encoded.rule.codec)];
+  }
+  fBooked.erase(it);
+
+  for (const auto& filename : filenames) {
+    std::unique_ptr<TFile> file(TFile::Open(filename.c_str(), "UPDATE"));
+    if (!file || file->IsZombie()) {
+      std::cerr << "[OutputEncoding] Cannot open " << filename << ", its encoded columns cannot be decoded." << std::endl;
+      continue;
+    }
+    TNamed named(ManifestName(tree).c_str(), manifest.str().c_str());
+    named.Write(nullptr, TObject::kOverwrite);
+    file->Close();
+  }
+  std::cout << "[OutputEncoding] " << tree << ":";
+  for (const auto& [codec, n] : counts) std::cout << " " << n << " " << codec;
+  std::cout << " -> " << filenames.front();
+  if (filenames.size() > 1) std::cout << " and " << filenames.size() - 1 << " partitions";
+  std::cout << std::endl;
+}
+
+ROOT::RDF::RNode OutputEncoding::Decode(ROOT::RDF::RNode df, const std::string& filename, const std::string& tree) {
+  std::unique_ptr<TFile> file(TFile::Open(filename.c_str(), "READ"));
+  if (!file || file->IsZombie()) return df;
+  auto* named = file->Get<TNamed>(ManifestName(tree).c_str());
+  if (!named) return df;
+  DeclareHelpers();
+
+  std::istringstream manifest(named->GetTitle());
+  std::string line;
+  while (std::getline(manifest, line)) {
+    std::vector<std::string> fields;
+    std::istringstream is(line);
+    for (std::string field; std::getline(is, field, '\t');) fields.push_back(field);
+    Codec codec;
+    if (fields.size() < 4 || !ParseCodec(fields[1], codec)) {
+      std::cerr << "[OutputEncoding] Bad manifest line in " << filename << ": " << line << std::endl;
+      continue;
+    }
+    const std::string& column = fields[0];
+    const std::string& parameter = fields[2];
+    const std::string& type = fields[3];
+    if (!df.HasColumn(column)) continue;
+    switch (codec) {
+      case Codec::kMantissa:
+        break;
+      case Codec::kFixedPoint:
+        df = df.Redefine(column, "DISANA_Encoding::FromFixed<" + type + ">(" + column + ", " + parameter + ")");
+        break;
+      case Codec::kBits:
+        df = df.Redefine(column, "DISANA_Encoding::FromBits<" + type + ">(" + column + ")");
+        break;
+      case Codec::kDictionary: {
+        auto dictionary = std::make_shared<std::vector<long long>>();
+        std::istringstream values(fields.size() > 4 ? fields[4] : "");
+        for (long long value; values >> value;) dictionary->push_back(value);
+        const bool decoded = WithIntegerType(type, [&](auto value) {
+          using T = decltype(value);
+          if constexpr (std::is_arithmetic_v<T>)
+            df = df.Redefine(column, [dictionary](unsigned char c) { return FromCodes<T>(c, *dictionary); }, {column});
+          else
+            df = df.Redefine(column, [dictionary](const ROOT::RVec<unsigned char>& c) { return FromCodes<T>(c, *dictionary); }, {column});
+        });
+        if (!decoded) std::cerr << "[OutputEncoding] Cannot decode " << column << " of type " << type << " in " << filename << std::endl;
+        break;
+      }
+    }
+  }
+  return df;
+}
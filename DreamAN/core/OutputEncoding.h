@@ -0,0 +1,85 @@
+#ifndef OUTPUTENCODING_H
+#define OUTPUTENCODING_H
+
+#include <ROOT/RDF/RInterface.hxx>
+#include <atomic>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Precision-controlled encoding of snapshot columns. Per column (name, prefix* or *suffix pattern;
+// the first rule that matches the name and fits the column type wins):
+//   kMantissa    floats rounded to `parameter` mantissa bits; same type, nothing to decode, but
+//                the zeroed low bits compress away
+//   kFixedPoint  floats stored as 16-bit integers of step `parameter` (clamped at +-32767 steps)
+//   kBits        0/1 vectors (pass flags) packed 8 per byte
+//   kDictionary  integers (pid, status) stored as 8-bit codes; the dictionary is filled during the
+//                event loop, and a 256th distinct value fails the snapshot
+//
+//   mgr.SetOutputEncoding(std::make_shared<OutputEncoding>(OutputEncoding::Physics()));
+//
+// How a tree was encoded is stored in its file as the TNamed <tree>_encoding. Decode() turns the
+// columns back into their original types; the stage cache, BitmapIndex and ZoneMapReader apply it
+// on read, analysis macros reading the outputs directly do
+//
+//   auto df = OutputEncoding::Decode(ROOT::RDataFrame(tree, file), file, tree);
+//
+// macros/mainEncodingBenchmark.C compares size, read time and the (xB, Q2, t) yields with the raw file.
+class OutputEncoding {
+ public:
+  enum class Codec { kMantissa, kFixedPoint, kBits, kDictionary };
+  struct Rule {
+    std::string pattern;
+    Codec codec;
+    double parameter = 0;  // mantissa bits or fixed-point step
+  };
+  static constexpr int kDictionarySize = 255;
+  // Values seen by a kDictionary column, code = slot + 1; shared by its encoder and the manifest
+  struct Dictionary {
+    explicit Dictionary(const std::string& name) : column(name) {
+      for (auto& value : values) value = kEmptySlot;
+    }
+    static constexpr long long kEmptySlot = std::numeric_limits<long long>::min();
+    std::string column;
+    std::atomic<long long> values[kDictionarySize];
+  };
+
+  void AddRule(const Rule& rule) { fRules.push_back(rule); }
+  const std::vector<Rule>& GetRules() const { return fRules; }
+  std::string Fingerprint() const;  // part of the stage cache configuration
+
+  // Momenta, vertices, detector positions and energies within resolution; pass flags as bits;
+  // pid, charge and status as dictionaries. Run, event and helicity columns are left untouched.
+  static OutputEncoding Physics();
+
+  // df with the matched columns redefined to their encoded form, to be snapshotted as tree.
+  // Columns that read the raw values (partition selections, clustered keys) go on df first.
+  ROOT::RDF::RNode Encode(ROOT::RDF::RNode df, const std::string& tree, const std::vector<std::string>& columns);
+  // Whether df comes out of Encode with at least one column encoded
+  static bool IsEncoded(ROOT::RDF::RNode df) { return df.HasColumn(kEncodedColumn); }
+  static constexpr const char* kEncodedColumn = "DISANA_encoded";  // marker, never read
+  // After the snapshot: stores the encoding of tree (with the filled dictionaries) in filename,
+  // or in every file written from the encoded node (the snapshot and its partitions)
+  void WriteManifest(const std::string& tree, const std::vector<std::string>& filenames);
+  void WriteManifest(const std::string& tree, const std::string& filename) { WriteManifest(tree, std::vector<std::string>{filename}); }
+
+  // df with the encoded columns of tree in filename restored; df itself for files without encoding
+  static ROOT::RDF::RNode Decode(ROOT::RDF::RNode df, const std::string& filename, const std::string& tree);
+  static std::string ManifestName(const std::string& tree) { return tree + "_encoding"; }
+
+ private:
+  struct Encoded {
+    std::string column;
+    std::string type;  // before encoding, restored by Decode
+    Rule rule;
+    std::shared_ptr<Dictionary> dictionary;  // kDictionary only
+  };
+  const Rule* Match(const std::string& column, const std::string& type) const;
+
+  std::vector<Rule> fRules;
+  std::map<std::string, std::vector<Encoded>> fBooked;  // by tree, until WriteManifest
+};
+
+#endif  // OUTPUTENCODING_H
@@ -0,0 +1,87 @@
+#include "OutputWriter.h"
+
+#include <TROOT.h>
+
+#include <chrono>
+#include <exception>
+#include <iostream>
+
+namespace {
+double SecondsSince(std::chrono::steady_clock::time_point start) { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); }
+}  // namespace
+
+OutputWriter::OutputWriter(size_t maxQueued) : fMaxQueued(maxQueued > 0 ? maxQueued : 1) {
+  ROOT::EnableThreadSafety();  // the writer thread does ROOT I/O next to the event loop
+  fThread = std::thread(&OutputWriter::Run, this);
+}
+
+OutputWriter::~OutputWriter() {
+  WaitIdle();
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    fStop = true;
+  }
+  fWakeWriter.notify_all();
+  fThread.join();
+}
+
+void OutputWriter::Submit(const std::string& label, std::function<void()> job) {
+  const auto start = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(fMutex);
+  if (fQueue.size() >= fMaxQueued) {
+    fWakeProducers.wait(lock, [this] { return fQueue.size() < fMaxQueued; });
+    fProducerWait += SecondsSince(start);
+  }
+  fQueue.push_back({label, std::move(job)});
+  lock.unlock();
+  fWakeWriter.notify_one();
+}
+
+void OutputWriter::Run() {
+  while (true) {
+    std::unique_lock<std::mutex> lock(fMutex);
+    fWakeWriter.wait(lock, [this] { return fStop || !fQueue.empty(); });
+    if (fQueue.empty()) return;  // stopping
+    Job job = std::move(fQueue.front());
+    fQueue.pop_front();
+    fBusy = true;
+    lock.unlock();
+    fWakeProducers.notify_all();
+
+    const auto start = std::chrono::steady_clock::now();
+    try {
+      job.work();
+    } catch (const std::exception& e) {
+      std::cerr << "[OutputWriter] " << job.label << " failed: " << e.what() << std::endl;
+    }
+    const double seconds = SecondsSince(start);
+
+    lock.lock();
+    fWriteTime += seconds;
+    ++fJobs;
+    fBusy = false;
+    lock.unlock();
+    fWakeProducers.notify_all();
+  }
+}
+
+double OutputWriter::WaitIdle() {
+  const auto start = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(fMutex);
+  fWakeProducers.wait(lock, [this] { return fQueue.empty() && !fBusy; });
+  const double waited = SecondsSince(start);
+  fFlushWait += waited;
+  return waited;
+}
+
+double OutputWriter::Flush() {
+  const double waited = WaitIdle();
+  if (fJobs > 0) PrintSummary();
+  return waited;
+}
+
+void OutputWriter::PrintSummary() const {
+  std::lock_guard<std::mutex> lock(fMutex);
+  std::cout << "[OutputWriter] " << fJobs << " jobs, " << fWriteTime << " s of output on the writer thread; main thread waited " << fProducerWait << " s on a full queue and "
+            << fFlushWait << " s in Flush" << std::endl;
+}
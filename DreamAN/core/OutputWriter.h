@@ -0,0 +1,65 @@
+#ifndef OUTPUTWRITER_H
+#define OUTPUTWRITER_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Output service: one writer thread that runs the output jobs (stage cache entries, event
+// indexes, the sampler metadata) in submission order while the main thread goes on with the next
+// event loop. The queue is bounded, a producer waits when it is full. Everything that writes
+// into the same TFile must go through the writer once it is in use; Flush() waits for the queue
+// and reports how long the main thread waited.
+//
+// Only work that can overlap a later event loop is queued. The histograms and trees registered
+// with the AnalysisTaskManager are written in SaveOutput after Flush(), on the main thread: they
+// go into the one shared output file after the last loop, so there is nothing left to overlap.
+// The plotting side (DISANAcomparer) does not use the writer, and partial results are not
+// written during a loop.
+//
+//   auto writer = std::make_shared<OutputWriter>(16);
+//   writer->Submit("index dfSelected.root", [] { ... });   // right after the snapshot's loop
+//   writer->Flush();
+class OutputWriter {
+ public:
+  explicit OutputWriter(size_t maxQueued = 16);
+  ~OutputWriter();
+  OutputWriter(const OutputWriter&) = delete;
+  OutputWriter& operator=(const OutputWriter&) = delete;
+
+  // Queues a job; blocks while the queue is full
+  void Submit(const std::string& label, std::function<void()> job);
+
+  // Waits until every queued job is done, then prints the timing. Returns the seconds waited.
+  double Flush();
+  void PrintSummary() const;
+
+ private:
+  struct Job {
+    std::string label;
+    std::function<void()> work;
+  };
+  void Run();
+  double WaitIdle();
+
+  size_t fMaxQueued;
+  std::deque<Job> fQueue;
+  bool fBusy = false;
+  bool fStop = false;
+  mutable std::mutex fMutex;
+  std::condition_variable fWakeWriter;
+  std::condition_variable fWakeProducers;
+  std::thread fThread;
+
+  // timing, in seconds
+  double fWriteTime = 0;
+  double fProducerWait = 0;
+  double fFlushWait = 0;
+  size_t fJobs = 0;
+};
+
+#endif  // OUTPUTWRITER_H
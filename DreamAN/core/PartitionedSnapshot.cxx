@@ -0,0 +1,139 @@
+#include "PartitionedSnapshot.h"
+
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include "EventLoopDiagnostics.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+// Region of the first passing particle of pid, as a JIT expression that works on std::vector
+// (HIPO input) and RVec (cached stage) columns alike
+std::string RegionExpression(int pid, bool maxEnergyPhoton) {
+  std::string particle = "REC_Particle_pid[i] == " + std::to_string(pid) + " && REC_Particle_pass[i]";
+  if (maxEnergyPhoton) particle += " && REC_Photon_MaxE[i]";
+  return "[&] { for (size_t i = 0; i < REC_Particle_pid.size(); ++i) if (" + particle +
+         ") { const int s = std::abs(REC_Particle_status[i]); return s >= 1000 && s < 2000 ? 0 : s >= 2000 && s < 3000 ? 1 : s >= 4000 && s < 5000 ? 2 : -1; } return -1; }()";
+}
+
+std::string FileName(const std::string& partition) {
+  std::string name = partition;
+  for (char& c : name)
+    if (!std::isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_' && c != '.') c = '_';
+  return name + ".root";
+}
+}  // namespace
+
+void PartitionedSnapshot::AddDimension(const std::string& dimension, const std::vector<Partition>& partitions) {
+  if (partitions.empty()) {
+    std::cerr << "[PartitionedSnapshot] Dimension " << dimension << " has no partitions, ignored." << std::endl;
+    return;
+  }
+  fDimensions.emplace_back(dimension, partitions);
+}
+
+std::vector<PartitionedSnapshot::Partition> PartitionedSnapshot::DVCSTopologies() {
+  return {{"FT-CD", "pho_det_region == 0 && pro_det_region == 2"}, {"FD-CD", "pho_det_region == 1 && pro_det_region == 2"}, {"FD-FD", "pho_det_region == 1 && pro_det_region == 1"}};
+}
+
+std::vector<PartitionedSnapshot::Partition> PartitionedSnapshot::Helicities() { return {{"pos", "helicity == 1"}, {"neg", "helicity == -1"}}; }
+
+std::vector<PartitionedSnapshot::Partition> PartitionedSnapshot::RunPeriods(const std::vector<RunRange>& periods) {
+  std::vector<Partition> partitions;
+  for (const auto& period : periods) partitions.push_back({period.name, "run >= " + std::to_string(period.first) + " && run <= " + std::to_string(period.last)});
+  return partitions;
+}
+
+ROOT::RDF::RNode PartitionedSnapshot::DefineColumns(ROOT::RDF::RNode df) {
+  const bool particles = df.HasColumn("REC_Particle_pid") && df.HasColumn("REC_Particle_status") && df.HasColumn("REC_Particle_pass");
+  if (particles) {
+    if (!df.HasColumn("pho_det_region")) df = df.Define("pho_det_region", RegionExpression(22, df.HasColumn("REC_Photon_MaxE")));
+    if (!df.HasColumn("pro_det_region")) df = df.Define("pro_det_region", RegionExpression(2212, false));
+    if (!df.HasColumn("ele_det_region")) df = df.Define("ele_det_region", RegionExpression(11, false));
+  }
+  if (!df.HasColumn("run")) df = df.Define("run", df.HasColumn("RUN_config_run") ? "RUN_config_run.empty() ? 0 : int(RUN_config_run[0])" : "0");
+  if (!df.HasColumn("helicity")) df = df.Define("helicity", df.HasColumn("REC_Event_helicity") ? "REC_Event_helicity.empty() ? 0 : int(REC_Event_helicity[0])" : "0");
+  return df;
+}
+
+std::string PartitionedSnapshot::Directory(const std::string& filename) {
+  fs::path path(filename);
+  return (path.parent_path() / (path.stem().string() + "_partitions")).string();
+}
+
+std::vector<PartitionedSnapshot::Partition> PartitionedSnapshot::Combinations() const {
+  std::vector<Partition> combinations = {{"", ""}};
+  for (const auto& [dimension, partitions] : fDimensions) {
+    std::vector<Partition> next;
+    for (const auto& prefix : combinations) {
+      for (const auto& p : partitions) {
+        if (prefix.name.empty())
+          next.push_back({p.name, "(" + p.selection + ")"});
+        else
+          next.push_back({prefix.name + "_" + p.name, prefix.selection + " && (" + p.selection + ")"});
+      }
+    }
+    combinations = std::move(next);
+  }
+  return combinations;
+}
+
+void PartitionedSnapshot::Book(ROOT::RDF::RNode df, const std::string& tree, const std::string& filename, const std::vector<std::string>& columns) {
+  if (!IsActive()) return;
+  const std::string dir = Directory(filename);
+  std::error_code ec;
+  fs::create_directories(dir, ec);
+  if (ec) {
+    std::cerr << "[PartitionedSnapshot] Cannot create " << dir << ": " << ec.message() << ", " << tree << " not partitioned." << std::endl;
+    return;
+  }
+
+  ROOT::RDF::RSnapshotOptions options;
+  options.fLazy = true;
+  Booked booked;
+  booked.source = filename;
+  booked.columns = columns;
+  booked.total = df.Count();
+  ROOT::RDF::RNode node = DefineColumns(df);
+  for (const auto& partition : Combinations()) {
+    auto selected = node.Filter(partition.selection, partition.name);
+    const std::string file = (fs::path(dir) / FileName(partition.name)).string();
+    DISANA_BOOK("Snapshot", tree + " -> " + file, columns);
+    booked.partitions.push_back({partition, file, selected.Count(), selected.Snapshot(tree, file, columns, options)});
+  }
+  fBooked[tree] = std::move(booked);
+}
+
+std::vector<std::string> PartitionedSnapshot::WriteManifest(const std::string& tree) {
+  auto it = fBooked.find(tree);
+  if (it == fBooked.end()) return {};
+  Booked& booked = it->second;
+
+  std::ofstream manifest(fs::path(Directory(booked.source)) / "manifest.txt");
+  manifest << "tree " << tree << "\nsource " << booked.source << " " << *booked.total << "\ndimensions";
+  for (const auto& dimension : fDimensions) manifest << " " << dimension.first;
+  manifest << "\ncolumns " << booked.columns.size();
+  for (const auto& column : booked.columns) manifest << " " << column;
+  manifest << "\n";
+  std::cout << "[PartitionedSnapshot] " << tree << " (" << *booked.total << " events):";
+  std::vector<std::string> files;
+  for (auto& p : booked.partitions) {
+    files.push_back(p.file);
+    manifest << "partition " << p.partition.name << " " << fs::path(p.file).filename().string() << " " << *p.entries << " " << p.partition.selection << "\n";
+    std::cout << " " << p.partition.name << " " << *p.entries;
+  }
+  std::cout << " -> " << Directory(booked.source) << std::endl;
+  fBooked.erase(it);
+  return files;
+}
+
+std::vector<std::string> PartitionedSnapshot::Write(ROOT::RDF::RNode df, const std::string& tree, const std::string& filename, const std::vector<std::string>& columns) {
+  Book(df, tree, filename, columns);
+  auto it = fBooked.find(tree);
+  if (it == fBooked.end()) return {};
+  DISANA_WATCH(df, "Snapshot(" + tree + ", partitions)", it->second.total.GetValue());
+  return WriteManifest(tree);
+}
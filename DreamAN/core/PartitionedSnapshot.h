@@ -0,0 +1,84 @@
+#ifndef PARTITIONEDSNAPSHOT_H
+#define PARTITIONEDSNAPSHOT_H
+
+#include <ROOT/RDF/RInterface.hxx>
+#include <ROOT/RDataFrame.hxx>
+#include <map>
+#include <string>
+#include <vector>
+
+// Per-topology (and per run period, per helicity) copies of a snapshot, written in the same
+// event loop as the snapshot itself.
+//
+// A partition is a named selection string (JIT-compiled, like the cut strings of the comparer);
+// the partitions written are the cartesian product of the dimensions added, e.g. topology x
+// helicity gives FT-CD_pos, FT-CD_neg, FD-CD_pos, ... For a snapshot <dir>/dfSelected.root the
+// partitions go to <dir>/dfSelected_partitions/<partition>.root, every one with the tree name
+// and the columns of the full snapshot, next to a manifest.txt listing the selection and entries
+// of each partition. An event lands in every partition whose selection it passes.
+//
+//   auto parts = std::make_shared<PartitionedSnapshot>();
+//   parts->AddDimension("topology", PartitionedSnapshot::DVCSTopologies());
+//   parts->AddDimension("helicity", PartitionedSnapshot::Helicities());
+//   mgr.SetPartitioning(parts);   // every SafeSnapshot of the tasks is partitioned
+//
+// The presets select on columns added by DefineColumns(): pho/pro/ele_det_region (0 FT, 1 FD,
+// 2 CD, -1 none; first passing particle, the REC_Photon_MaxE photon), run and helicity. With an
+// OutputEncoding the partitions are booked on the encoded node, so they hold the same encoded
+// columns as the snapshot; define the preset columns before encoding (SafeSnapshot does), since
+// a selection on an encoded column sees its codes. Nothing in the tree reads the partitions back
+// yet: they are for per-topology fits and external readers, decoded with OutputEncoding::Decode.
+class PartitionedSnapshot {
+ public:
+  struct Partition {
+    std::string name;
+    std::string selection;
+  };
+  struct RunRange {
+    std::string name;
+    int first;
+    int last;
+  };
+
+  void AddDimension(const std::string& dimension, const std::vector<Partition>& partitions);
+  bool IsActive() const { return !fDimensions.empty(); }
+
+  static std::vector<Partition> DVCSTopologies();  // FT-CD, FD-CD, FD-FD
+  static std::vector<Partition> Helicities();      // pos, neg
+  static std::vector<Partition> RunPeriods(const std::vector<RunRange>& periods);
+
+  // Adds the det_region, run and helicity columns the presets use (those not already defined)
+  static ROOT::RDF::RNode DefineColumns(ROOT::RDF::RNode df);
+
+  // Books lazy snapshots of the partitions of df; they are filled by the next event loop of the
+  // graph of df (the one of the full snapshot). WriteManifest(tree) once it has run; it returns
+  // the partition files written.
+  void Book(ROOT::RDF::RNode df, const std::string& tree, const std::string& filename, const std::vector<std::string>& columns);
+  std::vector<std::string> WriteManifest(const std::string& tree);
+  // Book, run and write the manifest, when the full snapshot does not need an event loop
+  std::vector<std::string> Write(ROOT::RDF::RNode df, const std::string& tree, const std::string& filename, const std::vector<std::string>& columns);
+
+  static std::string Directory(const std::string& filename);
+
+ private:
+  using SnapshotResult = ROOT::RDF::RResultPtr<ROOT::RDF::RInterface<ROOT::Detail::RDF::RLoopManager>>;
+  struct BookedPartition {
+    Partition partition;
+    std::string file;
+    ROOT::RDF::RResultPtr<ULong64_t> entries;
+    SnapshotResult snapshot;  // a lazy action only runs while its result is alive
+  };
+  struct Booked {
+    std::string source;
+    std::vector<std::string> columns;
+    ROOT::RDF::RResultPtr<ULong64_t> total;
+    std::vector<BookedPartition> partitions;
+  };
+
+  std::vector<Partition> Combinations() const;
+
+  std::vector<std::pair<std::string, std::vector<Partition>>> fDimensions;
+  std::map<std::string, Booked> fBooked;  // by tree, until the manifest is written
+};
+
+#endif  // PARTITIONEDSNAPSHOT_H
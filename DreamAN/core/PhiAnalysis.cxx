@@ -1,9 +1,11 @@
 #include "PhiAnalysis.h"
 
 #include <cmath>
+#include <sstream>
 #include <stdexcept>
 
 #include "AnalysisTaskManager.h"
+#include "../Math/ExclusiveCandidates.h"
 
 PhiAnalysis::PhiAnalysis(bool IsMC, bool IsReproc) : IsMC(IsMC), IsReproc(IsReproc), fHistPhotonP(nullptr), fOutFile(nullptr) {}
 PhiAnalysis::~PhiAnalysis() {}
@@ -13,8 +15,8 @@ void PhiAnalysis::UserCreateOutputObjects() {}
 void PhiAnalysis::UserExec(ROOT::RDF::RNode& df) {
   using namespace std;
 
-  if (fMaxEvents > 0) {
-    df = df.Range(0, fMaxEvents);   // only process the first fMaxEvents
+  if (fSampler.IsActive()) {
+    df = fSampler.Apply(df);  // event cap and/or deterministic sampling, MT safe
   }
   if (!fTrackCuts || !fEventCuts) throw std::runtime_error("PhiAnalysis: One or more cut not set.");
 
@@ -55,8 +57,19 @@ void PhiAnalysis::UserExec(ROOT::RDF::RNode& df) {
   auto cols_track_fid = CombineColumns(RECParticle::All(), std::vector<std::string>{"REC_Track_pass_fid"});
   auto cols_track_nofid = CombineColumns(RECParticle::All(), std::vector<std::string>{"REC_Track_pass_nofid"});
 
+  // As with the EventCut functor, which is copied when EventCutResult is defined: dfSelected keeps
+  // the mother-mass setting the event cuts came with, SetDoInvMassCut adds it from the fiducial stage on
+  const bool motherCutSelected = fEventCuts->GetDoCutMotherInvMass();
+  const bool motherCutFid = motherCutSelected || fDoInvMassCut;
+  const EventCutFunction topologyCutSelected = fTopologyCut ? fTopologyCut(*fEventCuts, motherCutSelected) : EventCutFunction();
+  const EventCutFunction topologyCutFid = fTopologyCut ? fTopologyCut(*fEventCuts, motherCutFid) : EventCutFunction();
+  const auto defineEventCutResult = [this](ROOT::RDF::RNode node, const std::vector<std::string>& cols, const EventCutFunction& topologyCut) {
+    if (topologyCut) return DefineOrRedefine(node, "EventCutResult", topologyCut, cols);
+    return DefineOrRedefine(node, "EventCutResult", *fEventCuts, cols);
+  };
+
   dfSelected = dfDefsWithTraj;
-  dfSelected = DefineOrRedefine(*dfSelected, "EventCutResult", *fEventCuts, cols_track_nofid);
+  dfSelected = defineEventCutResult(*dfSelected, cols_track_nofid, topologyCutSelected);
   dfSelected = DefineOrRedefine(*dfSelected, "REC_Event_pass", [](const EventCutResult& result) { return result.eventPass; }, {"EventCutResult"});
   dfSelected = DefineOrRedefine(*dfSelected, "REC_Particle_pass", [](const EventCutResult& result) { return result.particlePass; }, {"EventCutResult"});
   //dfSelected = DefineOrRedefine(*dfSelected, "REC_Photon_MaxE", [](const EventCutResult& result) { return result.MaxPhotonEnergyPass; }, {"EventCutResult"});
@@ -68,10 +81,13 @@ void PhiAnalysis::UserExec(ROOT::RDF::RNode& df) {
   }
 
   dfSelected = dfSelected->Filter("REC_Event_pass");
+  const bool useStageCache = fStageCache && !fSampler.IsActive();
+  if (fStageCache && fSampler.IsActive()) std::cout << "[StageCache] Not used: event sampling changes the selected events." << std::endl;
+  if (useStageCache) UseCachedStage(*dfSelected, "dfSelected", "phi_selected", StageConfig(*fTrackCutsNoFid, motherCutSelected));
   // After fiducial cut
   if (fFiducialCut) {
     dfSelected_afterFid = dfDefsWithTraj;
-    dfSelected_afterFid = DefineOrRedefine(*dfSelected_afterFid, "EventCutResult", *fEventCuts, cols_track_fid);
+    dfSelected_afterFid = defineEventCutResult(*dfSelected_afterFid, cols_track_fid, topologyCutFid);
     dfSelected_afterFid = DefineOrRedefine(*dfSelected_afterFid, "REC_Event_pass", [](const EventCutResult& result) { return result.eventPass; }, {"EventCutResult"});
     dfSelected_afterFid = DefineOrRedefine(*dfSelected_afterFid, "REC_Particle_pass", [](const EventCutResult& result) { return result.particlePass; }, {"EventCutResult"});
     dfSelected_afterFid = DefineOrRedefine(*dfSelected_afterFid, "REC_Photon_MaxE", [](const EventCutResult& result) { return result.MaxPhotonEnergyPass; }, {"EventCutResult"});
@@ -84,6 +100,8 @@ void PhiAnalysis::UserExec(ROOT::RDF::RNode& df) {
     }
 
     dfSelected_afterFid = dfSelected_afterFid->Filter("REC_Event_pass");
+    if (useStageCache)
+      UseCachedStage(*dfSelected_afterFid, IsReproc ? "dfSelected_afterFid_reprocessed" : "dfSelected_afterFid", "phi_afterFid", StageConfig(*fTrackCutsWithFid, motherCutFid));
   }
 
   dfSelected_afterFid_afterCorr = dfSelected_afterFid;
@@ -105,10 +123,10 @@ void PhiAnalysis::SaveOutput() {
   }
    if (IsMC) {
     // snapshot of the MC bank for efficiency and other studies
-    dforginal->Snapshot("dfSelectedMC", Form("%s/%s", fOutputDir.c_str(), "dfSelectedMC.root"),
+    DISANA_WATCH(*dforginal, "Snapshot(dfSelectedMC)", (void)dforginal->Snapshot("dfSelectedMC", Form("%s/%s", fOutputDir.c_str(), "dfSelectedMC.root"),
                  {"MC_Particle_pid", "MC_Particle_px", "MC_Particle_py", "MC_Particle_pz", "MC_Particle_vx", "MC_Particle_vy", "MC_Particle_vz", "MC_Particle_vt", "MC_Event_weight",
                   "MC_Event_pbeam",  // include if this exists
-                  "MC_Event_ptarget", "MC_Event_ebeam"});
+                  "MC_Event_ptarget", "MC_Event_ebeam"}));
   }
 
 
@@ -117,11 +135,18 @@ void PhiAnalysis::SaveOutput() {
     return;
   }
 
+  // Book the counts before the snapshots so they are filled in the same event loop
+  auto nSelected = dfSelected->Count();
+  std::optional<ROOT::RDF::RResultPtr<ULong64_t>> nSelectedAfterFid, nSelectedAfterCorr;
+  if (fFiducialCut && dfSelected_afterFid.has_value()) nSelectedAfterFid = dfSelected_afterFid->Count();
+  if (fDoMomentumCorrection && dfSelected_afterFid_afterCorr.has_value()) nSelectedAfterCorr = dfSelected_afterFid_afterCorr->Count();
+  DISANA_BOOK("Count", "selected events", std::vector<std::string>{});
+
   if (!IsReproc) SafeSnapshot(*dfSelected, "dfSelected", Form("%s/%s", fOutputDir.c_str(), "dfSelected.root"));
   if (fFiducialCut && dfSelected_afterFid.has_value()) {
     std::cout << "output directory is : " << fOutputDir.c_str() << std::endl;
-    std::cout << "Events selected: " << dfSelected->Count().GetValue() << std::endl;
-    std::cout << "Events selected after fiducial: " << dfSelected_afterFid->Count().GetValue() << std::endl;
+    std::cout << "Events selected: " << DISANA_WATCH(*dfSelected, "Count(dfSelected)", nSelected.GetValue()) << std::endl;
+    std::cout << "Events selected after fiducial: " << DISANA_WATCH(*dfSelected_afterFid, "Count(dfSelected_afterFid)", nSelectedAfterFid->GetValue()) << std::endl;
     if (IsReproc && dfSelected_afterFid.has_value()) {
       SafeSnapshot(*dfSelected_afterFid, "dfSelected_afterFid_reprocessed", Form("%s/%s", fOutputDir.c_str(), "dfSelected_afterFid_reprocessed.root"));
     } else {
@@ -129,12 +154,29 @@ void PhiAnalysis::SaveOutput() {
     }
   }
   if (fDoMomentumCorrection && dfSelected_afterFid_afterCorr.has_value()) {
-    std::cout << "Events selected after fiducial and momentum correction: " << dfSelected_afterFid_afterCorr->Count().GetValue() << std::endl;
+    std::cout << "Events selected after fiducial and momentum correction: " << DISANA_WATCH(*dfSelected_afterFid_afterCorr, "Count(dfSelected_afterFid_afterCorr)", nSelectedAfterCorr->GetValue()) << std::endl;
     SafeSnapshot(*dfSelected_afterFid_afterCorr, "dfSelected_afterFid_afterCorr", Form("%s/%s", fOutputDir.c_str(), "dfSelected_afterFid_afterCorr.root"));
   }
 
+  fSampler.Print();
+  Defer("sampler metadata", [this] { fSampler.WriteMetadata(fOutFile); });
   fOutFile->cd();
 }
 
+// The best Phi candidate (ele_px ... , cand_score) and its Q2, xB, W, t for the .npy export
+ROOT::RDF::RNode PhiAnalysis::DefineExportColumns(ROOT::RDF::RNode df) const {
+  const ExclusiveCandidates<PhiCandidates> candidates(fbeam_energy);
+  df = AsRVec(df, {"REC_Particle_pid", "REC_Particle_px", "REC_Particle_py", "REC_Particle_pz", "REC_Particle_pass"});
+  return candidates.DefineKinematics(candidates.DefineBest(df));
+}
+
+// Everything the selected events depend on, for the stage cache key; motherCut is the mass cut the stage applied
+std::string PhiAnalysis::StageConfig(const TrackCut& trackCuts, bool motherCut) const {
+  std::ostringstream os;
+  os << "PhiAnalysis IsMC " << IsMC << " IsReproc " << IsReproc << " acceptAll " << fAcceptAll << " invMass " << fDoInvMassCut << " FT " << fFTonConfig
+     << "\ntrack cuts\n" << trackCuts.Fingerprint() << "\nevent cuts\n" << fEventCuts->Fingerprint(motherCut);
+  return os.str();
+}
+
 void PhiAnalysis::SetOutputFile(TFile* file) { fOutFile = file; }
 void PhiAnalysis::SetOutputDir(const std::string& dir) { fOutputDir = dir; }
@@ -0,0 +1,164 @@
+#include "StageCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+StageCache::StageCache(const std::string& directory, ULong64_t maxBytes) : fDirectory(directory), fMaxBytes(maxBytes) {
+  std::error_code ec;
+  fs::create_directories(fDirectory, ec);
+  if (ec) std::cerr << "[StageCache] Cannot create " << fDirectory << ": " << ec.message() << std::endl;
+}
+
+// FNV-1a, 64 bit
+uint64_t StageCache::Hash(const std::string& text) {
+  uint64_t h = 1469598103934665603ULL;
+  for (unsigned char c : text) {
+    h ^= c;
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+namespace {
+std::string Hex(uint64_t value) {
+  char text[17];
+  std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(value));
+  return text;
+}
+}  // namespace
+
+std::string StageCache::Key(const std::string& stage, const std::string& config, const std::string& input) const {
+  // every lookup is checked on its own: a file that vanished or cannot be read is not cached
+  // rather than keyed with a default size or time that a later file could match
+  std::error_code ec;
+  const auto path = fs::canonical(input, ec);
+  if (ec) return "";
+  const auto size = fs::file_size(path, ec);
+  if (ec) return "";
+  const auto mtime = fs::last_write_time(path, ec);
+  if (ec) return "";
+  std::ostringstream text;
+  text << "v" << kFormatVersion << " " << stage << "\n" << config << "\n" << path.string() << " " << size << " " << mtime.time_since_epoch().count() << "\n";
+  return Hex(Hash(text.str()));
+}
+
+std::string StageCache::Key(const std::string& stage, const std::string& config, const std::vector<std::string>& inputs) const {
+  std::string text = "set " + std::to_string(inputs.size()) + "\n";
+  for (const auto& input : inputs) {
+    const std::string key = Key(stage, config, input);
+    if (key.empty()) return "";
+    text += key + "\n";
+  }
+  return Hex(Hash(text));
+}
+
+std::string StageCache::EntryPath(const std::string& stage, const std::string& key, const std::string& extension) const {
+  return (fs::path(fDirectory) / (stage + "-" + key + extension)).string();
+}
+
+std::string StageCache::Find(const std::string& stage, const std::string& key) const {
+  const std::string file = EntryPath(stage, key, ".root");
+  std::error_code ec;
+  if (!fs::exists(file, ec) || !fs::exists(EntryPath(stage, key, ".txt"), ec)) return "";
+  fs::last_write_time(file, fs::file_time_type::clock::now(), ec);  // LRU
+  return file;
+}
+
+bool StageCache::Store(const std::string& stage, const std::string& key, const std::string& file, const std::string& config) const {
+  const std::string target = EntryPath(stage, key, ".root");
+  const std::string tmp = PendingPath(stage, key);
+  std::error_code ec;
+  if (file != tmp) fs::copy_file(file, tmp, fs::copy_options::overwrite_existing, ec);
+  if (!ec) fs::rename(tmp, target, ec);
+  if (ec) {
+    std::cerr << "[StageCache] Could not store " << file << ": " << ec.message() << std::endl;
+    fs::remove(tmp, ec);
+    return false;
+  }
+  // the manifest is written last, an entry without it is incomplete and never found
+  std::ofstream manifest(EntryPath(stage, key, ".txt"));
+  manifest << "stage " << stage << "\n";
+  if (file != tmp) manifest << "source " << file << "\n";
+  manifest << config << "\n";
+  manifest.close();
+  std::cout << "[StageCache] Stored " << stage << " (" << key << ")" << std::endl;
+  Evict(target);
+  return true;
+}
+
+void StageCache::Invalidate(const std::string& stage) const {
+  std::error_code ec;
+  size_t removed = 0;
+  for (const auto& entry : fs::directory_iterator(fDirectory, ec)) {
+    const std::string name = entry.path().filename().string();
+    if (name.rfind(stage + "-", 0) == 0) removed += fs::remove(entry.path(), ec);
+  }
+  std::cout << "[StageCache] Invalidated " << stage << " (" << removed << " files)" << std::endl;
+}
+
+void StageCache::Clear() const {
+  std::error_code ec;
+  for (const auto& entry : fs::directory_iterator(fDirectory, ec)) {
+    const auto ext = entry.path().extension();
+    if (ext == ".root" || ext == ".txt" || ext == ".tmp") fs::remove(entry.path(), ec);
+  }
+  std::cout << "[StageCache] Cleared " << fDirectory << std::endl;
+}
+
+ULong64_t StageCache::SizeOnDisk() const {
+  std::error_code ec;
+  ULong64_t total = 0;
+  for (const auto& entry : fs::directory_iterator(fDirectory, ec)) {
+    if (entry.is_regular_file(ec)) total += entry.file_size(ec);
+  }
+  return total;
+}
+
+// Drops the least recently used entries until the directory fits in fMaxBytes
+void StageCache::Evict(const std::string& keep) const {
+  if (fMaxBytes == 0) return;
+  struct Entry {
+    fs::path file;
+    fs::file_time_type used;
+    ULong64_t bytes;
+  };
+  std::vector<Entry> entries;
+  std::error_code ec;
+  ULong64_t total = SizeOnDisk();
+  for (const auto& entry : fs::directory_iterator(fDirectory, ec)) {
+    if (entry.path().extension() != ".root") continue;
+    entries.push_back({entry.path(), entry.last_write_time(ec), entry.file_size(ec)});
+  }
+  std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.used < b.used; });
+  for (const auto& e : entries) {
+    if (total <= fMaxBytes) break;
+    if (e.file == fs::path(keep)) continue;
+    fs::path manifest = e.file;
+    manifest.replace_extension(".txt");
+    fs::remove(e.file, ec);
+    fs::remove(manifest, ec);
+    total -= std::min(total, e.bytes);
+    std::cout << "[StageCache] Evicted " << e.file.filename().string() << std::endl;
+  }
+  if (total > fMaxBytes) {
+    fs::path manifest = keep;
+    manifest.replace_extension(".txt");
+    fs::remove(keep, ec);
+    fs::remove(manifest, ec);
+    std::cerr << "[StageCache] " << keep << " alone exceeds the cache limit of " << fMaxBytes << " bytes, not kept." << std::endl;
+  }
+}
+
+void StageCache::Print() const {
+  std::error_code ec;
+  std::cout << "[StageCache] " << fDirectory << ": " << SizeOnDisk() / (1024.0 * 1024.0) << " MB of " << fMaxBytes / (1024.0 * 1024.0) << " MB" << std::endl;
+  for (const auto& entry : fs::directory_iterator(fDirectory, ec)) {
+    if (entry.path().extension() == ".root") std::cout << "  " << entry.path().filename().string() << "  " << entry.file_size(ec) / (1024.0 * 1024.0) << " MB" << std::endl;
+  }
+}
@@ -0,0 +1,70 @@
+#ifndef STAGECACHE_H
+#define STAGECACHE_H
+
+#include <Rtypes.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// On-disk cache of pipeline stage outputs.
+//
+// A stage output (e.g. dfSelected.root: fiducial masks, particle kinematics and event-cut
+// decisions of every selected event) is stored per input file, under a key that hashes the
+// stage name, the stage configuration text and the identity (canonical path, size,
+// modification time) of that file. A later run with the same upstream configuration reads the
+// stage back as the chain of the entries of its inputs instead of decoding and re-cutting the
+// raw events; a changed cut gives new keys for every file, a changed or added file only for
+// itself, so the entries of the other files stay valid. A file that cannot be inspected gives no
+// key and the stage is not cached. Sources that cannot tell the input file of an event (the
+// HIPO data source) get one entry for the whole input set instead.
+//
+// Entries hold the plain stage columns in input order, whatever the output encoding, clustering
+// or ordering of the snapshot they were taken from. They are <stage>-<key>.root plus a
+// <stage>-<key>.txt manifest with the configuration and the input, and the directory is kept
+// below a size limit by dropping the least recently used entries.
+//
+//   auto cache = std::make_shared<StageCache>("/volatile/me/disana_cache", 50ULL << 30);
+//   mgr.SetStageCache(cache);   // the tasks look their stages up before building them
+//   cache->Invalidate("dvcs_afterFid");  // or cache->Clear()
+class StageCache {
+ public:
+  static constexpr int kFormatVersion = 2;  // part of every key; bump when the code of a cached stage changes its output
+  // Index of the input file of each event in the stages looked up per file, -1 when unknown
+  static constexpr const char* kInputColumn = "DISANA_input";
+
+  explicit StageCache(const std::string& directory, ULong64_t maxBytes = 20ULL << 30);
+
+  void SetMaxBytes(ULong64_t maxBytes) { fMaxBytes = maxBytes; }
+  const std::string& GetDirectory() const { return fDirectory; }
+
+  // Key of the stage output of one input file; empty when the file cannot be inspected
+  std::string Key(const std::string& stage, const std::string& config, const std::string& input) const;
+  // Key of one entry for a whole input set; empty when one of the files cannot be inspected
+  std::string Key(const std::string& stage, const std::string& config, const std::vector<std::string>& inputs) const;
+
+  // Cached file of the key, empty when absent. A hit counts as a use for the LRU order.
+  std::string Find(const std::string& stage, const std::string& key) const;
+  // Where a stage output can be written inside the cache directory, for Store to move it in place
+  std::string PendingPath(const std::string& stage, const std::string& key) const { return EntryPath(stage, key, ".root.tmp"); }
+  // Moves a pending output (PendingPath) or copies any other finished stage output into the cache, then applies the size limit
+  bool Store(const std::string& stage, const std::string& key, const std::string& file, const std::string& config) const;
+
+  // Removes every entry of the stage, or of all stages
+  void Invalidate(const std::string& stage) const;
+  void Clear() const;
+
+  ULong64_t SizeOnDisk() const;
+  void Print() const;
+
+  static uint64_t Hash(const std::string& text);
+
+ private:
+  std::string EntryPath(const std::string& stage, const std::string& key, const std::string& extension) const;
+  void Evict(const std::string& keep) const;
+
+  std::string fDirectory;
+  ULong64_t fMaxBytes;
+};
+
+#endif  // STAGECACHE_H
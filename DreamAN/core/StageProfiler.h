@@ -0,0 +1,237 @@
+#ifndef STAGEPROFILER_H
+#define STAGEPROFILER_H
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <ROOT/TypeTraits.hxx>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Opt-in hardware-counter and allocation profile of pipeline stages.
+//
+// A stage is a Define functor (AnalysisTask::DefineOrRedefine wraps every one while the profiler
+// is enabled, under the column name) or any callable wrapped by hand, e.g. in a plotting macro:
+//   auto& prof = StageProfiler::Get();
+//   prof.Enable();
+//   df = df.Define("Mx2_ep", prof.Wrap("Mx2_ep", [](...) { ... }), {...});
+//   ...
+//   prof.PrintSummary();
+//
+// Per call of the stage, on the thread (= RDataFrame processing slot) running it, it takes
+//  - wall time,
+//  - cycles, instructions, cache misses and branch misses of that thread from a Linux
+//    perf_event_open counter group (user space only; shown as "n/a" when the kernel refuses,
+//    e.g. perf_event_paranoid > 2 or no PMU in the VM),
+//  - malloc calls and bytes, counted by the allocator hook in AllocHook.cxx, which is linked only
+//    with -DDISANA_ALLOC_HOOK=ON (the columns stay 0 otherwise).
+// Wrapping happens when the graph is booked: enable the profiler before building the pipeline;
+// when it is off, DefineOrRedefine books the functors unchanged.
+class StageProfiler {
+ public:
+  struct Counters {
+    uint64_t calls = 0;
+    uint64_t ns = 0;
+    uint64_t cycles = 0;
+    uint64_t instructions = 0;
+    uint64_t cacheMisses = 0;
+    uint64_t branchMisses = 0;
+    uint64_t mallocs = 0;
+    uint64_t mallocBytes = 0;
+
+    void Add(const Counters& o) {
+      calls += o.calls;
+      ns += o.ns;
+      cycles += o.cycles;
+      instructions += o.instructions;
+      cacheMisses += o.cacheMisses;
+      branchMisses += o.branchMisses;
+      mallocs += o.mallocs;
+      mallocBytes += o.mallocBytes;
+    }
+  };
+
+  // Incremented by the allocator hook of the calling thread (see AllocHook.cxx)
+  struct AllocCounters {
+    uint64_t calls;
+    uint64_t bytes;
+  };
+  static AllocCounters& ThreadAllocs() {
+    static thread_local AllocCounters counters{0, 0};
+    return counters;
+  }
+
+  static StageProfiler& Get() {
+    static StageProfiler instance;
+    return instance;
+  }
+
+  void Enable(bool on = true) { fEnabled = on; }
+  bool IsEnabled() const { return fEnabled; }
+
+  // Returns a callable with the signature of f that accounts every call to the stage
+  template <typename F>
+  auto Wrap(const std::string& stage, F&& f) {
+    using Fn = std::decay_t<F>;
+    return WrapImpl<Fn, typename ROOT::TypeTraits::CallableTraits<Fn>::ret_type>(StageId(stage), std::forward<F>(f),
+                                                                                   typename ROOT::TypeTraits::CallableTraits<Fn>::arg_types{});
+  }
+
+  void Reset() {
+    std::lock_guard<std::mutex> lock(fMutex);
+    for (auto& thread : fThreads) thread->stages.clear();
+  }
+
+  void PrintSummary(bool perSlot = false, std::ostream& os = std::cout) const {
+    std::lock_guard<std::mutex> lock(fMutex);
+    os << "[StageProfiler] ================ Stage profile (per call) ================" << std::endl;
+    os << "  " << std::left << std::setw(32) << "stage" << std::right << std::setw(12) << "calls" << std::setw(10) << "ns" << std::setw(12) << "cycles" << std::setw(7) << "IPC"
+       << std::setw(11) << "cache-miss" << std::setw(12) << "branch-miss" << std::setw(9) << "mallocs" << std::setw(10) << "bytes" << std::endl;
+    for (size_t id = 0; id < fStages.size(); ++id) {
+      Counters total;
+      for (const auto& thread : fThreads)
+        if (id < thread->stages.size()) total.Add(thread->stages[id]);
+      if (total.calls == 0) continue;
+      PrintRow(os, fStages[id], total);
+      if (!perSlot) continue;
+      for (size_t t = 0; t < fThreads.size(); ++t) {
+        if (id < fThreads[t]->stages.size() && fThreads[t]->stages[id].calls > 0) PrintRow(os, "  thread " + std::to_string(t), fThreads[t]->stages[id]);
+      }
+    }
+    if (!fCountersAvailable) os << "[StageProfiler] Hardware counters unavailable (perf_event_open refused, see /proc/sys/kernel/perf_event_paranoid)." << std::endl;
+  }
+
+ private:
+  static constexpr int kNumEvents = 4;
+
+  // Counter group and per-stage sums of one thread
+  struct ThreadState {
+    int fds[kNumEvents] = {-1, -1, -1, -1};  // fds[0] leads the group
+    bool opened = false;
+    std::vector<Counters> stages;
+    ~ThreadState() { Close(); }
+    void Close() {
+      for (int& fd : fds) {
+        if (fd >= 0) close(fd);
+        fd = -1;
+      }
+    }
+  };
+
+  StageProfiler() = default;
+
+  int StageId(const std::string& stage) {
+    std::lock_guard<std::mutex> lock(fMutex);
+    auto it = fStageIds.find(stage);
+    if (it != fStageIds.end()) return it->second;
+    fStages.push_back(stage);
+    return fStageIds[stage] = static_cast<int>(fStages.size()) - 1;
+  }
+
+  ThreadState& Thread() {
+    static thread_local ThreadState* state = nullptr;
+    if (!state) {
+      auto owned = std::make_unique<ThreadState>();
+      state = owned.get();
+      OpenCounters(*state);
+      std::lock_guard<std::mutex> lock(fMutex);
+      fThreads.push_back(std::move(owned));  // kept until exit, the summary reads them after the loop
+    }
+    return *state;
+  }
+
+  void OpenCounters(ThreadState& state) {
+    const uint64_t configs[kNumEvents] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    for (int i = 0; i < kNumEvents; ++i) {
+      perf_event_attr attr{};
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = configs[i];
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP;
+      state.fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, state.fds[0], 0));  // this thread, any CPU
+      if (state.fds[i] < 0) {
+        state.Close();
+        fCountersAvailable = false;
+        return;
+      }
+    }
+    state.opened = true;
+  }
+
+  static bool ReadCounters(const ThreadState& state, uint64_t (&values)[kNumEvents]) {
+    struct {
+      uint64_t nr;
+      uint64_t values[kNumEvents];
+    } group;
+    if (!state.opened || read(state.fds[0], &group, sizeof(group)) != static_cast<ssize_t>(sizeof(group))) return false;
+    for (int i = 0; i < kNumEvents; ++i) values[i] = group.values[i];
+    return true;
+  }
+
+  template <typename Fn, typename Ret, typename... Args>
+  auto WrapImpl(int id, Fn f, ROOT::TypeTraits::TypeList<Args...>) {
+    return [this, id, f](Args... args) mutable -> Ret {
+      ThreadState& thread = Thread();
+      uint64_t before[kNumEvents] = {}, after[kNumEvents] = {};
+      const bool counted = ReadCounters(thread, before);
+      const AllocCounters allocsBefore = ThreadAllocs();
+      const auto start = std::chrono::steady_clock::now();
+
+      Ret result = f(std::forward<Args>(args)...);
+
+      const auto stop = std::chrono::steady_clock::now();
+      const AllocCounters allocsAfter = ThreadAllocs();
+      if (thread.stages.size() <= static_cast<size_t>(id)) {
+        std::lock_guard<std::mutex> lock(fMutex);  // the summary may be reading the vector
+        thread.stages.resize(id + 1);
+      }
+      Counters& c = thread.stages[id];
+      ++c.calls;
+      c.ns += std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+      if (counted && ReadCounters(thread, after)) {
+        c.cycles += after[0] - before[0];
+        c.instructions += after[1] - before[1];
+        c.cacheMisses += after[2] - before[2];
+        c.branchMisses += after[3] - before[3];
+      }
+      c.mallocs += allocsAfter.calls - allocsBefore.calls;
+      c.mallocBytes += allocsAfter.bytes - allocsBefore.bytes;
+      return result;
+    };
+  }
+
+  static void PrintRow(std::ostream& os, const std::string& name, const Counters& c) {
+    const double n = static_cast<double>(c.calls);
+    os << "  " << std::left << std::setw(32) << name << std::right << std::setw(12) << c.calls << std::fixed << std::setprecision(1) << std::setw(10) << c.ns / n;
+    if (c.cycles > 0) {
+      os << std::setw(12) << c.cycles / n << std::setprecision(2) << std::setw(7) << static_cast<double>(c.instructions) / c.cycles << std::setprecision(1) << std::setw(11)
+         << c.cacheMisses / n << std::setw(12) << c.branchMisses / n;
+    } else {
+      os << std::setw(12) << "n/a" << std::setw(7) << "n/a" << std::setw(11) << "n/a" << std::setw(12) << "n/a";
+    }
+    os << std::setprecision(2) << std::setw(9) << c.mallocs / n << std::setprecision(0) << std::setw(10) << c.mallocBytes / n << std::endl;
+    os.unsetf(std::ios::floatfield);
+    os << std::setprecision(6);
+  }
+
+  mutable std::mutex fMutex;
+  bool fEnabled = false;
+  std::atomic<bool> fCountersAvailable{true};
+  std::vector<std::string> fStages;
+  std::map<std::string, int> fStageIds;
+  std::vector<std::unique_ptr<ThreadState>> fThreads;
+};
+
+#endif  // STAGEPROFILER_H
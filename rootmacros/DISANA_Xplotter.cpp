@@ -3,13 +3,16 @@
 #include "../DreamAN/DrawHist/DISANAcomparer.h"
 #include "../DreamAN/DrawHist/DrawStyle.h"
 #include "../DreamAN/DrawHist/DISANAMath.h"
+#include "../DreamAN/DrawHist/DISANAserver.h"
+#include "../DreamAN/DrawHist/DISANAfilterchain.h"
+#include "../DreamAN/Math/ExclusiveCandidates.h"
 
 ROOT::RDF::RNode RejectPi0TwoPhoton(ROOT::RDF::RNode df_);
 ROOT::RDF::RNode SelectPi0Event(ROOT::RDF::RNode df);
 void CreateCorrectionHistogram4D(ROOT::RDF::RNode df_dvcs_mc, ROOT::RDF::RNode df_pi0_mc, ROOT::RDF::RNode df_dvcs_data, ROOT::RDF::RNode df_pi0_data,
                                  const std::string& out_file_name);
 
-ROOT::RDF::RNode ApplyFinalDVCSSelections(ROOT::RDF::RNode df, bool inbending);
+ROOT::RDF::RNode ApplyFinalDVCSSelections(ROOT::RDF::RNode df, bool inbending, const std::string& outputDir, const std::string& dataset);
 
 ROOT::RDF::RNode InitKinematics(const std::string& filename_ = "", const std::string& treename_ = "", float beam_energy = 0);
 
@@ -19,6 +22,17 @@ static double PhiFunc(float px, float py) {
   double phi = std::atan2(py, px);
   return phi < 0 ? phi + 2 * M_PI : phi;
 }
+// FT = 0, FD = 1, CD = 2, other = -1, from REC_Particle_status of row i
+static int DetRegionAt(const ROOT::VecOps::RVec<short>& status, int i) {
+  int abs_status = std::abs(status[i]);
+  if (abs_status >= 1000 && abs_status < 2000) return 0;
+  if (abs_status >= 2000 && abs_status < 3000) return 1;
+  if (abs_status >= 4000 && abs_status < 5000) return 2;
+  return -1;
+}
+
+// false: first passing e, p and REC_Photon_MaxE photon; true: best ranked e p gamma candidate (ExclusiveCandidates.h)
+static constexpr bool kRankedCandidates = false;
 
 /// styling plots
 // double double titleSize = 0.05, double labelSize = 0.04,double xTitleOffset = 1.1, double yTitleOffset = 1.6, int font = 42, int maxDigits = 5, int nDivisions = 510, double
@@ -50,6 +64,7 @@ void DISANA_Xplotter() {
   bool DoBkgCorr = true;       // Set to true if you want to apply background correction
 
   ROOT::EnableImplicitMT();
+  const std::string outputDir = "./";  // plots and the measured cut order
   // std::string input_path_from_analysisRun = "/work/clas12/singh/CrossSectionAN/RGA_spring2018_Analysis/fromDVCS_wagon/Inb/";
   // test case
   //std::string input_path_from_analysisRun_inb_data = "/w/hallb-scshelf2102/clas12/singh/CrossSectionAN/NewAnalysisFrameWork/testing_outupt/afterFiducialCuts/DVCS_wagon/inb/";
@@ -87,17 +102,17 @@ void DISANA_Xplotter() {
 
   // Apply final DVCS cuts
   // inb
-  auto df_final_dvcs_inb_data = ApplyFinalDVCSSelections(df_afterFid_inb_data, true);
-  //auto df_final_dvcs_inb_data_corr = ApplyFinalDVCSSelections(df_afterFid_inb_data_corr, true);
+  auto df_final_dvcs_inb_data = ApplyFinalDVCSSelections(df_afterFid_inb_data, true, outputDir, "inb_data");
+  //auto df_final_dvcs_inb_data_corr = ApplyFinalDVCSSelections(df_afterFid_inb_data_corr, true, outputDir, "inb_data_corr");
   auto df_final_dvcsPi_rejected_inb_data = RejectPi0TwoPhoton(df_final_dvcs_inb_data);
   //auto df_final_dvcsPi_rejected_inb_data_corr = RejectPi0TwoPhoton(df_final_dvcs_inb_data_corr);
-  auto df_final_dvcs_inb_MC = ApplyFinalDVCSSelections(df_afterFid_inb_MC, true);
+  auto df_final_dvcs_inb_MC = ApplyFinalDVCSSelections(df_afterFid_inb_MC, true, outputDir, "inb_MC");
   auto df_final_dvcsPi_rejected_inb_MC = RejectPi0TwoPhoton(df_final_dvcs_inb_MC);
 
   // outb
-  auto df_final_dvcs_outb_data = ApplyFinalDVCSSelections(df_afterFid_outb_data, false);
+  auto df_final_dvcs_outb_data = ApplyFinalDVCSSelections(df_afterFid_outb_data, false, outputDir, "outb_data");
   auto df_final_dvcsPi_rejected_outb_data = RejectPi0TwoPhoton(df_final_dvcs_outb_data);
-  auto df_final_dvcs_outb_MC = ApplyFinalDVCSSelections(df_afterFid_outb_MC, false);
+  auto df_final_dvcs_outb_MC = ApplyFinalDVCSSelections(df_afterFid_outb_MC, false, outputDir, "outb_MC");
   auto df_final_dvcsPi_rejected_outb_MC = RejectPi0TwoPhoton(df_final_dvcs_outb_MC);
 
   // pi0 event selection cuts
@@ -113,13 +128,23 @@ void DISANA_Xplotter() {
   // for inbending data
 
   DISANAcomparer comparer;
-  comparer.SetOutputDir("./");
+  comparer.SetOutputDir(outputDir);
   comparer.SetKinStyle(KinStyle);
   comparer.SetDVCSStyle(dvcsStyle);
   comparer.SetCrossSectionStyle(csStyle);
   comparer.SetBSAStyle(bsaStyle);
 
   comparer.PlotIndividual(false);
+  comparer.SetRenderWorkers(8);  // canvases are painted by 8 batch processes at RenderPending()
+  // Restyling re-runs read the filled histograms back instead of running the event loops (DISANAresultcache.h);
+  // the keys hash this macro, so editing a lambda or string cut here refills
+  // comparer.SetResultCache("./.disana_results", "v1", {__FILE__});
+  // comparer.SetModelInputs("Sp18 Inb", {filename_afterFid_inb_data, filename_afterFid_inb_MC});
+  // comparer.SetModelInputs("Sp18 Outb", {filename_afterFid_outb_data, filename_afterFid_outb_MC});
+  // First look at a new dataset: scaled previews every 5% of the entries while the loops run (DISANApreview.h)
+  // comparer.EnableProgressivePreview("./preview", 0.05);
+  // comparer.SetModelEntries("Sp18 Inb", DISANApreview::CountEntries("dfSelected_afterFid", {filename_afterFid_inb_data}));
+  // comparer.SetModelEntries("Sp18 Outb", DISANApreview::CountEntries("dfSelected_afterFid", {filename_afterFid_outb_data}));
   /// bins for cross-section plots
   BinManager xBins;
   // xBins.SetQ2Bins({.11,1.3,1.6,2.1,2.8,3.6,8.0});
@@ -179,84 +204,156 @@ void DISANA_Xplotter() {
   //comparer.PlotDIS_Pi0CorrComparison();
   //comparer.PlotExclusivityComparisonByDetectorCases(detCuts);
 
+  comparer.RenderPending();  // before Terminate, which skips the comparer's destructor
+
+  // Interactive re-plotting: keep the final candidates in memory and answer cut/histogram requests over a socket
+  // DISANAserver server;
+  // server.AddModel("Sp18 Inb", df_final_dvcsPi_rejected_inb_data, {"Q2", "xB", "t", "phi", "W", "Mx2_epg", "Emiss", "PTmiss", "pho_det_region", "pro_det_region"});
+  // server.AddModel("Sp18 Outb", df_final_dvcsPi_rejected_outb_data, {"Q2", "xB", "t", "phi", "W", "Mx2_epg", "Emiss", "PTmiss", "pho_det_region", "pro_det_region"});
+  // server.Serve("/tmp/disana.sock");
+
   gApplication->Terminate(0);
 }
 
 ROOT::RDF::RNode InitKinematics(const std::string& filename_, const std::string& treename_, float beam_energy) {
   ROOT::RDataFrame rdf(treename_, filename_);
   auto df_ = std::make_unique<ROOT::RDF::RNode>(rdf);
-  *df_ = df_->Define("ele_px",
-                     [](const ROOT::VecOps::RVec<int>& pid, const ROOT::VecOps::RVec<float>& px, const ROOT::VecOps::RVec<bool>& trackpass) {
-                       for (size_t i = 0; i < pid.size(); ++i)
-                         if (pid[i] == 11 && trackpass[i]) return px[i];
-                       return -999.0f;
-                     },
-                     {"REC_Particle_pid", "REC_Particle_px", "REC_Particle_pass"})
-             .Define("ele_py",
-                     [](const ROOT::VecOps::RVec<int>& pid, const ROOT::VecOps::RVec<float>& py, const ROOT::VecOps::RVec<bool>& trackpass) {
-                       for (size_t i = 0; i < pid.size(); ++i)
-                         if (pid[i] == 11 && trackpass[i]) return py[i];
-                       return -999.0f;
-                     },
-                     {"REC_Particle_pid", "REC_Particle_py", "REC_Particle_pass"})
-             .Define("ele_pz",
-                     [](const ROOT::VecOps::RVec<int>& pid, const ROOT::VecOps::RVec<float>& pz, const ROOT::VecOps::RVec<bool>& trackpass) {
-                       for (size_t i = 0; i < pid.size(); ++i)
-                         if (pid[i] == 11 && trackpass[i]) return pz[i];
-                       return -999.0f;
-                     },
-                     {"REC_Particle_pid", "REC_Particle_pz", "REC_Particle_pass"})
-             .Define("pho_px",
-                     [](const ROOT::VecOps::RVec<int>& pid, const ROOT::VecOps::RVec<float>& px, const ROOT::VecOps::RVec<bool>& trackpass, const ROOT::VecOps::RVec<bool>& maxEpass) {
-                       for (size_t i = 0; i < pid.size(); ++i)
-                         if (pid[i] == 22 && trackpass[i] && maxEpass[i]) return px[i];
-                       return -999.0f;
-                     },
-                     {"REC_Particle_pid", "REC_Particle_px", "REC_Particle_pass", "REC_Photon_MaxE"})
-             .Define("pho_py",
-                     [](const ROOT::VecOps::RVec<int>& pid, const ROOT::VecOps::RVec<float>& py, const ROOT::VecOps::RVec<bool>& trackpass, const ROOT::VecOps::RVec<bool>& maxEpass) {
-                       for (size_t i = 0; i < pid.size(); ++i)
-                         if (pid[i] == 22 && trackpass[i] && maxEpass[i]) return py[i];
-                       return -999.0f;
-                     },
-                     {"REC_Particle_pid", "REC_Particle_py", "REC_Particle_pass", "REC_Photon_MaxE"})
-             .Define("pho_pz",
-                     [](const ROOT::VecOps::RVec<int>& pid, const ROOT::VecOps::RVec<float>& pz, const ROOT::VecOps::RVec<bool>& trackpass, const ROOT::VecOps::RVec<bool>& maxEpass) {
-                       for (size_t i = 0; i < pid.size(); ++i)
-                         if (pid[i] == 22 && trackpass[i] && maxEpass[i]) return pz[i];
-                       return -999.0f;
-                     },
-                     {"REC_Particle_pid", "REC_Particle_pz", "REC_Particle_pass", "REC_Photon_MaxE"})
-             .Define("recpho_beta",
-                     [](const ROOT::VecOps::RVec<int>& pid, const ROOT::VecOps::RVec<float>& beta, const ROOT::VecOps::RVec<bool>& trackpass, const ROOT::VecOps::RVec<bool>& maxEpass) {
-                       for (size_t i = 0; i < pid.size(); ++i)
-                         if (pid[i] == 22 && trackpass[i] && maxEpass[i]) return beta[i];
-                       return -999.0f;
-                     },
-                     {"REC_Particle_pid", "REC_Particle_beta", "REC_Particle_pass", "REC_Photon_MaxE"})
-             .Define("pro_px",
-                     [](const ROOT::VecOps::RVec<int>& pid, const ROOT::VecOps::RVec<float>& px, const ROOT::VecOps::RVec<bool>& trackpass) {
-                       for (size_t i = 0; i < pid.size(); ++i)
-                         if (pid[i] == 2212 && trackpass[i]) return px[i];
-                       return -999.0f;
-                     },
-                     {"REC_Particle_pid", "REC_Particle_px", "REC_Particle_pass"})
-             .Define("pro_py",
-                     [](const ROOT::VecOps::RVec<int>& pid, const ROOT::VecOps::RVec<float>& py, const ROOT::VecOps::RVec<bool>& trackpass) {
-                       for (size_t i = 0; i < pid.size(); ++i)
-                         if (pid[i] == 2212 && trackpass[i]) return py[i];
-                       return -999.0f;
-                     },
-                     {"REC_Particle_pid", "REC_Particle_py", "REC_Particle_pass"})
-             .Define("pro_pz",
-                     [](const ROOT::VecOps::RVec<int>& pid, const ROOT::VecOps::RVec<float>& pz, const ROOT::VecOps::RVec<bool>& trackpass) {
-                       for (size_t i = 0; i < pid.size(); ++i)
-                         if (pid[i] == 2212 && trackpass[i]) return pz[i];
-                       return -999.0f;
-                     },
-                     {"REC_Particle_pid", "REC_Particle_pz", "REC_Particle_pass"})
-             .Filter([](float ex, float gx, float px) { return ex != -999 && gx != -999 && px != -999; }, {"ele_px", "pho_px", "pro_px"})
-             .Define("recel_p", MomentumFunc, {"ele_px", "ele_py", "ele_pz"})
+  if (kRankedCandidates) {
+    // every e p gamma assignment scored by exclusivity, best one kept (all photons, not only REC_Photon_MaxE)
+    *df_ = ExclusiveCandidates<DVCSCandidates>(beam_energy).DefineBest(*df_);
+    *df_ = df_->Define("recpho_beta", [](const ROOT::VecOps::RVec<float>& beta, int i) { return beta[i]; }, {"REC_Particle_beta", "pho_index"})
+               .Define("pho_det_region", DetRegionAt, {"REC_Particle_status", "pho_index"})
+               .Define("pro_det_region", DetRegionAt, {"REC_Particle_status", "pro_index"})
+               .Define("ele_det_region", DetRegionAt, {"REC_Particle_status", "ele_index"});
+  } else {
+    *df_ = df_->Define("ele_px",
+                       [](const ROOT::VecOps::RVec<int>& pid, const ROOT::VecOps::RVec<float>& px, const ROOT::VecOps::RVec<bool>& trackpass) {
+                         for (size_t i = 0; i < pid.size(); ++i)
+                           if (pid[i] == 11 && trackpass[i]) return px[i];
+                         return -999.0f;
+                       },
+                       {"REC_Particle_pid", "REC_Particle_px", "REC_Particle_pass"})
+               .Define("ele_py",
+                       [](const ROOT::VecOps::RVec<int>& pid, const ROOT::VecOps::RVec<float>& py, const ROOT::VecOps::RVec<bool>& trackpass) {
+                         for (size_t i = 0; i < pid.size(); ++i)
+                           if (pid[i] == 11 && trackpass[i]) return py[i];
+                         return -999.0f;
+                       },
+                       {"REC_Particle_pid", "REC_Particle_py", "REC_Particle_pass"})
+               .Define("ele_pz",
+                       [](const ROOT::VecOps::RVec<int>& pid, const ROOT::VecOps::RVec<float>& pz, const ROOT::VecOps::RVec<bool>& trackpass) {
+                         for (size_t i = 0; i < pid.size(); ++i)
+                           if (pid[i] == 11 && trackpass[i]) return pz[i];
+                         return -999.0f;
+                       },
+                       {"REC_Particle_pid", "REC_Particle_pz", "REC_Particle_pass"})
+               .Define("pho_px",
+                       [](const ROOT::VecOps::RVec<int>& pid, const ROOT::VecOps::RVec<float>& px, const ROOT::VecOps::RVec<bool>& trackpass, const ROOT::VecOps::RVec<bool>& maxEpass) {
+                         for (size_t i = 0; i < pid.size(); ++i)
+                           if (pid[i] == 22 && trackpass[i] && maxEpass[i]) return px[i];
+                         return -999.0f;
+                       },
+                       {"REC_Particle_pid", "REC_Particle_px", "REC_Particle_pass", "REC_Photon_MaxE"})
+               .Define("pho_py",
+                       [](const ROOT::VecOps::RVec<int>& pid, const ROOT::VecOps::RVec<float>& py, const ROOT::VecOps::RVec<bool>& trackpass, const ROOT::VecOps::RVec<bool>& maxEpass) {
+                         for (size_t i = 0; i < pid.size(); ++i)
+                           if (pid[i] == 22 && trackpass[i] && maxEpass[i]) return py[i];
+                         return -999.0f;
+                       },
+                       {"REC_Particle_pid", "REC_Particle_py", "REC_Particle_pass", "REC_Photon_MaxE"})
+               .Define("pho_pz",
+                       [](const ROOT::VecOps::RVec<int>& pid, const ROOT::VecOps::RVec<float>& pz, const ROOT::VecOps::RVec<bool>& trackpass, const ROOT::VecOps::RVec<bool>& maxEpass) {
+                         for (size_t i = 0; i < pid.size(); ++i)
+                           if (pid[i] == 22 && trackpass[i] && maxEpass[i]) return pz[i];
+                         return -999.0f;
+                       },
+                       {"REC_Particle_pid", "REC_Particle_pz", "REC_Particle_pass", "REC_Photon_MaxE"})
+               .Define("recpho_beta",
+                       [](const ROOT::VecOps::RVec<int>& pid, const ROOT::VecOps::RVec<float>& beta, const ROOT::VecOps::RVec<bool>& trackpass, const ROOT::VecOps::RVec<bool>& maxEpass) {
+                         for (size_t i = 0; i < pid.size(); ++i)
+                           if (pid[i] == 22 && trackpass[i] && maxEpass[i]) return beta[i];
+                         return -999.0f;
+                       },
+                       {"REC_Particle_pid", "REC_Particle_beta", "REC_Particle_pass", "REC_Photon_MaxE"})
+               .Define("pro_px",
+                       [](const ROOT::VecOps::RVec<int>& pid, const ROOT::VecOps::RVec<float>& px, const ROOT::VecOps::RVec<bool>& trackpass) {
+                         for (size_t i = 0; i < pid.size(); ++i)
+                           if (pid[i] == 2212 && trackpass[i]) return px[i];
+                         return -999.0f;
+                       },
+                       {"REC_Particle_pid", "REC_Particle_px", "REC_Particle_pass"})
+               .Define("pro_py",
+                       [](const ROOT::VecOps::RVec<int>& pid, const ROOT::VecOps::RVec<float>& py, const ROOT::VecOps::RVec<bool>& trackpass) {
+                         for (size_t i = 0; i < pid.size(); ++i)
+                           if (pid[i] == 2212 && trackpass[i]) return py[i];
+                         return -999.0f;
+                       },
+                       {"REC_Particle_pid", "REC_Particle_py", "REC_Particle_pass"})
+               .Define("pro_pz",
+                       [](const ROOT::VecOps::RVec<int>& pid, const ROOT::VecOps::RVec<float>& pz, const ROOT::VecOps::RVec<bool>& trackpass) {
+                         for (size_t i = 0; i < pid.size(); ++i)
+                           if (pid[i] == 2212 && trackpass[i]) return pz[i];
+                         return -999.0f;
+                       },
+                       {"REC_Particle_pid", "REC_Particle_pz", "REC_Particle_pass"})
+               .Filter([](float ex, float gx, float px) { return ex != -999 && gx != -999 && px != -999; }, {"ele_px", "pho_px", "pro_px"})
+               .Define("pho_det_region",
+                       [](const ROOT::VecOps::RVec<int>& pid, const ROOT::VecOps::RVec<short>& status, const ROOT::VecOps::RVec<bool>& pass, const ROOT::VecOps::RVec<bool>& maxEpass) {
+                         for (size_t i = 0; i < pid.size(); ++i) {
+                           if (pid[i] == 22 && pass[i] && maxEpass[i]) {
+                             int abs_status = std::abs(status[i]);
+                             if (abs_status >= 1000 && abs_status < 2000)
+                               return 0;  // FT
+                             else if (abs_status >= 2000 && abs_status < 3000)
+                               return 1;  // FD
+                             else if (abs_status >= 4000 && abs_status < 5000)
+                               return 2;  // CD
+                             else
+                               return -1;  // Unknown/Other
+                           }
+                         }
+                         return -1;
+                       },
+                       {"REC_Particle_pid", "REC_Particle_status", "REC_Particle_pass", "REC_Photon_MaxE"})
+
+               .Define("pro_det_region",
+                       [](const ROOT::VecOps::RVec<int>& pid, const ROOT::VecOps::RVec<short>& status, const ROOT::VecOps::RVec<bool>& pass) {
+                         for (size_t i = 0; i < pid.size(); ++i) {
+                           if (pid[i] == 2212 && pass[i]) {
+                             int abs_status = std::abs(status[i]);
+                             if (abs_status >= 1000 && abs_status < 2000)
+                               return 0;  // FT (probably rare for protons)
+                             else if (abs_status >= 2000 && abs_status < 3000)
+                               return 1;  // FD
+                             else if (abs_status >= 4000 && abs_status < 5000)
+                               return 2;  // CD
+                             else
+                               return -1;
+                           }
+                         }
+                         return -1;
+                       },
+                       {"REC_Particle_pid", "REC_Particle_status", "REC_Particle_pass"})
+               .Define("ele_det_region",
+                       [](const ROOT::VecOps::RVec<int>& pid, const ROOT::VecOps::RVec<short>& status, const ROOT::VecOps::RVec<bool>& pass) {
+                         for (size_t i = 0; i < pid.size(); ++i) {
+                           if (pid[i] == 11 && pass[i]) {
+                             int abs_status = std::abs(status[i]);
+                             if (abs_status >= 1000 && abs_status < 2000)
+                               return 0;  // FT (probably rare for protons)
+                             else if (abs_status >= 2000 && abs_status < 3000)
+                               return 1;  // FD
+                             else if (abs_status >= 4000 && abs_status < 5000)
+                               return 2;  // CD
+                             else
+                               return -1;
+                           }
+                         }
+                         return -1;
+                       },
+                       {"REC_Particle_pid", "REC_Particle_status", "REC_Particle_pass"});
+  }
+  *df_ = df_->Define("recel_p", MomentumFunc, {"ele_px", "ele_py", "ele_pz"})
              .Define("recel_theta", ThetaFunc, {"ele_px", "ele_py", "ele_pz"})
              .Define("recel_phi", PhiFunc, {"ele_px", "ele_py"})
              .Define("recpho_p", MomentumFunc, {"pho_px", "pho_py", "pho_pz"})
@@ -264,62 +361,7 @@ ROOT::RDF::RNode InitKinematics(const std::string& filename_, const std::string&
              .Define("recpho_phi", PhiFunc, {"pho_px", "pho_py"})
              .Define("recpro_p", MomentumFunc, {"pro_px", "pro_py", "pro_pz"})
              .Define("recpro_theta", ThetaFunc, {"pro_px", "pro_py", "pro_pz"})
-             .Define("recpro_phi", PhiFunc, {"pro_px", "pro_py"})
-             .Define("pho_det_region",
-                     [](const ROOT::VecOps::RVec<int>& pid, const ROOT::VecOps::RVec<short>& status, const ROOT::VecOps::RVec<bool>& pass, const ROOT::VecOps::RVec<bool>& maxEpass) {
-                       for (size_t i = 0; i < pid.size(); ++i) {
-                         if (pid[i] == 22 && pass[i] && maxEpass[i]) {
-                           int abs_status = std::abs(status[i]);
-                           if (abs_status >= 1000 && abs_status < 2000)
-                             return 0;  // FT
-                           else if (abs_status >= 2000 && abs_status < 3000)
-                             return 1;  // FD
-                           else if (abs_status >= 4000 && abs_status < 5000)
-                             return 2;  // CD
-                           else
-                             return -1;  // Unknown/Other
-                         }
-                       }
-                       return -1;
-                     },
-                     {"REC_Particle_pid", "REC_Particle_status", "REC_Particle_pass", "REC_Photon_MaxE"})
-
-             .Define("pro_det_region",
-                     [](const ROOT::VecOps::RVec<int>& pid, const ROOT::VecOps::RVec<short>& status, const ROOT::VecOps::RVec<bool>& pass) {
-                       for (size_t i = 0; i < pid.size(); ++i) {
-                         if (pid[i] == 2212 && pass[i]) {
-                           int abs_status = std::abs(status[i]);
-                           if (abs_status >= 1000 && abs_status < 2000)
-                             return 0;  // FT (probably rare for protons)
-                           else if (abs_status >= 2000 && abs_status < 3000)
-                             return 1;  // FD
-                           else if (abs_status >= 4000 && abs_status < 5000)
-                             return 2;  // CD
-                           else
-                             return -1;
-                         }
-                       }
-                       return -1;
-                     },
-                     {"REC_Particle_pid", "REC_Particle_status", "REC_Particle_pass"})
-             .Define("ele_det_region",
-                     [](const ROOT::VecOps::RVec<int>& pid, const ROOT::VecOps::RVec<short>& status, const ROOT::VecOps::RVec<bool>& pass) {
-                       for (size_t i = 0; i < pid.size(); ++i) {
-                         if (pid[i] == 11 && pass[i]) {
-                           int abs_status = std::abs(status[i]);
-                           if (abs_status >= 1000 && abs_status < 2000)
-                             return 0;  // FT (probably rare for protons)
-                           else if (abs_status >= 2000 && abs_status < 3000)
-                             return 1;  // FD
-                           else if (abs_status >= 4000 && abs_status < 5000)
-                             return 2;  // CD
-                           else
-                             return -1;
-                         }
-                       }
-                       return -1;
-                     },
-                     {"REC_Particle_pid", "REC_Particle_status", "REC_Particle_pass"});
+             .Define("recpro_phi", PhiFunc, {"pro_px", "pro_py"});
 
   *df_ = define_DISCAT(*df_, "Q2", &DISANAMath::GetQ2, beam_energy);
   *df_ = define_DISCAT(*df_, "xB", &DISANAMath::GetxB, beam_energy);
@@ -379,43 +421,52 @@ ROOT::RDF::RNode SelectPi0Event(ROOT::RDF::RNode df_) {
       {"REC_Particle_pid", "REC_Particle_pass", "REC_DaughterParticle_pass"}, "Cut: one good e, γ (not π⁰-like), p");
 }
 // exclusivity cuts
-ROOT::RDF::RNode ApplyFinalDVCSSelections(ROOT::RDF::RNode df, bool inbending) {
-  return df
+ROOT::RDF::RNode ApplyFinalDVCSSelections(ROOT::RDF::RNode df, bool inbending, const std::string& outputDir, const std::string& dataset) {
+  // The exclusivity cuts are a conjunction: they run in the order measured on the first entries
+  // of each dataset (cheapest rejection first), the selected events are the same as with the fixed
+  // order. Rejection rates differ between inbending, outbending and MC samples, so every dataset
+  // has its own chain, kept in <outputDir>/final_dvcs_cutorder_<dataset>.txt and re-measured when
+  // the cuts change.
+  static const std::vector<std::pair<std::string, std::string>> criteria = {
       // 4. Q2 > 1
-      .Filter("Q2 > 1.0", "Cut: Q2 > 1 GeV^2")
-      .Filter("t < 1.0", "Cut: t > 1 GeV^2")
-      //.Filter("recel_p > 6.0", "Cut: recel_p > 0.6")
+      {"Q2 > 1.0", "Cut: Q2 > 1 GeV^2"},
+      {"t < 1.0", "Cut: t > 1 GeV^2"},
+      //{"recel_p > 6.0", "Cut: recel_p > 0.6"},
 
       // 5. W > 2
-      .Filter("W > 2.0", "Cut: W > 1.8 GeV")
-      //.Filter("phi > 100.0 && phi < 300 ", "Cut: phi")
-
-
-  // 6. Electron and photon in different sectors
-  //.Filter("ele_sector != pho_sector", "Cut: e and gamma in different sectors")
-
-  // 7. Proton and photon in different sectors if ECAL hit
-  //.Filter(
-  //    [](int p_sec, int g_sec, bool has_ecal_hit) {
-  //     return (p_sec != g_sec) || !has_ecal_hit;
-  //   },
-  //  {"pro_sector", "pho_sector", "pro_has_ECAL_hit"},
-  //  "Cut: p and gamma different sector if ECAL hit")
-  //
-  // 9. 3σ exclusivity cuts
-  //.Filter("Mx2_ep > -1.5 && Mx2_ep < 1.5", "Cut: MM^2(ep) in 3sigma")
-  .Filter("Emiss < 1.0", "Cut: Missing energy")
-  .Filter("PTmiss < 0.15", "Cut: Transverse missing momentum")
-  .Filter("Theta_e_gamma > 5 ", "Cut: Theta_e_gamma")
-  .Filter("Theta_gamma_gamma < 0.7", "Cut: photon-missing angle")
-  //.Filter("DeltaPhi < 25.0", "Cut: Coplanarity");
-  .Filter("(pho_det_region==0&&pro_det_region==2)||(pho_det_region==1&&pro_det_region==1)||(pho_det_region==1&&pro_det_region==2)", "Cut: three config");
-  //.Filter("(pho_det_region==0&&pro_det_region==2&&PTmiss<0.28)||(pho_det_region==1&&pro_det_region==1&&PTmiss<0.46)||(pho_det_region==1&&pro_det_region==2&&PTmiss<0.23)", "Cut: PTmiss in 3sigma")
-  //.Filter("(pho_det_region==0&&pro_det_region==2&&Emiss<1.15&&Emiss>-0.95)||(pho_det_region==1&&pro_det_region==1&&Emiss<1.23&&Emiss>-0.99)||(pho_det_region==1&&pro_det_region==2&&Emiss<1.2&&Emiss>-0.96)", "Cut: Emiss in 3sigma")
-  //.Filter("(pho_det_region==0&&pro_det_region==2&&Mx2_eg<3.38&&Mx2_eg>-0.76)||(pho_det_region==1&&pro_det_region==1&&Mx2_eg<2.52&&Mx2_eg>-0.48)||(pho_det_region==1&&pro_det_region==2&&Mx2_eg<2.81&&Mx2_eg>-0.67)", "Cut: Mx2_eg in 3sigma");
-
-  // 10. Quality Assurance Cut
-  //.Filter("REC_Event_pass == true", "Cut: QA pass");
+      {"W > 2.0", "Cut: W > 1.8 GeV"},
+      //{"phi > 100.0 && phi < 300 ", "Cut: phi"},
+
+      // 6. Electron and photon in different sectors
+      //{"ele_sector != pho_sector", "Cut: e and gamma in different sectors"},
+
+      // 7. Proton and photon in different sectors if ECAL hit
+      //{"(pro_sector != pho_sector) || !pro_has_ECAL_hit", "Cut: p and gamma different sector if ECAL hit"},
+      //
+      // 9. 3σ exclusivity cuts
+      //{"Mx2_ep > -1.5 && Mx2_ep < 1.5", "Cut: MM^2(ep) in 3sigma"},
+      {"Emiss < 1.0", "Cut: Missing energy"},
+      {"PTmiss < 0.15", "Cut: Transverse missing momentum"},
+      {"Theta_e_gamma > 5 ", "Cut: Theta_e_gamma"},
+      {"Theta_gamma_gamma < 0.7", "Cut: photon-missing angle"},
+      //{"DeltaPhi < 25.0", "Cut: Coplanarity"},
+      {"(pho_det_region==0&&pro_det_region==2)||(pho_det_region==1&&pro_det_region==1)||(pho_det_region==1&&pro_det_region==2)", "Cut: three config"},
+      //{"(pho_det_region==0&&pro_det_region==2&&PTmiss<0.28)||(pho_det_region==1&&pro_det_region==1&&PTmiss<0.46)||(pho_det_region==1&&pro_det_region==2&&PTmiss<0.23)", "Cut: PTmiss in 3sigma"},
+      //{"(pho_det_region==0&&pro_det_region==2&&Emiss<1.15&&Emiss>-0.95)||(pho_det_region==1&&pro_det_region==1&&Emiss<1.23&&Emiss>-0.99)||(pho_det_region==1&&pro_det_region==2&&Emiss<1.2&&Emiss>-0.96)", "Cut: Emiss in 3sigma"},
+      //{"(pho_det_region==0&&pro_det_region==2&&Mx2_eg<3.38&&Mx2_eg>-0.76)||(pho_det_region==1&&pro_det_region==1&&Mx2_eg<2.52&&Mx2_eg>-0.48)||(pho_det_region==1&&pro_det_region==2&&Mx2_eg<2.81&&Mx2_eg>-0.67)", "Cut: Mx2_eg in 3sigma"},
+
+      // 10. Quality Assurance Cut
+      //{"REC_Event_pass == true", "Cut: QA pass"},
+  };
+  static std::map<std::string, DISANAfilterchain> finalDVCS;
+  auto [it, added] = finalDVCS.try_emplace(dataset, criteria);
+  DISANAfilterchain& chain = it->second;
+  const std::string cutOrderFile = outputDir + "/final_dvcs_cutorder_" + dataset + ".txt";
+  if (added && !chain.Load(cutOrderFile)) {
+    chain.Calibrate(df);
+    chain.Save(cutOrderFile);
+  }
+  return chain.Apply(df);
 }
 /*
 void CreateCorrectionHistogram4D(ROOT::RDF::RNode df_dvcs_mc, ROOT::RDF::RNode df_pi0_mc, ROOT::RDF::RNode df_dvcs_data, ROOT::RDF::RNode df_pi0_data,